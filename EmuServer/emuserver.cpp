@@ -12,8 +12,12 @@
 //------------------------------------------------------------------------------
 
 
+#include <algorithm>
 #include <fstream>
+#include <iterator>
+#include <sstream>
 #include <cstdio>
+#include <cstring>
 #include <thread>
 
 #include "constants.h"
@@ -24,6 +28,7 @@ using namespace std;
 #if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
 #include <csignal>
 #include <unistd.h>
+#include <sys/stat.h>
 #define GetCurrentDir getcwd
 #endif
 #if defined(PLATFORM_WINDOWS)
@@ -36,27 +41,58 @@ using namespace std;
 #include "flags.h"
 #include "filesystem.h"
 #include "log.h"
+#include "misc.h"
 #include "platform.h"
 #include "platformfactory.h"
 #include "protocolhandler.h"
+#include "sessionserver.h"
+#include "guestmemory.h"
 #include "version.h"
 #include "iservershared.h"
 
 #include "link.h"
 #include "inmemorylink.h"
+#include "recordinglink.h"
 
 #include "cpu.h"
 #include "memory.h"
+#include "networkemulator.h"
 
 // global variables
 static char *progName;
-WORD32 flags;
+// Holds the flags set from the command line, given to each node of the network.
+ControlBlock *myControl = nullptr;
 long ramSize = DefaultMemSize;
-InMemoryLinkFactory *inMemoryLinkFactory = nullptr;
-Memory * myMemory = nullptr;
-CPU * myCPU = nullptr;
+int nodeCount = 1;
+// If non-zero, the nodes run on a pool of this many host threads, rather than one each.
+int hostThreads = 0;
+int budget = NetworkEmulator::DefaultBudget;
+// If non-zero, the network runs in PDES mode, with bytes taking this many cycles to cross a link.
+WORD32 linkLatency = 0;
+// If non-zero, the network runs in lockstep, this many cycles at a time.
+WORD32 lockstepQuantum = 0;
+// If non-zero, the root and the IServer take turns on the main thread, the root running this many instructions a turn.
+int cooperativeBudget = 0;
+// The host's input to the network may be recorded to a file, or replayed from one instead of serving the IServer
+// protocol, tracing (with the debug flags given) only once traceFrom bytes have been replayed.
+std::string recordFile;
+std::string replayFile;
+long traceFrom = 0;
+WORD32 traceFlags = 0;
+std::vector<NetworkEmulator::Connection> connections;
+// Or the nodes and their wiring may be described by a topology file.
+std::string topologyFile;
+// If non-zero, this many independent copies of the network are run, each served by its own IServer session.
+int farmSize = 0;
+NetworkEmulator * myNetwork = nullptr;
+SessionServer * myFarmServer = nullptr;
 SymbolTable * mySymbolTable = nullptr;
 set<WORD32> breakpointAddresses;
+map<WORD32, WORD32> watchpointRanges;
+std::string snapshotFile;
+// A program may be loaded directly into the root's memory: a raw image at an address, or the start of a boot file.
+std::string imageFile;
+WORD32 imageAddress = 0;
 map<std::string, WORD32> symbolToAddress;
 
 bool processCommandLine(int argc, char *argv[]) {
@@ -80,6 +116,201 @@ bool processCommandLine(int argc, char *argv[]) {
 					}
 					programCommandLine += std::string(argv[i]);
 					break;
+				case '-': {
+					const char *value;
+					if (strcmp(argv[i], "--") == 0) {
+						// The rest are the program's, whatever they look like.
+						for (i++; i < argc; i++) {
+							if (!programCommandLine.empty()) {
+								programCommandLine += " ";
+							}
+							programCommandLine += std::string(argv[i]);
+						}
+					} else if ((value = longOptionValue(argv[i], "farm")) != nullptr) {
+						// Not -F, which is temulate's clone list.
+#if defined(PLATFORM_WINDOWS)
+						if (sscanf_s(value, "%d", &farmSize) != 1 || farmSize < 1) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+						if (sscanf(value, "%d", &farmSize) != 1 || farmSize < 1) {
+#endif
+							logFatal("--farm must be given the number of boards e.g. --farm=100");
+							return false;
+						}
+					} else if ((value = longOptionValue(argv[i], "cache")) != nullptr) {
+						if (!createFileCache(std::string(value))) {
+							return false;
+						}
+					} else if ((value = longOptionValue(argv[i], "nodes")) != nullptr) {
+#if defined(PLATFORM_WINDOWS)
+						if (sscanf_s(value, "%d", &nodeCount) != 1 || nodeCount < 1) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+						if (sscanf(value, "%d", &nodeCount) != 1 || nodeCount < 1) {
+#endif
+							logFatal("--nodes must be given the number of nodes e.g. --nodes=16");
+							return false;
+						}
+					} else if ((value = longOptionValue(argv[i], "wire")) != nullptr) {
+						NetworkEmulator::Connection connection {};
+#if defined(PLATFORM_WINDOWS)
+						if (sscanf_s(value, "%d:%d,%d:%d", &connection.nodeA, &connection.linkA, &connection.nodeB, &connection.linkB) == 4) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+						if (sscanf(value, "%d:%d,%d:%d", &connection.nodeA, &connection.linkA, &connection.nodeB, &connection.linkB) == 4) {
+#endif
+							connections.push_back(connection);
+						} else {
+							logFatal("--wire must be given two node:link pairs e.g. --wire=0:1,1:0");
+							return false;
+						}
+					} else if ((value = longOptionValue(argv[i], "topology")) != nullptr) {
+						if (*value != '\0') {
+							topologyFile = std::string(value);
+						} else {
+							logFatal("--topology must be given a topology file e.g. --topology=ring.top");
+							return false;
+						}
+					} else if ((value = longOptionValue(argv[i], "host-threads")) != nullptr) {
+						int matched;
+#if defined(PLATFORM_WINDOWS)
+						matched = sscanf_s(value, "%d,%d", &hostThreads, &budget);
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+						matched = sscanf(value, "%d,%d", &hostThreads, &budget);
+#endif
+						if (matched < 1 || hostThreads < 1 || budget < 1) {
+							logFatal("--host-threads must be given the number of host threads, and optionally a budget e.g. --host-threads=4,4096");
+							return false;
+						}
+					} else if ((value = longOptionValue(argv[i], "pdes")) != nullptr) {
+						linkLatency = NetworkEmulator::DefaultLinkLatency;
+						if (*value != '\0') {
+#if defined(PLATFORM_WINDOWS)
+							if (sscanf_s(value, "%u", &linkLatency) != 1 || linkLatency == 0) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+							if (sscanf(value, "%u", &linkLatency) != 1 || linkLatency == 0) {
+#endif
+								logFatal("--pdes may be given a link latency in cycles e.g. --pdes=22");
+								return false;
+							}
+						}
+					} else if ((value = longOptionValue(argv[i], "lockstep")) != nullptr) {
+						lockstepQuantum = NetworkEmulator::DefaultQuantum;
+						if (*value != '\0') {
+#if defined(PLATFORM_WINDOWS)
+							if (sscanf_s(value, "%u", &lockstepQuantum) != 1 || lockstepQuantum == 0) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+							if (sscanf(value, "%u", &lockstepQuantum) != 1 || lockstepQuantum == 0) {
+#endif
+								logFatal("--lockstep may be given a quantum in cycles e.g. --lockstep=20480");
+								return false;
+							}
+						}
+					} else if ((value = longOptionValue(argv[i], "cooperative")) != nullptr) {
+						cooperativeBudget = NetworkEmulator::DefaultBudget;
+						if (*value != '\0') {
+#if defined(PLATFORM_WINDOWS)
+							if (sscanf_s(value, "%d", &cooperativeBudget) != 1 || cooperativeBudget < 1) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+							if (sscanf(value, "%d", &cooperativeBudget) != 1 || cooperativeBudget < 1) {
+#endif
+								logFatal("--cooperative may be given a number of instructions e.g. --cooperative=4096");
+								return false;
+							}
+						}
+					} else if ((value = longOptionValue(argv[i], "record")) != nullptr) {
+						if (*value != '\0') {
+							recordFile = std::string(value);
+						} else {
+							logFatal("--record must be given a file to record to e.g. --record=run.rec");
+							return false;
+						}
+					} else if ((value = longOptionValue(argv[i], "replay")) != nullptr) {
+						std::string replaySpec(value);
+						const size_t at = replaySpec.find('@');
+						replayFile = replaySpec.substr(0, at);
+						if (replayFile.empty()) {
+							logFatal("--replay must be given a file to replay e.g. --replay=run.rec@123456");
+							return false;
+						}
+						if (at != std::string::npos) {
+#if defined(PLATFORM_WINDOWS)
+							if (sscanf_s(replaySpec.c_str() + at + 1, "%ld", &traceFrom) != 1 || traceFrom < 0) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+							if (sscanf(replaySpec.c_str() + at + 1, "%ld", &traceFrom) != 1 || traceFrom < 0) {
+#endif
+								logFatal("--replay=<F>@ must be followed by a number of bytes e.g. --replay=run.rec@123456");
+								return false;
+							}
+						}
+					} else if ((value = longOptionValue(argv[i], "preload")) != nullptr) {
+						if (!addPreloadImage(std::string(value))) {
+							return false;
+						}
+						SET_FLAGS(DebugFlags_BlockBoot);
+					} else if ((value = longOptionValue(argv[i], "image")) != nullptr) {
+						std::string imageSpec(value);
+						const size_t at = imageSpec.find('@');
+						imageFile = imageSpec.substr(0, at);
+						if (imageFile.empty()) {
+							logFatal("--image must be given a boot file, or an image file and hex address e.g. --image=app.bin@80001000");
+							return false;
+						}
+						if (at != std::string::npos) {
+#if defined(PLATFORM_WINDOWS)
+							if (sscanf_s(imageSpec.c_str() + at + 1, "%x", &imageAddress) != 1) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+							if (sscanf(imageSpec.c_str() + at + 1, "%x", &imageAddress) != 1) {
+#endif
+								logFatalF("Incorrect hex address given to --image: %s", imageSpec.c_str());
+								return false;
+							}
+						}
+					} else if ((value = longOptionValue(argv[i], "snapshot")) != nullptr) {
+						if (*value != '\0') {
+							snapshotFile = std::string(value);
+						} else {
+							logFatal("--snapshot must be given a snapshot file e.g. --snapshot=app.snap");
+							return false;
+						}
+					} else if ((value = longOptionValue(argv[i], "watch")) != nullptr) {
+						char symbolName[40];
+						WORD32 watchAddress = 0;
+						WORD32 watchLength = 4;
+						std::string watchSpec(value);
+						const size_t comma = watchSpec.find(',');
+						const std::string watchAddressSpec = watchSpec.substr(0, comma);
+						if (comma != std::string::npos) {
+#if defined(PLATFORM_WINDOWS)
+							if (sscanf_s(watchSpec.c_str() + comma + 1, "%x", &watchLength) != 1) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+							if (sscanf(watchSpec.c_str() + comma + 1, "%x", &watchLength) != 1) {
+#endif
+								logFatal("--watch length must be a hex number e.g. --watch=8007F123,10");
+								return false;
+							}
+						}
+#if defined(PLATFORM_WINDOWS)
+						if (sscanf_s(watchAddressSpec.c_str(), "%s", sizeof(symbolName), symbolName) == 1 && symbolToAddress.count(symbolName) == 1) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+						if (sscanf(watchAddressSpec.c_str(), "%s", symbolName) == 1 && symbolToAddress.count(symbolName) == 1) {
+#endif
+							watchpointRanges[symbolToAddress[symbolName]] = watchLength;
+#if defined(PLATFORM_WINDOWS)
+						} else if (sscanf_s(watchAddressSpec.c_str(), "%x", &watchAddress) == 1) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+						} else if (sscanf(watchAddressSpec.c_str(), "%x", &watchAddress) == 1) {
+#endif
+							watchpointRanges[watchAddress] = watchLength;
+						} else {
+							logFatal("--watch must be given a hex address or symbol e.g. --watch=8007F123");
+							return false;
+						}
+					} else {
+						if (!programCommandLine.empty()) {
+							programCommandLine += " ";
+						}
+						programCommandLine += std::string(argv[i]);
+					}
+					}
+					break;
 				case 'm':
 					if (strlen(argv[i]) >= 3) {
 #if defined(PLATFORM_WINDOWS)
@@ -313,11 +544,53 @@ void usage() {
 	logInfo("  -b<H> Add H (a hex address or symbol) as a breakpoint (can be repeated)");
 	logInfo("        (Note: symbols must have been specified first with -s<F> to give");
 	logInfo("         a symbol as a breakpoint)");
+	logInfo("  --preload=<F>@<H> Load image file F into memory at hex address H, with the extended");
+	logInfo("        boot protocol's block pokes, before sending the bootfile (can be repeated)");
+	logInfo("  --watch=<H>[,<L>] Watch L (hex, default 4) bytes of RAM from H (a hex address or");
+	logInfo("        symbol); any access to them enters the monitor (can be repeated)");
+	logInfo("  --snapshot=<F> Resume from the snapshot in file F (saved with the monitor's snap");
+	logInfo("        command) instead of booting");
+	logInfo("  --image=<F>[@<H>] Load raw image file F directly into memory at hex address H, and");
+	logInfo("        start it there, instead of booting over link 0. Without H, F is a boot file:");
+	logInfo("        its first block is loaded directly at MemStart and started, and any more of");
+	logInfo("        it (e.g. for a chain loader) is sent over link 0");
+	logInfo("  --nodes=<N> Emulate a network of N transputers (default 1), each on its own thread.");
+	logInfo("        Node 0 is connected to the IServer by its link 0, and the other nodes");
+	logInfo("        boot from their link 0. Breakpoints, watchpoints, snapshots and the");
+	logInfo("        monitor apply to node 0");
+	logInfo("  --wire=<A>:<a>,<B>:<b> Wire link a of node A to link b of node B (can be repeated)");
+	logInfo("  --topology=<F> Emulate the network described by topology file F, instead of --nodes");
+	logInfo("        and --wire: its nodes' memory and symbols, boot file (if not given) and wiring,");
+	logInfo("        which may be generated (pipeline, ring, mesh, torus, hypercube, tree) or");
+	logInfo("        switched by C004 crossbars");
+	logInfo("  --host-threads=<T>[,<B>] Run the nodes on a pool of T host threads instead, each node");
+	logInfo("        running B instructions (default 4096) at a time, or until it blocks on a link");
+	logInfo("  --pdes[=<L>] Keep the nodes' clocks faithful to a real network (conservative PDES),");
+	logInfo("        each byte taking L cycles (default 22) to cross a link. Runs on a pool of");
+	logInfo("        as many threads as host cores, unless --host-threads is given");
+	logInfo("  --lockstep[=<Q>] Run the nodes deterministically, in lockstep on one thread, Q cycles");
+	logInfo("        (default 20480) at a time");
+	logInfo("  --cooperative[=<B>] Run the root and the IServer on one thread, taking turns: the root");
+	logInfo("        runs until it waits for the IServer, or for B instructions (default 4096), then");
+	logInfo("        the IServer handles what it has sent. A single node only, without");
+	logInfo("        --host-threads, --pdes or --lockstep");
+	logInfo("  --record=<F> Record the IServer's input to the network (including the bootfile) in F");
+	logInfo("  --replay=<F>[@<N>] Replay the input recorded in F instead of serving the IServer");
+	logInfo("        protocol. The -d options only take effect once N bytes have been replayed");
+	logInfo("  --farm=<N> Run a farm of N independent boards, each a copy of the network booted with");
+	logInfo("        the bootfile, all served by this IServer. Each board has its own open files");
+	logInfo("        and root directory, board<n> in the root directory, created if need be.");
+	logInfo("        Exits with the first non-zero exit code of any board");
+	logInfo("  --cache[=<MB>] Serve files opened read-only from a cache of MB megabytes (default 64),");
+	logInfo("        so that files opened repeatedly are read from the host once (shared by a farm)");
+	logInfo("  --    Pass all the arguments after it to the Emulator, even options the EmuServer uses itself");
     logInfo("  -h    Displays this usage summary");
     logInfo("  -l<X> Sets log level. X is one of [diwef] for DEBUG, INFO");
     logInfo("        WARN, ERROR or FATAL. Default is INFO");
     logInfo("  -r<directory> Sets the root directory served by the IServer. Current directory if not given.");
     logInfo("Any options not understood by the EmuServer are stored to be made available to the Emulator.");
+    logInfo("Options beginning -b -d -h -i -j -l -m -M -r -s -x, and the long options above, are the");
+    logInfo("EmuServer's own: give them after -- to pass them on.");
 }
 
 void cleanup() {
@@ -325,13 +598,273 @@ void cleanup() {
 	delete myLink;
 	delete platformFactory;
 	delete linkFactory;
-	delete inMemoryLinkFactory;
-	delete myCPU;
+	delete myNetwork;
 	delete mySymbolTable;
-	delete myMemory;
+	delete myControl;
+	if (fileCache != nullptr) {
+		fileCache->logStatistics();
+		delete fileCache;
+	}
 	fflush(stdout);
 }
 
+// Read the bootstraps of the nodes the topology has booted directly by the host, rather than through the root.
+// Returns false, having logged why, if any can't be read.
+bool readBootstraps(const Topology &topology, std::vector<std::vector<BYTE8>> &bootstraps) {
+    bootstraps.assign(topology.nodes.size(), std::vector<BYTE8>());
+    for (size_t i = 1; i < topology.nodes.size(); i++) {
+        const std::string &bootFile = topology.nodes[i].bootFile;
+        if (bootFile.empty()) {
+            continue;
+        }
+        std::ifstream in(bootFile, std::ifstream::in | std::ifstream::binary);
+        if (!in) {
+            logFatalF("Could not open boot file %s of node %d", bootFile.c_str(), (int) i);
+            return false;
+        }
+        bootstraps[i].assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    return true;
+}
+
+// Replay the IServer's input, recorded with --record, to the network. Being deterministic, the network sends the same
+// output as when recorded, which is discarded. Returns the exit code.
+int replayHostInput() {
+    std::ifstream replay(replayFile, std::ifstream::in | std::ifstream::binary);
+    char magic[RecordingMagicLength];
+    if (!replay.read(magic, RecordingMagicLength) || memcmp(magic, RecordingMagic, RecordingMagicLength) != 0) {
+        logFatalF("%s is not a recording of the IServer's input", replayFile.c_str());
+        return 1;
+    }
+    std::thread discard([] {
+        try {
+            for (;;) {
+                myLink->readByte();
+            }
+        } catch (exception &e) {
+            // The link is reset on termination.
+        }
+    });
+    logInfoF("Replaying the IServer's input from %s", replayFile.c_str());
+    long replayed = 0;
+    char b;
+    try {
+        while (replay.get(b)) {
+            if (replayed == traceFrom && traceFlags != 0) {
+                logInfoF("Tracing from byte %ld of the replay", replayed);
+                myNetwork->requestTrace(traceFlags);
+            }
+            myLink->writeByte(static_cast<BYTE8>(b));
+            replayed++;
+        }
+        logInfoF("Replayed %ld bytes; interrupt to stop", replayed);
+    } catch (exception &e) {
+        logErrorF("Replay stopped after %ld bytes: %s", replayed, e.what());
+    }
+    // Until the network stops by itself, or is interrupted.
+    myNetwork->join();
+    myNetwork->terminate();
+    discard.join();
+    return 0;
+}
+
+// The root's memory, for the IServer's direct requests.
+class RootMemory : public GuestMemory {
+public:
+    explicit RootMemory(Memory *memory): myMemory(memory) {}
+    BYTE8 *map(const WORD32 address, const WORD32 length, const bool forWriting) override {
+        return myMemory->hostAddress(address, length, forWriting);
+    }
+private:
+    Memory *myMemory;
+};
+
+// Start each node of the network on its own thread, or on the pool, the root listening to the other side of the host
+// link.
+void startNetwork(NetworkEmulator *network) {
+    if (linkLatency != 0) {
+        network->setLinkLatency(linkLatency);
+        if (hostThreads == 0) {
+            hostThreads = std::max(1, (int) std::thread::hardware_concurrency());
+        }
+    }
+    if (lockstepQuantum != 0) {
+        network->startLockstep(lockstepQuantum);
+    } else if (hostThreads > 0) {
+        network->startScheduled(hostThreads, budget);
+    } else {
+        network->start();
+    }
+}
+
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+void farmInterruptHandler(int sig) {
+	signal(SIGINT, farmInterruptHandler);
+	logWarn("EmuServer interrupted. Terminating...");
+	if (myFarmServer != nullptr) {
+		myFarmServer->stop();
+	}
+}
+#endif
+
+// Take turns on this thread: the root runs until it waits on a link, or has used its budget, then the IServer handles
+// whatever the root has sent it, so bytes aren't handed between threads on different cores. The bootfile (from
+// offset) is sent first, as the root takes it. Returns the exit code.
+int serveCooperatively(CPU *rootCPU, long bootOffset) {
+    std::vector<BYTE8> boot;
+    if (!bootFile.empty()) {
+        std::ifstream bootStream(bootFile, std::ifstream::in | std::ifstream::binary);
+        if (!bootStream || !bootStream.seekg(bootOffset, ios::beg)) {
+            logFatalF("Could not open boot file %s", bootFile.c_str());
+            return 1;
+        }
+        boot.assign(std::istreambuf_iterator<char>(bootStream), std::istreambuf_iterator<char>());
+    }
+    ProtocolHandler handler(*myLink, *myPlatform, myRootDirectory);
+    handler.setDebug(debugProtocol);
+    RootMemory rootMemory(myNetwork->getMemory(0));
+    if (recordFile.empty()) {
+        handler.setGuestMemory(&rootMemory);
+    }
+    // Set when the root stores a byte on the host link, or takes one.
+    bool rootProgressed = false;
+    myLink->setProgressCallback([&rootProgressed] { rootProgressed = true; });
+    rootCPU->prepareToRun(false);
+    size_t booted = 0;
+    int exitCode = 1;
+    try {
+        while (!finished) {
+            bool progressed = false;
+            rootProgressed = false;
+            while (booted < boot.size() && myLink->tryWriteByte(boot[booted])) {
+                booted++;
+                progressed = true;
+            }
+            if (booted == boot.size()) {
+                progressed = handler.pollFrame() || progressed;
+                if (handler.exitReceived()) {
+                    logDebugF("Received exit code %d", handler.exitCode());
+                    exitCode = handler.exitCode();
+                    break;
+                }
+            }
+            const CPU::RunResult result = rootCPU->run(cooperativeBudget);
+            if (result == CPU::RunResult::Terminated) {
+                break;
+            }
+            // Only this thread can unblock the root, so if neither it nor the IServer has moved a byte over the host
+            // link, the root is waiting for a link that nothing will ever serve.
+            if (result == CPU::RunResult::Blocked && !progressed && !rootProgressed) {
+                logError("The root is deadlocked, waiting for a link that nothing will serve");
+                break;
+            }
+        }
+    } catch (exception &e) {
+        logErrorF("Could not serve the root: %s", e.what());
+    }
+    myLink->setProgressCallback(nullptr);
+    return exitCode;
+}
+
+// Each board's root directory is a directory of the root directory, which is created if it doesn't exist.
+// Returns false, having logged why, if it can't be.
+bool makeBoardDirectory(const std::string &boardDirectory) {
+    try {
+        if (pathIsDir(boardDirectory)) {
+            return true;
+        }
+    } catch (exception &e) {
+        // It doesn't exist.
+    }
+#if defined(PLATFORM_WINDOWS)
+    if (_mkdir(boardDirectory.c_str()) != 0) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+    if (mkdir(boardDirectory.c_str(), 0777) != 0) {
+#endif
+        logFatalF("Could not create board directory '%s': %s", boardDirectory.c_str(), getLastError().c_str());
+        return false;
+    }
+    return true;
+}
+
+// Run farmSize independent copies of the network, all booted with the bootfile, serving them all from one
+// SessionServer rather than a process each. Returns the first non-zero exit code of any board, or 0.
+int runFarm(const Topology &topology, const std::vector<std::vector<BYTE8>> &bootstraps) {
+    std::vector<NetworkEmulator *> boards;
+    std::vector<RootMemory *> rootMemories;
+    myFarmServer = new SessionServer(std::max(2, (int) std::thread::hardware_concurrency()));
+    myFarmServer->setDebug(debugProtocol);
+    // A board's program may carry on after exiting the IServer, but there's no-one left to serve it.
+    myFarmServer->setFinishedCallback([&boards] (const int board) { boards[board]->terminate(); });
+    bool started = true;
+    for (int i = 0; i < farmSize && started; i++) {
+        started = false;
+        const std::string boardDirectory = pathJoin(myRootDirectory, "board" + std::to_string(i));
+        if (!makeBoardDirectory(boardDirectory)) {
+            break;
+        }
+        auto *board = new NetworkEmulator();
+        boards.push_back(board);
+        if (!board->initialise(topology, ramSize, myControl->flags, mySymbolTable)) {
+            logFatalF("Network initialisation failed for board %d", i);
+            break;
+        }
+        startNetwork(board);
+        if (!bootstraps.empty() && !board->bootNodes(bootstraps)) {
+            break;
+        }
+        Platform *platform = platformFactory->createPlatform();
+        platform->setCommandLines(fullCommandLine, programCommandLine);
+        try {
+            platform->initialise();
+        } catch (exception &e) {
+            logFatalF("Could not initialise platform for board %d: %s", i, e.what());
+            delete platform;
+            break;
+        }
+        platform->setConsoleOutputPolicy(CONSOLE_COALESCE);
+        platform->setFileCache(fileCache);
+        rootMemories.push_back(new RootMemory(board->getMemory(0)));
+        myFarmServer->addSession(*board->getHostLink(), platform, boardDirectory, rootMemories.back());
+        if (!bootFile.empty()) {
+            sendFileOverLink(*board->getHostLink(), bootFile, "boot");
+        }
+        started = !finished;
+    }
+
+    int exitCode = 1;
+    if (started) {
+        logInfoF("Started %d board(s)", farmSize);
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+        signal(SIGINT, farmInterruptHandler);
+#endif
+        myFarmServer->run();
+        exitCode = 0;
+        for (int i = 0; i < myFarmServer->sessions() && exitCode == 0; i++) {
+            exitCode = myFarmServer->exitCode(i);
+        }
+    }
+
+    // Any boards still running, if interrupted.
+    for (NetworkEmulator *board: boards) {
+        board->terminate();
+    }
+    for (NetworkEmulator *board: boards) {
+        board->join();
+    }
+    // The sessions' links belong to the boards.
+    delete myFarmServer;
+    myFarmServer = nullptr;
+    for (NetworkEmulator *board: boards) {
+        delete board;
+    }
+    for (RootMemory *rootMemory: rootMemories) {
+        delete rootMemory;
+    }
+    fflush(stdout);
+    return exitCode;
+}
+
 int main(int argc, char *argv[]) {
     progName = argv[0];
     bootFile = "";
@@ -342,7 +875,7 @@ int main(int argc, char *argv[]) {
     monitorLink = false;
     finished = false;
     int exitCode = 0;
-	flags = 0;
+	myControl = new ControlBlock();
 
     if (!processCommandLine(argc, argv)) {
         cleanup();
@@ -361,6 +894,8 @@ int main(int argc, char *argv[]) {
         cleanup();
         exit(1);
     }
+    myPlatform->setConsoleOutputPolicy(CONSOLE_COALESCE);
+    myPlatform->setFileCache(fileCache);
 
 #if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
     logDebug("Setting up signal handlers");
@@ -369,19 +904,12 @@ int main(int argc, char *argv[]) {
     signal(SIGINT, interruptHandler);
 #endif
 
-    // The EmuServer doesn't allow link customisation from the command line. There's only a pair of InMemoryLinks
-    // between IServer and Emulator.
-    inMemoryLinkFactory = new InMemoryLinkFactory(1, 0);
-    myLink = inMemoryLinkFactory->linkA();
-    Link * cpuLink = inMemoryLinkFactory->linkB();
-    // The CPU will initialise its link during the initialise call. The IServer side needs its own initialisation.
-    try {
-        myLink->initialise();
-    } catch (exception &e) {
-        logFatalF("Could not initialise IServer link 1: %s", e.what());
-        cleanup();
-        exit(1);
-    }
+	// Replaying, the tracing asked for is held back until the point of interest.
+	if (!replayFile.empty() && traceFrom > 0) {
+		traceFlags = myControl->flags & (DebugFlags_DebugLevel | DebugFlags_MemAccessDebugLevel | DebugFlags_LinkComms |
+			DebugFlags_Clocks | DebugFlags_Queues | DebugFlags_eForth | DebugFlags_Monitor);
+		myControl->flags &= ~traceFlags;
+	}
 
 	mySymbolTable = new SymbolTable();
 	int symbolCount = 0;
@@ -394,57 +922,150 @@ int main(int argc, char *argv[]) {
 		logInfoF("Added %d symbol(s)", symbolCount);
 	}
 
-    logDebug("Constructing memory...");
-    myMemory = new Memory();
-	if (!myMemory->initialiseROMFileAndSymbolTable(nullptr, mySymbolTable)) {
-		logFatal("Could not initialise memory's symbol table");
-		cleanup();
-		exit(1);
-	}
-    logDebug("Memory constructed");
-
-    logDebug("Initialising memory...");
-    if (!myMemory->initialise(ramSize)) {
-        logFatal("Memory initialisation failed");
+    // The EmuServer doesn't allow link customisation from the command line. Node 0's link 0 is an InMemoryLink
+    // to the IServer, and any other nodes are wired to each other by InMemoryLinks.
+    Topology topology;
+    std::vector<std::vector<BYTE8>> bootstraps;
+    if (!topologyFile.empty()) {
+        if (nodeCount != 1 || !connections.empty()) {
+            logFatal("A topology file cannot be combined with --nodes or --wire");
+            cleanup();
+            exit(1);
+        }
+        if (!topology.load(topologyFile)) {
+            cleanup();
+            exit(1);
+        }
+        if (bootFile.empty() && imageFile.empty()) {
+            bootFile = topology.bootFile;
+        }
+        if (!readBootstraps(topology, bootstraps)) {
+            cleanup();
+            exit(1);
+        }
+    } else {
+        topology.nodes.assign(nodeCount, { 0, "", "" });
+        topology.connections = connections;
+    }
+    if (cooperativeBudget != 0 && (topology.nodes.size() != 1 || hostThreads != 0 || linkLatency != 0 ||
+        lockstepQuantum != 0 || farmSize != 0 || monitorLink || !replayFile.empty() || !preloadImages.empty())) {
+        logFatal("--cooperative runs a single node on the IServer's thread, so cannot be combined with --nodes, --topology, --host-threads, --pdes, --lockstep, --farm, -M, --replay or --preload");
         cleanup();
         exit(1);
     }
-    logDebug("Constructing CPU...");
-    myCPU = new CPU();
-    logDebug("Initialising CPU");
-	myCPU->initialiseSymbolTable(mySymbolTable);
-    Link *cpuLinks[4] = { cpuLink, nullptr, nullptr, nullptr };
-    if (!myCPU->initialise(myMemory, cpuLinks)) {
-        logFatal("CPU initialisation failed");
+    if (farmSize > 0) {
+        if (monitorLink || !replayFile.empty() || !recordFile.empty() || !snapshotFile.empty() || !imageFile.empty() ||
+            !preloadImages.empty() || !breakpointAddresses.empty() || !watchpointRanges.empty() ||
+            (myControl->flags & DebugFlags_Monitor)) {
+            logFatal("--farm serves every board over the IServer protocol, so cannot be combined with -M, --replay, --record, --snapshot, --image, --preload, -b, --watch or -i");
+            cleanup();
+            exit(1);
+        }
+        exitCode = runFarm(topology, bootstraps);
+        cleanup();
+        return exitCode;
+    }
+    logDebug("Constructing network...");
+    myNetwork = new NetworkEmulator();
+    if (!myNetwork->initialise(topology, ramSize, myControl->flags, mySymbolTable)) {
+        logFatal("Network initialisation failed");
         cleanup();
         exit(1);
     }
+    myLink = myNetwork->getHostLink();
+    if (!recordFile.empty()) {
+        myLink = new RecordingLink(myLink, recordFile);
+        try {
+            myLink->initialise();
+        } catch (exception &e) {
+            logFatalF("Could not record the IServer's input: %s", e.what());
+            cleanup();
+            exit(1);
+        }
+        logInfoF("Recording the IServer's input to %s", recordFile.c_str());
+    }
+    CPU *rootCPU = myNetwork->getCPU(0);
 
 	for (WORD32 breakpointAddress : breakpointAddresses) {
-		myCPU->addBreakpoint(breakpointAddress);
+		rootCPU->addBreakpoint(breakpointAddress);
+	}
+	for (auto &watchpointRange: watchpointRanges) {
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		if (!myNetwork->getMemory(0)->addWatchpoint(watchpointRange.first, watchpointRange.second)) {
+			cleanup();
+			exit(1);
+		}
+#else
+		logWarnF("Watchpoints are not supported on this platform; ignoring %08X", watchpointRange.first);
+#endif
+	}
+	long imageConsumed = 0;
+	if (!imageFile.empty()) {
+		if (!snapshotFile.empty() || !preloadImages.empty() || !bootFile.empty()) {
+			logFatal("--image loads the program directly, so cannot be combined with --snapshot, --preload or a bootfile");
+			cleanup();
+			exit(1);
+		}
+		const bool loaded = (imageAddress != 0) ? rootCPU->loadRawImage(imageFile.c_str(), imageAddress)
+											   : rootCPU->loadBootImage(imageFile.c_str(), imageConsumed);
+		if (!loaded) {
+			cleanup();
+			exit(1);
+		}
+		if (imageAddress == 0) {
+			// The rest of it is sent over the link.
+			bootFile = imageFile;
+		}
+	}
+	if (!snapshotFile.empty()) {
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		if (!rootCPU->restoreSnapshot(snapshotFile.c_str())) {
+			cleanup();
+			exit(1);
+		}
+#else
+		logFatal("Snapshots are not supported on this platform");
+		cleanup();
+		exit(1);
+#endif
 	}
 
-    // Start the emulator on a second thread, listening to the other side of the InMemory link.
-    auto *cpuThread = new std::thread([] {
-        logDebug("Start of emulation");
-        myCPU->emulate(false);
-        fflush(stdout);
-        logDebug("End of emulation");
-    });
+    if (cooperativeBudget == 0) {
+        startNetwork(myNetwork);
+    }
+
+    // Nodes the host boots directly are booted all at once, before the root, so it can't disturb them.
+    if (!bootstraps.empty() && !myNetwork->bootNodes(bootstraps)) {
+        cleanup();
+        exit(1);
+    }
 
     // start iserver operations
-    if (!bootFile.empty()) {
-        sendFileOverLink(bootFile, "boot");
+    if (replayFile.empty()) {
+        preloadImagesOverLink();
+    }
+    if (!bootFile.empty() && replayFile.empty() && cooperativeBudget == 0 && !finished) {
+        sendFileOverLink(bootFile, "boot", imageConsumed);
         logDebug("End of boot file send");
     }
 
-    if (monitorLink) {
+    if (!replayFile.empty()) {
+        exitCode = replayHostInput();
+    } else if (cooperativeBudget != 0) {
+        logDebug("Running the root and processing IServer protocol on one thread");
+        exitCode = serveCooperatively(rootCPU, imageConsumed);
+    } else if (monitorLink) {
         logDebug("Monitoring boot link");
         monitorBootLink();
     } else {
         logDebug("Processing IServer protocol");
         auto * myProtocolHandler = new ProtocolHandler(*myLink, *myPlatform, myRootDirectory);
         myProtocolHandler->setDebug(debugProtocol);
+        RootMemory rootMemory(myNetwork->getMemory(0));
+        // A recording is only of the link, so couldn't replay what direct requests read into memory.
+        if (recordFile.empty()) {
+            myProtocolHandler->setGuestMemory(&rootMemory);
+        }
         while (!finished) {
             finished = myProtocolHandler->processFrame();
         }
@@ -452,16 +1073,16 @@ int main(int argc, char *argv[]) {
         logDebugF("Received exit code %d", exitCode);
     }
 
-    try {
-        logDebug("Resetting link");
-        myLink->resetLink();
-    } catch (exception &e) {
-        logErrorF("Could not reset link 0: %s", e.what());
-    }
-
     logDebug("EmuServer stop");
-    cpuThread->join();
-    delete cpuThread;
+    // The program may still be running after it has exited the IServer, and other nodes may be waiting for it.
+    myNetwork->terminate();
+    if (cooperativeBudget != 0) {
+        // As the root's own thread would, it ends its emulation.
+        while (rootCPU->run(cooperativeBudget) == CPU::RunResult::Ran) {
+        }
+    }
+    myNetwork->join();
+    fflush(stdout);
 
     cleanup();
     return exitCode;
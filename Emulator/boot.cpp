@@ -13,6 +13,14 @@
 //------------------------------------------------------------------------------
 
 #include <exception>
+#include <thread>
+#ifdef DESKTOP
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#endif
 
 #include "memloc.h"
 using namespace std;
@@ -28,8 +36,17 @@ Boot::~Boot() = default;
 bool Boot::initialise(Memory *memory, Link *links[4]) {
     myBootLen = 0;
     myMemory = memory;
+    myControl = memory->getControlBlock();
+    bool anyPolled = false;
     for (int i = 0; i < 4; i++) {
         myLinks[i] = links[i];
+        // Unconnected (Null) links can't be polled, and would otherwise deliver endless boot-pokes.
+        myPolled[i] = links[i]->canPoll();
+        anyPolled |= myPolled[i];
+    }
+    if (!anyPolled) {
+        // Links that block can't be polled together, so as before, wait for link 0.
+        myPolled[0] = true;
     }
     return true;
 }
@@ -38,6 +55,10 @@ BYTE8 Boot::bootLen() {
     return myBootLen;
 }
 
+int Boot::bootLinkNo() {
+    return myLinkNo;
+}
+
 // See TTH, p53
 // Transputer Instruction Set - Appendix ("start") states that the first link to receive a
 // byte handles the boot/peek/poke protocol, and that the links are polled in a
@@ -46,82 +67,307 @@ BYTE8 Boot::bootLen() {
 // Note that Parachute is not a microcode emulator, and does not have a reset or
 // analyse 'pin'.
 void Boot::start() {
-    // TODO make use of multiple links, later. Return the link that booted, it'll go in CReg.
-	int linkNo = 0;
-	Link *bootLink = myLinks[linkNo];
+    begin();
+#ifdef DESKTOP
+    // Sleep until one of the polled links progresses, rather than spinning. Shared with the callbacks, which a link
+    // may still be running after they're removed. Links that can poll but don't call back (e.g. StubLinks) are polled
+    // again every PollIntervalMillis.
+    struct Progress {
+        std::mutex mutex;
+        std::condition_variable changed;
+        bool progressed = false;
+    };
+    const std::shared_ptr<Progress> progress = std::make_shared<Progress>();
+    const std::function<void()> callback = [progress] {
+        std::lock_guard<std::mutex> lock(progress->mutex);
+        progress->progressed = true;
+        progress->changed.notify_all();
+    };
+    setPolledProgressCallbacks(callback);
+    try {
+        while (!poll()) {
+            std::unique_lock<std::mutex> lock(progress->mutex);
+            progress->changed.wait_for(lock, std::chrono::milliseconds(PollIntervalMillis),
+                                       [&progress] { return progress->progressed; });
+            progress->progressed = false;
+        }
+    } catch (...) {
+        setPolledProgressCallbacks(nullptr);
+        throw;
+    }
+    setPolledProgressCallbacks(nullptr);
+#else
+    while (!poll()) {
+        std::this_thread::yield();
+    }
+#endif
+}
 
+#ifdef DESKTOP
+void Boot::setPolledProgressCallbacks(const std::function<void()> &callback) {
+    for (int i = 0; i < 4; i++) {
+        if (myPolled[i] && myLinks[i]->canPoll()) {
+            myLinks[i]->setProgressCallback(callback);
+        }
+    }
+}
+#endif
+
+void Boot::begin() {
     myBootLen = 0;
-    BYTE8 ctrl = 0;
-    // Repeatedly read first byte:
-    // 'poke': 0 => read address word, data word, store data word at address
-    // 'peek': 1 => read word, output word at that address
-    // 'boot': x where x>1, x is the length of boot code to read into MemStart onwards
-    // CWG p74 states that the address does not need to be word-aligned.
-    do {
-        try {
-            ctrl = bootLink->readByte();
-            if (IS_FLAG_SET(DebugFlags_LinkComms)) {
-                logDebugF("Boot ctrl byte = %02X", ctrl);
-            }
-            switch (ctrl) {
-                case BOOT_PEEK: // peek
-                    try {
-                        WORD32 addr = bootLink->readWord();
-                        WORD32 value = 0xDEADF00D;
-                        if (myMemory->isLegalMemory(addr)) {
-                            value = myMemory->getWord(addr);
+    myLinkNo = 0;
+    myNextLinkNo = 0;
+    myPhase = BootPhase::Control;
+    myCount = 0;
+    myWord = 0;
+}
+
+// The links are polled in a repeating cycle starting at link 0; the first to deliver a control byte handles the
+// rest of its command.
+bool Boot::pollControl(BYTE8 &ctrl) {
+    for (int i = 0; i < 4; i++) {
+        myLinkNo = myNextLinkNo;
+        myNextLinkNo = (myNextLinkNo + 1) % 4;
+        if (myPolled[myLinkNo] && myLinks[myLinkNo]->tryReadByte(ctrl)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Accumulate a little-endian word, LSB first MSB last, into myWord.
+bool Boot::pollWord(Link *bootLink) {
+    while (myCount < 4) {
+        BYTE8 b;
+        if (!bootLink->tryReadByte(b)) {
+            return false;
+        }
+        myWord |= ((WORD32) b) << (8 * myCount++);
+    }
+    myCount = 0;
+    return true;
+}
+
+// Repeatedly read first byte:
+// 'poke': 0 => read address word, data word, store data word at address
+// 'peek': 1 => read word, output word at that address
+// 'boot': x where x>1, x is the length of boot code to read into MemStart onwards
+// CWG p74 states that the address does not need to be word-aligned.
+// Each phase resumes where it left off, if the link couldn't transfer a byte last time.
+bool Boot::poll() {
+    try {
+        for (;;) {
+            Link *bootLink = myLinks[myLinkNo];
+            switch (myPhase) {
+                case BootPhase::Control: {
+                    BYTE8 ctrl;
+                    if (!pollControl(ctrl)) {
+                        return false;
+                    }
+                    if (IS_FLAG_SET(DebugFlags_LinkComms)) {
+                        logDebugF("Boot ctrl byte = %02X from link %d", ctrl, myLinkNo);
+                    }
+                    myCount = 0;
+                    myWord = 0;
+                    switch (ctrl) {
+                        case BOOT_PEEK:
+                            myPhase = BootPhase::PeekAddress;
+                            break;
+                        case BOOT_POKE:
+                            myPhase = BootPhase::PokeAddress;
+                            break;
+                        case BOOT_BLOCK_POKE:
+                        case BOOT_BLOCK_PEEK:
+                            if (IS_FLAG_SET(DebugFlags_BlockBoot)) {
+                                myBlockPeek = (ctrl == BOOT_BLOCK_PEEK);
+                                myPhase = BootPhase::BlockAddress;
+                                break;
+                            }
+                            // Otherwise, it's a bootstrap length.
+                            myBootLen = ctrl;
+                            myPhase = BootPhase::Code;
+                            break;
+                        default:
+                            myBootLen = ctrl;
                             if (IS_FLAG_SET(DebugFlags_LinkComms)) {
-                                logDebugF("Boot-peek @ %08X = %08X", addr, value);
+                                logDebugF("Primary bootstrap contains 0x%02X bytes", myBootLen);
                             }
-                        } else {
-                            logWarnF("Boot-peek requested read from bad address %08X", addr);
+                            myPhase = BootPhase::Code;
+                            break;
+                    }
+                    }
+                    break;
+                case BootPhase::PeekAddress: {
+                    if (!pollWord(bootLink)) {
+                        return false;
+                    }
+                    const WORD32 addr = myWord;
+                    WORD32 value = 0xDEADF00D;
+                    if (myMemory->isLegalMemory(addr)) {
+                        value = myMemory->getWord(addr);
+                        if (IS_FLAG_SET(DebugFlags_LinkComms)) {
+                            logDebugF("Boot-peek @ %08X = %08X", addr, value);
                         }
-                        bootLink->writeWord(value);
-                    } catch (exception &e) {
-                        logFatalF("I/O failure on link %d during boot-peek: %s", linkNo, e.what());
-                        exit(1);
+                    } else {
+                        logWarnF("Boot-peek requested read from bad address %08X", addr);
+                    }
+                    myWord = value;
+                    myPhase = BootPhase::PeekReply;
                     }
                     break;
-                case BOOT_POKE:
-                    try {
-                        WORD32 addr = bootLink->readWord();
-                        WORD32 value = bootLink->readWord();
-                        if (myMemory->isLegalMemory(addr)) {
-                            myMemory->setWord(addr, value);
-                            if (IS_FLAG_SET(DebugFlags_LinkComms)) {
-                                logDebugF("Boot-poke stored %08X @ %08X", value,  addr);
-                            }
-                        } else {
-                            logWarnF("Boot-poke requested write to bad address %08X value %08X", addr, value);
+                case BootPhase::PeekReply:
+                    // Always output as a little-endian word, LSB first MSB last
+                    while (myCount < 4) {
+                        if (!bootLink->tryWriteByte((myWord >> (8 * myCount)) & 0xff)) {
+                            return false;
                         }
-                    } catch (exception &e) {
-                        logFatalF("I/O failure on link %d during boot-poke: %s", linkNo, e.what());
-                        exit(1);
+                        myCount++;
+                    }
+                    myPhase = BootPhase::Control;
+                    break;
+                case BootPhase::PokeAddress:
+                    if (!pollWord(bootLink)) {
+                        return false;
                     }
+                    myPokeAddress = myWord;
+                    myWord = 0;
+                    myPhase = BootPhase::PokeValue;
                     break;
-                default:
-                    myBootLen = ctrl;
-                    try {
+                case BootPhase::PokeValue:
+                    if (!pollWord(bootLink)) {
+                        return false;
+                    }
+                    if (myMemory->isLegalMemory(myPokeAddress)) {
+                        myMemory->setWord(myPokeAddress, myWord);
                         if (IS_FLAG_SET(DebugFlags_LinkComms)) {
-                            logDebugF("Primary bootstrap contains 0x%02X bytes", myBootLen);
+                            logDebugF("Boot-poke stored %08X @ %08X", myWord, myPokeAddress);
                         }
-                        WORD32 addr = MemStart;
-                        for (int i = 0; i < myBootLen; i++) {
-                            BYTE8 value = bootLink->readByte();
-                            // addr is going to be valid, always. There's always at least
-                            // 0xff bytes of memory after MemStart.
-                            myMemory->setByte(addr++, value);
+                    } else {
+                        logWarnF("Boot-poke requested write to bad address %08X value %08X", myPokeAddress, myWord);
+                    }
+                    myPhase = BootPhase::Control;
+                    break;
+                case BootPhase::BlockAddress:
+                    if (!pollWord(bootLink)) {
+                        return false;
+                    }
+                    myBlockAddress = myWord;
+                    myWord = 0;
+                    myPhase = BootPhase::BlockLength;
+                    break;
+                case BootPhase::BlockLength:
+                    if (!pollWord(bootLink)) {
+                        return false;
+                    }
+                    myBlockLength = myWord;
+                    if (IS_FLAG_SET(DebugFlags_LinkComms)) {
+                        logDebugF("Boot-block-%s of %u bytes @ %08X", myBlockPeek ? "peek" : "poke", myBlockLength,
+                                  myBlockAddress);
+                    }
+                    myBlock.clear();
+                    myCount = 0;
+                    myPhase = myBlockPeek ? BootPhase::BlockPeekReply : BootPhase::BlockPokeData;
+                    break;
+                case BootPhase::BlockPokeData:
+                    while (myBlockLength > 0) {
+                        BYTE8 value;
+                        if (!bootLink->tryReadByte(value)) {
+                            return false;
+                        }
+                        myBlock.push_back(value);
+                        myBlockLength--;
+                        if (myBlock.size() == BlockChunk || myBlockLength == 0) {
+                            storeBlock();
                         }
-                    } catch (exception &e) {
-                        logFatalF("I/O failure on link %d during bootstrap: %s", linkNo, e.what());
-                        exit(1);
                     }
+                    myPhase = BootPhase::Control;
                     break;
+                case BootPhase::BlockPeekReply:
+                    while (myCount < (int) myBlock.size() || myBlockLength > 0) {
+                        if (myCount == (int) myBlock.size()) {
+                            loadBlock();
+                        }
+                        if (!bootLink->tryWriteByte(myBlock[myCount])) {
+                            return false;
+                        }
+                        myCount++;
+                    }
+                    myPhase = BootPhase::Control;
+                    break;
+                case BootPhase::Code:
+                    while (myCount < myBootLen) {
+                        BYTE8 value;
+                        if (!bootLink->tryReadByte(value)) {
+                            return false;
+                        }
+                        // addr is going to be valid, always. There's always at least
+                        // 0xff bytes of memory after MemStart.
+                        myMemory->setByte(MemStart + myCount++, value);
+                    }
+                    logDebugF("Boot done from link %d", myLinkNo);
+                    return true;
             }
-        } catch (exception &e) {
-            logFatalF("Boot failed to read control byte from link %d: %s", linkNo, e.what());
-            exit(1);
         }
-    } while (ctrl <= 1);
-    logDebug("Boot done");
+    } catch (exception &e) {
+        if (myControl->pendingRequests() & Request_Terminate) {
+            // The link was reset to stop a node that was never booted.
+            logDebugF("Boot abandoned on link %d: %s", myLinkNo, e.what());
+            SET_FLAGS(EmulatorState_Terminate);
+            return true;
+        }
+        if (myPhase == BootPhase::Control) {
+            logFatalF("Boot failed to read control byte from link %d: %s", myLinkNo, e.what());
+        } else {
+            logFatalF("I/O failure on link %d during %s: %s", myLinkNo, phaseName(), e.what());
+        }
+        exit(1);
+    }
+}
+
+// Store the data of a block poke received so far, in one copy.
+void Boot::storeBlock() {
+    const WORD32 length = (WORD32) myBlock.size();
+    if (!myMemory->writeBlock(myBlockAddress, myBlock.data(), length)) {
+        logWarnF("Boot-block-poke requested write to bad addresses %08X-%08X", myBlockAddress,
+                 myBlockAddress + length - 1);
+    }
+    myBlockAddress += length;
+    myBlock.clear();
+}
+
+// Fetch the next part of a block peek's reply, in one copy.
+void Boot::loadBlock() {
+    const WORD32 length = (myBlockLength < BlockChunk) ? myBlockLength : BlockChunk;
+    myBlock.resize(length);
+    if (!myMemory->readBlock(myBlockAddress, myBlock.data(), length)) {
+        logWarnF("Boot-block-peek requested read from bad addresses %08X-%08X", myBlockAddress,
+                 myBlockAddress + length - 1);
+        // As a single peek would, reply with 0xDEADF00D.
+        for (WORD32 i = 0; i < length; i++) {
+            myBlock[i] = (0xDEADF00D >> (8 * ((myBlockAddress + i) & 3))) & 0xff;
+        }
+    }
+    myBlockAddress += length;
+    myBlockLength -= length;
+    myCount = 0;
+}
+
+const char *Boot::phaseName() const {
+    switch (myPhase) {
+        case BootPhase::PeekAddress:
+        case BootPhase::PeekReply:
+            return "boot-peek";
+        case BootPhase::PokeAddress:
+        case BootPhase::PokeValue:
+            return "boot-poke";
+        case BootPhase::BlockAddress:
+        case BootPhase::BlockLength:
+            return myBlockPeek ? "boot-block-peek" : "boot-block-poke";
+        case BootPhase::BlockPokeData:
+            return "boot-block-poke";
+        case BootPhase::BlockPeekReply:
+            return "boot-block-peek";
+        default:
+            return "bootstrap";
+    }
 }
@@ -15,25 +15,56 @@
 #ifndef BOOT_H
 #define BOOT_H
 
+#include <vector>
+
+#include "constants.h"
 #include "memory.h"
 #include "link.h"
 
-const BYTE8 BOOT_PEEK = 1;
-const BYTE8 BOOT_POKE = 0;
-
-
 class Boot {
 public:
     // 2-phase CTOR since there's only one global Boot
     Boot();
     bool initialise(Memory *memory, Link *links[4]);
+    // Handle the protocol until booted, blocking on the link.
     void start();
+    static const int PollIntervalMillis = 100;
+    // Or, without blocking: begin, then poll until it returns true. It returns false when the link can't transfer
+    // any more yet.
+    void begin();
+    bool poll();
     BYTE8 bootLen();
+    // The link the bootstrap arrived on.
+    int bootLinkNo();
     ~Boot();
 private:
+    enum class BootPhase { Control, PeekAddress, PeekReply, PokeAddress, PokeValue, BlockAddress, BlockLength,
+        BlockPokeData, BlockPeekReply, Code };
+    // Block transfers go to or from memory this many bytes at a time.
+    static const WORD32 BlockChunk = 65536;
+    bool pollControl(BYTE8 &ctrl);
+    bool pollWord(Link *bootLink);
+    void storeBlock();
+    void loadBlock();
+    const char *phaseName() const;
+#ifdef DESKTOP
+    void setPolledProgressCallbacks(const std::function<void()> &callback);
+#endif
     Memory *myMemory{};
+    ControlBlock *myControl{};
     Link *myLinks[4]{};
+    bool myPolled[4]{}; // the links that may deliver a control byte
+    int myLinkNo{}; // handling the current command
+    int myNextLinkNo{}; // to be polled for a control byte
     BYTE8 myBootLen{};
+    BootPhase myPhase{BootPhase::Control};
+    int myCount{}; // bytes of the current word, or code, transferred
+    WORD32 myWord{};
+    WORD32 myPokeAddress{};
+    bool myBlockPeek{};
+    WORD32 myBlockAddress{};
+    WORD32 myBlockLength{}; // yet to be transferred to or from memory
+    std::vector<BYTE8> myBlock;
 };
 
 
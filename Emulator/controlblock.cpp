@@ -0,0 +1,85 @@
+//------------------------------------------------------------------------------
+//
+// File        : controlblock.cpp
+// Description : Per-CPU flags, and requests made of the CPU by other threads
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <chrono>
+#include "controlblock.h"
+
+ControlBlock::ControlBlock() : flags(0), myRequests(0), myTraceFlags(0) {
+}
+
+const int ControlBlock::PauseWaitMillis;
+
+void ControlBlock::request(const WORD32 requests) {
+	myRequests.fetch_or(requests, std::memory_order_release);
+	wake();
+}
+
+void ControlBlock::withdraw(const WORD32 requests) {
+	myRequests.fetch_and(~requests, std::memory_order_release);
+	wake();
+}
+
+void ControlBlock::requestFromSignalHandler(const WORD32 requests) {
+	// No locking or notifying here; the paused CPU's wait times out.
+	myRequests.fetch_or(requests, std::memory_order_release);
+}
+
+void ControlBlock::wake() {
+#ifdef DESKTOP
+	{
+		// A CPU that has just found itself still paused is then either waiting, so is notified, or yet to check again.
+		std::lock_guard<std::mutex> guard(myPauseMutex);
+	}
+	myPauseWakeup.notify_all();
+#endif
+}
+
+void ControlBlock::waitWhilePaused() {
+#ifdef DESKTOP
+	std::unique_lock<std::mutex> lock(myPauseMutex);
+	while (pendingRequests() == Request_Pause) {
+		myPauseWakeup.wait_for(lock, std::chrono::milliseconds(PauseWaitMillis));
+	}
+#else
+	while (pendingRequests() == Request_Pause) {
+	}
+#endif
+}
+
+WORD32 ControlBlock::takeRequests() {
+	return myRequests.fetch_and(Request_Pause, std::memory_order_acq_rel);
+}
+
+void ControlBlock::requestTrace(const WORD32 traceFlags) {
+	myTraceFlags.fetch_or(traceFlags, std::memory_order_relaxed);
+	request(Request_Trace);
+}
+
+WORD32 ControlBlock::getTraceFlags() const {
+	return myTraceFlags.load(std::memory_order_relaxed);
+}
+
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+void ControlBlock::requestSnapshot(const std::string &fileName) {
+	{
+		std::lock_guard<std::mutex> guard(mySnapshotMutex);
+		mySnapshotFile = fileName;
+	}
+	request(Request_Snapshot);
+}
+
+std::string ControlBlock::getSnapshotFile() {
+	std::lock_guard<std::mutex> guard(mySnapshotMutex);
+	return mySnapshotFile;
+}
+#endif
@@ -0,0 +1,81 @@
+//------------------------------------------------------------------------------
+//
+// File        : controlblock.h
+// Description : Per-CPU flags, and requests made of the CPU by other threads
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#ifndef _CONTROLBLOCK_H
+#define _CONTROLBLOCK_H
+
+#include <atomic>
+#include <string>
+
+#include "types.h"
+#include "platformdetection.h"
+
+#ifdef DESKTOP
+#include <condition_variable>
+#include <mutex>
+#endif
+
+// Requests that may be made of a running CPU.
+const WORD32 Request_Terminate = 0x01; // Stop emulating
+const WORD32 Request_Pause = 0x02;     // Stop interpreting until the request is withdrawn
+const WORD32 Request_Monitor = 0x04;   // Enter the interactive monitor
+const WORD32 Request_Snapshot = 0x08;  // Save a snapshot to the file given with requestSnapshot
+const WORD32 Request_Trace = 0x10;     // Set the flags given with requestTrace
+
+// Each CPU has a ControlBlock, shared with its Memory and Boot. The flags (see flags.h) are tested on every
+// instruction, and are only changed by the thread running the CPU (or by its owner before emulation starts), so
+// are a plain word.
+// Other threads, and signal handlers, don't touch the flags: they post requests, which the CPU takes at its next
+// safepoint - every CPU::SafepointInterval instructions.
+class ControlBlock {
+	public:
+		ControlBlock();
+		WORD32 flags;
+
+		// Safe to call from any thread. Both wake a paused CPU.
+		void request(WORD32 requests);
+		// A pause remains pending until withdrawn.
+		void withdraw(WORD32 requests);
+		// As request, but safe to call from a signal handler: a paused CPU notices within PauseWaitMillis.
+		void requestFromSignalHandler(WORD32 requests);
+		static const int PauseWaitMillis = 100;
+		// Called by the CPU at a safepoint: returns once the only pending request is no longer a pause.
+		void waitWhilePaused();
+		inline WORD32 pendingRequests() const {
+			return myRequests.load(std::memory_order_acquire);
+		}
+		// Called by the CPU at a safepoint: returns the pending requests, and clears all but a pause.
+		WORD32 takeRequests();
+		// Turn on debug flags part-way through a run, e.g. on reaching the point of interest of a replay.
+		void requestTrace(WORD32 traceFlags);
+		WORD32 getTraceFlags() const;
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+		// Not for use in a signal handler.
+		void requestSnapshot(const std::string &fileName);
+		std::string getSnapshotFile();
+#endif
+	private:
+		std::atomic<WORD32> myRequests;
+		std::atomic<WORD32> myTraceFlags;
+		void wake();
+#ifdef DESKTOP
+		std::mutex myPauseMutex;
+		std::condition_variable myPauseWakeup;
+#endif
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+		std::mutex mySnapshotMutex;
+		std::string mySnapshotFile;
+#endif
+};
+
+#endif // _CONTROLBLOCK_H
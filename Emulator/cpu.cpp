@@ -15,13 +15,28 @@
 using namespace std;
 
 #include <cctype>
+#include <climits>
 #include <cstdlib>
 #include <cstring>
 #include <cstdio>
 #include <string>
+#include <thread>
 
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <vector>
+
+#include "platformdetection.h"
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <map>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
 
 #include "types.h"
 #include "memloc.h"
@@ -129,7 +144,23 @@ inline WORD32 WordAlign(WORD32 addr) {
 CPU::CPU() {
 	logDebug("CPU CTOR");
 	myBoot = nullptr;
+	myControl = nullptr;
+	myCooperative = false;
+	myBooting = false;
+	myEnded = false;
+	myHorizonSet = false;
+	myHorizon = 0;
+	myLinkTransfer.link = nullptr;
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+	myWatching = false;
+#endif
 #ifdef DESKTOP
+	myRestoredFromSnapshot = false;
+	myBootFromImage = false;
+	myImageEntry = myImageLength = 0;
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+	myCloneAddress = 0;
+#endif
 	// Don't forget to initialise the symbol table to something! Client program is responsible for alloc/free of it.
 #endif
 }
@@ -138,6 +169,7 @@ bool CPU::initialise(Memory *memory, Link *links[4]) {
 	int i;
 	bool allLinksOK = true;
 	myMemory = memory;
+	myControl = memory->getControlBlock();
 	for (i = 0; i < 4; i++) {
 		if (links[i] == nullptr) {
 			myLinks[i] = new NullLink(i, false);
@@ -211,6 +243,46 @@ void CPU::seteForthStackAddresses(WORD32 aSPP, WORD32 aRPP) {
     RPP = aRPP;
 }
 
+bool CPU::loadRawImage(const char *fileName, const WORD32 address) {
+	WORD32 length;
+	if (!myMemory->loadImage(fileName, address, 0, LONG_MAX, length)) {
+		return false;
+	}
+	myBootFromImage = true;
+	myImageEntry = address;
+	myImageLength = length;
+	logInfoF("Loaded %u bytes of %s at %08X", length, fileName, address);
+	return true;
+}
+
+bool CPU::loadBootImage(const char *fileName, long &consumed) {
+	ifstream image(fileName, ifstream::in | ifstream::binary);
+	const int control = image.get();
+	if (!image) {
+		logFatalF("Could not read the length of boot file %s", fileName);
+		return false;
+	}
+	// 0 and 1 would be peek and poke requests, not code.
+	if (control < 2) {
+		logFatalF("Boot file %s starts with a %d byte peek or poke, not code", fileName, control);
+		return false;
+	}
+	WORD32 length;
+	if (!myMemory->loadImage(fileName, MemStart, 1, control, length)) {
+		return false;
+	}
+	if (length != (WORD32) control) {
+		logFatalF("Boot file %s has %u bytes of code, rather than %d", fileName, length, control);
+		return false;
+	}
+	myBootFromImage = true;
+	myImageEntry = MemStart;
+	myImageLength = length;
+	consumed = 1 + length;
+	logInfoF("Loaded %u bytes of boot file %s", length, fileName);
+	return true;
+}
+
 void CPU::DumpeForthDiagnostics(int logLevel) {
 	// Shenanigans to build an idea of the currently nested word execution
 	// based on colon words, code words, and words/sequences that have funky
@@ -269,7 +341,7 @@ void CPU::DumpeForthDiagnostics(int logLevel) {
 	}
 
 	// Turn off memory access diagnostics while we access memory...
-	WORD32 oldflags = flags & DebugFlags_MemAccessDebugLevel;
+	WORD32 oldflags = myControl->flags & DebugFlags_MemAccessDebugLevel;
 	CLEAR_FLAGS(DebugFlags_MemAccessDebugLevel);
 
 	// eForth registers from the workspace...
@@ -298,12 +370,23 @@ void CPU::DumpeForthDiagnostics(int logLevel) {
 
 void CPU::addBreakpoint(const WORD32 breakpointAddress) {
 	BreakpointAddresses.insert(breakpointAddress);
+	updateStopAddresses();
 }
 
 void CPU::removeBreakpoint(const WORD32 breakpointAddress) {
 	if (BreakpointAddresses.erase(breakpointAddress) == 0) {
 		logInfoF("Breakpoint not present: %08X", breakpointAddress);
 	}
+	updateStopAddresses();
+}
+
+void CPU::updateStopAddresses() {
+	myStopAddresses = BreakpointAddresses;
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+	if (myCloneAddress != 0) {
+		myStopAddresses.insert(myCloneAddress);
+	}
+#endif
 }
 
 void CPU::showBreakpointAddresses() {
@@ -419,12 +502,12 @@ WORD32 CPU::disassembleRange(WORD32 addr, WORD32 maxlen) {
 				for (i = 0; i < 8 - clen; i++) {
 					strcat_s(line, 256, "   ");
 				}
-				strcat_s(line, 256, disassembleIndirectOperation(cOreg, 0)); // TODO: fix potential BUFFER OVERFLOW
+				strcat_s(line, 256, disassembleIndirectOperation(cOreg, 0, myControl->flags & DebugFlags_DebugLevel)); // TODO: fix potential BUFFER OVERFLOW
 #elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
 				for (i = 0; i < 8 - clen; i++) {
 					strcat(line, "   ");
 				}
-				strcat(line, disassembleIndirectOperation(cOreg, 0)); // TODO: fix potential BUFFER OVERFLOW
+				strcat(line, disassembleIndirectOperation(cOreg, 0, myControl->flags & DebugFlags_DebugLevel)); // TODO: fix potential BUFFER OVERFLOW
 #endif
 				logInfo(line);
 				// initialise for next op
@@ -471,7 +554,7 @@ void CPU::disassembleCurrInstruction(int logLevel) {
 	switch (Instruction) {
 		case D_pfix:
 		case D_nfix:
-			if ((flags & DebugFlags_DebugLevel) >= Debug_OprCodes) {
+			if ((myControl->flags & DebugFlags_DebugLevel) >= Debug_OprCodes) {
 				// The IPtr of this instruction is needed for prefixes
 #ifdef DESKTOP
 				logFormat(logLevel, "#%08X%s: %s", IPtr - 1, 
@@ -485,27 +568,27 @@ void CPU::disassembleCurrInstruction(int logLevel) {
 			}
 			break;
 		case D_opr:
-			if ((flags & DebugFlags_DebugLevel) >= Debug_Disasm) {
-				if ((flags & DebugFlags_DebugLevel) >= Debug_OprCodes) {
+			if ((myControl->flags & DebugFlags_DebugLevel) >= Debug_Disasm) {
+				if ((myControl->flags & DebugFlags_DebugLevel) >= Debug_OprCodes) {
 #ifdef DESKTOP
 					logFormat(logLevel, ">%08X%s: %s", IPtr - 1,
 							mySymbolTable->possibleSymbol(IPtr - 1),
-							disassembleIndirectOperation(Oreg, Areg));
+							disassembleIndirectOperation(Oreg, Areg, myControl->flags & DebugFlags_DebugLevel));
 #endif
 #ifdef EMBEDEDD
 					logFormat(logLevel, ">%08X: %s", IPtr - 1,
-							disassembleIndirectOperation(Oreg, Areg));
+							disassembleIndirectOperation(Oreg, Areg, myControl->flags & DebugFlags_DebugLevel));
 #endif
 				} else {
 					logFormat(logLevel, "#%08X: %s",
 							InstructionStartIPtr,
-							disassembleIndirectOperation(Oreg, Areg));
+							disassembleIndirectOperation(Oreg, Areg, myControl->flags & DebugFlags_DebugLevel));
 				}
 			}
 			break;
 		default: // another direct instruction
-			if ((flags & DebugFlags_DebugLevel) >= Debug_Disasm) {
-				if ((flags & DebugFlags_DebugLevel) >= Debug_OprCodes) {
+			if ((myControl->flags & DebugFlags_DebugLevel) >= Debug_Disasm) {
+				if ((myControl->flags & DebugFlags_DebugLevel) >= Debug_OprCodes) {
 #ifdef DESKTOP
 					logFormat(logLevel, ">%08X%s: %s", IPtr - 1,
 							mySymbolTable->possibleSymbol(IPtr - 1),
@@ -526,8 +609,8 @@ void CPU::disassembleCurrInstruction(int logLevel) {
 
 }
 
-void dumpFlags() {
-	logInfoF("F %08X", flags);
+void dumpFlags(const ControlBlock *myControl) {
+	logInfoF("F %08X", myControl->flags);
 	if (IS_FLAG_SET(EmulatorState_ErrorFlag))
 		logInfo("-- ERROR");
 	if (IS_FLAG_SET(EmulatorState_HaltOnError))
@@ -582,12 +665,21 @@ inline bool CPU::monitor(void) {
 			logInfo("b addr  or  b+ addr  add addr (hex) as a breakpoint");
 			logInfo("b- addr              remove addr (hex) as a breakpoint");
 			logInfo("b?  or  b <no args>  display all breakpoint addresses");
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+			logInfo("w+ addr len          watch len (hex) bytes of RAM from addr (hex); any access to");
+			logInfo("                     them enters the monitor");
+			logInfo("w- addr              remove the watchpoint at addr (hex)");
+			logInfo("w?                   display all watchpoints");
+#endif
 			logInfo("<return>             single-step current instruction");
 			logInfo("r                    display all registers (depends on register display flags)");
 			logInfo("rq                   display queue registers");
 			logInfo("rc                   display clock registers");
 			logInfo("f                    display flags");
 			logInfo("s                    display all state: registers, flags, current disassembly");
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+			logInfo("snap file            save a snapshot to file, restored with -S<file> (emuserver: --snapshot=<file>)");
+#endif
 			logInfo("q                    quit emulator");
 			logInfo("t                    toggle disassembly of opr/memory R/W");
 			logInfo("g                    'go': quit monitor, continue interpretation");
@@ -633,6 +725,22 @@ inline bool CPU::monitor(void) {
 			//logInfoF("dw addr %08X len %08X", CurrDataAddress, CurrDataLen);
 			myMemory->hexDumpWords(CurrDataAddress, CurrDataLen);
 			CurrDataAddress += CurrDataLen;
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		} else if (strncmp("w+", instr, 2) == 0) {
+			if (sscanf(instr, "w+ %x %x", &a1, &a2) == 2) {
+				myMemory->addWatchpoint(a1, a2);
+				myWatching = myMemory->watchpointsSet();
+			} else {
+				logWarn("w+ requires an address and length");
+			}
+		} else if (strncmp("w-", instr, 2) == 0) {
+			if (sscanf(instr, "w- %x", &a1) == 1) {
+				myMemory->removeWatchpoint(a1);
+				myWatching = myMemory->watchpointsSet();
+			}
+		} else if (strncmp("w?", instr, 2) == 0) {
+			myMemory->showWatchpoints();
+#endif
 		} else if (strncmp("w", instr, 1) == 0) {
 			CurrDataAddress = Wdesc_WPtr(Wdesc);
 			if (sscanf(instr, "w %x", &a1) == 1) {
@@ -657,14 +765,27 @@ inline bool CPU::monitor(void) {
 			} else {
 				showBreakpointAddresses();
 			}
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+		} else if (strncmp("snap", instr, 4) == 0) {
+			char snapshotFile[72];
+			if (sscanf(instr, "snap %71s", snapshotFile) == 1) {
+				// The current instruction byte has been fetched but not executed; snapshot the state before the
+				// fetch, so that it is executed on restore. Oreg's low nibble is always clear before a fetch.
+				if (writeSnapshot(snapshotFile, IPtr - 1, Oreg & 0xFFFFFFF0)) {
+					logInfoF("Snapshot saved to %s", snapshotFile);
+				}
+			} else {
+				logWarn("snap requires a file name");
+			}
+#endif
 		} else if (strcmp(instr, "s") == 0) {
 			DumpRegs(LOGLEVEL_DEBUG);
 			DumpQueueRegs(LOGLEVEL_DEBUG);
 			DumpClockRegs(LOGLEVEL_DEBUG, InstCycles+MemCycles);
-			dumpFlags();
+			dumpFlags(myControl);
 			disassembleCurrInstruction(LOGLEVEL_INFO);
 		} else if (strcmp(instr, "f") == 0) {
-			dumpFlags();
+			dumpFlags(myControl);
 		} else if (strcmp(instr, "q") == 0) {
 			SET_FLAGS(EmulatorState_Terminate);
 			return false;
@@ -702,8 +823,15 @@ bool CPU::swapContextForBreakpointInstruction(void) {
 }
 
 inline void CPU::interpret(void) {
-	bool hitBreakpoint = IS_FLAG_SET(EmulatorState_BreakpointInstruction) ||
-						 BreakpointAddresses.count(IPtr) == 1;
+	bool hitBreakpoint = IS_FLAG_SET(EmulatorState_BreakpointInstruction);
+	if (myStopAddresses.count(IPtr) == 1) {
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+		if (IPtr == myCloneAddress) {
+			clone();
+		}
+#endif
+		hitBreakpoint = hitBreakpoint || BreakpointAddresses.count(IPtr) == 1;
+	}
 
 	// Fetch the current instruction
 	CurrInstruction = myMemory->getInstruction(IPtr++);
@@ -735,8 +863,8 @@ inline void CPU::interpret(void) {
 	// set otherwise.
 	InstCycles = 1;
 	// Clear pre-execute flags
-	flags &= FlagMask;
-	flags |= InterpFlagSet;
+	myControl->flags &= FlagMask;
+	myControl->flags |= InterpFlagSet;
 	// No schedule required as of yet. This will point to a process's
 	// workspace if that process should be scheduled, after the
 	// instruction has executed. 0 is a valid workspace, so initialise this to NotProcess_p (mint).
@@ -1139,15 +1267,7 @@ inline void CPU::interpret(void) {
 						}
 						// Now handle input from real links
 						if (myLink != nullptr) {
-							try {
-								WORD32 i;
-								for (i = 0; i < Areg; i++)  {
-									myMemory->setByte(Creg + i, myLink->readByte());
-								}
-							} catch (exception &e) {
-								logErrorF("in failed to read byte from link %d: %s", myLink->getLinkNo(), e.what());
-								SET_FLAGS(EmulatorState_Terminate);
-							}
+							linkInput(myLink, Creg, Areg, "in failed to read byte");
 						}
 					}
 					break;
@@ -1203,17 +1323,13 @@ inline void CPU::interpret(void) {
 						}
 						// Now handle output to real links
 						if (myLink != nullptr) {
-							try {
-								WORD32 i;
-								// Again, need to do something about blockcopy over
-								// the IServer link.... see O_in processing.
-								for (i = 0; i < Areg; i++) {
-									myLink->writeByte(myMemory->getByte(Creg + i));
-								}
-							} catch (exception &e) {
-								logErrorF("out failed to write byte to link %d: %s", myLink->getLinkNo(), e.what());
-								SET_FLAGS(EmulatorState_Terminate);
+							// Again, need to do something about blockcopy over
+							// the IServer link.... see O_in processing.
+							myLinkTransfer.output.clear();
+							for (WORD32 i = 0; i < Areg; i++) {
+								myLinkTransfer.output.push_back(myMemory->getByte(Creg + i));
 							}
+							linkOutput(myLink, "out failed to write byte");
 						}
 					}
 					break;
@@ -1267,12 +1383,8 @@ inline void CPU::interpret(void) {
 						}
 						// Now handle output to real links
 						if (myLink != nullptr) {
-							try {
-								myLink->writeByte((BYTE8)Areg & 0xff);
-							} catch (exception &e) {
-								logErrorF("outbyte failed to write byte to link %d: %s", myLink->getLinkNo(), e.what());
-								SET_FLAGS(EmulatorState_Terminate);
-							}
+							myLinkTransfer.output.assign(1, (BYTE8)Areg & 0xff);
+							linkOutput(myLink, "outbyte failed to write byte");
 						}
 					}
 					break;
@@ -1316,12 +1428,12 @@ inline void CPU::interpret(void) {
 						}
 						// Now handle output to real links
 						if (myLink != nullptr) {
-							try {
-								myLink->writeWord(Areg);
-							} catch (exception &e) {
-								logErrorF("outword failed to write word to link %d: %s", myLink->getLinkNo(), e.what());
-								SET_FLAGS(EmulatorState_Terminate);
+							// Always output as a little-endian word, LSB first MSB last
+							myLinkTransfer.output.clear();
+							for (int i = 0; i < 4; i++) {
+								myLinkTransfer.output.push_back((Areg >> (8 * i)) & 0xff);
 							}
+							linkOutput(myLink, "outword failed to write word");
 						}
 					}
 					break;
@@ -2084,10 +2196,10 @@ inline void CPU::interpret(void) {
 					break;
 					
 				case O_testlds:
-					PUSH(flags);
+					PUSH(myControl->flags);
 					break;
 				case O_teststs:
-					flags = POP();
+					myControl->flags = POP();
 					break;
 				case O_testhardchan:
 					// Parachute software link abstraction does not
@@ -2169,6 +2281,9 @@ inline void CPU::interpret(void) {
 
 				case X_marker:
 					logInfo("*** MARKER ***");
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+					clone();
+#endif
 					// otherwise does nothing
 					break;
 
@@ -2197,6 +2312,24 @@ inline void CPU::interpret(void) {
 
 	} // End of instruction switch
 
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+	// Did this instruction touch a page holding a watched range? If the access was within the range, stop in the
+	// monitor before the next instruction. Either way, protect the page again. Nothing can trap while no watchpoints
+	// are set, so the (volatile) trap flag is only read when some are.
+	if (myWatching && myMemory->watchpointTrapped()) {
+		WORD32 watchAddress;
+		if (myMemory->takeWatchpointHit(watchAddress)) {
+#ifdef DESKTOP
+			logInfoF("*** WATCHPOINT %08X%s accessed by instruction at %08X", watchAddress, mySymbolTable->possibleSymbolString(watchAddress).c_str(), InstructionStartIPtr);
+#else
+			logInfoF("*** WATCHPOINT %08X accessed by instruction at %08X", watchAddress, InstructionStartIPtr);
+#endif
+			SET_FLAGS(DebugFlags_Monitor);
+		}
+		myMemory->rearmWatchpoints();
+	}
+#endif
+
 	// Reset Oreg if that last one wasn't a prefix
 	// TODO: add another flag that is cleared before interpretation and set
 	// on pfix / nfix - this may be quicker than checking the Instruction
@@ -2212,7 +2345,7 @@ inline void CPU::interpret(void) {
 		// TODO is this IPtr the wrong one? It's the next instruction, surely?
 		logFatalF("Bad instruction: #%08X Oreg:#%08X IPtr:%08X %s", Instruction, OldOreg, IPtr,
 				(Instruction == D_opr) ?
-				disassembleIndirectOperation(OldOreg, Areg) :
+				disassembleIndirectOperation(OldOreg, Areg, myControl->flags & DebugFlags_DebugLevel) :
 				disassembleDirectOperation(Instruction, OldOreg)
 			 );
 		DumpRegs(LOGLEVEL_FATAL);
@@ -2318,7 +2451,7 @@ inline void CPU::interpret(void) {
 	// correct value for IPtr gets output... 
 	if (Instruction != D_pfix && Instruction != D_nfix) {
 		InstructionStartIPtr = IPtr;
-		if ((flags & DebugFlags_DebugLevel) >= Debug_DisRegs) {
+		if ((myControl->flags & DebugFlags_DebugLevel) >= Debug_DisRegs) {
 			DumpRegs(LOGLEVEL_DEBUG);
 			if (IS_FLAG_SET(EmulatorState_QueueInstruction))
 				DumpQueueRegs(LOGLEVEL_DEBUG);
@@ -2331,7 +2464,7 @@ inline void CPU::interpret(void) {
 #endif
 
 	// Halt-On-Error and Error flags => terminate
-	if ((flags & (EmulatorState_ErrorFlag | EmulatorState_HaltOnError)) ==
+	if ((myControl->flags & (EmulatorState_ErrorFlag | EmulatorState_HaltOnError)) ==
 		       (EmulatorState_ErrorFlag | EmulatorState_HaltOnError)) {
 		SET_FLAGS(EmulatorState_Terminate);
 		logWarn("Halt-On-Error and Error set. Stopping.");
@@ -2351,17 +2484,103 @@ inline void CPU::interpret(void) {
 // down any link before bootstrap takes place.
 // Note that Parachute is not a microcode emulator, and does not have a reset or
 // analyse 'pin'.
-void CPU::bootFromLink0() {
-	// TODO We're fixed to the Link0 for now until boot.cpp can poll them and return the link it used.
-	// We'll come here with Link0 in Creg.
-	// When boot.cpp returns a link, we'll set Creg to it here.
+void CPU::bootFromLinks() {
 	myBoot->start();
 	bootLen = myBoot->bootLen();
+	Creg = Link0Input + 4 * myBoot->bootLinkNo();
 }
 
 void CPU::emulate(const bool bootFromROM) {
+	myCooperative = false;
+	initialiseEmulation(bootFromROM);
+	logDebug("---- Starting Emulation ----");
+	while (IS_FLAG_CLEAR(EmulatorState_Terminate)) {
+		for (int i = 0; i < SafepointInterval && IS_FLAG_CLEAR(EmulatorState_Terminate); i++) {
+			interpret();
+		}
+		if (myControl->pendingRequests() != 0) {
+			serviceRequests();
+		}
+	}
+	logDebug("---- Ending Emulation ----");
+	endEmulation();
+}
+
+void CPU::prepareToRun(const bool bootFromROM) {
+	myCooperative = true;
+	initialiseEmulation(bootFromROM);
+	logDebug("---- Starting Emulation ----");
+}
+
+CPU::RunResult CPU::run(const int budget) {
+	if (IS_FLAG_CLEAR(EmulatorState_Terminate)) {
+		if (!continueBlockedTransfer()) {
+			return RunResult::Blocked;
+		}
+		for (int i = 0; i < budget && IS_FLAG_CLEAR(EmulatorState_Terminate) && !atHorizon(); i++) {
+			interpret();
+			if ((myBooting || myLinkTransfer.link != nullptr) && !continueBlockedTransfer()) {
+				return RunResult::Blocked;
+			}
+		}
+		// Even at the horizon, so that a node waiting there can be terminated.
+		if (myControl->pendingRequests() != 0) {
+			serviceRequests();
+		}
+	}
+	if (IS_FLAG_SET(EmulatorState_Terminate)) {
+		if (!myEnded) {
+			logDebug("---- Ending Emulation ----");
+			endEmulation();
+		}
+		return RunResult::Terminated;
+	}
+	return atHorizon() ? RunResult::AtHorizon : RunResult::Ran;
+}
+
+void CPU::setHorizon(const WORD32 horizon) {
+	myHorizonSet = true;
+	myHorizon = horizon;
+}
+
+WORD32 CPU::getCycleCount() const {
+	return CycleCount;
+}
+
+bool CPU::awaitingTimedInput() const {
+	if (myBooting) {
+		// Any link it could boot from that's untimed may be the host's.
+		for (Link *link: myLinks) {
+			if (link->canPoll() && link->getLatency() == 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+	return myLinkTransfer.link != nullptr && myLinkTransfer.input && myLinkTransfer.link->getLatency() != 0;
+}
+
+// The clocks wrap, so compare as the timer instructions do.
+bool CPU::atHorizon() const {
+	return myHorizonSet && (SWORD32)(CycleCount - myHorizon) >= 0;
+}
+
+// Time passes while waiting for a link; the quantum is checked after the next instruction.
+void CPU::advanceClockTo(const WORD32 time) {
+	const SWORD32 wait = (SWORD32)(time - CycleCount);
+	if (wait > 0) {
+		CycleCount += wait;
+		CycleCountSinceReset += wait;
+		HiClock = CycleCountSinceReset / 20;
+		LoClock = HiClock / 64;
+	}
+}
+
+// Registers, boot, and diagnostics, before the first instruction.
+void CPU::initialiseEmulation(const bool bootFromROM) {
 #ifdef DESKTOP
 	myBootFromROM = bootFromROM;
+	if (!myRestoredFromSnapshot) {
 #endif
 	// Initialise timing subsystem
 	CycleCount = CycleCountSinceReset = 
@@ -2373,30 +2592,39 @@ void CPU::emulate(const bool bootFromROM) {
 	// the start instruction, in Transputer Instruction Set - Appendix.
 	// That does not include the descheduling bits, FErrorFlag, and does
 	// include the EnableJ0Break flag.
-	flags = flags & (~(EmulatorState_ErrorFlag | EmulatorState_FErrorFlag |
+	myControl->flags = myControl->flags & (~(EmulatorState_ErrorFlag | EmulatorState_FErrorFlag |
 						EmulatorState_HaltOnError |
 						EmulatorState_DeschedulePending |
 						EmulatorState_DescheduleRequired));
 	// Set queue pointers to magic values
 	HiHead = HiTail = LoHead = LoTail = 0xDEADF00D;
-	// Initialise monitor
-	CurrDataAddress = CurrDisasmAddress = MemStart;
-	CurrDataLen = CurrDisasmLen = 64;
 	LastAjwInBytes = 16; // useful, perhaps, until next ajw
 
 	start();
+#ifdef DESKTOP
+	} else {
+		logDebug("---- Resuming from snapshot ----");
+	}
+#endif
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+	// Any given on the command line.
+	myWatching = myMemory->watchpointsSet();
+#endif
+	// Initialise monitor
+	CurrDataAddress = CurrDisasmAddress = MemStart;
+	CurrDataLen = CurrDisasmLen = 64;
 
 	// Go...
 	//
 	InstructionStartIPtr = IPtr;
 
-	if ((flags & DebugFlags_DebugLevel) >= Debug_DisRegs) {
+	if ((myControl->flags & DebugFlags_DebugLevel) >= Debug_DisRegs) {
 		DumpRegs(LOGLEVEL_DEBUG);
 	}
-	if ((flags & DebugFlags_Queues) == DebugFlags_Queues) {
+	if ((myControl->flags & DebugFlags_Queues) == DebugFlags_Queues) {
 		DumpQueueRegs(LOGLEVEL_DEBUG);
 	}
-	if ((flags & DebugFlags_Clocks) == DebugFlags_Clocks) {
+	if ((myControl->flags & DebugFlags_Clocks) == DebugFlags_Clocks) {
 		DumpClockRegs(LOGLEVEL_DEBUG, (WORD32)0);
 	}
 
@@ -2406,24 +2634,416 @@ void CPU::emulate(const bool bootFromROM) {
 		InterpFlagSet |= EmulatorState_TimerInstruction;
 	if (IS_FLAG_SET(DebugFlags_Queues))
 		InterpFlagSet |= EmulatorState_QueueInstruction;
+}
 
-	logDebug("---- Starting Emulation ----");
-	while (IS_FLAG_CLEAR(EmulatorState_Terminate)) {
-		interpret();
-	}
-	logDebug("---- Ending Emulation ----");
-
-	if ((flags & DebugFlags_DebugLevel) >= Debug_DisRegs) {
+void CPU::endEmulation() {
+	myEnded = true;
+	if ((myControl->flags & DebugFlags_DebugLevel) >= Debug_DisRegs) {
 		DumpRegs(LOGLEVEL_DEBUG);
 	}
-	if ((flags & DebugFlags_Queues) == DebugFlags_Queues) {
+	if ((myControl->flags & DebugFlags_Queues) == DebugFlags_Queues) {
 		DumpQueueRegs(LOGLEVEL_DEBUG);
 	}
-	if ((flags & DebugFlags_Clocks) == DebugFlags_Clocks) {
+	if ((myControl->flags & DebugFlags_Clocks) == DebugFlags_Clocks) {
 		DumpClockRegs(LOGLEVEL_DEBUG, (WORD32)0);
 	}
 }
 
+// Link transfers. Emulating, they block until complete. Running cooperatively, they proceed as far as the link
+// allows, and are left pending for run to continue; no further instructions are interpreted until they complete,
+// just as when blocked.
+// On a timed link, each byte output is stamped with the time it reaches the other end, a latency after the last,
+// and the clock of the CPU at each end moves on to it as the byte is transferred.
+void CPU::linkInput(Link *link, const WORD32 address, const WORD32 length, const char *failure) {
+	myLinkTransfer.link = link;
+	myLinkTransfer.input = true;
+	myLinkTransfer.address = address;
+	myLinkTransfer.length = length;
+	myLinkTransfer.done = 0;
+	myLinkTransfer.failure = failure;
+	continueLinkTransfer();
+}
+
+// The bytes to output are in myLinkTransfer.output.
+void CPU::linkOutput(Link *link, const char *failure) {
+	myLinkTransfer.link = link;
+	myLinkTransfer.input = false;
+	myLinkTransfer.length = (WORD32) myLinkTransfer.output.size();
+	myLinkTransfer.done = 0;
+	myLinkTransfer.failure = failure;
+	continueLinkTransfer();
+}
+
+// Returns true when the transfer has completed, or failed (terminating emulation).
+bool CPU::continueLinkTransfer() {
+	LinkTransfer &transfer = myLinkTransfer;
+	try {
+		if (transfer.input) {
+			while (transfer.done < transfer.length) {
+				BYTE8 b;
+				if (myCooperative) {
+					if (!transfer.link->tryReadByte(b)) {
+						return false;
+					}
+				} else {
+					b = transfer.link->readByte();
+				}
+				myMemory->setByte(transfer.address + transfer.done++, b);
+				if (transfer.link->getLatency() != 0) {
+					advanceClockTo(transfer.link->getReadTime());
+				}
+			}
+		} else {
+			const WORD32 latency = transfer.link->getLatency();
+			while (transfer.done < transfer.length) {
+				if (latency != 0) {
+					transfer.link->setWriteTime(CycleCount + latency);
+				}
+				if (myCooperative) {
+					if (!transfer.link->tryWriteByte(transfer.output[transfer.done])) {
+						return false;
+					}
+				} else {
+					transfer.link->writeByte(transfer.output[transfer.done]);
+				}
+				transfer.done++;
+				if (latency != 0) {
+					advanceClockTo(CycleCount + latency);
+				}
+			}
+		}
+	} catch (exception &e) {
+		logFormat(linkFailureLogLevel(), transfer.input ? "%s from link %d: %s" : "%s to link %d: %s",
+			transfer.failure, transfer.link->getLinkNo(), e.what());
+		SET_FLAGS(EmulatorState_Terminate);
+	}
+	transfer.link = nullptr;
+	return true;
+}
+
+// Running cooperatively, continue any boot or link transfer left pending. Returns false if it still can't complete.
+bool CPU::continueBlockedTransfer() {
+	if (myBooting) {
+		if (!myBoot->poll()) {
+			return false;
+		}
+		myBooting = false;
+		// As start does, after booting from a link.
+		bootLen = myBoot->bootLen();
+		Creg = Link0Input + 4 * myBoot->bootLinkNo();
+		Wdesc = WordAlign((WORD32)(IPtr + (WORD32)bootLen)) | 0x1;
+		Link *bootLink = myLinks[myBoot->bootLinkNo()];
+		if (bootLink->getLatency() != 0) {
+			advanceClockTo(bootLink->getReadTime());
+		}
+	}
+	if (myLinkTransfer.link != nullptr) {
+		return continueLinkTransfer();
+	}
+	return true;
+}
+
+// A link transfer that fails because the link was reset while we were being terminated isn't an error.
+int CPU::linkFailureLogLevel() const {
+	return (myControl->pendingRequests() & Request_Terminate) ? LOGLEVEL_DEBUG : LOGLEVEL_ERROR;
+}
+
+// Called between instructions, when another thread has posted requests to the ControlBlock.
+void CPU::serviceRequests() {
+	bool paused = false;
+	for (;;) {
+		const WORD32 requests = myControl->takeRequests();
+		if (requests & Request_Terminate) {
+			logInfo("Termination requested");
+			SET_FLAGS(EmulatorState_Terminate);
+			return;
+		}
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+		if (requests & Request_Snapshot) {
+			const std::string snapshotFile = myControl->getSnapshotFile();
+			if (saveSnapshot(snapshotFile.c_str())) {
+				logInfoF("Snapshot saved to %s", snapshotFile.c_str());
+			}
+		}
+#endif
+		if (requests & Request_Trace) {
+			SET_FLAGS(myControl->getTraceFlags());
+			logInfo("Tracing enabled");
+		}
+		if (requests & Request_Monitor) {
+			SET_FLAGS(DebugFlags_Monitor);
+		}
+		if (!(requests & Request_Pause)) {
+			break;
+		}
+		if (!paused) {
+			logInfo("Emulation paused");
+			paused = true;
+		}
+		// Until the pause is withdrawn, or something else is requested.
+		myControl->waitWhilePaused();
+	}
+	if (paused) {
+		logInfo("Emulation resumed");
+	}
+}
+
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+// Snapshot file layout; all values little-endian 32-bit words:
+//   "PARASNAP", version, register count, registers..., FAreg, FBreg, FCreg (as 64-bit pairs, LS word first),
+//   processor flags, RAM size, ROM size, link types (4), RAM image offset, saved page count, saved page addresses...
+// followed, at the RAM image offset, by a sparse RAM image (see Memory::saveImage).
+static const char SnapshotMagic[8] = { 'P', 'A', 'R', 'A', 'S', 'N', 'A', 'P' };
+static const WORD32 SnapshotVersion = 1;
+// The processor flags that are part of the emulated state, rather than debug settings.
+static const WORD32 SnapshotFlagMask = EmulatorState_ErrorFlag | EmulatorState_HaltOnError | EmulatorState_FErrorFlag |
+	EmulatorState_DeschedulePending | EmulatorState_DescheduleRequired | EmulatorState_J0Break;
+
+static void putSnapshotWord(std::vector<BYTE8> &buffer, const WORD32 w) {
+	buffer.push_back(w & 0xff);
+	buffer.push_back((w >> 8) & 0xff);
+	buffer.push_back((w >> 16) & 0xff);
+	buffer.push_back((w >> 24) & 0xff);
+}
+
+static void putSnapshotReal(std::vector<BYTE8> &buffer, const REAL64 r) {
+	WORD64 bits;
+	memcpy(&bits, &r, sizeof(bits));
+	putSnapshotWord(buffer, (WORD32) (bits & 0xFFFFFFFF));
+	putSnapshotWord(buffer, (WORD32) (bits >> 32));
+}
+
+// Reads the next word of a snapshot, returning false at end of file.
+static bool getSnapshotWord(const int fd, off_t &offset, WORD32 &w) {
+	BYTE8 b[4];
+	if (pread(fd, b, 4, offset) != 4) {
+		return false;
+	}
+	offset += 4;
+	w = (b[3] << 24) | (b[2] << 16) | (b[1] << 8) | b[0];
+	return true;
+}
+
+static bool getSnapshotReal(const int fd, off_t &offset, REAL64 &r) {
+	WORD32 lsw, msw;
+	if (!getSnapshotWord(fd, offset, lsw) || !getSnapshotWord(fd, offset, msw)) {
+		return false;
+	}
+	const WORD64 bits = MakeWORD64(msw, lsw);
+	memcpy(&r, &bits, sizeof(r));
+	return true;
+}
+
+bool CPU::saveSnapshot(const char *fileName) {
+	return writeSnapshot(fileName, IPtr, Oreg);
+}
+
+bool CPU::writeSnapshot(const char *fileName, const WORD32 snapshotIPtr, const WORD32 snapshotOreg) {
+	// Written to a new file that then replaces any old one, since RAM may be mapped from the old one, having been
+	// restored from it.
+	std::string tempFileName = std::string(fileName) + ".XXXXXX";
+	const int fd = mkstemp(&tempFileName[0]);
+	if (fd == -1) {
+		logErrorF("Could not create snapshot %s: %s", fileName, strerror(errno));
+		return false;
+	}
+	fchmod(fd, 0644); // rather than mkstemp's 0600
+	WORD32 * const registers[] = { &Wdesc, &Areg, &Breg, &Creg,
+		&HiHead, &HiTail, &LoHead, &LoTail, &HiTimerHead, &LoTimerHead, &HiTimeout, &LoTimeout,
+		&CycleCount, &CycleCountSinceReset, &HiClock, &LoClock, &LoClockLastQuantumExpiry, &QuantumRemaining,
+		&LastAjwInBytes };
+	const WORD32 registerCount = sizeof(registers) / sizeof(registers[0]);
+
+	std::vector<BYTE8> header(SnapshotMagic, SnapshotMagic + sizeof(SnapshotMagic));
+	putSnapshotWord(header, SnapshotVersion);
+	putSnapshotWord(header, registerCount + 2);
+	putSnapshotWord(header, snapshotIPtr);
+	putSnapshotWord(header, snapshotOreg);
+	for (WORD32 *reg: registers) {
+		putSnapshotWord(header, *reg);
+	}
+	putSnapshotReal(header, FAreg);
+	putSnapshotReal(header, FBreg);
+	putSnapshotReal(header, FCreg);
+	putSnapshotWord(header, myControl->flags & SnapshotFlagMask);
+	putSnapshotWord(header, (WORD32) myMemory->getMemSize());
+	putSnapshotWord(header, (WORD32) myMemory->getROMSize());
+	for (Link *link: myLinks) {
+		putSnapshotWord(header, (WORD32) link->getLinkType());
+	}
+
+	// The RAM image is written first, since the header lists the pages it contains; it follows the header at a
+	// 64KB boundary, so it can be mapped.
+	std::vector<WORD32> savedPages;
+	const WORD32 maxHeaderLength = (WORD32) header.size() + 8 + (4 * (WORD32) (myMemory->getMemSize() / Memory::DirtyPageSize + 1));
+	const off_t imageOffset = (maxHeaderLength + 65535) & ~65535;
+	bool ok = myMemory->saveImage(fd, imageOffset, savedPages);
+	if (ok) {
+		putSnapshotWord(header, (WORD32) imageOffset);
+		putSnapshotWord(header, (WORD32) savedPages.size());
+		for (WORD32 pageAddr: savedPages) {
+			putSnapshotWord(header, pageAddr);
+		}
+		if (pwrite(fd, header.data(), header.size(), 0) != (ssize_t) header.size()) {
+			logErrorF("Could not write snapshot header to %s: %s", fileName, strerror(errno));
+			ok = false;
+		}
+	}
+	close(fd);
+	if (ok && rename(tempFileName.c_str(), fileName) == -1) {
+		logErrorF("Could not replace snapshot %s: %s", fileName, strerror(errno));
+		ok = false;
+	}
+	if (!ok) {
+		unlink(tempFileName.c_str());
+	}
+	if (ok) {
+		logDebugF("Snapshot %s holds %d of %d pages of RAM", fileName, savedPages.size(), myMemory->getMemSize() / Memory::DirtyPageSize);
+	}
+	return ok;
+}
+
+void CPU::setClones(const std::vector<CloneStreams> &clones, const WORD32 cloneAddress) {
+	myClones = clones;
+	myCloneAddress = cloneAddress;
+	updateStopAddresses();
+}
+
+void CPU::clone() {
+	if (myClones.empty()) {
+		return;
+	}
+	std::vector<CloneStreams> clones;
+	clones.swap(myClones); // only clone once
+	myCloneAddress = 0;
+	updateStopAddresses();
+	long maxRunning = sysconf(_SC_NPROCESSORS_ONLN);
+	if (maxRunning < 1) {
+		maxRunning = 1;
+	}
+	logInfoF("Cloning %d emulators at #%08X, %d at a time", clones.size(), InstructionStartIPtr, maxRunning);
+	// Don't let the children inherit (and repeat) buffered output.
+	logFlush();
+	fflush(stdout);
+
+	std::map<pid_t, size_t> running;
+	int failures = 0;
+	auto waitForOne = [&]() {
+		int status;
+		const pid_t pid = wait(&status);
+		if (pid == -1) {
+			return;
+		}
+		const size_t cloneNo = running[pid];
+		running.erase(pid);
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+			logInfoF("Clone %d (pid %d) finished", cloneNo, pid);
+		} else {
+			logErrorF("Clone %d (pid %d) failed with status %d", cloneNo, pid, status);
+			failures++;
+		}
+	};
+	for (size_t cloneNo = 0; cloneNo < clones.size(); cloneNo++) {
+		while ((long) running.size() >= maxRunning) {
+			waitForOne();
+		}
+		const pid_t pid = fork();
+		if (pid == -1) {
+			logErrorF("Could not fork clone %d: %s", cloneNo, strerror(errno));
+			failures++;
+			break;
+		}
+		if (pid == 0) {
+			// In the child: carry on emulating from here, with the clone's streams.
+			logInfoF("Clone %d (pid %d) input [%s] output [%s]", cloneNo, getpid(), clones[cloneNo].input.c_str(), clones[cloneNo].output.c_str());
+			if (!myLinks[0]->rebindForClone(clones[cloneNo].input, clones[cloneNo].output)) {
+				logFatalF("Link 0 of clone %d cannot be given new streams", cloneNo);
+				fflush(stdout);
+				_exit(1);
+			}
+			return;
+		}
+		running[pid] = cloneNo;
+	}
+	while (!running.empty()) {
+		waitForOne();
+	}
+	logInfoF("All clones finished; %d failed", failures);
+	SET_FLAGS(EmulatorState_Terminate);
+}
+
+bool CPU::restoreSnapshot(const char *fileName) {
+	const int fd = open(fileName, O_RDONLY);
+	if (fd == -1) {
+		logErrorF("Could not open snapshot %s: %s", fileName, strerror(errno));
+		return false;
+	}
+	char magic[sizeof(SnapshotMagic)];
+	off_t offset = sizeof(magic);
+	WORD32 version = 0, registerCount = 0;
+	if (pread(fd, magic, sizeof(magic), 0) != sizeof(magic) || memcmp(magic, SnapshotMagic, sizeof(magic)) != 0 ||
+		!getSnapshotWord(fd, offset, version) || version != SnapshotVersion) {
+		logErrorF("%s is not a version %d snapshot", fileName, SnapshotVersion);
+		close(fd);
+		return false;
+	}
+	WORD32 * const registers[] = { &IPtr, &Oreg, &Wdesc, &Areg, &Breg, &Creg,
+		&HiHead, &HiTail, &LoHead, &LoTail, &HiTimerHead, &LoTimerHead, &HiTimeout, &LoTimeout,
+		&CycleCount, &CycleCountSinceReset, &HiClock, &LoClock, &LoClockLastQuantumExpiry, &QuantumRemaining,
+		&LastAjwInBytes };
+	bool ok = getSnapshotWord(fd, offset, registerCount) && registerCount == sizeof(registers) / sizeof(registers[0]);
+	for (WORD32 *reg: registers) {
+		ok = ok && getSnapshotWord(fd, offset, *reg);
+	}
+	ok = ok && getSnapshotReal(fd, offset, FAreg) && getSnapshotReal(fd, offset, FBreg) && getSnapshotReal(fd, offset, FCreg);
+	WORD32 snapshotFlags = 0, ramSize = 0, romSize = 0, imageOffset = 0, pageCount = 0;
+	WORD32 linkTypes[4] = { 0, 0, 0, 0 };
+	ok = ok && getSnapshotWord(fd, offset, snapshotFlags) &&
+		getSnapshotWord(fd, offset, ramSize) && getSnapshotWord(fd, offset, romSize);
+	for (WORD32 &linkType: linkTypes) {
+		ok = ok && getSnapshotWord(fd, offset, linkType);
+	}
+	ok = ok && getSnapshotWord(fd, offset, imageOffset) && getSnapshotWord(fd, offset, pageCount);
+	if (!ok) {
+		logErrorF("Snapshot %s is truncated or corrupt", fileName);
+		close(fd);
+		return false;
+	}
+	if (ramSize != (WORD32) myMemory->getMemSize() || romSize != (WORD32) myMemory->getROMSize()) {
+		logErrorF("Snapshot %s was taken with %d bytes of RAM and a %d byte ROM; this emulator has %d and %d",
+			fileName, ramSize, romSize, myMemory->getMemSize(), myMemory->getROMSize());
+		close(fd);
+		return false;
+	}
+	// No transfer is in progress at a safepoint, so the links have no state of their own to restore, but the program
+	// expects whatever it was talking to.
+	for (int i = 0; i < 4; i++) {
+		if (linkTypes[i] != (WORD32) myLinks[i]->getLinkType()) {
+			logErrorF("Snapshot %s was taken with link %d of type %d; this emulator's is of type %d",
+				fileName, i, linkTypes[i], myLinks[i]->getLinkType());
+			close(fd);
+			return false;
+		}
+	}
+	std::vector<WORD32> savedPages(pageCount);
+	for (WORD32 &pageAddr: savedPages) {
+		ok = ok && getSnapshotWord(fd, offset, pageAddr);
+	}
+	ok = ok && myMemory->restoreImage(fd, imageOffset, savedPages);
+	// The mapping holds its own reference to the file.
+	close(fd);
+	if (!ok) {
+		logErrorF("Could not restore RAM from snapshot %s", fileName);
+		return false;
+	}
+	myControl->flags = (myControl->flags & ~SnapshotFlagMask) | (snapshotFlags & SnapshotFlagMask);
+	bootLen = 0;
+	myRestoredFromSnapshot = true;
+	logInfoF("Restored snapshot %s: IPtr #%08X Wdesc #%08X", fileName, IPtr, Wdesc);
+	return true;
+}
+#endif
+
 // Executed from emulate, above, and also on receipt of a start instruction.
 void CPU::start() {
 #ifdef DESKTOP
@@ -2435,15 +3055,30 @@ void CPU::start() {
 		IPtr = ResetCode;
 		Wdesc = MemStart;
 		Creg = 0xDEADF00D; // CWG states 'undefined'.
+	} else if (myBootFromImage) {
+		// As if the image had been booted from link 0. Only the first start is from it: a later start
+		// instruction boots from the links.
+		logDebug("---- Starting Boot from Image ----");
+		Areg = IPtr;
+		Breg = Wdesc;
+		Creg = Link0Input;
+		IPtr = myImageEntry;
+		Wdesc = WordAlign(myImageEntry + myImageLength);
+		myBootFromImage = false;
 	} else {
 #endif
 		logDebug("---- Starting Boot from Links ----");
 		IPtr = MemStart;
 		Areg = IPtr;
 		Breg = Wdesc;
-		Creg = Link0Input; // The default IServer link input
-		// TODO set Creg to the link boot.cpp finds, when it uses multiple ones.
-		bootFromLink0();
+		Creg = Link0Input; // Until a link delivers the bootstrap.
+		if (myCooperative) {
+			// run completes the boot, as the link allows.
+			myBoot->begin();
+			myBooting = true;
+			return;
+		}
+		bootFromLinks();
 		// NB: CWG p74 states Areg is set to the previous value of IPtr, Breg the previous of Wdesc,
 		// Creg a pointer to the link the Transputer booted from.
 		// The initial workspace is the first free word of memory. A low priority process.
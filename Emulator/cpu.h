@@ -16,6 +16,8 @@
 
 #include <set>
 #include <deque>
+#include <string>
+#include <vector>
 
 #include "types.h"
 #include "memory.h"
@@ -24,6 +26,7 @@
 #include "platformdetection.h"
 #include "symbol.h"
 #include "boot.h"
+#include "controlblock.h"
 
 class CPU {
 	public:
@@ -36,15 +39,54 @@ class CPU {
 #ifdef DESKTOP
 		void initialiseSymbolTable(SymbolTable *symbolTable);
 		void seteForthStackAddresses(WORD32 SPP, WORD32 RPP);
+		// Rather than being sent over a link, a program can be loaded straight into memory before emulate, which
+		// then starts it as if it had just been booted. A raw image is loaded at, and started from, address.
+		// A boot file's first block is loaded at MemStart; consumed is set to the bytes of the file used, so
+		// that the rest (e.g. for a chain loader) can then be sent over a link.
+		bool loadRawImage(const char *fileName, WORD32 address);
+		bool loadBootImage(const char *fileName, long &consumed);
 #endif
 		void addBreakpoint(WORD32 breakpointAddress);
 		void removeBreakpoint(WORD32 breakpointAddress);
 		void emulate(const bool bootFromROM);
+		// Alternatively, to share a host thread with other CPUs: prepare, then call run repeatedly until it
+		// returns Terminated. It interprets up to budget instructions, returning Blocked early if a link can't
+		// transfer (in which case the link's progress callback is called when it might), or AtHorizon once its
+		// clock reaches the horizon, if one has been set.
+		enum class RunResult { Ran, Blocked, AtHorizon, Terminated };
+		void prepareToRun(const bool bootFromROM);
+		RunResult run(int budget);
+		// In PDES mode, the network's nodes keep their clocks within a window: run stops at the horizon, until
+		// it is moved on.
+		void setHorizon(WORD32 horizon);
+		WORD32 getCycleCount(void) const;
+		// Blocked waiting for a byte from a timed link, so the clock can't move until that byte's stamp.
+		bool awaitingTimedInput(void) const;
 		void start();
+		// Requests posted to the ControlBlock (shared with the Memory given to initialise) are acted upon after
+		// this many instructions.
+		static const int SafepointInterval = 1024;
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+		// Snapshots hold the registers, queues, clocks, processor flags and RAM. Restore one before calling
+		// emulate, which then resumes from it rather than booting. The state of the links' far ends isn't part of
+		// a snapshot, so take them when no link transfer is in progress.
+		bool saveSnapshot(const char *fileName);
+		bool restoreSnapshot(const char *fileName);
+		// Cloning: when the program executes a marker instruction, or reaches cloneAddress (if non-zero), the
+		// emulator forks a child per CloneStreams, each continuing from that point with its own link 0 input and
+		// output. The parent waits for the children (running as many at once as there are host cores), then
+		// terminates. Memory is shared copy-on-write between them.
+		struct CloneStreams {
+			std::string input;
+			std::string output;
+		};
+		void setClones(const std::vector<CloneStreams> &clones, WORD32 cloneAddress);
+#endif
 		~CPU();
 	private:
 		// Dynamically allocated memory
 		Memory *myMemory;
+		ControlBlock *myControl;
 		Link *myLinks[4];
 		Boot *myBoot;
 		// All registers
@@ -73,6 +115,22 @@ class CPU {
 		WORD32 InstructionStartIPtr; // Start of instruction, for disassembly
 		// Bootstrap storage
 		BYTE8 bootLen;
+		// Cooperative running: a boot, or link transfer, waiting for the link
+		bool myCooperative;
+		bool myBooting;
+		bool myEnded;
+		bool myHorizonSet;
+		WORD32 myHorizon;
+		struct LinkTransfer {
+			Link *link; // nullptr if there's no transfer in progress
+			bool input;
+			WORD32 address; // input destination
+			std::vector<BYTE8> output;
+			WORD32 length;
+			WORD32 done;
+			const char *failure;
+		};
+		LinkTransfer myLinkTransfer;
 		// Monitor usage
 		WORD32 CurrDataAddress;
 		WORD32 CurrDataLen;
@@ -80,8 +138,25 @@ class CPU {
 		WORD32 CurrDisasmLen;
 		WORD32 LastAjwInBytes;
 		set<WORD32> BreakpointAddresses;
+		// The addresses each instruction is checked against: the breakpoints, and the clone address, so that reaching
+		// the latter costs nothing beyond the breakpoint check.
+		set<WORD32> myStopAddresses;
+		void updateStopAddresses();
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		// True while any watchpoints are set, so that only then need each instruction look for a trapped access.
+		// Updated when emulation starts, and when the monitor sets or removes them.
+		bool myWatching;
+#endif
 #ifdef DESKTOP
 		bool myBootFromROM;
+		bool myRestoredFromSnapshot;
+		bool myBootFromImage;
+		WORD32 myImageEntry;
+		WORD32 myImageLength;
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		std::vector<CloneStreams> myClones;
+		WORD32 myCloneAddress;
+#endif
 		SymbolTable *mySymbolTable;
 		// eForth diagnostic; start of data and return stack
 		WORD32 SPP;
@@ -96,9 +171,19 @@ class CPU {
 		inline WORD32 POP(void);
 		inline void PUSH(WORD32 x);
 		inline void interpret(void);
-		inline void bootFromLink0(void);
+		inline void bootFromLinks(void);
 		bool swapContextForBreakpointInstruction(void);
 		inline bool monitor(void);
+		void serviceRequests(void);
+		void initialiseEmulation(bool bootFromROM);
+		void endEmulation(void);
+		void linkInput(Link *link, WORD32 address, WORD32 length, const char *failure);
+		void linkOutput(Link *link, const char *failure);
+		bool continueLinkTransfer(void);
+		bool continueBlockedTransfer(void);
+		inline bool atHorizon(void) const;
+		void advanceClockTo(WORD32 time);
+		int linkFailureLogLevel(void) const;
 
 		void DumpRegs(int logLevel);
 		void DumpQueueRegs(int logLevel) const;
@@ -110,6 +195,10 @@ class CPU {
 		void DumpeForthDiagnostics(int logLevel);
 		inline void bootFromROMFile(const char *fileName);
 #endif
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+		bool writeSnapshot(const char *fileName, WORD32 snapshotIPtr, WORD32 snapshotOreg);
+		void clone();
+#endif
 
 };
 
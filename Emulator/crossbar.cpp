@@ -0,0 +1,216 @@
+//------------------------------------------------------------------------------
+//
+// File        : crossbar.cpp
+// Description : An emulation of the C004 programmable link switch, for
+//               networks of transputers.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <exception>
+using namespace std;
+
+#include "crossbar.h"
+#include "log.h"
+
+Crossbar::Crossbar() : myControl(nullptr), myReplyPending(false), myReply(0), myThread(nullptr), myStopping(false),
+	myProgressed(false) {
+	logDebug("Crossbar CTOR");
+	for (int i = 0; i < Ports; i++) {
+		myPorts[i] = nullptr;
+		myInputs[i] = -1;
+		myPending[i] = 0;
+		myPendingTime[i] = 0;
+		myPendingOutputs[i] = 0;
+	}
+}
+
+void Crossbar::attach(const int port, Link *link) {
+	myPorts[port] = link;
+}
+
+void Crossbar::setControl(Link *link) {
+	myControl = link;
+}
+
+void Crossbar::connect(const int input, const int output) {
+	myInputs[output] = input;
+}
+
+WORD32 Crossbar::outputsOf(const int input) const {
+	WORD32 outputs = 0;
+	for (int output = 0; output < Ports; output++) {
+		if (myInputs[output] == input && myPorts[output] != nullptr) {
+			outputs |= 1U << output;
+		}
+	}
+	return outputs;
+}
+
+void Crossbar::start() {
+	const auto progress = [this] {
+		std::lock_guard<std::mutex> guard(myMutex);
+		myProgressed = true;
+		myProgress.notify_one();
+	};
+	for (Link *link: myPorts) {
+		if (link != nullptr) {
+			link->setProgressCallback(progress);
+		}
+	}
+	if (myControl != nullptr) {
+		myControl->setProgressCallback(progress);
+	}
+	myThread = new std::thread([this] { forward(); });
+}
+
+void Crossbar::forward() {
+	logDebug("Crossbar starting");
+	try {
+		while (!myStopping) {
+			{
+				// Progress from here on is noticed by the wait.
+				std::lock_guard<std::mutex> guard(myMutex);
+				myProgressed = false;
+			}
+			bool progressed = false;
+			if (myControl != nullptr) {
+				BYTE8 b;
+				if (myReplyPending) {
+					if (myControl->tryWriteByte(myReply)) {
+						myReplyPending = false;
+						progressed = true;
+					}
+				} else if (myControl->tryReadByte(b)) {
+					command(b);
+					progressed = true;
+				}
+			}
+			for (int input = 0; input < Ports; input++) {
+				if (myPendingOutputs[input] == 0) {
+					const WORD32 outputs = outputsOf(input);
+					if (outputs == 0 || myPorts[input] == nullptr ||
+						!myPorts[input]->tryReadByte(myPending[input])) {
+						continue;
+					}
+					myPendingTime[input] = myPorts[input]->getReadTime();
+					myPendingOutputs[input] = outputs;
+					progressed = true;
+				}
+				for (int output = 0; output < Ports; output++) {
+					if ((myPendingOutputs[input] & (1U << output)) == 0) {
+						continue;
+					}
+					// In PDES mode, the byte is stamped with the time it reached the switch.
+					myPorts[output]->setWriteTime(myPendingTime[input]);
+					if (myPorts[output]->tryWriteByte(myPending[input])) {
+						myPendingOutputs[input] &= ~(1U << output);
+						progressed = true;
+					}
+				}
+			}
+			if (!progressed) {
+				std::unique_lock<std::mutex> lock(myMutex);
+				myProgress.wait(lock, [this] { return myProgressed || myStopping; });
+			}
+		}
+	} catch (exception &e) {
+		logDebugF("Crossbar link failed: %s", e.what());
+	}
+	logDebug("Crossbar stopping");
+}
+
+void Crossbar::command(const BYTE8 b) {
+	myCommand.push_back(b);
+	const size_t length = myCommand.size();
+	const BYTE8 code = myCommand[0];
+	if (length > 1 && b >= Ports) {
+		logWarnF("Crossbar command %d has an invalid port %d", code, b);
+		myCommand.clear();
+		return;
+	}
+	switch (code) {
+		case 0:
+			if (length == 3) {
+				connect(myCommand[1], myCommand[2]);
+				break;
+			}
+			return;
+		case 1:
+			if (length == 3) {
+				connect(myCommand[1], myCommand[2]);
+				connect(myCommand[2], myCommand[1]);
+				break;
+			}
+			return;
+		case 2:
+			if (length == 2) {
+				const int input = myInputs[myCommand[1]];
+				myReply = (input == -1) ? 0x80 : (BYTE8) input;
+				myReplyPending = true;
+				break;
+			}
+			return;
+		case 4:
+			for (int output = 0; output < Ports; output++) {
+				myInputs[output] = -1;
+			}
+			break;
+		case 5:
+			if (length == 2) {
+				myInputs[myCommand[1]] = -1;
+				break;
+			}
+			return;
+		case 6:
+			if (length == 3) {
+				if (myInputs[myCommand[2]] == myCommand[1]) {
+					myInputs[myCommand[2]] = -1;
+				}
+				if (myInputs[myCommand[1]] == myCommand[2]) {
+					myInputs[myCommand[1]] = -1;
+				}
+				break;
+			}
+			return;
+		default:
+			logWarnF("Crossbar command %d is not known", code);
+			break;
+	}
+	// Bytes already read aren't passed to outputs that are no longer connected to their input.
+	for (int input = 0; input < Ports; input++) {
+		myPendingOutputs[input] &= outputsOf(input);
+	}
+	myCommand.clear();
+}
+
+void Crossbar::stop() {
+	myStopping = true;
+	{
+		std::lock_guard<std::mutex> guard(myMutex);
+		myProgress.notify_all();
+	}
+	if (myThread != nullptr) {
+		myThread->join();
+		delete myThread;
+		myThread = nullptr;
+	}
+	for (Link *link: myPorts) {
+		if (link != nullptr) {
+			link->setProgressCallback(nullptr);
+		}
+	}
+	if (myControl != nullptr) {
+		myControl->setProgressCallback(nullptr);
+	}
+}
+
+Crossbar::~Crossbar() {
+	logDebug("Crossbar DTOR");
+	stop();
+}
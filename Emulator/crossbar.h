@@ -0,0 +1,69 @@
+//------------------------------------------------------------------------------
+//
+// File        : crossbar.h
+// Description : An emulation of the C004 programmable link switch, for
+//               networks of transputers.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#ifndef _CROSSBAR_H
+#define _CROSSBAR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+#include "link.h"
+
+// Each of the 32 ports is a link; bytes arriving on a port are passed on by the port(s) whose outputs are connected
+// to it. The connections can be changed by commands sent to the configuration link, as on the C004:
+//   0 <in> <out>   connect input in to output out
+//   1 <a> <b>      connect ports a and b both ways
+//   2 <out>        enquire: replies with the input connected to out, or with bit 7 set if none is
+//   4              disconnect everything
+//   5 <out>        disconnect output out
+//   6 <a> <b>      disconnect ports a and b both ways
+// It runs on its own thread, until stopped or one of its links is reset.
+class Crossbar {
+	public:
+		static const int Ports = 32;
+		Crossbar();
+		// The links are owned by the caller, and must outlive this.
+		void attach(int port, Link *link);
+		void setControl(Link *link);
+		void connect(int input, int output);
+		void start();
+		void stop();
+		~Crossbar();
+
+	private:
+		void forward();
+		void command(BYTE8 b);
+		WORD32 outputsOf(int input) const;
+		Link *myPorts[Ports];
+		Link *myControl;
+		int myInputs[Ports]; // of each output, or -1
+		// A byte read from each input, and the outputs it has still to be written to.
+		BYTE8 myPending[Ports];
+		WORD32 myPendingTime[Ports];
+		WORD32 myPendingOutputs[Ports];
+		std::vector<BYTE8> myCommand;
+		bool myReplyPending;
+		BYTE8 myReply;
+		std::thread *myThread;
+		std::atomic<bool> myStopping;
+		std::mutex myMutex;
+		std::condition_variable myProgress;
+		bool myProgressed; // by a link's other end, since the last pass; guarded by myMutex
+};
+
+#endif // _CROSSBAR_H
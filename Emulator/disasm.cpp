@@ -438,12 +438,12 @@ static const char *disassembleIndirectInstName(WORD32 Oreg, WORD32 Areg) {
 
 /* Disassemble an indirect operation. Oreg holds the operation code, and
    for the case of certain Floating Point operations, Areg holds an operation
-   code.
+   code. debugLevel is the CPU's flags & DebugFlags_DebugLevel.
  */
-char *disassembleIndirectOperation(WORD32 Oreg, WORD32 Areg) {
+char *disassembleIndirectOperation(WORD32 Oreg, WORD32 Areg, WORD32 debugLevel) {
 	static char buf[255];
 	buf[0] = '\0';
-	if ((flags & DebugFlags_DebugLevel) >= Debug_OprCodes) {
+	if (debugLevel >= Debug_OprCodes) {
 #if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX) || defined(PLATFORM_PICO)
 		snprintf(buf, 255, " (O=#%08X) ", Oreg);
 #elif defined(PLATFORM_WINDOWS)
@@ -451,7 +451,7 @@ char *disassembleIndirectOperation(WORD32 Oreg, WORD32 Areg) {
 #endif
 	}
 	if (Oreg == O_fpentry) {
-		if ((flags & DebugFlags_DebugLevel) >= Debug_OprCodes) {
+		if (debugLevel >= Debug_OprCodes) {
 #if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX) || defined(PLATFORM_PICO)
 			snprintf(buf, 255, " (fpentry A=#%08X) ", Areg);
 #elif defined(PLATFORM_WINDOWS)
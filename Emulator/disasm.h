@@ -14,6 +14,6 @@
 #ifndef _DISASM_H
 #define _DISASM_H
 extern char *disassembleDirectOperation(WORD32 Instruction, WORD32 Oreg);
-extern char *disassembleIndirectOperation(WORD32 Oreg, WORD32 Areg);
+extern char *disassembleIndirectOperation(WORD32 Oreg, WORD32 Areg, WORD32 debugLevel);
 #endif // _DISASM_H
 
@@ -14,6 +14,8 @@
 #ifndef _FLAGS_H
 #define _FLAGS_H
 
+#include "controlblock.h"
+
 /* The Flags bits hold the following debug settings.
    Some of the options set in the config file are stored here, and may be
    changed by some parts of the emulator. 
@@ -46,7 +48,7 @@
    
    12 (0x1000)         eForth diagnostics: on or off
    
-   13 (0x2000)         Reserved
+   13 (0x2000)         Extended boot protocol (block peek/poke): on or off
    
    14 (0x4000)         Reserved
    
@@ -63,6 +65,7 @@
 #define DebugFlags_TerminateOnMemViol 0x0400
 #define DebugFlags_Monitor 0x0800
 #define DebugFlags_eForth 0x1000
+#define DebugFlags_BlockBoot 0x2000
 
 // Debugging Levels, i.e. flags & DebugFlags_DebugLevel
 #define Debug_None 0                            // No debugging information
@@ -77,8 +80,7 @@
 
 
 
-// Global flags variable
-extern WORD32 flags; 
+// The flags are held in each CPU's ControlBlock (see controlblock.h); there is no global flags variable.
 
 // Flag mask applied to Flags to turn off all debugging
 #define DebugFlagMask (~(DebugFlags_DebugLevel | \
@@ -147,11 +149,12 @@ extern WORD32 flags;
                      EmulatorState_QueueInstruction | \
                      EmulatorState_Interrupt))
 
-// Macros for testing, setting and clearing flags:
-#define IS_FLAG_SET(test)       (flags & (test))
-#define IS_FLAG_CLEAR(test)     (!(flags & (test)))
-#define SET_FLAGS(set)          flags |= (set)
-#define CLEAR_FLAGS(clear)      flags &= (~(clear))
+// Macros for testing, setting and clearing flags, in the ControlBlock pointed to by myControl, which the CPU,
+// Memory and Boot hold, as do the programs that construct them:
+#define IS_FLAG_SET(test)       (myControl->flags & (test))
+#define IS_FLAG_CLEAR(test)     (!(myControl->flags & (test)))
+#define SET_FLAGS(set)          myControl->flags |= (set)
+#define CLEAR_FLAGS(clear)      myControl->flags &= (~(clear))
 
 
 #endif // _FLAGS_H
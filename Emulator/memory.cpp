@@ -20,9 +20,16 @@
 #include <sys/stat.h>
 #include <cstring>
 #include <cerrno>
+#include <algorithm>
 using namespace std;
 
 #include "platformdetection.h"
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <csignal>
+#endif
 
 #include "types.h"
 #include "constants.h"
@@ -31,8 +38,72 @@ using namespace std;
 #include "flags.h"
 #include "log.h"
 
-Memory::Memory() {
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+// Memories with watchpoints, searched by the fault handler. Only modified when watchpoints are added or removed,
+// from the monitor or command line.
+static Memory *watchedMemories = nullptr;
+static bool watchpointHandlerInstalled = false;
+static struct sigaction previousSegvAction;
+static struct sigaction previousBusAction;
+
+static void addWatchedMemory(Memory *memory) {
+	for (Memory *m = watchedMemories; m != nullptr; m = m->myNextWatchedMemory) {
+		if (m == memory) {
+			return;
+		}
+	}
+	memory->myNextWatchedMemory = watchedMemories;
+	watchedMemories = memory;
+}
+
+static void removeWatchedMemory(Memory *memory) {
+	Memory **link = &watchedMemories;
+	while (*link != nullptr) {
+		if (*link == memory) {
+			*link = memory->myNextWatchedMemory;
+			memory->myNextWatchedMemory = nullptr;
+			return;
+		}
+		link = &(*link)->myNextWatchedMemory;
+	}
+}
+
+static void watchpointFaultHandler(int sig, siginfo_t *info, void *context) {
+	for (Memory *m = watchedMemories; m != nullptr; m = m->myNextWatchedMemory) {
+		if (m->handleWatchpointFault(info->si_addr)) {
+			return; // restart the faulting access on the now-unprotected page
+		}
+	}
+	// Not a watchpoint; pass it on to whatever handled it before us.
+	const struct sigaction &previous = (sig == SIGBUS) ? previousBusAction : previousSegvAction;
+	if (previous.sa_flags & SA_SIGINFO) {
+		previous.sa_sigaction(sig, info, context);
+	} else if (previous.sa_handler == SIG_DFL || previous.sa_handler == SIG_IGN) {
+		// Restore the default action; the fault recurs on return and is fatal as usual.
+		signal(sig, SIG_DFL);
+	} else {
+		previous.sa_handler(sig);
+	}
+}
+
+static void installWatchpointFaultHandler() {
+	if (watchpointHandlerInstalled) {
+		return;
+	}
+	struct sigaction action{};
+	action.sa_sigaction = watchpointFaultHandler;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_SIGINFO;
+	sigaction(SIGSEGV, &action, &previousSegvAction);
+	// macOS reports protection faults on mapped memory as SIGBUS.
+	sigaction(SIGBUS, &action, &previousBusAction);
+	watchpointHandlerInstalled = true;
+}
+#endif
+
+Memory::Memory(ControlBlock *control) {
 	logDebug("Memory CTOR");
+	myControl = control;
 	resetMemory();
 }
 
@@ -41,23 +112,47 @@ void Memory::resetMemory() {
 	myROMPresent = false;
 	myReadOnlyMemory = nullptr;
 	myReadOnlyMemorySize = 0;
+	myROMMapped = false;
 	mySize = 0;
+	myRAMSpan = 0;
 	myMemEnd = InternalMemStart;
 	myHighestAccess = InternalMemStart;
 	myCurrentCycles = 0;
 }
 
 bool Memory::initialise(const long initialRAMSize) {
-	myMemory = static_cast<BYTE8 *>(calloc(initialRAMSize, 1));
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+	// Anonymous mappings are zero filled and page aligned, so ranges of RAM can be mprotected for watchpoints.
+	// An extra page is mapped since the bounds checks below admit accesses at myMemEnd.
+	myHostPageSize = (size_t) sysconf(_SC_PAGESIZE);
+	myRAMMappedSize = ((initialRAMSize + myHostPageSize - 1) & ~(myHostPageSize - 1)) + myHostPageSize;
+	void *ramMapping = mmap(nullptr, myRAMMappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ramMapping == MAP_FAILED) {
+		myRAMMappedSize = 0;
+		logFatal("Failed to allocate memory");
+		return false;
+	}
+	myMemory = static_cast<BYTE8 *>(ramMapping);
+	myRAMSpan = myRAMMappedSize;
+#else
+	// A word more, since the bounds checks below admit accesses at myMemEnd.
+	myRAMSpan = initialRAMSize + sizeof(WORD32);
+	myMemory = static_cast<BYTE8 *>(calloc(myRAMSpan, 1));
 	if (myMemory == nullptr) {
 		logFatal("Failed to allocate memory");
 		return false;
 	}
+#endif
 	/*for (int i=0; i<initialRAMSize; i++) {
 		myMemory[i] = 0xAA;
 	}*/
 	myMemEnd = InternalMemStart + initialRAMSize;
 	mySize = initialRAMSize;
+	// Pages are counted up to and including myMemEnd, which the bounds checks below admit.
+	const WORD32 pages = (WORD32) (initialRAMSize / DirtyPageSize) + 1;
+	myDirtyPageWords = (pages + 31) / 32;
+	myDirtyPages.reset(new std::atomic<WORD32>[myDirtyPageWords]);
+	forgetDirtyPages();
 	logDebugF("RAM (size %d bytes) from %08X to %08X", mySize, InternalMemStart, myMemEnd);
 
 	return true;
@@ -94,12 +189,11 @@ bool Memory::loadROMFile(const char *fileName) {
 
 	const off_t romSize = st.st_size;
 	const WORD32 romSize32 = (WORD32) romSize;
-	myReadOnlyMemorySize = romSize32;
-	myReadOnlyMemory = (BYTE8 *)calloc(myReadOnlyMemorySize, 1);
-	if (myReadOnlyMemory == nullptr) {
-		logFatal("Failed to allocate Read-Only memory");
+	if (romSize32 == 0) {
+		logFatalF("ROM file %s is empty", fileName);
 		return false;
 	}
+	myReadOnlyMemorySize = romSize32;
 
 	myROMStart = MaxINT - romSize32 + 1;
 	logDebugF("ROM (size %d bytes) will be loaded from %08X to %08X", romSize32, myROMStart, MaxINT);
@@ -108,6 +202,39 @@ bool Memory::loadROMFile(const char *fileName) {
 		return false;
 	}
 
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+	// Map the ROM privately and read-only rather than reading it into a heap copy. The kernel then shares the
+	// ROM's pages between every emulator instance (and any forked children) using the same file, and only the
+	// pages actually executed are faulted in.
+	const int romFd = open(fileName, O_RDONLY);
+	if (romFd == -1) {
+		if (strerror_r(errno, msgbuf, 255) == 0) {
+			// do nothing; ignore warning
+		}
+		logFatalF("Could not open ROM file %s: %s", fileName, msgbuf);
+		return false;
+	}
+	void *romMapping = mmap(nullptr, myReadOnlyMemorySize, PROT_READ, MAP_PRIVATE, romFd, 0);
+	if (romMapping == MAP_FAILED) {
+		if (strerror_r(errno, msgbuf, 255) == 0) {
+			// do nothing; ignore warning
+		}
+		close(romFd);
+		logFatalF("Could not map ROM file %s: %s", fileName, msgbuf);
+		return false;
+	}
+	// The mapping holds its own reference to the file.
+	close(romFd);
+	myReadOnlyMemory = static_cast<BYTE8 *>(romMapping);
+	myROMMapped = true;
+	return true;
+#else
+	myReadOnlyMemory = (BYTE8 *)calloc(myReadOnlyMemorySize, 1);
+	if (myReadOnlyMemory == nullptr) {
+		logFatal("Failed to allocate Read-Only memory");
+		return false;
+	}
+
 	ifstream romFile;
 	// Set exceptions to be thrown on failure
 	romFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
@@ -129,6 +256,38 @@ bool Memory::loadROMFile(const char *fileName) {
 
 	romFile.close();
 	return true;
+#endif
+}
+
+bool Memory::loadImage(const char *fileName, const WORD32 addr, const long fileOffset, const long maxLength,
+					   WORD32 &length) {
+	ifstream image(fileName, ifstream::in | ifstream::binary);
+	if (!image) {
+		logFatalF("Could not open image file %s", fileName);
+		return false;
+	}
+	image.seekg(0, ios::end);
+	const long fileLength = (long) image.tellg() - fileOffset;
+	if (fileLength < 0) {
+		logFatalF("Image file %s is shorter than %ld bytes", fileName, fileOffset);
+		return false;
+	}
+	const long imageLength = (fileLength < maxLength) ? fileLength : maxLength;
+	if (addr < InternalMemStart || addr > myMemEnd || imageLength > (long) (myMemEnd - addr) + 1) {
+		logFatalF("Image file %s (%ld bytes) does not fit in memory at %08X", fileName, imageLength, addr);
+		return false;
+	}
+	// One read, straight into RAM.
+	image.seekg(fileOffset, ios::beg);
+	image.read(reinterpret_cast<char *>(myMemory + (addr - InternalMemStart)), imageLength);
+	if (image.gcount() != imageLength) {
+		logFatalF("Tried to load %ld bytes from image file %s, but only read %ld", imageLength, fileName, (long) image.gcount());
+		return false;
+	}
+	length = (WORD32) imageLength;
+	markWritten(addr, length);
+	logDebugF("Loaded %u bytes of image file %s at %08X", length, fileName, addr);
+	return true;
 }
 
 #endif // DESKTOP
@@ -136,12 +295,27 @@ bool Memory::loadROMFile(const char *fileName) {
 Memory::~Memory() {
 	logDebugF("Memory DTOR - this is 0x%lx, Memory is 0x%lx, ROM is 0x%lx", this, myMemory, myReadOnlyMemory);
 	if (myMemory != nullptr) {
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		myWatchpoints.clear();
+		removeWatchedMemory(this);
+		logDebug("Memory is not NULL - unmapping");
+		munmap(myMemory, myRAMMappedSize);
+#else
 		logDebug("Memory is not NULL - freeing");
 		free(myMemory);
+#endif
 	}
 	if (myReadOnlyMemory != nullptr) {
-		logDebug("Read-Only Memory is not NULL - freeing");
-		free(myReadOnlyMemory);
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		if (myROMMapped) {
+			logDebug("Read-Only Memory is mapped - unmapping");
+			munmap(myReadOnlyMemory, myReadOnlyMemorySize);
+		} else
+#endif
+		{
+			logDebug("Read-Only Memory is not NULL - freeing");
+			free(myReadOnlyMemory);
+		}
 	}
 	if (myMemory != nullptr || myReadOnlyMemory != nullptr) {
 		resetMemory();
@@ -155,8 +329,16 @@ WORD32 Memory::getMemEnd() const {
 long Memory::getMemSize() const {
 	return mySize;
 }
+long Memory::getROMSize() const {
+	return myROMPresent ? (long) myReadOnlyMemorySize : 0;
+}
+
+ControlBlock *Memory::getControlBlock() const {
+	return myControl;
+}
+
 WORD32 Memory::getHighestAccess() const {
-	return myHighestAccess;
+	return myHighestAccess.load(std::memory_order_relaxed);
 }
 
 // TODO fix external memory access taking longer than internal access - this
@@ -165,11 +347,9 @@ BYTE8 Memory::getByte(WORD32 addr) {
 	BYTE8 b;
 	if (addr >= InternalMemStart && addr <= myMemEnd) {
 		myCurrentCycles += 1;
-		if (addr > myHighestAccess) {
-			myHighestAccess = addr;
-		}
+		noteAccess(addr);
 		b = myMemory[addr - InternalMemStart];
-		if ((flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
+		if ((myControl->flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
 #ifdef DESKTOP
 			logDebugF("R 1 [%08X]%s=%02X (%c)", addr, mySymbolTable->possibleSymbolString(addr).c_str(), b, isprint(b) ? b : '?');
 #else
@@ -180,7 +360,7 @@ BYTE8 Memory::getByte(WORD32 addr) {
 		myCurrentCycles += 1;
 		// not tracking highest ROM access here
 		b = myReadOnlyMemory[addr - myROMStart];
-		if ((flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
+		if ((myControl->flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
 #ifdef DESKTOP
 			logDebugF("R 1 [%08X]%s=%02X (%c)", addr, mySymbolTable->possibleSymbolString(addr).c_str(), b, isprint(b) ? b : '?');
 #else
@@ -211,11 +391,9 @@ BYTE8 Memory::getInstruction(WORD32 addr) {
 	BYTE8 b;
 	if (addr >= InternalMemStart && addr <= myMemEnd) {
 		myCurrentCycles += 1;
-		if (addr > myHighestAccess) {
-			myHighestAccess = addr;
-		}
+		noteAccess(addr);
 		b = myMemory[addr - InternalMemStart];
-		if ((flags & DebugFlags_MemAccessDebugLevel) == MemAccessDebug_Full) {
+		if ((myControl->flags & DebugFlags_MemAccessDebugLevel) == MemAccessDebug_Full) {
 #ifdef DESKTOP
 			logDebugF("I 1 [%08X]%s=%02X", addr, mySymbolTable->possibleSymbolString(addr).c_str(), b);
 #else
@@ -226,7 +404,7 @@ BYTE8 Memory::getInstruction(WORD32 addr) {
 		myCurrentCycles += 1;
 		// not tracking highest ROM access here
 		b = myReadOnlyMemory[addr - myROMStart];
-		if ((flags & DebugFlags_MemAccessDebugLevel) == MemAccessDebug_Full) {
+		if ((myControl->flags & DebugFlags_MemAccessDebugLevel) == MemAccessDebug_Full) {
 #ifdef DESKTOP
 			logDebugF("I 1 [%08X]%s=%02X", addr, mySymbolTable->possibleSymbolString(addr).c_str(), b);
 #else
@@ -256,11 +434,10 @@ BYTE8 Memory::getInstruction(WORD32 addr) {
 void Memory::setByte(WORD32 addr, BYTE8 value) {
 	if (addr >= InternalMemStart && addr <= myMemEnd) {
 		myCurrentCycles += 1;
-		if (addr > myHighestAccess) {
-			myHighestAccess = addr;
-		}
+		noteAccess(addr);
 		myMemory[addr - InternalMemStart] = value;
-		if ((flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
+		markDirty(addr);
+		if ((myControl->flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
 #ifdef DESKTOP
 			logDebugF("W 1 [%08X]%s=%02X", addr, mySymbolTable->possibleSymbolString(addr).c_str(), value);
 #else
@@ -305,15 +482,13 @@ WORD32 Memory::getWord(WORD32 addr) {
 	WORD32 w;
 	if (addr >= InternalMemStart && addr <= myMemEnd) {
 		myCurrentCycles += 1;
-		if (addr > myHighestAccess) {
-			myHighestAccess = addr;
-		}
+		noteAccess(addr);
 		b = myMemory + (addr - InternalMemStart);
 		// Irrespective of the emulator hosts's endianness, words are
 		// always stored in memory in little-endian form, as on a real
 		// Transputer. LSB first MSB last
 		w = (b[3] << 24) | (b[2] << 16) | (b[1] << 8) | b[0];
-		if ((flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
+		if ((myControl->flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
 #ifdef DESKTOP
 			logDebugF("R 4 [%08X]%s=%08X%s", addr, mySymbolTable->possibleSymbolString(addr).c_str(), w, mySymbolTable->possibleSymbolString(w).c_str());
 #else
@@ -328,7 +503,7 @@ WORD32 Memory::getWord(WORD32 addr) {
 		// always stored in memory in little-endian form, as on a real
 		// Transputer. LSB first MSB last
 		w = (b[3] << 24) | (b[2] << 16) | (b[1] << 8) | b[0];
-		if ((flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
+		if ((myControl->flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
 #ifdef DESKTOP
 			logDebugF("R 4 [%08X]%s=%08X%s", addr, mySymbolTable->possibleSymbolString(addr).c_str(), w, mySymbolTable->possibleSymbolString(w).c_str());
 #else
@@ -359,9 +534,7 @@ void Memory::setWord(WORD32 addr, WORD32 value) {
 	BYTE8 *b;
 	if (addr >= InternalMemStart && addr <= myMemEnd) {
 		myCurrentCycles += 1;
-		if (addr > myHighestAccess) {
-			myHighestAccess = addr;
-		}
+		noteAccess(addr);
 		b = myMemory + (addr - InternalMemStart);
 		// Irrespective of the emulator hosts's endianness, words are
 		// always stored in memory in little-endian form, as on a real
@@ -370,7 +543,9 @@ void Memory::setWord(WORD32 addr, WORD32 value) {
 		b[1] = (value & 0x0000ff00) >> 8;
 		b[2] = (value & 0x00ff0000) >> 16;
 		b[3] = (value & 0xff000000) >> 24;
-		if ((flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
+		markDirty(addr);
+		markDirty(addr + 3);
+		if ((myControl->flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
 #ifdef DESKTOP
 			logDebugF("W 4 [%08X]%s=%08X%s", addr, mySymbolTable->possibleSymbolString(addr).c_str(), value, mySymbolTable->possibleSymbolString(value).c_str());
 #else
@@ -461,17 +636,15 @@ void Memory::blockCopy(WORD32 len, WORD32 srcAddr, WORD32 destAddr) {
 	for (i = 0, sA = srcAddr, dA = destAddr; i < len; i++, sA++, dA++) {
 		// Read from source...
 		if (sA >= InternalMemStart && sA <= myMemEnd) {
-			if (sA > myHighestAccess) {
-				myHighestAccess = sA;
-			}
+			noteAccess(sA);
 			b = myMemory[sA - InternalMemStart];
-			if ((flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
+			if ((myControl->flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
 				logDebugF("R 1 [%08X]=%02X", sA, b);
 			}
 		} else if (myROMPresent && sA >= myROMStart && sA <= MaxINT) {
 			// not tracking highest ROM access
 			b = myReadOnlyMemory[sA - myROMStart];
-			if ((flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
+			if ((myControl->flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
 				logDebugF("R 1 [%08X]=%02X", sA, b);
 			}
 		} else {
@@ -485,11 +658,10 @@ void Memory::blockCopy(WORD32 len, WORD32 srcAddr, WORD32 destAddr) {
 		}
 		// Write to destination
 		if (dA >= InternalMemStart && dA <= myMemEnd) {
-			if (dA > myHighestAccess) {
-				myHighestAccess = dA;
-			}
+			noteAccess(dA);
 			myMemory[dA - InternalMemStart] = b;
-			if ((flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
+			markDirty(dA);
+			if ((myControl->flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
 				logDebugF("W 1 [%08X]=%02X", dA, b);
 			}
 		} else if (myROMPresent && dA >= myROMStart && dA <= MaxINT) {
@@ -512,6 +684,348 @@ void Memory::blockCopy(WORD32 len, WORD32 srcAddr, WORD32 destAddr) {
 	}
 }
 
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+bool Memory::addWatchpoint(const WORD32 addr, const WORD32 len) {
+	if (len == 0 || addr < InternalMemStart || addr + len > myMemEnd || addr + len < addr) {
+		logErrorF("Watchpoint %08X length %08X is not within RAM (%08X to %08X)", addr, len, InternalMemStart, myMemEnd);
+		return false;
+	}
+	installWatchpointFaultHandler();
+	addWatchedMemory(this);
+	myWatchpoints[addr] = len;
+	myWatchpointsSet = true;
+	protectWatchpoints(PROT_NONE);
+	logInfoF("Watching %08X length %08X", addr, len);
+	return true;
+}
+
+bool Memory::removeWatchpoint(const WORD32 addr) {
+	auto iter = myWatchpoints.find(addr);
+	if (iter == myWatchpoints.end()) {
+		logErrorF("No watchpoint at %08X", addr);
+		return false;
+	}
+	// Unprotect everything, then reprotect the pages of any remaining watchpoints, since they may share pages with
+	// the one being removed.
+	protectWatchpoints(PROT_READ | PROT_WRITE);
+	myWatchpoints.erase(iter);
+	if (myWatchpoints.empty()) {
+		myWatchpointsSet = false;
+		removeWatchedMemory(this);
+	} else {
+		protectWatchpoints(PROT_NONE);
+	}
+	return true;
+}
+
+void Memory::showWatchpoints() {
+	if (myWatchpoints.empty()) {
+		logInfo("No watchpoints set");
+		return;
+	}
+	for (auto &watchpoint: myWatchpoints) {
+#ifdef DESKTOP
+		logInfoF("%08X%s length %08X", watchpoint.first, mySymbolTable->possibleSymbolString(watchpoint.first).c_str(), watchpoint.second);
+#else
+		logInfoF("%08X length %08X", watchpoint.first, watchpoint.second);
+#endif
+	}
+}
+
+bool Memory::takeWatchpointHit(WORD32 &addr) {
+	if (!myWatchpointHit) {
+		return false;
+	}
+	addr = myWatchpointHitAddress;
+	myWatchpointHit = false;
+	return true;
+}
+
+void Memory::rearmWatchpoints() {
+	myWatchpointTrapped = false;
+	protectWatchpoints(PROT_NONE);
+}
+
+void Memory::protectWatchpoints(const int protection) {
+	const size_t pageMask = ~(myHostPageSize - 1);
+	for (auto &watchpoint: myWatchpoints) {
+		const size_t firstPage = (watchpoint.first - InternalMemStart) & pageMask;
+		const size_t lastPage = (watchpoint.first - InternalMemStart + watchpoint.second - 1) & pageMask;
+		if (mprotect(myMemory + firstPage, lastPage - firstPage + myHostPageSize, protection) == -1) {
+			logErrorF("Could not change protection of watchpoint %08X: %s", watchpoint.first, strerror(errno));
+		}
+	}
+}
+
+// Runs in signal handler context: no logging or allocation here.
+bool Memory::handleWatchpointFault(const void *hostAddress) {
+	const BYTE8 *faultAddress = static_cast<const BYTE8 *>(hostAddress);
+	if (myMemory == nullptr || faultAddress < myMemory || faultAddress >= myMemory + myRAMMappedSize) {
+		return false;
+	}
+	const size_t pageMask = ~(myHostPageSize - 1);
+	const size_t offset = faultAddress - myMemory;
+	const size_t faultPage = offset & pageMask;
+	bool onWatchedPage = false;
+	bool inWatchedRange = false;
+	for (auto &watchpoint: myWatchpoints) {
+		const size_t start = watchpoint.first - InternalMemStart;
+		const size_t end = start + watchpoint.second;
+		if (faultPage >= (start & pageMask) && faultPage <= ((end - 1) & pageMask)) {
+			onWatchedPage = true;
+		}
+		if (offset >= start && offset < end) {
+			inWatchedRange = true;
+		}
+	}
+	if (!onWatchedPage) {
+		return false;
+	}
+	// Let this access (and the rest of this instruction's accesses to this page) proceed; the CPU rearms the
+	// watchpoints after the instruction.
+	mprotect(myMemory + faultPage, myHostPageSize, PROT_READ | PROT_WRITE);
+	myWatchpointTrapped = true;
+	if (inWatchedRange && !myWatchpointHit) {
+		myWatchpointHitAddress = (WORD32) (InternalMemStart + offset);
+		myWatchpointHit = true;
+	}
+	return true;
+}
+#endif
+
+bool Memory::isPageDirty(const WORD32 addr) const {
+	if (addr < InternalMemStart || addr > myMemEnd) {
+		return false;
+	}
+	const WORD32 page = (addr - InternalMemStart) / DirtyPageSize;
+	return (myDirtyPages[page >> 5].load(std::memory_order_relaxed) & (1U << (page & 31))) != 0;
+}
+
+WORD32 Memory::getDirtyPageCount() const {
+	WORD32 count = 0;
+	for (WORD32 word = 0; word < myDirtyPageWords; word++) {
+		for (WORD32 bits = myDirtyPages[word].load(std::memory_order_relaxed); bits != 0; bits &= bits - 1) {
+			count++;
+		}
+	}
+	return count;
+}
+
+std::vector<WORD32> Memory::getDirtyPages() const {
+	std::vector<WORD32> dirtyPages;
+	for (WORD32 word = 0; word < myDirtyPageWords; word++) {
+		for (WORD32 bits = myDirtyPages[word].load(std::memory_order_relaxed); bits != 0; bits &= bits - 1) {
+			WORD32 bit = 0;
+			while ((bits & (1U << bit)) == 0) {
+				bit++;
+			}
+			dirtyPages.push_back(InternalMemStart + ((word << 5) + bit) * DirtyPageSize);
+		}
+	}
+	return dirtyPages;
+}
+
+void Memory::clearDirtyPages() {
+	for (WORD32 word = 0; word < myDirtyPageWords; word++) {
+		myDirtyPages[word].store(0, std::memory_order_relaxed);
+	}
+	myCleanPagesZero = false;
+}
+
+// Clear the dirty bitmap when RAM outside the dirty pages is known to be zero.
+void Memory::forgetDirtyPages() {
+	clearDirtyPages();
+	myCleanPagesZero = true;
+}
+
+// The dirty pages, or, if pages have been written without still being marked dirty, all of them.
+std::vector<WORD32> Memory::pagesNotKnownZero() const {
+	if (myCleanPagesZero) {
+		return getDirtyPages();
+	}
+	std::vector<WORD32> pages;
+	for (size_t offset = 0; offset < myRAMSpan; offset += DirtyPageSize) {
+		pages.push_back(InternalMemStart + (WORD32) offset);
+	}
+	return pages;
+}
+
+// The dirty page at offset runs to the end of the memory backing RAM, beyond mySize.
+size_t Memory::dirtyPageLength(const WORD32 offset) const {
+	return (offset + DirtyPageSize > myRAMSpan) ? myRAMSpan - offset : DirtyPageSize;
+}
+
+void Memory::resetDirtyPages() {
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+	protectWatchpoints(PROT_READ | PROT_WRITE);
+#endif
+	for (WORD32 pageAddr: pagesNotKnownZero()) {
+		const WORD32 offset = pageAddr - InternalMemStart;
+		memset(myMemory + offset, 0, dirtyPageLength(offset));
+	}
+	forgetDirtyPages();
+	myHighestAccess = InternalMemStart;
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+	protectWatchpoints(PROT_NONE);
+#endif
+}
+
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+// Images are padded to a multiple of 64KB so they can be mapped whatever the host page size.
+static const off_t ImageAlignment = 65536;
+
+off_t Memory::imageLength() const {
+	return (myRAMSpan + ImageAlignment - 1) & ~(ImageAlignment - 1);
+}
+
+static bool isZeroPage(const BYTE8 *page, const size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		if (page[i] != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Memory::saveImage(const int fd, const off_t fileOffset, std::vector<WORD32> &savedPages) {
+	// Pages that haven't been written are zero, so usually only the dirty ones need examining.
+	protectWatchpoints(PROT_READ | PROT_WRITE);
+	savedPages.clear();
+	bool ok = true;
+	for (WORD32 pageAddr: pagesNotKnownZero()) {
+		const WORD32 offset = pageAddr - InternalMemStart;
+		const size_t len = dirtyPageLength(offset);
+		if (isZeroPage(myMemory + offset, len)) {
+			continue;
+		}
+		if (pwrite(fd, myMemory + offset, len, fileOffset + offset) != (ssize_t) len) {
+			logErrorF("Could not write page %08X to snapshot: %s", pageAddr, strerror(errno));
+			ok = false;
+			break;
+		}
+		savedPages.push_back(pageAddr);
+	}
+	// Extend the file over any trailing zero pages so that the whole image can be mapped.
+	if (ok && ftruncate(fd, fileOffset + imageLength()) == -1) {
+		logErrorF("Could not set the length of the snapshot: %s", strerror(errno));
+		ok = false;
+	}
+	protectWatchpoints(PROT_NONE);
+	return ok;
+}
+
+bool Memory::restoreImage(const int fd, const off_t fileOffset, const std::vector<WORD32> &savedPages) {
+	for (WORD32 pageAddr: savedPages) {
+		if (pageAddr < InternalMemStart || pageAddr - InternalMemStart >= myRAMSpan || (pageAddr % DirtyPageSize) != 0) {
+			logErrorF("Snapshot page %08X is not a page of RAM", pageAddr);
+			return false;
+		}
+	}
+	if (fileOffset % myHostPageSize == 0) {
+		// Replace RAM with a private mapping of the image; writes then go to copies of the image's pages.
+		void *mapping = mmap(myMemory, myRAMMappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, fileOffset);
+		if (mapping == MAP_FAILED) {
+			logErrorF("Could not map snapshot: %s", strerror(errno));
+			return false;
+		}
+	} else {
+		// The host's pages are larger than the image alignment; read the saved pages in instead.
+		memset(myMemory, 0, myRAMSpan);
+		for (WORD32 pageAddr: savedPages) {
+			const WORD32 offset = pageAddr - InternalMemStart;
+			const size_t len = dirtyPageLength(offset);
+			if (pread(fd, myMemory + offset, len, fileOffset + offset) != (ssize_t) len) {
+				logErrorF("Could not read page %08X from snapshot: %s", pageAddr, strerror(errno));
+				return false;
+			}
+		}
+	}
+	// The saved pages are the only non-zero ones.
+	forgetDirtyPages();
+	for (WORD32 pageAddr: savedPages) {
+		markDirty(pageAddr);
+	}
+	myHighestAccess = InternalMemStart;
+	protectWatchpoints(PROT_NONE);
+	return true;
+}
+#endif
+
+// After a bulk write to RAM, mark its pages dirty, and note its highest address.
+void Memory::markWritten(const WORD32 addr, const WORD32 len) {
+	if (len == 0) {
+		return;
+	}
+	const WORD32 last = addr + len - 1;
+	for (WORD32 page = (addr - InternalMemStart) / DirtyPageSize; page <= (last - InternalMemStart) / DirtyPageSize; page++) {
+		markDirty(InternalMemStart + page * DirtyPageSize);
+	}
+	noteAccess(last);
+}
+
+bool Memory::readBlock(const WORD32 addr, BYTE8 *data, const WORD32 len) {
+	if (len == 0) {
+		return true;
+	}
+	const WORD32 last = addr + len - 1;
+	if (last < addr) {
+		return false;
+	}
+	if (addr >= InternalMemStart && last <= myMemEnd) {
+		memcpy(data, myMemory + (addr - InternalMemStart), len);
+		noteAccess(last);
+	} else if (myROMPresent && addr >= myROMStart) {
+		memcpy(data, myReadOnlyMemory + (addr - myROMStart), len);
+	} else {
+		return false;
+	}
+	if ((myControl->flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
+		logDebugF("R %u [%08X]", len, addr);
+	}
+	return true;
+}
+
+bool Memory::writeBlock(const WORD32 addr, const BYTE8 *data, const WORD32 len) {
+	if (len == 0) {
+		return true;
+	}
+	const WORD32 last = addr + len - 1;
+	if (addr < InternalMemStart || last > myMemEnd || last < addr) {
+		return false;
+	}
+	memcpy(myMemory + (addr - InternalMemStart), data, len);
+	markWritten(addr, len);
+	if ((myControl->flags & DebugFlags_MemAccessDebugLevel) != MemAccessDebug_No) {
+		logDebugF("W %u [%08X]", len, addr);
+	}
+	return true;
+}
+
+BYTE8 *Memory::hostAddress(const WORD32 addr, const WORD32 len, const bool forWriting) {
+	const WORD32 last = addr + ((len == 0) ? 0 : len - 1);
+	if (last < addr) {
+		return nullptr;
+	}
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+	if (myWatchpointsSet) {
+		logWarnF("Direct access to %08X length %08X refused while watchpoints are set", addr, len);
+		return nullptr;
+	}
+#endif
+	if (addr >= InternalMemStart && last <= myMemEnd) {
+		if (forWriting) {
+			markWritten(addr, len);
+		} else {
+			noteAccess(last);
+		}
+		return myMemory + (addr - InternalMemStart);
+	}
+	if (!forWriting && myROMPresent && addr >= myROMStart) {
+		return myReadOnlyMemory + (addr - myROMStart);
+	}
+	return nullptr;
+}
+
 bool Memory::isLegalMemory(WORD32 addr) const {
 	return (addr >= InternalMemStart && addr <= myMemEnd) ||
 			(myROMPresent && addr >= myROMStart && addr <= MaxINT);
@@ -526,6 +1040,10 @@ WORD32 offset=addr;
 SWORD32 left=len;
 SWORD32 upto16, x;
 BYTE8 b;
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+	// Dumping is not an access by the program, so don't let it trigger watchpoints.
+	protectWatchpoints(PROT_READ | PROT_WRITE);
+#endif
 	while (left > 0) {
 		for (i = 0; i < 78; i++) {
 			line[i] = ' ';
@@ -563,6 +1081,9 @@ BYTE8 b;
 		offset += upto16;
 		left -= upto16;
 	}
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+	protectWatchpoints(PROT_NONE);
+#endif
 }
 
 // Precondition: lenInBytes is a multiple of the word size, 4 bytes
@@ -578,6 +1099,10 @@ WORD32 w;
 01234567890123456789012345678901234567890123456789012345678901234567890123456789
 00000000 | 01234567 01234567 01234567 01234567 | .... .... .... ....
  */
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+	// Dumping is not an access by the program, so don't let it trigger watchpoints.
+	protectWatchpoints(PROT_READ | PROT_WRITE);
+#endif
 	while (leftBytes > 0) {
 		for (i = 0; i < 78; i++) {
 			line[i] = ' ';
@@ -634,5 +1159,8 @@ WORD32 w;
 		offset += 16;
 		leftBytes -= 16;
 	}
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+	protectWatchpoints(PROT_NONE);
+#endif
 }
 
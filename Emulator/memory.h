@@ -14,20 +14,34 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+#include <sys/types.h>
+
 #include "types.h"
+#include "memloc.h"
 #include "symbol.h"
+#include "controlblock.h"
+#include "platformdetection.h"
 
 class Memory {
 	public:
 		// 2-phase CTOR since there's only one global Memory
-		Memory();
+		explicit Memory(ControlBlock *control);
 		bool initialise(long initialRAMSize);
 #ifdef DESKTOP
 		bool initialiseROMFileAndSymbolTable(const char *romFileName, SymbolTable *symbolTable);
+		// Read up to maxLength bytes of a file, from fileOffset, straight into RAM at addr, setting length to the
+		// number read. Returns false, having logged why, if the file can't be read or doesn't fit.
+		bool loadImage(const char *fileName, WORD32 addr, long fileOffset, long maxLength, WORD32 &length);
 #endif
 		~Memory();
 		WORD32 getMemEnd() const;
 		long getMemSize() const;
+		long getROMSize() const;
+		ControlBlock *getControlBlock() const;
 		WORD32 getHighestAccess() const;
 		BYTE8 getByte(WORD32 addr);
 		BYTE8 getInstruction(WORD32 addr);
@@ -36,11 +50,58 @@ class Memory {
 		void setWord(WORD32 addr, WORD32 value);
 		int getCurrentCyclesAndReset();
 		void blockCopy(WORD32 len, WORD32 srcAddr, WORD32 destAddr);
+		// Bulk transfers between the host and memory, for the boot protocol. Return false, transferring nothing, if
+		// any of the range isn't RAM (or, for reads, ROM).
+		bool readBlock(WORD32 addr, BYTE8 *data, WORD32 len);
+		bool writeBlock(WORD32 addr, const BYTE8 *data, WORD32 len);
+		// The host address of len bytes of memory from addr, for a host that transfers them itself, e.g. the IServer's
+		// direct requests. nullptr if any of the range isn't RAM (or, if not forWriting, ROM). A range for writing is
+		// marked as written. May be called on a thread other than the CPU's. nullptr, too, while any watchpoint is set,
+		// since the host's access could trap on a watched page, and be taken for the CPU's.
+		BYTE8 *hostAddress(WORD32 addr, WORD32 len, bool forWriting);
 		bool isLegalMemory(WORD32 addr) const;
+		// Dirty page tracking. Every write to RAM marks its DirtyPageSize page as dirty, so that callers can find
+		// (and reset, or save) just the memory a program has touched, rather than the whole of RAM.
+		static const WORD32 DirtyPageSize = 4096;
+		bool isPageDirty(WORD32 addr) const;
+		WORD32 getDirtyPageCount() const;
+		// The start addresses of the dirty pages, in ascending order.
+		std::vector<WORD32> getDirtyPages() const;
+		// Pages written before this keep their contents, but are no longer dirty, so resetDirtyPages and saveImage
+		// then have to look at every page until RAM is next known to be zero outside the dirty pages.
+		void clearDirtyPages();
+		// Zero the dirty pages, returning RAM to its initial state, and clear the dirty bitmap.
+		void resetDirtyPages();
 		// Used by the monitor
 		void hexDump(WORD32 addr, WORD32 len);
 		void hexDumpWords(WORD32 addr, WORD32 lenInBytes);
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		// Data watchpoints. The host pages backing a watched range are protected, so only accesses to those pages
+		// trap; unwatched memory runs at full speed.
+		bool addWatchpoint(WORD32 addr, WORD32 len);
+		bool removeWatchpoint(WORD32 addr);
+		void showWatchpoints();
+		inline bool watchpointsSet() const { return myWatchpointsSet.load(std::memory_order_relaxed); }
+		// True if an access during the current instruction trapped on a watched page. While watchpointsSet, the CPU
+		// checks this after each instruction, then calls takeWatchpointHit and rearmWatchpoints.
+		inline bool watchpointTrapped() const { return myWatchpointTrapped; }
+		// True (and the guest address accessed) if a trapped access was within a watched range. Clears the hit.
+		bool takeWatchpointHit(WORD32 &addr);
+		void rearmWatchpoints();
+		// Called from the SIGSEGV/SIGBUS handler. Returns true iff the fault was on one of our watched pages, in
+		// which case that page is unprotected so the faulting access can be restarted.
+		bool handleWatchpointFault(const void *hostAddress);
+		Memory *myNextWatchedMemory{};
+		// Snapshots. saveImage writes the non-zero pages of RAM into fd at their offsets from fileOffset, leaving
+		// holes for the zero pages, and returns the addresses of the pages written. restoreImage maps such an image
+		// copy-on-write over RAM; only the pages the restored program touches are read in.
+		bool saveImage(int fd, off_t fileOffset, std::vector<WORD32> &savedPages);
+		bool restoreImage(int fd, off_t fileOffset, const std::vector<WORD32> &savedPages);
+		// The length of the image saveImage writes.
+		off_t imageLength() const;
+#endif
 	private:
+		ControlBlock *myControl{};
 #ifdef DESKTOP
 		SymbolTable *mySymbolTable{};
 #endif
@@ -48,16 +109,56 @@ class Memory {
 		BYTE8 *myMemory{};
 		long mySize{};
 		WORD32 myMemEnd{};
-		WORD32 myHighestAccess{};
+		// The bytes backing RAM. More than mySize, since the bounds checks admit accesses at myMemEnd; the last dirty
+		// page covers the rest, so that they are reset and saved too.
+		size_t myRAMSpan{};
+		size_t dirtyPageLength(WORD32 offset) const;
+		// Atomic, as a host transferring directly to or from memory may raise it while the CPU does.
+		std::atomic<WORD32> myHighestAccess{};
+		inline void noteAccess(WORD32 addr) {
+			WORD32 highest = myHighestAccess.load(std::memory_order_relaxed);
+			while (addr > highest && !myHighestAccess.compare_exchange_weak(highest, addr, std::memory_order_relaxed)) {
+			}
+		}
 		//=(InternalMemStart + MemSize);
 		void resetMemory();
 		int myCurrentCycles{};
+		void markWritten(WORD32 addr, WORD32 len);
+		// One bit per DirtyPageSize page of RAM. Atomic, as a host transferring directly into memory marks pages on
+		// its own thread while the CPU marks others; a page already dirty costs only a load.
+		std::unique_ptr<std::atomic<WORD32>[]> myDirtyPages;
+		WORD32 myDirtyPageWords{};
+		// True while every page that isn't dirty is zero: cleared by clearDirtyPages.
+		bool myCleanPagesZero{};
+		void forgetDirtyPages();
+		std::vector<WORD32> pagesNotKnownZero() const;
+		inline void markDirty(WORD32 addr) {
+			const WORD32 page = (addr - InternalMemStart) / DirtyPageSize;
+			std::atomic<WORD32> &bits = myDirtyPages[page >> 5];
+			const WORD32 bit = 1U << (page & 31);
+			if ((bits.load(std::memory_order_relaxed) & bit) == 0) {
+				bits.fetch_or(bit, std::memory_order_relaxed);
+			}
+		}
 		// ROM (if present) extends from myROMStart, until MaxINT - it is loaded at the end of memory, so that the
 		// 2-byte jump at ResetCode is present.
 		bool myROMPresent{};
 		WORD32 myROMStart{};
 		BYTE8 *myReadOnlyMemory{};
 		size_t myReadOnlyMemorySize{};
+		// True if myReadOnlyMemory is a read-only mapping of the ROM file, rather than a heap copy.
+		bool myROMMapped{};
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		// RAM is mapped (rather than calloc'd) so that it is page aligned and can be protected for watchpoints.
+		size_t myRAMMappedSize{};
+		size_t myHostPageSize{};
+		std::map<WORD32, WORD32> myWatchpoints; // address -> length
+		std::atomic<bool> myWatchpointsSet{}; // for hostAddress, which mustn't look at the map from another thread
+		volatile bool myWatchpointTrapped{};
+		volatile bool myWatchpointHit{};
+		volatile WORD32 myWatchpointHitAddress{};
+		void protectWatchpoints(int protection);
+#endif
 };
 
 #endif // MEMORY_H
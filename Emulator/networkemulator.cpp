@@ -0,0 +1,390 @@
+//------------------------------------------------------------------------------
+//
+// File        : networkemulator.cpp
+// Description : A network of transputers, each emulated on its own thread,
+//               with their links wired together in memory.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <atomic>
+#include <exception>
+using namespace std;
+
+#include "networkemulator.h"
+#include "flags.h"
+#include "log.h"
+
+NetworkEmulator::NetworkEmulator() {
+	logDebug("NetworkEmulator CTOR");
+	myHostLink = nullptr;
+	myScheduler = nullptr;
+	myLinkLatency = 0;
+}
+
+bool NetworkEmulator::initialise(const int nodeCount, const long ramSize, const WORD32 flags,
+								 SymbolTable *symbolTable, const std::vector<Connection> &connections) {
+	Topology topology;
+	topology.nodes.assign(nodeCount < 0 ? 0 : nodeCount, { 0, "", "" });
+	topology.connections = connections;
+	return initialise(topology, ramSize, flags, symbolTable);
+}
+
+bool NetworkEmulator::initialise(const Topology &topology, const long ramSize, const WORD32 flags,
+								 SymbolTable *symbolTable) {
+	const int nodeCount = (int) topology.nodes.size();
+	const std::vector<Connection> &connections = topology.connections;
+	if (nodeCount < 1) {
+		logFatalF("A network needs at least one node, not %d", nodeCount);
+		return false;
+	}
+	for (int i = 0; i < nodeCount; i++) {
+		Node node = { nullptr, nullptr, nullptr, { nullptr, nullptr, nullptr, nullptr },
+					  { nullptr, nullptr, nullptr, nullptr }, nullptr };
+		node.control = new ControlBlock();
+		// Only the root has the console, so only it may enter the monitor.
+		node.control->flags = (i == 0) ? flags : (flags & ~DebugFlags_Monitor);
+		myNodes.push_back(node);
+	}
+
+	// The root's link 0 goes to the host.
+	auto *hostLinkFactory = new InMemoryLinkFactory(1, 0);
+	myLinkFactories.push_back(hostLinkFactory);
+	myHostLink = hostLinkFactory->linkA();
+	myNodes[0].links[0] = hostLinkFactory->linkB();
+
+	for (const Connection &connection: connections) {
+		if (connection.nodeA < 0 || connection.nodeA >= nodeCount || connection.nodeB < 0 || connection.nodeB >= nodeCount) {
+			logFatalF("Cannot connect node %d to node %d; nodes are numbered 0 to %d",
+					  connection.nodeA, connection.nodeB, nodeCount - 1);
+			return false;
+		}
+		if (connection.linkA < 0 || connection.linkA > 3 || connection.linkB < 0 || connection.linkB > 3) {
+			logFatalF("Cannot connect link %d to link %d; links are numbered 0 to 3",
+					  connection.linkA, connection.linkB);
+			return false;
+		}
+		if (connection.nodeA == connection.nodeB && connection.linkA == connection.linkB) {
+			logFatalF("Cannot connect link %d of node %d to itself", connection.linkA, connection.nodeA);
+			return false;
+		}
+		if (myNodes[connection.nodeA].links[connection.linkA] != nullptr) {
+			logFatalF("Link %d of node %d is already connected", connection.linkA, connection.nodeA);
+			return false;
+		}
+		if (myNodes[connection.nodeB].links[connection.linkB] != nullptr) {
+			logFatalF("Link %d of node %d is already connected", connection.linkB, connection.nodeB);
+			return false;
+		}
+		auto *linkFactory = new InMemoryLinkFactory(connection.linkA, connection.linkB);
+		myLinkFactories.push_back(linkFactory);
+		myNodes[connection.nodeA].links[connection.linkA] = linkFactory->linkA();
+		myNodes[connection.nodeB].links[connection.linkB] = linkFactory->linkB();
+		myNodes[connection.nodeA].peers[connection.linkA] = linkFactory->linkB();
+		myNodes[connection.nodeB].peers[connection.linkB] = linkFactory->linkA();
+		logDebugF("Connected node %d link %d to node %d link %d",
+				  connection.nodeA, connection.linkA, connection.nodeB, connection.linkB);
+	}
+
+	for (const Topology::Crossbar &description: topology.crossbars) {
+		auto *crossbar = new Crossbar();
+		myCrossbars.push_back(crossbar);
+		for (const Topology::Attachment &attachment: description.attachments) {
+			Link *link = wireToCrossbar(attachment.node, attachment.link, attachment.port);
+			if (link == nullptr) {
+				return false;
+			}
+			crossbar->attach(attachment.port, link);
+		}
+		if (description.controlNode != -1) {
+			Link *link = wireToCrossbar(description.controlNode, description.controlLink, Crossbar::Ports);
+			if (link == nullptr) {
+				return false;
+			}
+			crossbar->setControl(link);
+		}
+		for (const std::pair<int, int> &route: description.routes) {
+			crossbar->connect(route.first, route.second);
+			crossbar->connect(route.second, route.first);
+		}
+	}
+
+	// Nodes boot from whichever link first delivers a control byte, but unconnected links are NullLinks, which
+	// never do.
+	for (int i = 1; i < nodeCount; i++) {
+		const Node &node = myNodes[i];
+		if (node.links[0] == nullptr && node.links[1] == nullptr && node.links[2] == nullptr &&
+			node.links[3] == nullptr) {
+			logFatalF("Node %d cannot boot since none of its links are connected", i);
+			return false;
+		}
+	}
+
+	try {
+		myHostLink->initialise();
+	} catch (exception &e) {
+		logFatalF("Could not initialise host link: %s", e.what());
+		return false;
+	}
+
+	for (int i = 0; i < nodeCount; i++) {
+		Node &node = myNodes[i];
+		SymbolTable *nodeSymbolTable = symbolTable;
+		if (!topology.nodes[i].symbolFile.empty()) {
+			nodeSymbolTable = new SymbolTable();
+			mySymbolTables.push_back(nodeSymbolTable);
+			if (!nodeSymbolTable->loadSymbols(topology.nodes[i].symbolFile)) {
+				return false;
+			}
+		}
+		node.memory = new Memory(node.control);
+		if (!node.memory->initialiseROMFileAndSymbolTable(nullptr, nodeSymbolTable)) {
+			logFatalF("Could not initialise memory of node %d", i);
+			return false;
+		}
+		if (!node.memory->initialise(topology.nodes[i].ramSize != 0 ? topology.nodes[i].ramSize : ramSize)) {
+			logFatalF("Memory initialisation failed for node %d", i);
+			return false;
+		}
+		node.cpu = new CPU();
+		node.cpu->initialiseSymbolTable(nodeSymbolTable);
+		// The CPU now owns the links, replacing those not connected with NullLinks.
+		if (!node.cpu->initialise(node.memory, node.links)) {
+			logFatalF("CPU initialisation failed for node %d", i);
+			return false;
+		}
+	}
+	logInfoF("Network of %d node(s) with %d connection(s) and %d crossbar(s) initialised", nodeCount,
+			 (int) connections.size(), (int) myCrossbars.size());
+	return true;
+}
+
+// Returns the crossbar's end of the link, or nullptr having logged why it can't be wired.
+Link *NetworkEmulator::wireToCrossbar(const int node, const int link, const int port) {
+	if (node < 0 || node >= (int) myNodes.size() || link < 0 || link > 3) {
+		logFatalF("Cannot connect link %d of node %d to a crossbar", link, node);
+		return nullptr;
+	}
+	if (myNodes[node].links[link] != nullptr) {
+		logFatalF("Link %d of node %d is already connected", link, node);
+		return nullptr;
+	}
+	auto *linkFactory = new InMemoryLinkFactory(port, link);
+	myLinkFactories.push_back(linkFactory);
+	myCrossbarLinks.push_back(linkFactory->linkA());
+	myNodes[node].links[link] = linkFactory->linkB();
+	logDebugF("Connected node %d link %d to crossbar %d port %d", node, link, (int) myCrossbars.size() - 1, port);
+	return linkFactory->linkA();
+}
+
+Link *NetworkEmulator::getHostLink() const {
+	return myHostLink;
+}
+
+int NetworkEmulator::getNodeCount() const {
+	return (int) myNodes.size();
+}
+
+CPU *NetworkEmulator::getCPU(const int node) const {
+	return myNodes[node].cpu;
+}
+
+Memory *NetworkEmulator::getMemory(const int node) const {
+	return myNodes[node].memory;
+}
+
+ControlBlock *NetworkEmulator::getControlBlock(const int node) const {
+	return myNodes[node].control;
+}
+
+Link *NetworkEmulator::getBootLink(const int node) const {
+	for (Link *peer: myNodes[node].peers) {
+		if (peer != nullptr) {
+			return peer;
+		}
+	}
+	return nullptr;
+}
+
+bool NetworkEmulator::bootNodes(const std::vector<std::vector<BYTE8>> &bootstraps) {
+	std::vector<std::thread> senders;
+	std::atomic<bool> failed(false);
+	for (int i = 1; i < (int) bootstraps.size() && i < (int) myNodes.size(); i++) {
+		if (bootstraps[i].empty()) {
+			continue;
+		}
+		Link *peer = getBootLink(i);
+		if (peer == nullptr) {
+			logFatalF("Node %d cannot be booted by the host, since it isn't wired to another node", i);
+			failed = true;
+			break;
+		}
+		const std::vector<BYTE8> *bootstrap = &bootstraps[i];
+		senders.emplace_back([peer, bootstrap, i, &failed] {
+			try {
+				peer->writeBytes(const_cast<BYTE8 *>(bootstrap->data()), (int) bootstrap->size());
+				logDebugF("Sent %d byte bootstrap to node %d", (int) bootstrap->size(), i);
+			} catch (exception &e) {
+				logFatalF("Could not boot node %d: %s", i, e.what());
+				failed = true;
+			}
+		});
+	}
+	for (std::thread &sender: senders) {
+		sender.join();
+	}
+	return !failed;
+}
+
+void NetworkEmulator::start() {
+	for (Crossbar *crossbar: myCrossbars) {
+		crossbar->start();
+	}
+	for (int i = 0; i < (int) myNodes.size(); i++) {
+		CPU *cpu = myNodes[i].cpu;
+		myNodes[i].thread = new std::thread([cpu, i] {
+			logDebugF("Start of emulation of node %d", i);
+			cpu->emulate(false);
+			logDebugF("End of emulation of node %d", i);
+		});
+	}
+}
+
+void NetworkEmulator::startScheduled(const int threadCount, const int budget) {
+	logInfoF("Running %d node(s) on %d thread(s)", (int) myNodes.size(), threadCount);
+	myScheduler = new Scheduler(threadCount, budget);
+	myScheduler->setLookahead(myLinkLatency);
+	scheduleNodes();
+}
+
+void NetworkEmulator::startLockstep(const WORD32 quantum) {
+	logInfoF("Running %d node(s) in lockstep", (int) myNodes.size());
+	myScheduler = new Scheduler(1, DefaultBudget);
+	myScheduler->setLockstep(quantum);
+	scheduleNodes();
+}
+
+void NetworkEmulator::scheduleNodes() {
+	for (Node &node: myNodes) {
+		node.cpu->prepareToRun(false);
+		const int task = myScheduler->addTask(node.cpu);
+		Scheduler *scheduler = myScheduler;
+		for (Link *link: node.links) {
+			// Unconnected links are NullLinks, which never block.
+			if (link != nullptr) {
+				link->setProgressCallback([scheduler, task] { scheduler->wake(task); });
+			}
+		}
+	}
+	for (Crossbar *crossbar: myCrossbars) {
+		crossbar->start();
+	}
+	// The callbacks are on the registers shared with each link's peer, so the host's end of the root's link 0 wakes
+	// the root too, when the host sends it something or takes its output.
+	myScheduler->start();
+}
+
+void NetworkEmulator::setLinkLatency(const WORD32 latency) {
+	myLinkLatency = latency;
+	// All but the host's link, whose bytes arrive when the host sends them.
+	for (size_t i = 1; i < myLinkFactories.size(); i++) {
+		myLinkFactories[i]->setLatency(latency);
+	}
+}
+
+void NetworkEmulator::requestTrace(const WORD32 traceFlags) {
+	for (int i = 0; i < (int) myNodes.size(); i++) {
+		myNodes[i].control->requestTrace((i == 0) ? traceFlags : (traceFlags & ~DebugFlags_Monitor));
+	}
+}
+
+void NetworkEmulator::terminate() {
+	for (Node &node: myNodes) {
+		node.control->request(Request_Terminate);
+	}
+	// Resetting an InMemoryLink fails transfers at both of its ends, so resetting the node end of each will do.
+	for (InMemoryLinkFactory *linkFactory: myLinkFactories) {
+		try {
+			linkFactory->linkB()->resetLink();
+		} catch (exception &e) {
+			logErrorF("Could not reset link: %s", e.what());
+		}
+	}
+	if (myScheduler != nullptr) {
+		// Those blocked have been woken by the resets; this is for any waiting on anything else.
+		myScheduler->wakeAll();
+	}
+}
+
+void NetworkEmulator::join() {
+	if (myScheduler != nullptr) {
+		myScheduler->join();
+		if (myLinkLatency != 0) {
+			for (int i = 0; i < (int) myNodes.size(); i++) {
+				logInfoF("Node %d ran for %u cycles", i, myNodes[i].cpu->getCycleCount());
+			}
+		}
+		// The links outlive it.
+		for (Node &node: myNodes) {
+			for (Link *link: node.links) {
+				if (link != nullptr) {
+					link->setProgressCallback(nullptr);
+				}
+			}
+		}
+		delete myScheduler;
+		myScheduler = nullptr;
+	}
+	for (Node &node: myNodes) {
+		if (node.thread != nullptr) {
+			node.thread->join();
+			delete node.thread;
+			node.thread = nullptr;
+		}
+	}
+	// Nothing is left to talk through them.
+	for (Crossbar *crossbar: myCrossbars) {
+		crossbar->stop();
+	}
+}
+
+NetworkEmulator::~NetworkEmulator() {
+	logDebug("NetworkEmulator DTOR");
+	bool running = (myScheduler != nullptr);
+	for (Node &node: myNodes) {
+		running |= (node.thread != nullptr);
+	}
+	if (running) {
+		terminate();
+		join();
+	}
+	for (Node &node: myNodes) {
+		if (node.cpu != nullptr) {
+			delete node.cpu;
+		} else {
+			// Never initialised, so still ours.
+			for (Link *link: node.links) {
+				delete link;
+			}
+		}
+		delete node.memory;
+		delete node.control;
+	}
+	for (Crossbar *crossbar: myCrossbars) {
+		delete crossbar;
+	}
+	for (Link *link: myCrossbarLinks) {
+		delete link;
+	}
+	for (SymbolTable *symbolTable: mySymbolTables) {
+		delete symbolTable;
+	}
+	for (InMemoryLinkFactory *linkFactory: myLinkFactories) {
+		delete linkFactory;
+	}
+}
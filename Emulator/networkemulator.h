@@ -0,0 +1,106 @@
+//------------------------------------------------------------------------------
+//
+// File        : networkemulator.h
+// Description : A network of transputers, each emulated on its own thread,
+//               with their links wired together in memory.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#ifndef _NETWORKEMULATOR_H
+#define _NETWORKEMULATOR_H
+
+#include <thread>
+#include <vector>
+
+#include "types.h"
+#include "controlblock.h"
+#include "cpu.h"
+#include "memory.h"
+#include "link.h"
+#include "inmemorylink.h"
+#include "symbol.h"
+#include "scheduler.h"
+#include "topology.h"
+#include "crossbar.h"
+
+// Node 0 is the root: its link 0 is connected to the host (usually the IServer), via the link returned by
+// getHostLink. Every node boots from whichever of its links first delivers a control byte, usually its link 0,
+// wired towards the root, which (or whose booted program) sends them their code. Or the host can boot them all at
+// once, with bootNodes. Links that aren't wired are NullLinks.
+class NetworkEmulator {
+	public:
+		typedef Topology::Connection Connection;
+		// 2-phase CTOR, like the CPUs and Memories it holds.
+		NetworkEmulator();
+		// Construct nodeCount nodes with ramSize bytes of RAM each, wired by the connections. Each node has its own
+		// ControlBlock, whose flags are set from flags (though only the root may enter the monitor).
+		bool initialise(int nodeCount, long ramSize, WORD32 flags, SymbolTable *symbolTable,
+						const std::vector<Connection> &connections);
+		// Or construct the nodes, connections and crossbars of a topology. Nodes whose RAM size isn't given have
+		// ramSize bytes, and those without their own symbol file use symbolTable.
+		bool initialise(const Topology &topology, long ramSize, WORD32 flags, SymbolTable *symbolTable);
+		// Owned by the caller, who must delete it after this.
+		Link *getHostLink() const;
+		int getNodeCount() const;
+		CPU *getCPU(int node) const;
+		Memory *getMemory(int node) const;
+		ControlBlock *getControlBlock(int node) const;
+		// Start each node emulating, booting from its links, on its own thread.
+		void start();
+		// Or, for networks with more nodes than there are host cores, run them on a pool of threadCount threads,
+		// budget instructions at a time. Nodes blocked on links don't occupy a thread.
+		static const int DefaultBudget = 4096;
+		void startScheduled(int threadCount, int budget);
+		// For timing-faithful results, before startScheduled: run in PDES mode (see Scheduler), with every byte
+		// taking latency cycles to cross a link between nodes. A byte takes about 1.1us on a 10Mbit/s link.
+		static const WORD32 DefaultLinkLatency = 22;
+		void setLinkLatency(WORD32 latency);
+		// Or, for runs that can be repeated exactly, run the nodes on one thread in lockstep (see Scheduler),
+		// quantum cycles at a time. The default is a low priority timeslice. Crossbars run on their own threads, so
+		// runs of networks with crossbars may not repeat exactly.
+		static const WORD32 DefaultQuantum = 20480;
+		void startLockstep(WORD32 quantum);
+		// Once started, the host may boot any of the other nodes directly, with bootstraps[n] (if not empty) being
+		// sent to node n, all in parallel, from the far end of its lowest-numbered link wired to another node. None
+		// of its neighbours may send that node anything before this returns. Returns false, having logged why, if
+		// any can't be sent.
+		bool bootNodes(const std::vector<std::vector<BYTE8>> &bootstraps);
+		// That far end, which the host may go on to use to talk to the booted node; nullptr if it has none.
+		Link *getBootLink(int node) const;
+		// Turn on the given debug flags in every node (though only the root may enter the monitor), at their next
+		// safepoint.
+		void requestTrace(WORD32 traceFlags);
+		// Ask every node to terminate, and reset all the links so that nodes blocked in transfers notice.
+		void terminate();
+		// Wait for all the nodes to terminate.
+		void join();
+		~NetworkEmulator();
+
+	private:
+		struct Node {
+			ControlBlock *control;
+			Memory *memory;
+			CPU *cpu;
+			Link *links[4];
+			Link *peers[4]; // the other ends of the links wired to other nodes
+			std::thread *thread;
+		};
+		void scheduleNodes(void);
+		Link *wireToCrossbar(int node, int link, int port);
+		std::vector<Node> myNodes;
+		std::vector<InMemoryLinkFactory *> myLinkFactories;
+		std::vector<Crossbar *> myCrossbars;
+		std::vector<Link *> myCrossbarLinks; // their ends of the links wired to them
+		std::vector<SymbolTable *> mySymbolTables; // the nodes' own
+		Link *myHostLink;
+		Scheduler *myScheduler;
+		WORD32 myLinkLatency;
+};
+
+#endif // _NETWORKEMULATOR_H
@@ -0,0 +1,341 @@
+//------------------------------------------------------------------------------
+//
+// File        : scheduler.cpp
+// Description : Runs many CPUs on a fixed pool of host threads, with
+//               work-stealing.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+#include "scheduler.h"
+#include "log.h"
+
+// Which scheduler and worker the current thread is, so that tasks woken by a worker's CPU go onto its own deque.
+static thread_local Scheduler *currentScheduler = nullptr;
+static thread_local int currentWorker = -1;
+
+Scheduler::Scheduler(const int threadCount, const int budget) : myBudget(budget), myLiveTasks(0), myNextWorker(0),
+	myStopping(false), myLookahead(0), myHorizon(0), myActiveTasks(0), myQuantum(0),
+	myWorkGeneration(0) {
+	logDebugF("Scheduler CTOR with %d threads", threadCount);
+	for (int i = 0; i < threadCount; i++) {
+		std::unique_ptr<Worker> worker(new Worker());
+		worker->thread = nullptr;
+		myWorkers.push_back(std::move(worker));
+	}
+}
+
+int Scheduler::addTask(CPU *cpu) {
+	std::unique_ptr<Task> task(new Task());
+	task->cpu = cpu;
+	task->state.store(Task_Queued);
+	task->time.store(cpu->getCycleCount());
+	task->awaitingTimedInput.store(false);
+	myTasks.push_back(std::move(task));
+	const int taskId = (int) myTasks.size() - 1;
+	// Spread the initial tasks across the workers.
+	myWorkers[taskId % myWorkers.size()]->tasks.push_back(taskId);
+	myLiveTasks++;
+	myActiveTasks++;
+	return taskId;
+}
+
+void Scheduler::setLookahead(const WORD32 lookahead) {
+	myLookahead = lookahead;
+}
+
+void Scheduler::setLockstep(const WORD32 quantum) {
+	myQuantum = quantum;
+}
+
+void Scheduler::start() {
+	if (myLiveTasks == 0) {
+		myStopping = true;
+	}
+	if (myLookahead != 0 && !myTasks.empty()) {
+		WORD32 earliest = myTasks[0]->time.load();
+		for (auto &task: myTasks) {
+			if ((SWORD32)(task->time.load() - earliest) < 0) {
+				earliest = task->time.load();
+			}
+		}
+		myHorizon = earliest + myLookahead;
+		logInfoF("PDES mode, with a lookahead of %u cycles", myLookahead);
+	}
+	if (myQuantum != 0) {
+		logInfoF("Lockstep mode, with a quantum of %u cycles", myQuantum);
+		myWorkers[0]->thread = new std::thread([this] { lockstep(); });
+		return;
+	}
+	for (int i = 0; i < (int) myWorkers.size(); i++) {
+		myWorkers[i]->thread = new std::thread([this, i] { work(i); });
+	}
+}
+
+void Scheduler::wake(const int task) {
+	std::atomic<int> &state = myTasks[task]->state;
+	int current = state.load();
+	for (;;) {
+		if (current == Task_Blocked) {
+			if (state.compare_exchange_weak(current, Task_Queued)) {
+				queue(task);
+				return;
+			}
+		} else if (current == Task_Running) {
+			// Its worker will run it again, rather than leaving it blocked.
+			if (state.compare_exchange_weak(current, Task_Woken)) {
+				return;
+			}
+		} else {
+			return; // Already queued, woken, or done.
+		}
+	}
+}
+
+void Scheduler::wakeAll() {
+	for (int task = 0; task < (int) myTasks.size(); task++) {
+		wake(task);
+		int atHorizon = Task_AtHorizon;
+		if (myTasks[task]->state.compare_exchange_strong(atHorizon, Task_Queued)) {
+			queue(task);
+		}
+	}
+}
+
+// Queue a task that wasn't active onto the current worker's deque, or any, if not called by a worker.
+void Scheduler::queue(const int task) {
+	myActiveTasks++;
+	if (myQuantum != 0) {
+		// The lockstep thread finds it by its state.
+		workChanged(false);
+		return;
+	}
+	push(currentScheduler == this ? currentWorker : (int) (myNextWorker++ % myWorkers.size()), task);
+}
+
+// When the last active task blocks, reaches the horizon or terminates, the window can move on.
+void Scheduler::taskInactive() {
+	if (--myActiveTasks == 0 && myLookahead != 0) {
+		advanceWindow();
+	}
+}
+
+void Scheduler::advanceWindow() {
+	std::lock_guard<std::mutex> guard(myWindowMutex);
+	bool bounded = false;
+	WORD32 earliest = 0;
+	for (auto &task: myTasks) {
+		const int state = task->state.load();
+		if (state == Task_Done || (state == Task_Blocked && task->awaitingTimedInput.load())) {
+			continue;
+		}
+		const WORD32 time = task->time.load();
+		if (!bounded || (SWORD32)(time - earliest) < 0) {
+			earliest = time;
+			bounded = true;
+		}
+	}
+	if (!bounded) {
+		// Every CPU is waiting for another: deadlock.
+		return;
+	}
+	const WORD32 horizon = earliest + myLookahead;
+	if ((SWORD32)(horizon - myHorizon.load()) > 0) {
+		myHorizon = horizon;
+	}
+	for (int task = 0; task < (int) myTasks.size(); task++) {
+		if ((SWORD32)(myTasks[task]->time.load() - myHorizon.load()) < 0) {
+			int atHorizon = Task_AtHorizon;
+			if (myTasks[task]->state.compare_exchange_strong(atHorizon, Task_Queued)) {
+				queue(task);
+			}
+		}
+	}
+}
+
+void Scheduler::push(const int worker, const int task) {
+	{
+		std::lock_guard<std::mutex> guard(myWorkers[worker]->mutex);
+		myWorkers[worker]->tasks.push_back(task);
+	}
+	workChanged(false);
+}
+
+void Scheduler::workChanged(const bool everyone) {
+	std::lock_guard<std::mutex> guard(myIdleMutex);
+	myWorkGeneration++;
+	if (everyone) {
+		myIdle.notify_all();
+	} else {
+		myIdle.notify_one();
+	}
+}
+
+bool Scheduler::nextTask(const int worker, int &task) {
+	{
+		Worker &own = *myWorkers[worker];
+		std::lock_guard<std::mutex> guard(own.mutex);
+		if (!own.tasks.empty()) {
+			task = own.tasks.back();
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+	for (size_t i = 1; i < myWorkers.size(); i++) {
+		Worker &victim = *myWorkers[(worker + i) % myWorkers.size()];
+		std::lock_guard<std::mutex> guard(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void Scheduler::work(const int worker) {
+	currentScheduler = this;
+	currentWorker = worker;
+	logDebugF("Scheduler worker %d starting", worker);
+	while (!myStopping) {
+		int task;
+		// Anything pushed after this is noticed by the wait.
+		const unsigned long generation = myWorkGeneration.load();
+		if (!nextTask(worker, task)) {
+			std::unique_lock<std::mutex> lock(myIdleMutex);
+			myIdle.wait(lock, [this, generation] { return myWorkGeneration.load() != generation || myStopping; });
+			continue;
+		}
+		Task &current = *myTasks[task];
+		std::atomic<int> &state = current.state;
+		state.store(Task_Running);
+		if (myLookahead != 0) {
+			current.cpu->setHorizon(myHorizon.load());
+		}
+		const CPU::RunResult result = current.cpu->run(myBudget);
+		current.time.store(current.cpu->getCycleCount());
+		current.awaitingTimedInput.store(result == CPU::RunResult::Blocked && current.cpu->awaitingTimedInput());
+		switch (result) {
+			case CPU::RunResult::Ran:
+				state.store(Task_Queued);
+				push(worker, task);
+				break;
+			case CPU::RunResult::Blocked: {
+				int running = Task_Running;
+				if (state.compare_exchange_strong(running, Task_Blocked)) {
+					taskInactive();
+				} else {
+					// Woken while running, so the link may now be able to proceed.
+					state.store(Task_Queued);
+					push(worker, task);
+				}
+				}
+				break;
+			case CPU::RunResult::AtHorizon:
+				// Released when the window moves on.
+				state.store(Task_AtHorizon);
+				taskInactive();
+				break;
+			case CPU::RunResult::Terminated:
+				state.store(Task_Done);
+				if (--myLiveTasks == 0) {
+					myStopping = true;
+					workChanged(true);
+				}
+				taskInactive();
+				break;
+		}
+	}
+	logDebugF("Scheduler worker %d stopping", worker);
+}
+
+void Scheduler::lockstep() {
+	currentScheduler = this;
+	currentWorker = 0;
+	logDebug("Scheduler lockstep starting");
+	WORD32 earliest = 0;
+	for (int task = 0; task < (int) myTasks.size(); task++) {
+		const WORD32 time = myTasks[task]->time.load();
+		if (task == 0 || (SWORD32)(time - earliest) < 0) {
+			earliest = time;
+		}
+	}
+	// Quanta start at multiples of the quantum, so that a run resumed from a snapshot keeps in step.
+	WORD32 horizon = earliest - (earliest % myQuantum) + myQuantum;
+	while (!myStopping) {
+		const unsigned long generation = myWorkGeneration.load();
+		// Each pass runs the runnable CPUs in order; those that block are run on a later pass, once woken.
+		bool ran = false;
+		for (auto &current: myTasks) {
+			std::atomic<int> &state = current->state;
+			int queued = Task_Queued;
+			if (!state.compare_exchange_strong(queued, Task_Running)) {
+				continue;
+			}
+			ran = true;
+			current->cpu->setHorizon(horizon);
+			switch (current->cpu->run(myBudget)) {
+				case CPU::RunResult::Ran:
+					state.store(Task_Queued);
+					break;
+				case CPU::RunResult::Blocked: {
+					int running = Task_Running;
+					if (!state.compare_exchange_strong(running, Task_Blocked)) {
+						state.store(Task_Queued);
+					}
+					}
+					break;
+				case CPU::RunResult::AtHorizon:
+					state.store(Task_AtHorizon);
+					break;
+				case CPU::RunResult::Terminated:
+					state.store(Task_Done);
+					if (--myLiveTasks == 0) {
+						myStopping = true;
+					}
+					break;
+			}
+		}
+		if (ran) {
+			continue;
+		}
+		// Nothing could run: every CPU is blocked, or has finished the quantum.
+		bool atHorizon = false;
+		for (auto &current: myTasks) {
+			int waiting = Task_AtHorizon;
+			atHorizon |= current->state.compare_exchange_strong(waiting, Task_Queued);
+		}
+		if (atHorizon) {
+			horizon += myQuantum;
+		} else {
+			// All blocked, so waiting for the host, unless woken during the pass.
+			std::unique_lock<std::mutex> lock(myIdleMutex);
+			myIdle.wait(lock, [this, generation] { return myWorkGeneration.load() != generation || myStopping; });
+		}
+	}
+	logDebug("Scheduler lockstep stopping");
+}
+
+void Scheduler::join() {
+	for (auto &worker: myWorkers) {
+		if (worker->thread != nullptr) {
+			worker->thread->join();
+			delete worker->thread;
+			worker->thread = nullptr;
+		}
+	}
+}
+
+Scheduler::~Scheduler() {
+	logDebug("Scheduler DTOR");
+	myStopping = true;
+	workChanged(true);
+	join();
+}
@@ -0,0 +1,99 @@
+//------------------------------------------------------------------------------
+//
+// File        : scheduler.h
+// Description : Runs many CPUs on a fixed pool of host threads, with
+//               work-stealing.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cpu.h"
+
+// Each CPU is a task, run for a budget of instructions at a time by one of the worker threads. A task whose CPU
+// blocks on a link isn't run again until the link's progress callback wakes it (see wake), so blocked CPUs cost
+// nothing. Each worker has its own deque of runnable tasks, taking from its back; idle workers steal from the
+// front of the others'.
+// In PDES mode (given a lookahead), the CPUs' clocks are kept within a window: each runs until its clock reaches
+// the horizon, which is moved on, when no task is runnable, to the earliest clock plus the lookahead. No message
+// can then arrive in a CPU's past, since every byte crossing a link takes at least the lookahead to arrive. CPUs
+// waiting for a byte from a timed link don't hold the window back, as their clocks will jump to its stamp.
+// In lockstep mode, a single thread runs each CPU in turn, in the order they were added, to the end of each fixed
+// quantum of cycles, so that transfers between them always happen in the same order.
+class Scheduler {
+	public:
+		Scheduler(int threadCount, int budget);
+		// Add the CPUs before starting; each must have been prepared with CPU::prepareToRun. Returns the task id
+		// to wake it with.
+		int addTask(CPU *cpu);
+		// Before starting, to run in PDES mode; lookahead is the shortest time a byte takes to cross a link.
+		void setLookahead(WORD32 lookahead);
+		// Or, to run in lockstep mode, on one thread whatever the thread count.
+		void setLockstep(WORD32 quantum);
+		void start();
+		// Make the task runnable, if it is blocked. May be called from any thread.
+		void wake(int task);
+		// Also releases those waiting at the horizon, so that they may act upon any requests.
+		void wakeAll();
+		// Wait until every CPU has terminated.
+		void join();
+		~Scheduler();
+
+	private:
+		enum TaskState { Task_Blocked, Task_Queued, Task_Running, Task_Woken, Task_AtHorizon, Task_Done };
+		struct Task {
+			CPU *cpu;
+			std::atomic<int> state;
+			// As of the end of its last run, for moving the window on while it may be running again.
+			std::atomic<WORD32> time;
+			std::atomic<bool> awaitingTimedInput;
+		};
+		struct Worker {
+			std::mutex mutex;
+			std::deque<int> tasks;
+			std::thread *thread;
+		};
+		void work(int worker);
+		void lockstep(void);
+		bool nextTask(int worker, int &task);
+		void push(int worker, int task);
+		void queue(int task);
+		void taskInactive(void);
+		void workChanged(bool everyone);
+		void advanceWindow(void);
+
+		int myBudget;
+		std::vector<std::unique_ptr<Task>> myTasks;
+		std::vector<std::unique_ptr<Worker>> myWorkers;
+		std::atomic<int> myLiveTasks;
+		std::atomic<unsigned int> myNextWorker;
+		std::atomic<bool> myStopping;
+		// PDES: the window is moved on when there are no queued or running tasks.
+		WORD32 myLookahead;
+		std::atomic<WORD32> myHorizon;
+		std::atomic<int> myActiveTasks;
+		std::mutex myWindowMutex;
+		WORD32 myQuantum;
+		// Idle workers wait here for work, until the generation moves on: it's bumped under the mutex whenever work
+		// is pushed, or the scheduler stops.
+		std::mutex myIdleMutex;
+		std::condition_variable myIdle;
+		std::atomic<unsigned long> myWorkGeneration;
+};
+
+#endif // _SCHEDULER_H
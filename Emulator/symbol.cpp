@@ -13,6 +13,7 @@
 
 #include <cstdlib>
 #include <cctype>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -24,6 +25,7 @@ using namespace std;
 #ifdef DESKTOP
 
 #include "types.h"
+#include "platformdetection.h"
 #include "symbol.h"
 #include "log.h"
 
@@ -39,6 +41,31 @@ void SymbolTable::addSymbol(const std::string name, const WORD32 address) {
 	addressToSymbol[address] = name;
 }
 
+bool SymbolTable::loadSymbols(const std::string &fileName) {
+	std::ifstream read(fileName);
+	if (!read) {
+		logFatalF("Could not open symbol file %s", fileName.c_str());
+		return false;
+	}
+	for (std::string line; std::getline(read, line); ) {
+		char name[128];
+		WORD32 address;
+		if (line.empty()) {
+			continue;
+		}
+#if defined(PLATFORM_WINDOWS)
+		if (sscanf_s(line.c_str(), "%127s %08x", name, (unsigned) sizeof(name), &address) != 2) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		if (sscanf(line.c_str(), "%127s %08x", name, &address) != 2) {
+#endif
+			logFatalF("Symbol file %s has a line that isn't NAME HEX-ADDRESS: %s", fileName.c_str(), line.c_str());
+			return false;
+		}
+		addSymbol(name, address);
+	}
+	return true;
+}
+
 bool SymbolTable::symbolExists(std::string name) {
 	return symbolToAddress.count(name) == 1;
 }
@@ -25,6 +25,9 @@ class SymbolTable {
 	public:
 		SymbolTable();
 		void addSymbol(std::string name, WORD32 addr);
+		// Add the symbols listed in a file, one NAME HEX-ADDRESS per line. Returns false (having logged why) if it
+		// can't be read.
+		bool loadSymbols(const std::string &fileName);
 		bool symbolExists(std::string name);
 		WORD32 getSymbolValue(std::string name); // precondition: it's known to exist
 		std::string getSymbolName(WORD32 addr); // precondition: it's known to exist
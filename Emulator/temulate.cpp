@@ -50,13 +50,17 @@ using namespace std;
 // global variables
 long ramSize;
 long romSize;
-WORD32 flags;
+ControlBlock *myControl;
 
 #ifdef DESKTOP
 
 static char *romFile;
 static char *progName;
 set<WORD32> breakpointAddresses;
+map<WORD32, WORD32> watchpointRanges;
+std::string snapshotFile;
+std::string cloneFile;
+std::string cloneAddressSpec;
 map<std::string, WORD32> symbolToAddress;
 WORD32 SPP, RPP;
 
@@ -94,10 +98,20 @@ void usage() {
 	logInfo("  -i    Enters interactive monitor immediately");
 	logInfo("  -j    Enables break on j0");
 	logInfo("  -x    Terminate emulation upon memory violation");
+	logInfo("  -k    Enables the extended boot protocol's block peeks and pokes, so boot");
+	logInfo("        control bytes 2 and 3 aren't bootstrap lengths");
 	logInfo("  -s<F> Load a list of symbols (lines with NAME HEX-ADDRESS) from file X");
 	logInfo("  -b<H> Add H (a hex address or symbol) as a breakpoint (can be repeated)");
 	logInfo("        (Note: symbols must have been specified first with -s<F> to give");
 	logInfo("         a symbol as a breakpoint)");
+	logInfo("  -w<H>[,<L>] Watch L (hex, default 4) bytes of RAM from H (a hex address or");
+	logInfo("        symbol); any access to them enters the monitor (can be repeated)");
+	logInfo("  -S<F> Resume from the snapshot in file F (saved with the monitor's snap command)");
+	logInfo("        instead of booting");
+	logInfo("  -F<F>[@<H>] Clone the emulator when the program executes a marker instruction, or");
+	logInfo("        reaches H (a hex address or symbol). F lists one clone per line as");
+	logInfo("        'input-file output-file' (or just 'output-file'); each clone continues with");
+	logInfo("        those as its TVS input and output. Requires -tvs.");
 	logInfo("  -e    Enables debug features that assist eForth debugging:");
 	logInfo("        Displays the data and return stacks (with symbols)");
 	logInfo("        (Note: symbols must have been specified first with -s<F> and");
@@ -251,6 +265,9 @@ bool processCommandLine(int argc, char *argv[]) {
 				case 'x':
 					SET_FLAGS(DebugFlags_TerminateOnMemViol);
 					break;
+				case 'k':
+					SET_FLAGS(DebugFlags_BlockBoot);
+					break;
 				case 'b': {
 					// TODO if you want a breakpoint at a symbol whose name is a valid hex number, tough!
 					char symbolName[40];
@@ -278,6 +295,62 @@ bool processCommandLine(int argc, char *argv[]) {
 					}
 					}
 					break;
+				case 'S':
+					if (strlen(argv[i]) > 2) {
+						snapshotFile = std::string(argv[i] + 2);
+					} else {
+						logFatal("-S must be directly followed by a snapshot file");
+						return false;
+					}
+					break;
+				case 'F': {
+					std::string cloneSpec(&argv[i][2]);
+					const size_t at = cloneSpec.find('@');
+					cloneFile = cloneSpec.substr(0, at);
+					if (at != std::string::npos) {
+						cloneAddressSpec = cloneSpec.substr(at + 1);
+					}
+					if (cloneFile.empty()) {
+						logFatal("-F must be directly followed by a clone list file");
+						return false;
+					}
+					}
+					break;
+				case 'w': {
+					char symbolName[40];
+					WORD32 watchAddress = 0;
+					WORD32 watchLength = 4;
+					std::string watchSpec(&argv[i][2]);
+					const size_t comma = watchSpec.find(',');
+					const std::string watchAddressSpec = watchSpec.substr(0, comma);
+					if (comma != std::string::npos) {
+#if defined(PLATFORM_WINDOWS)
+						if (sscanf_s(watchSpec.c_str() + comma + 1, "%x", &watchLength) != 1) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+						if (sscanf(watchSpec.c_str() + comma + 1, "%x", &watchLength) != 1) {
+#endif
+							logFatal("-w length must be a hex number e.g. -w8007F123,10");
+							return false;
+						}
+					}
+#if defined(PLATFORM_WINDOWS)
+					if (sscanf_s(watchAddressSpec.c_str(), "%s", sizeof(symbolName), symbolName) == 1 && symbolToAddress.count(symbolName) == 1) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+					if (sscanf(watchAddressSpec.c_str(), "%s", symbolName) == 1 && symbolToAddress.count(symbolName) == 1) {
+#endif
+						watchpointRanges[symbolToAddress[symbolName]] = watchLength;
+#if defined(PLATFORM_WINDOWS)
+					} else if (sscanf_s(watchAddressSpec.c_str(), "%x", &watchAddress) == 1) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+					} else if (sscanf(watchAddressSpec.c_str(), "%x", &watchAddress) == 1) {
+#endif
+						watchpointRanges[watchAddress] = watchLength;
+					} else {
+						logFatal("-w must be directly followed by a hex address or symbol e.g. -w8007F123");
+						return false;
+					}
+					}
+					break;
 				case 's': {
 					char symbolFile[128];
 #if defined(PLATFORM_WINDOWS)
@@ -351,10 +424,56 @@ bool processCommandLine(int argc, char *argv[]) {
 	if (showConf) {
 		showConfiguration();
 	}
+	if (!cloneFile.empty() && IS_FLAG_CLEAR(EmulatorState_TVS)) {
+		logFatal("-F requires -tvs");
+		return false;
+	}
 	//logDebug("End of cmd line processing");
 	return true;
 }
 
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+// Read the -F clone list, and the optional clone address.
+bool readClones(std::vector<CPU::CloneStreams> &clones, WORD32 &cloneAddress) {
+	std::ifstream read(cloneFile);
+	if (!read.good()) {
+		logFatalF("Could not open clone list file %s", cloneFile.c_str());
+		return false;
+	}
+	for (std::string line; std::getline(read, line); ) {
+		std::stringstream ss(line);
+		std::string first, second;
+		ss >> first;
+		ss >> second;
+		if (first.empty()) {
+			continue;
+		}
+		CPU::CloneStreams streams;
+		if (second.empty()) {
+			streams.output = first;
+		} else {
+			streams.input = first;
+			streams.output = second;
+		}
+		clones.push_back(streams);
+	}
+	if (clones.empty()) {
+		logFatalF("Clone list file %s is empty", cloneFile.c_str());
+		return false;
+	}
+	cloneAddress = 0;
+	if (!cloneAddressSpec.empty()) {
+		if (symbolToAddress.count(cloneAddressSpec) == 1) {
+			cloneAddress = symbolToAddress[cloneAddressSpec];
+		} else if (sscanf(cloneAddressSpec.c_str(), "%x", &cloneAddress) != 1) {
+			logFatal("-F<F>@ must be followed by a hex address or symbol e.g. -Fclones.txt@8007F123");
+			return false;
+		}
+	}
+	return true;
+}
+#endif
+
 #ifdef UNIX
 void segViolHandler(int sig) {
 	logFatal("Segmentation violation. Terminating");
@@ -366,7 +485,7 @@ void interruptHandler(int sig) {
 	signal(SIGINT,interruptHandler);
 	logWarn("Emulator interrupted.. indicating shutdown is necessary");
 	fflush(stdout);
-	SET_FLAGS(EmulatorState_Terminate);
+	myControl->requestFromSignalHandler(Request_Terminate);
 }
 #endif // UNIX
 
@@ -441,7 +560,7 @@ int main() {
 #endif
 	ramSize = DefaultMemSize;
 	romSize = 0;
-	flags = 0;
+	myControl = new ControlBlock();
 
 #ifdef EMBEDDED
 	int logLevel = LOGLEVEL_INFO;
@@ -502,7 +621,7 @@ int main() {
 #endif
 
 	logDebug("Constructing memory...");
-	memory = new Memory();
+	memory = new Memory(myControl);
 	logDebug("Memory constructed");
 #if defined(DESKTOP)
 	if (!memory->initialiseROMFileAndSymbolTable(romFile, symbolTable)) {
@@ -539,6 +658,38 @@ int main() {
 	if (IS_FLAG_SET(DebugFlags_eForth)) {
 		cpu->seteForthStackAddresses(SPP, RPP);
 	}
+	for (auto &watchpointRange: watchpointRanges) {
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		if (!memory->addWatchpoint(watchpointRange.first, watchpointRange.second)) {
+			doExit(1);
+		}
+#else
+		logWarnF("Watchpoints are not supported on this platform; ignoring %08X", watchpointRange.first);
+#endif
+	}
+	if (!cloneFile.empty()) {
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		std::vector<CPU::CloneStreams> clones;
+		WORD32 cloneAddress;
+		if (!readClones(clones, cloneAddress)) {
+			doExit(1);
+		}
+		cpu->setClones(clones, cloneAddress);
+#else
+		logFatal("Cloning is not supported on this platform");
+		doExit(1);
+#endif
+	}
+	if (!snapshotFile.empty()) {
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		if (!cpu->restoreSnapshot(snapshotFile.c_str())) {
+			doExit(1);
+		}
+#else
+		logFatal("Snapshots are not supported on this platform");
+		doExit(1);
+#endif
+	}
 #endif
 	logInfo("Start of emulation");
 
@@ -23,7 +23,6 @@ using namespace std;
 #include "types.h"
 #include "memloc.h"
 
-WORD32 flags;
 #include "flags.h"
 
 class PeekPokeBootTest : public ::testing::Test {
@@ -32,6 +31,7 @@ public:
     }
 protected:
 
+    ControlBlock *myControl;
     Memory *myMemory;
     InMemoryLinkFactory *m_linkFactory[4];
     Link *myBootLinks[4];
@@ -45,9 +45,10 @@ protected:
 
     void SetUp() override {
         setLogLevel(LOGLEVEL_DEBUG);
+        myControl = new ControlBlock();
         SET_FLAGS(DebugFlags_LinkComms | MemAccessDebug_Full | DebugFlags_TerminateOnMemViol);
         logDebug("SetUp start");
-	    myMemory = new Memory();
+	    myMemory = new Memory(myControl);
         if (!myMemory->initialise(1024)) {
             logError("Memory initialisation failed");
             FAIL();
@@ -118,6 +119,7 @@ protected:
         }
         delete myMemory;
         delete myBoot;
+        delete myControl;
         logDebug("TearDown complete");
         logFlush();
     }
@@ -136,9 +138,7 @@ protected:
     }
 };
 
-// For characterising the initial code lifted out of main, we only use Link0.
-// With this initial code, synchronous links don't currently provide a mechanism for
-// sensing whether any data is available. Allowing any / all links is an enhancement.
+// Most of these use Link0; in-memory links can be polled, so any link may be used.
 
 TEST_F(PeekPokeBootTest, PeekAWordFromLegalMemory) {
     myMemory->setWord(MemStart + 20, 0xCAFEF00D);
@@ -255,3 +255,47 @@ TEST_F(PeekPokeBootTest, BootIt) {
 
     EXPECT_EQ(myBoot->bootLen(), 7);
 }
+
+TEST_F(PeekPokeBootTest, BootFromWhicheverLinkDeliversFirst) {
+    setupDone.store(true, std::memory_order_release);
+    startBoot();
+
+    // Peeks and pokes may arrive on any link before the bootstrap.
+    myControlLinks[1]->writeByte(BOOT_POKE);
+    myControlLinks[1]->writeWord(MemStart + 20);
+    myControlLinks[1]->writeWord(0x12345678);
+    myControlLinks[2]->writeByte(2);
+    myControlLinks[2]->writeByte(0xDE);
+    myControlLinks[2]->writeByte(0xAD);
+
+    waitUntilEndOfBoot();
+    EXPECT_EQ(myMemory->getWord(MemStart + 20), 0x12345678);
+    EXPECT_EQ(myMemory->getByte(MemStart + 0), 0xDE);
+    EXPECT_EQ(myBoot->bootLinkNo(), 2);
+}
+
+TEST_F(PeekPokeBootTest, BlockPokeAndPeekWhenEnabled) {
+    SET_FLAGS(DebugFlags_BlockBoot);
+    setupDone.store(true, std::memory_order_release);
+    startBoot();
+
+    BYTE8 data[10] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    myControlLinks[0]->writeByte(BOOT_BLOCK_POKE);
+    myControlLinks[0]->writeWord(MemStart + 21);
+    myControlLinks[0]->writeWord(sizeof(data));
+    myControlLinks[0]->writeBytes(data, sizeof(data));
+    myControlLinks[0]->writeByte(BOOT_BLOCK_PEEK);
+    myControlLinks[0]->writeWord(MemStart + 21);
+    myControlLinks[0]->writeWord(sizeof(data));
+    for (BYTE8 b: data) {
+        EXPECT_EQ(myControlLinks[0]->readByte(), b);
+    }
+    // Only longer bootstraps are possible now.
+    myControlLinks[0]->writeByte(4);
+    myControlLinks[0]->writeWord(0);
+
+    waitUntilEndOfBoot();
+    EXPECT_EQ(myMemory->getByte(MemStart + 21), 1);
+    EXPECT_EQ(myMemory->getByte(MemStart + 30), 10);
+    EXPECT_EQ(myBoot->bootLen(), 4);
+}
@@ -0,0 +1,118 @@
+//------------------------------------------------------------------------------
+//
+// File        : testcontrolblock.cpp
+// Description : Tests the posting and taking of requests in the ControlBlock.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <chrono>
+#include <thread>
+#include "gtest/gtest.h"
+using namespace std;
+#include "types.h"
+#include "flags.h"
+
+class ControlBlockTest : public ::testing::Test {
+protected:
+    ControlBlock *myControl = nullptr;
+
+    void SetUp() override {
+        myControl = new ControlBlock();
+    }
+
+    void TearDown() override {
+        delete myControl;
+    }
+};
+
+TEST_F(ControlBlockTest, InitiallyClear) {
+    EXPECT_EQ(myControl->flags, 0U);
+    EXPECT_EQ(myControl->pendingRequests(), 0U);
+}
+
+TEST_F(ControlBlockTest, FlagMacrosUseTheControlBlock) {
+    SET_FLAGS(DebugFlags_Monitor | EmulatorState_TVS);
+    EXPECT_TRUE(IS_FLAG_SET(DebugFlags_Monitor));
+    CLEAR_FLAGS(DebugFlags_Monitor);
+    EXPECT_TRUE(IS_FLAG_CLEAR(DebugFlags_Monitor));
+    EXPECT_EQ(myControl->flags, (WORD32) EmulatorState_TVS);
+    // Requests don't touch the flags.
+    myControl->request(Request_Terminate);
+    EXPECT_TRUE(IS_FLAG_CLEAR(EmulatorState_Terminate));
+}
+
+TEST_F(ControlBlockTest, TakingRequestsClearsThem) {
+    myControl->request(Request_Terminate);
+    myControl->request(Request_Monitor);
+    EXPECT_EQ(myControl->takeRequests(), Request_Terminate | Request_Monitor);
+    EXPECT_EQ(myControl->pendingRequests(), 0U);
+}
+
+TEST_F(ControlBlockTest, PauseRemainsPendingUntilWithdrawn) {
+    myControl->request(Request_Pause | Request_Monitor);
+    EXPECT_EQ(myControl->takeRequests(), Request_Pause | Request_Monitor);
+    EXPECT_EQ(myControl->pendingRequests(), Request_Pause);
+    myControl->withdraw(Request_Pause);
+    EXPECT_EQ(myControl->pendingRequests(), 0U);
+}
+
+TEST_F(ControlBlockTest, RequestsFromOtherThreadsAreNotLost) {
+    std::thread terminator([this] { for (int i = 0; i < 10000; i++) myControl->request(Request_Terminate); });
+    std::thread monitor([this] { for (int i = 0; i < 10000; i++) myControl->request(Request_Monitor); });
+    WORD32 taken = 0;
+    while (taken != (Request_Terminate | Request_Monitor)) {
+        taken |= myControl->takeRequests();
+    }
+    terminator.join();
+    monitor.join();
+    EXPECT_EQ(taken, Request_Terminate | Request_Monitor);
+}
+
+TEST_F(ControlBlockTest, TraceRequestCarriesFlags) {
+    myControl->requestTrace(0x02);
+    myControl->requestTrace(0x40);
+    EXPECT_EQ(myControl->takeRequests(), Request_Trace);
+    EXPECT_EQ(myControl->getTraceFlags(), 0x42U);
+}
+
+TEST_F(ControlBlockTest, WithdrawingThePauseWakesTheWaiter) {
+    myControl->request(Request_Pause);
+    std::thread cpu([this] { myControl->waitWhilePaused(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const auto withdrawn = std::chrono::steady_clock::now();
+    myControl->withdraw(Request_Pause);
+    cpu.join();
+    // Well within the wait's timeout, so it was notified.
+    EXPECT_LT(std::chrono::steady_clock::now() - withdrawn,
+              std::chrono::milliseconds(ControlBlock::PauseWaitMillis / 2));
+}
+
+TEST_F(ControlBlockTest, RequestWhilePausedEndsTheWait) {
+    myControl->request(Request_Pause);
+    std::thread cpu([this] { myControl->waitWhilePaused(); });
+    myControl->request(Request_Monitor);
+    cpu.join();
+    EXPECT_EQ(myControl->takeRequests(), Request_Pause | Request_Monitor);
+}
+
+TEST_F(ControlBlockTest, RequestFromSignalHandlerIsNoticedByTheWaitsTimeout) {
+    myControl->request(Request_Pause);
+    std::thread cpu([this] { myControl->waitWhilePaused(); });
+    myControl->requestFromSignalHandler(Request_Terminate);
+    cpu.join();
+    EXPECT_EQ(myControl->takeRequests(), Request_Pause | Request_Terminate);
+}
+
+#if defined(DESKTOP) && (defined(PLATFORM_OSX) || defined(PLATFORM_LINUX))
+TEST_F(ControlBlockTest, SnapshotRequestCarriesFileName) {
+    myControl->requestSnapshot("/tmp/cpu.snap");
+    EXPECT_EQ(myControl->takeRequests(), Request_Snapshot);
+    EXPECT_EQ(myControl->getSnapshotFile(), "/tmp/cpu.snap");
+}
+#endif
@@ -0,0 +1,323 @@
+//------------------------------------------------------------------------------
+//
+// File        : testmemory.cpp
+// Description : Tests the memory subsystem's dirty page tracking, snapshot images and watchpoints.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <cstdio>
+#include <thread>
+#include <unistd.h>
+#include "gtest/gtest.h"
+using namespace std;
+#include "log.h"
+#include "memory.h"
+#include "types.h"
+#include "memloc.h"
+
+#include "flags.h"
+
+class MemoryTest : public ::testing::Test {
+protected:
+    ControlBlock *myControl = nullptr;
+    Memory *myMemory = nullptr;
+    SymbolTable *mySymbolTable = nullptr;
+
+    void SetUp() override {
+        setLogLevel(LOGLEVEL_DEBUG);
+        myControl = new ControlBlock();
+        myMemory = new Memory(myControl);
+        ASSERT_TRUE(myMemory->initialise(64 * 1024));
+        mySymbolTable = new SymbolTable();
+        myMemory->initialiseROMFileAndSymbolTable(nullptr, mySymbolTable);
+    }
+
+    void TearDown() override {
+        delete myMemory;
+        delete mySymbolTable;
+        delete myControl;
+    }
+};
+
+TEST_F(MemoryTest, InitialMemoryIsZero) {
+    for (WORD32 addr = InternalMemStart; addr < InternalMemStart + (64 * 1024); addr += 4) {
+        ASSERT_EQ(myMemory->getWord(addr), 0UL);
+    }
+}
+
+TEST_F(MemoryTest, InitiallyNoPagesAreDirty) {
+    EXPECT_EQ(myMemory->getDirtyPageCount(), 0UL);
+    EXPECT_TRUE(myMemory->getDirtyPages().empty());
+    EXPECT_FALSE(myMemory->isPageDirty(InternalMemStart));
+}
+
+TEST_F(MemoryTest, ReadsDoNotDirtyPages) {
+    myMemory->getByte(InternalMemStart + 0x1000);
+    myMemory->getWord(InternalMemStart + 0x2000);
+    myMemory->getInstruction(InternalMemStart + 0x3000);
+    EXPECT_EQ(myMemory->getDirtyPageCount(), 0UL);
+}
+
+TEST_F(MemoryTest, WritesDirtyTheirPages) {
+    myMemory->setByte(InternalMemStart + 0x1001, 0x01);
+    myMemory->setWord(InternalMemStart + 0x3000, 0x01020304);
+    EXPECT_EQ(myMemory->getDirtyPageCount(), 2UL);
+    EXPECT_FALSE(myMemory->isPageDirty(InternalMemStart));
+    EXPECT_TRUE(myMemory->isPageDirty(InternalMemStart + 0x1000));
+    EXPECT_TRUE(myMemory->isPageDirty(InternalMemStart + 0x1FFF));
+    EXPECT_FALSE(myMemory->isPageDirty(InternalMemStart + 0x2000));
+    EXPECT_TRUE(myMemory->isPageDirty(InternalMemStart + 0x3000));
+    const std::vector<WORD32> expected = { InternalMemStart + 0x1000, InternalMemStart + 0x3000 };
+    EXPECT_EQ(myMemory->getDirtyPages(), expected);
+}
+
+TEST_F(MemoryTest, WordWriteAcrossPageBoundaryDirtiesBothPages) {
+    myMemory->setWord(InternalMemStart + 0x0FFE, 0xFFFFFFFF);
+    const std::vector<WORD32> expected = { InternalMemStart, InternalMemStart + 0x1000 };
+    EXPECT_EQ(myMemory->getDirtyPages(), expected);
+}
+
+TEST_F(MemoryTest, BlockCopyDirtiesDestinationPages) {
+    myMemory->blockCopy(0x20, InternalMemStart + 0x1000, InternalMemStart + 0x5FF0);
+    const std::vector<WORD32> expected = { InternalMemStart + 0x5000, InternalMemStart + 0x6000 };
+    EXPECT_EQ(myMemory->getDirtyPages(), expected);
+}
+
+TEST_F(MemoryTest, BlockWriteDirtiesItsPagesAndReadsBack) {
+    std::vector<BYTE8> data(0x20), back(0x20);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (BYTE8) (i + 1);
+    }
+    ASSERT_TRUE(myMemory->writeBlock(InternalMemStart + 0x5FF0, data.data(), (WORD32) data.size()));
+    const std::vector<WORD32> expected = { InternalMemStart + 0x5000, InternalMemStart + 0x6000 };
+    EXPECT_EQ(myMemory->getDirtyPages(), expected);
+    ASSERT_TRUE(myMemory->readBlock(InternalMemStart + 0x5FF0, back.data(), (WORD32) back.size()));
+    EXPECT_EQ(back, data);
+}
+
+TEST_F(MemoryTest, BlockTransfersMustBeWithinMemory) {
+    BYTE8 data[8] = { 0 };
+    EXPECT_FALSE(myMemory->writeBlock(InternalMemStart + (64 * 1024) - 4, data, sizeof(data)));
+    EXPECT_FALSE(myMemory->readBlock(InternalMemStart - 4, data, sizeof(data)));
+    EXPECT_EQ(myMemory->getDirtyPageCount(), 0UL);
+}
+
+TEST_F(MemoryTest, HostAddressForWritingDirtiesItsPages) {
+    BYTE8 *host = myMemory->hostAddress(InternalMemStart + 0x5FF0, 0x20, true);
+    ASSERT_NE(host, nullptr);
+    host[0x1F] = 0x42;
+    const std::vector<WORD32> expected = { InternalMemStart + 0x5000, InternalMemStart + 0x6000 };
+    EXPECT_EQ(myMemory->getDirtyPages(), expected);
+    EXPECT_EQ(myMemory->getByte(InternalMemStart + 0x600F), 0x42);
+    EXPECT_EQ(myMemory->hostAddress(InternalMemStart + 0x5FF0, 0x20, false), host);
+    EXPECT_EQ(myMemory->getDirtyPageCount(), 2UL);
+}
+
+TEST_F(MemoryTest, HostAddressMustBeWithinMemory) {
+    EXPECT_EQ(myMemory->hostAddress(InternalMemStart + (64 * 1024) - 4, 8, true), nullptr);
+    EXPECT_EQ(myMemory->hostAddress(InternalMemStart - 4, 8, false), nullptr);
+    EXPECT_EQ(myMemory->hostAddress(0xFFFFFFF0, 0x20, false), nullptr);
+    EXPECT_EQ(myMemory->getDirtyPageCount(), 0UL);
+}
+
+TEST_F(MemoryTest, HostAndCPUDirtyingPagesTogetherLoseNone) {
+    // The CPU writes the even pages as the host maps the odd ones for writing, all sharing one word of the bitmap.
+    for (int i = 0; i < 200; i++) {
+        myMemory->clearDirtyPages();
+        std::thread cpu([this] {
+            for (WORD32 page = 0; page < 16; page += 2) {
+                myMemory->setByte(InternalMemStart + page * Memory::DirtyPageSize, 0x01);
+            }
+        });
+        std::thread host([this] {
+            for (WORD32 page = 1; page < 16; page += 2) {
+                myMemory->hostAddress(InternalMemStart + page * Memory::DirtyPageSize, 1, true);
+            }
+        });
+        cpu.join();
+        host.join();
+        ASSERT_EQ(myMemory->getDirtyPageCount(), 16UL);
+    }
+}
+
+TEST_F(MemoryTest, ClearDirtyPagesKeepsContents) {
+    myMemory->setWord(InternalMemStart + 0x1000, 0x01020304);
+    myMemory->clearDirtyPages();
+    EXPECT_EQ(myMemory->getDirtyPageCount(), 0UL);
+    EXPECT_EQ(myMemory->getWord(InternalMemStart + 0x1000), 0x01020304UL);
+}
+
+TEST_F(MemoryTest, ResetDirtyPagesAfterClearingZeroesEarlierWrites) {
+    myMemory->setWord(InternalMemStart + 0x1000, 0x01020304);
+    myMemory->clearDirtyPages();
+    myMemory->resetDirtyPages();
+    EXPECT_EQ(myMemory->getWord(InternalMemStart + 0x1000), 0UL);
+}
+
+TEST_F(MemoryTest, ResetDirtyPagesZeroesThem) {
+    myMemory->setWord(InternalMemStart + 0x1000, 0x01020304);
+    myMemory->setWord(InternalMemStart + 0xFFFC, 0x05060708);
+    myMemory->resetDirtyPages();
+    EXPECT_EQ(myMemory->getDirtyPageCount(), 0UL);
+    EXPECT_EQ(myMemory->getWord(InternalMemStart + 0x1000), 0UL);
+    EXPECT_EQ(myMemory->getWord(InternalMemStart + 0xFFFC), 0UL);
+}
+
+TEST_F(MemoryTest, ResetDirtyPagesZeroesTheWordAtTheEndOfMemory) {
+    // The bounds checks admit an access at the end of memory, on a page beyond the RAM size.
+    const WORD32 end = InternalMemStart + (64 * 1024);
+    myMemory->setWord(end, 0x01020304);
+    EXPECT_TRUE(myMemory->isPageDirty(end));
+    myMemory->resetDirtyPages();
+    EXPECT_EQ(myMemory->getWord(end), 0UL);
+}
+
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+
+TEST_F(MemoryTest, ImageHoldsOnlyNonZeroPagesAndRestores) {
+    myMemory->setWord(InternalMemStart + 0x1000, 0x01020304);
+    myMemory->setWord(InternalMemStart + 0x2000, 0x00000000); // dirty, but zero
+    myMemory->setWord(InternalMemStart + 0xFFFC, 0x05060708);
+    char imageFile[] = "/tmp/testmemoryXXXXXX";
+    const int fd = mkstemp(imageFile);
+    ASSERT_NE(fd, -1);
+    unlink(imageFile);
+
+    std::vector<WORD32> savedPages;
+    ASSERT_TRUE(myMemory->saveImage(fd, 65536, savedPages));
+    const std::vector<WORD32> expected = { InternalMemStart + 0x1000, InternalMemStart + 0xF000 };
+    EXPECT_EQ(savedPages, expected);
+    EXPECT_EQ(lseek(fd, 0, SEEK_END), 65536 + myMemory->imageLength());
+
+    myMemory->resetDirtyPages();
+    myMemory->setWord(InternalMemStart + 0x3000, 0xFFFFFFFF);
+    ASSERT_TRUE(myMemory->restoreImage(fd, 65536, savedPages));
+    close(fd);
+    EXPECT_EQ(myMemory->getWord(InternalMemStart + 0x1000), 0x01020304UL);
+    EXPECT_EQ(myMemory->getWord(InternalMemStart + 0x3000), 0UL);
+    EXPECT_EQ(myMemory->getWord(InternalMemStart + 0xFFFC), 0x05060708UL);
+    EXPECT_EQ(myMemory->getDirtyPages(), expected);
+
+    // Restored memory is a private copy.
+    myMemory->setWord(InternalMemStart + 0x1000, 0xAAAAAAAA);
+    EXPECT_EQ(myMemory->getWord(InternalMemStart + 0x1000), 0xAAAAAAAAUL);
+}
+
+TEST_F(MemoryTest, ImageAfterClearingDirtyPagesHoldsEarlierWrites) {
+    myMemory->setWord(InternalMemStart + 0x1000, 0x01020304);
+    myMemory->clearDirtyPages();
+    char imageFile[] = "/tmp/testmemoryXXXXXX";
+    const int fd = mkstemp(imageFile);
+    ASSERT_NE(fd, -1);
+    unlink(imageFile);
+
+    std::vector<WORD32> savedPages;
+    ASSERT_TRUE(myMemory->saveImage(fd, 65536, savedPages));
+    const std::vector<WORD32> expected = { InternalMemStart + 0x1000 };
+    EXPECT_EQ(savedPages, expected);
+
+    myMemory->resetDirtyPages();
+    ASSERT_TRUE(myMemory->restoreImage(fd, 65536, savedPages));
+    close(fd);
+    EXPECT_EQ(myMemory->getWord(InternalMemStart + 0x1000), 0x01020304UL);
+}
+
+TEST_F(MemoryTest, ImageHoldsTheWordAtTheEndOfMemory) {
+    const WORD32 end = InternalMemStart + (64 * 1024);
+    myMemory->setWord(end, 0x01020304);
+    char imageFile[] = "/tmp/testmemoryXXXXXX";
+    const int fd = mkstemp(imageFile);
+    ASSERT_NE(fd, -1);
+    unlink(imageFile);
+
+    std::vector<WORD32> savedPages;
+    ASSERT_TRUE(myMemory->saveImage(fd, 65536, savedPages));
+    const std::vector<WORD32> expected = { end };
+    EXPECT_EQ(savedPages, expected);
+
+    myMemory->resetDirtyPages();
+    ASSERT_TRUE(myMemory->restoreImage(fd, 65536, savedPages));
+    close(fd);
+    EXPECT_EQ(myMemory->getWord(end), 0x01020304UL);
+}
+
+const WORD32 watched = InternalMemStart + 0x4010;
+
+TEST_F(MemoryTest, WatchpointMustBeInRAM) {
+    EXPECT_FALSE(myMemory->addWatchpoint(InternalMemStart - 4, 4));
+    EXPECT_FALSE(myMemory->addWatchpoint(InternalMemStart + (64 * 1024) - 2, 4));
+    EXPECT_FALSE(myMemory->addWatchpoint(watched, 0));
+    EXPECT_TRUE(myMemory->addWatchpoint(watched, 4));
+}
+
+TEST_F(MemoryTest, AccessOffWatchedPagesDoesNotTrap) {
+    EXPECT_TRUE(myMemory->addWatchpoint(watched, 4));
+    myMemory->setWord(InternalMemStart + 0x100, 0x12345678);
+    EXPECT_EQ(myMemory->getWord(InternalMemStart + 0x100), 0x12345678UL);
+    EXPECT_FALSE(myMemory->watchpointTrapped());
+}
+
+TEST_F(MemoryTest, WriteToWatchedRangeIsHit) {
+    EXPECT_TRUE(myMemory->addWatchpoint(watched, 4));
+    myMemory->setByte(watched + 2, 0xC9);
+    EXPECT_TRUE(myMemory->watchpointTrapped());
+    WORD32 hitAddress = 0;
+    EXPECT_TRUE(myMemory->takeWatchpointHit(hitAddress));
+    EXPECT_EQ(hitAddress, watched + 2);
+    EXPECT_FALSE(myMemory->takeWatchpointHit(hitAddress));
+    myMemory->rearmWatchpoints();
+    EXPECT_FALSE(myMemory->watchpointTrapped());
+
+    // The write happened, and reading it back traps again once rearmed.
+    EXPECT_EQ(myMemory->getByte(watched + 2), 0xC9);
+    EXPECT_TRUE(myMemory->watchpointTrapped());
+    EXPECT_TRUE(myMemory->takeWatchpointHit(hitAddress));
+    EXPECT_EQ(hitAddress, watched + 2);
+    myMemory->rearmWatchpoints();
+}
+
+TEST_F(MemoryTest, AccessOnWatchedPageOutsideRangeTrapsWithoutHit) {
+    EXPECT_TRUE(myMemory->addWatchpoint(watched, 4));
+    myMemory->setWord(watched + 8, 0xCAFEBABE);
+    EXPECT_TRUE(myMemory->watchpointTrapped());
+    WORD32 hitAddress = 0;
+    EXPECT_FALSE(myMemory->takeWatchpointHit(hitAddress));
+    myMemory->rearmWatchpoints();
+    EXPECT_EQ(myMemory->getWord(watched + 8), 0xCAFEBABEUL);
+}
+
+TEST_F(MemoryTest, RemovedWatchpointNoLongerTraps) {
+    EXPECT_TRUE(myMemory->addWatchpoint(watched, 4));
+    EXPECT_TRUE(myMemory->removeWatchpoint(watched));
+    EXPECT_FALSE(myMemory->removeWatchpoint(watched));
+    myMemory->setWord(watched, 0x01020304);
+    EXPECT_FALSE(myMemory->watchpointTrapped());
+}
+
+TEST_F(MemoryTest, HostAddressIsRefusedWhileWatchpointsAreSet) {
+    EXPECT_TRUE(myMemory->addWatchpoint(watched, 4));
+    EXPECT_EQ(myMemory->hostAddress(watched, 4, true), nullptr);
+    EXPECT_EQ(myMemory->hostAddress(InternalMemStart + 0x100, 4, false), nullptr);
+    EXPECT_FALSE(myMemory->watchpointTrapped());
+    EXPECT_TRUE(myMemory->removeWatchpoint(watched));
+    EXPECT_NE(myMemory->hostAddress(watched, 4, true), nullptr);
+}
+
+TEST_F(MemoryTest, HexDumpDoesNotTriggerWatchpoint) {
+    EXPECT_TRUE(myMemory->addWatchpoint(watched, 4));
+    myMemory->hexDump(watched, 16);
+    myMemory->hexDumpWords(watched, 16);
+    EXPECT_FALSE(myMemory->watchpointTrapped());
+    // ... and the watchpoint is still armed afterwards.
+    myMemory->getWord(watched);
+    EXPECT_TRUE(myMemory->watchpointTrapped());
+    myMemory->rearmWatchpoints();
+}
+
+#endif
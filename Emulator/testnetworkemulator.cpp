@@ -0,0 +1,281 @@
+//------------------------------------------------------------------------------
+//
+// File        : testnetworkemulator.cpp
+// Description : Tests the wiring, booting and termination of a network of emulated transputers.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "gtest/gtest.h"
+using namespace std;
+#include "log.h"
+#include "types.h"
+#include "memloc.h"
+#include "networkemulator.h"
+#include "cpu.h"
+
+// Node 0 reads 16 bytes from link 0 and sends them down link 1 (booting node 1), then repeatedly passes a byte
+// from link 0 to link 1, and one from link 1 back to link 0.
+static const BYTE8 relayBoot[] = {
+    0x28,
+    0x10, 0x24, 0xF2, 0x54, 0x21, 0x40, 0xF7, // ldlp 0; mint; ldnlp 4; ldc 16; in
+    0x10, 0x24, 0xF2, 0x51, 0x21, 0x40, 0xFB, // ldlp 0; mint; ldnlp 1; ldc 16; out
+    0x10, 0x24, 0xF2, 0x54, 0x41, 0xF7,       // loop: ldlp 0; mint; ldnlp 4; ldc 1; in
+    0x10, 0x24, 0xF2, 0x51, 0x41, 0xFB,       // ldlp 0; mint; ldnlp 1; ldc 1; out
+    0x10, 0x24, 0xF2, 0x55, 0x41, 0xF7,       // ldlp 0; mint; ldnlp 5; ldc 1; in
+    0x10, 0x24, 0xF2, 0x50, 0x41, 0xFB,       // ldlp 0; mint; ldnlp 0; ldc 1; out
+    0x61, 0x06                                // j loop
+};
+
+// Node 1 echoes each byte it reads from link 0.
+static const BYTE8 echoBoot[] = {
+    0x0F,
+    0x10, 0x24, 0xF2, 0x54, 0x41, 0xF7,       // loop: ldlp 0; mint; ldnlp 4; ldc 1; in
+    0x10, 0x24, 0xF2, 0x41, 0xFB,             // ldlp 0; mint; ldc 1; out
+    0x60, 0x03, 0x00, 0x00                    // j loop; padding
+};
+
+// Each node stores the input channel of the link it booted from (given in Creg) in local 1, then echoes each byte it
+// reads from that link.
+static const BYTE8 bootLinkEchoBoot[] = {
+    0x0F,
+    0xD1, 0xD1, 0xD1,                         // stl 1; stl 1; stl 1
+    0x10, 0x71, 0x41, 0xF7,                   // loop: ldlp 0; ldl 1; ldc 1; in
+    0x10, 0x71, 0x60, 0x5C, 0x41, 0xFB,       // ldlp 0; ldl 1; ldnlp -4; ldc 1; out
+    0x60, 0x04                                // j loop
+};
+static const WORD32 bootLinkEchoLocal1 = ((MemStart + 15 + 3) & ~3) + 4;
+
+static void writeImageFile(const char *fileName, const BYTE8 *data, size_t length) {
+    std::ofstream out(fileName, std::ofstream::out | std::ofstream::binary);
+    out.write(reinterpret_cast<const char *>(data), length);
+}
+
+class NetworkEmulatorTest : public ::testing::Test {
+protected:
+    NetworkEmulator *myNetwork = nullptr;
+    SymbolTable *mySymbolTable = nullptr;
+
+    void SetUp() override {
+        setLogLevel(LOGLEVEL_INFO);
+        mySymbolTable = new SymbolTable();
+        myNetwork = new NetworkEmulator();
+    }
+
+    void TearDown() override {
+        Link *hostLink = myNetwork->getHostLink();
+        delete myNetwork;
+        delete hostLink;
+        delete mySymbolTable;
+    }
+};
+
+TEST_F(NetworkEmulatorTest, UnbootableNodeIsRejected) {
+    EXPECT_FALSE(myNetwork->initialise(2, 1024 * 1024, 0, mySymbolTable, {}));
+}
+
+TEST_F(NetworkEmulatorTest, LinkCannotBeConnectedTwice) {
+    EXPECT_FALSE(myNetwork->initialise(3, 1024 * 1024, 0, mySymbolTable, { { 0, 1, 1, 0 }, { 0, 1, 2, 0 } }));
+}
+
+TEST_F(NetworkEmulatorTest, RootLinkZeroIsTheHosts) {
+    EXPECT_FALSE(myNetwork->initialise(2, 1024 * 1024, 0, mySymbolTable, { { 0, 0, 1, 0 } }));
+}
+
+TEST_F(NetworkEmulatorTest, NonExistentNodeIsRejected) {
+    EXPECT_FALSE(myNetwork->initialise(2, 1024 * 1024, 0, mySymbolTable, { { 0, 1, 2, 0 } }));
+}
+
+TEST_F(NetworkEmulatorTest, RootBootsSecondNodeAndRelaysToIt) {
+    ASSERT_TRUE(myNetwork->initialise(2, 1024 * 1024, 0, mySymbolTable, { { 0, 1, 1, 0 } }));
+    EXPECT_EQ(myNetwork->getNodeCount(), 2);
+    myNetwork->start();
+
+    Link *hostLink = myNetwork->getHostLink();
+    hostLink->writeBytes(const_cast<BYTE8 *>(relayBoot), sizeof(relayBoot));
+    hostLink->writeBytes(const_cast<BYTE8 *>(echoBoot), sizeof(echoBoot));
+    for (BYTE8 b: { 'h', 'e', 'l', 'l', 'o' }) {
+        hostLink->writeByte(b);
+        EXPECT_EQ(hostLink->readByte(), b);
+    }
+
+    // Both nodes are now blocked in link transfers.
+    myNetwork->terminate();
+    myNetwork->join();
+}
+
+TEST_F(NetworkEmulatorTest, NodesShareOneHostThread) {
+    ASSERT_TRUE(myNetwork->initialise(2, 1024 * 1024, 0, mySymbolTable, { { 0, 1, 1, 0 } }));
+    // Each node spends most of its time blocked on a link; with only one thread, this would hang if blocked nodes
+    // kept hold of it.
+    myNetwork->startScheduled(1, 64);
+
+    Link *hostLink = myNetwork->getHostLink();
+    hostLink->writeBytes(const_cast<BYTE8 *>(relayBoot), sizeof(relayBoot));
+    hostLink->writeBytes(const_cast<BYTE8 *>(echoBoot), sizeof(echoBoot));
+    for (BYTE8 b: { 'h', 'e', 'l', 'l', 'o' }) {
+        hostLink->writeByte(b);
+        EXPECT_EQ(hostLink->readByte(), b);
+    }
+
+    myNetwork->terminate();
+    myNetwork->join();
+}
+
+TEST_F(NetworkEmulatorTest, TimedLinksAdvanceClocks) {
+    ASSERT_TRUE(myNetwork->initialise(2, 1024 * 1024, 0, mySymbolTable, { { 0, 1, 1, 0 } }));
+    const WORD32 latency = 1000;
+    myNetwork->setLinkLatency(latency);
+    myNetwork->startScheduled(2, 64);
+
+    Link *hostLink = myNetwork->getHostLink();
+    hostLink->writeBytes(const_cast<BYTE8 *>(relayBoot), sizeof(relayBoot));
+    hostLink->writeBytes(const_cast<BYTE8 *>(echoBoot), sizeof(echoBoot));
+    for (BYTE8 b: { 'h', 'e', 'l', 'l', 'o' }) {
+        hostLink->writeByte(b);
+        EXPECT_EQ(hostLink->readByte(), b);
+    }
+
+    myNetwork->terminate();
+    myNetwork->join();
+    // Node 0 sent node 1 its 16 boot bytes, then each byte of the message, waiting for each reply; every byte
+    // taking the latency to cross their link.
+    EXPECT_GE(myNetwork->getCPU(1)->getCycleCount(), (16 + 5) * latency);
+    EXPECT_GE(myNetwork->getCPU(0)->getCycleCount(), (16 + 5 * 2) * latency);
+}
+
+TEST_F(NetworkEmulatorTest, LockstepRunsAreRepeatable) {
+    WORD32 cycles[2][2];
+    for (int run = 0; run < 2; run++) {
+        NetworkEmulator network;
+        ASSERT_TRUE(network.initialise(2, 1024 * 1024, 0, mySymbolTable, { { 0, 1, 1, 0 } }));
+        network.startLockstep(100);
+
+        Link *hostLink = network.getHostLink();
+        hostLink->writeBytes(const_cast<BYTE8 *>(relayBoot), sizeof(relayBoot));
+        hostLink->writeBytes(const_cast<BYTE8 *>(echoBoot), sizeof(echoBoot));
+        for (BYTE8 b: { 'h', 'e', 'l', 'l', 'o' }) {
+            hostLink->writeByte(b);
+            EXPECT_EQ(hostLink->readByte(), b);
+        }
+
+        network.terminate();
+        network.join();
+        cycles[run][0] = network.getCPU(0)->getCycleCount();
+        cycles[run][1] = network.getCPU(1)->getCycleCount();
+        delete hostLink;
+    }
+    EXPECT_EQ(cycles[0][0], cycles[1][0]);
+    EXPECT_EQ(cycles[0][1], cycles[1][1]);
+}
+
+TEST_F(NetworkEmulatorTest, RootBootsSecondNodeThroughCrossbar) {
+    Topology topology;
+    std::istringstream description(
+        "nodes 2\n"
+        "crossbar\n"
+        "attach 0 3 0:1\n"
+        "attach 0 7 1:0\n"
+        "route 0 3 7\n");
+    ASSERT_TRUE(topology.parse(description, "test"));
+    ASSERT_TRUE(myNetwork->initialise(topology, 1024 * 1024, 0, mySymbolTable));
+    myNetwork->start();
+
+    Link *hostLink = myNetwork->getHostLink();
+    hostLink->writeBytes(const_cast<BYTE8 *>(relayBoot), sizeof(relayBoot));
+    hostLink->writeBytes(const_cast<BYTE8 *>(echoBoot), sizeof(echoBoot));
+    for (BYTE8 b: { 'h', 'e', 'l', 'l', 'o' }) {
+        hostLink->writeByte(b);
+        EXPECT_EQ(hostLink->readByte(), b);
+    }
+
+    myNetwork->terminate();
+    myNetwork->join();
+}
+
+TEST_F(NetworkEmulatorTest, HostBootsNodesInParallelThroughAnyLink) {
+    ASSERT_TRUE(myNetwork->initialise(3, 1024 * 1024, 0, mySymbolTable, { { 0, 1, 1, 2 }, { 0, 2, 2, 3 } }));
+    // The root runs the echo code on its host link, leaving its links to the other nodes to the host.
+    const char *imageFile = "/tmp/testnetworkemulator.img";
+    writeImageFile(imageFile, bootLinkEchoBoot + 1, sizeof(bootLinkEchoBoot) - 1);
+    ASSERT_TRUE(myNetwork->getCPU(0)->loadRawImage(imageFile, MemStart));
+    remove(imageFile);
+    myNetwork->start();
+
+    const std::vector<BYTE8> bootstrap(bootLinkEchoBoot, bootLinkEchoBoot + sizeof(bootLinkEchoBoot));
+    ASSERT_TRUE(myNetwork->bootNodes({ {}, bootstrap, bootstrap }));
+    // Each node echoes back down the link it booted from, so must have been given that link in Creg.
+    for (int node = 1; node < 3; node++) {
+        Link *bootLink = myNetwork->getBootLink(node);
+        ASSERT_NE(bootLink, nullptr);
+        bootLink->writeByte('0' + node);
+        EXPECT_EQ(bootLink->readByte(), '0' + node);
+    }
+
+    myNetwork->terminate();
+    myNetwork->join();
+    EXPECT_EQ(myNetwork->getMemory(1)->getWord(bootLinkEchoLocal1), Link2Input);
+    EXPECT_EQ(myNetwork->getMemory(2)->getWord(bootLinkEchoLocal1), Link3Input);
+}
+
+TEST_F(NetworkEmulatorTest, RootStartsFromRawImageLoadedDirectly) {
+    ASSERT_TRUE(myNetwork->initialise(1, 1024 * 1024, 0, mySymbolTable, {}));
+    const char *imageFile = "/tmp/testnetworkemulator.img";
+    // The code of the bootstrap, without its length: started as if booted from link 0.
+    writeImageFile(imageFile, bootLinkEchoBoot + 1, sizeof(bootLinkEchoBoot) - 1);
+    ASSERT_TRUE(myNetwork->getCPU(0)->loadRawImage(imageFile, MemStart));
+    remove(imageFile);
+    myNetwork->start();
+
+    Link *hostLink = myNetwork->getHostLink();
+    for (BYTE8 b: { 'h', 'i' }) {
+        hostLink->writeByte(b);
+        EXPECT_EQ(hostLink->readByte(), b);
+    }
+
+    myNetwork->terminate();
+    myNetwork->join();
+    EXPECT_EQ(myNetwork->getMemory(0)->getWord(bootLinkEchoLocal1), Link0Input);
+}
+
+TEST_F(NetworkEmulatorTest, RootStartsFromBootFileLoadedDirectly) {
+    ASSERT_TRUE(myNetwork->initialise(1, 1024 * 1024, 0, mySymbolTable, {}));
+    const char *imageFile = "/tmp/testnetworkemulator.btl";
+    std::vector<BYTE8> bootFile(bootLinkEchoBoot, bootLinkEchoBoot + sizeof(bootLinkEchoBoot));
+    bootFile.push_back('h');
+    bootFile.push_back('i');
+    writeImageFile(imageFile, bootFile.data(), bootFile.size());
+    long consumed = 0;
+    ASSERT_TRUE(myNetwork->getCPU(0)->loadBootImage(imageFile, consumed));
+    remove(imageFile);
+    EXPECT_EQ(consumed, (long) sizeof(bootLinkEchoBoot));
+    myNetwork->start();
+
+    // The rest of the boot file is for the running bootstrap.
+    Link *hostLink = myNetwork->getHostLink();
+    hostLink->writeBytes(bootFile.data() + consumed, (int) (bootFile.size() - consumed));
+    EXPECT_EQ(hostLink->readByte(), 'h');
+    EXPECT_EQ(hostLink->readByte(), 'i');
+
+    myNetwork->terminate();
+    myNetwork->join();
+}
+
+TEST_F(NetworkEmulatorTest, BootFileMustStartWithCode) {
+    ASSERT_TRUE(myNetwork->initialise(1, 1024 * 1024, 0, mySymbolTable, {}));
+    const char *imageFile = "/tmp/testnetworkemulator.btl";
+    const BYTE8 poke[] = { BOOT_POKE, 0, 0, 0, 0 };
+    writeImageFile(imageFile, poke, sizeof(poke));
+    long consumed = 0;
+    EXPECT_FALSE(myNetwork->getCPU(0)->loadBootImage(imageFile, consumed));
+    remove(imageFile);
+}
@@ -0,0 +1,137 @@
+//------------------------------------------------------------------------------
+//
+// File        : testtopology.cpp
+// Description : Tests the parsing of topology files, and their wiring generators.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <sstream>
+#include "gtest/gtest.h"
+using namespace std;
+#include "log.h"
+#include "topology.h"
+
+class TopologyTest : public ::testing::Test {
+protected:
+    Topology myTopology;
+
+    void SetUp() override {
+        setLogLevel(LOGLEVEL_INFO);
+    }
+
+    bool parse(const std::string &text) {
+        std::istringstream in(text);
+        return myTopology.parse(in, "test");
+    }
+
+    // Every link is used at most once, and every node but the root boots from its link 0.
+    void expectWellWired() {
+        const int nodeCount = (int) myTopology.nodes.size();
+        std::vector<std::vector<int>> uses(nodeCount, std::vector<int>(4, 0));
+        uses[0][0] = 1;
+        for (const Topology::Connection &connection: myTopology.connections) {
+            uses[connection.nodeA][connection.linkA]++;
+            uses[connection.nodeB][connection.linkB]++;
+        }
+        for (int node = 0; node < nodeCount; node++) {
+            EXPECT_EQ(uses[node][0], 1) << "node " << node;
+            for (int link = 1; link < 4; link++) {
+                EXPECT_LE(uses[node][link], 1) << "node " << node << " link " << link;
+            }
+        }
+    }
+};
+
+TEST_F(TopologyTest, ExplicitWiringAndNodeSettings) {
+    ASSERT_TRUE(parse(
+        "# two nodes\n"
+        "nodes 2\n"
+        "memory 2\n"
+        "memory 1 4   # more for the worker\n"
+        "symbols 1 worker.sym\n"
+        "boot root.bin\n"
+        "\n"
+        "connect 0:1 1:0\n"));
+    ASSERT_EQ(myTopology.nodes.size(), 2U);
+    EXPECT_EQ(myTopology.nodes[0].ramSize, 2L * 1024 * 1024);
+    EXPECT_EQ(myTopology.nodes[1].ramSize, 4L * 1024 * 1024);
+    EXPECT_EQ(myTopology.nodes[1].symbolFile, "worker.sym");
+    EXPECT_EQ(myTopology.bootFile, "root.bin");
+    ASSERT_EQ(myTopology.connections.size(), 1U);
+    EXPECT_EQ(myTopology.connections[0].nodeB, 1);
+    EXPECT_EQ(myTopology.connections[0].linkB, 0);
+}
+
+TEST_F(TopologyTest, MistakesAreRejected) {
+    for (const char *text: {
+        "nodes 2\nconnect 0:1 1:4\n",     // no such link
+        "nodes 2\nconnect 0:1 2:0\n",     // no such node
+        "nodes 2\nconnect 0:0 1:0\n",     // the host's link
+        "mesh 2 2\nring\n",               // two generators
+        "nodes 5\nmesh 2 2\n",            // disagreeing sizes
+        "connect 0:1 1:0\n",              // no size
+        "nodes 2\nwibble\n" }) {
+        std::istringstream in(text);
+        EXPECT_FALSE(Topology().parse(in, "test")) << text;
+    }
+}
+
+TEST_F(TopologyTest, PipelineWiresEachNodeToTheNext) {
+    ASSERT_TRUE(parse("nodes 4\npipeline\n"));
+    ASSERT_EQ(myTopology.connections.size(), 3U);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(myTopology.connections[i].nodeA, i);
+        EXPECT_EQ(myTopology.connections[i].linkA, 1);
+        EXPECT_EQ(myTopology.connections[i].nodeB, i + 1);
+        EXPECT_EQ(myTopology.connections[i].linkB, 0);
+    }
+}
+
+TEST_F(TopologyTest, RingClosesBackToTheRoot) {
+    ASSERT_TRUE(parse("nodes 4\nring\n"));
+    expectWellWired();
+    EXPECT_EQ(myTopology.connections.size(), 4U);
+}
+
+TEST_F(TopologyTest, MeshBootsAlongShortestPaths) {
+    ASSERT_TRUE(parse("mesh 8 8\n"));
+    ASSERT_EQ(myTopology.nodes.size(), 64U);
+    expectWellWired();
+    EXPECT_EQ(myTopology.connections.size(), 2U * 7 * 8);
+}
+
+TEST_F(TopologyTest, TorusLeavesOneOfTheRootsWrapsUnwired) {
+    ASSERT_TRUE(parse("torus 4 4\n"));
+    expectWellWired();
+    EXPECT_EQ(myTopology.connections.size(), 2U * 4 * 4 - 1);
+}
+
+TEST_F(TopologyTest, HypercubeUsesOneLinkPerDimension) {
+    ASSERT_TRUE(parse("hypercube 3\n"));
+    ASSERT_EQ(myTopology.nodes.size(), 8U);
+    expectWellWired();
+    EXPECT_EQ(myTopology.connections.size(), 12U);
+}
+
+TEST_F(TopologyTest, TreeChildrenBootFromTheirParents) {
+    ASSERT_TRUE(parse("nodes 13\ntree 3\n"));
+    expectWellWired();
+    for (const Topology::Connection &connection: myTopology.connections) {
+        EXPECT_EQ(connection.nodeA, (connection.nodeB - 1) / 3);
+        EXPECT_EQ(connection.linkB, 0);
+    }
+}
+
+TEST_F(TopologyTest, GeneratorAvoidsExplicitlyWiredLinks) {
+    ASSERT_TRUE(parse("nodes 3\ncrossbar\ncontrol 0 0:1\nattach 0 0 2:3\npipeline\n"));
+    expectWellWired();
+    EXPECT_EQ(myTopology.connections[0].linkA, 2);
+    EXPECT_EQ(myTopology.crossbars[0].controlNode, 0);
+    EXPECT_EQ(myTopology.crossbars[0].attachments[0].port, 0);
+}
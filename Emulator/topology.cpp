@@ -0,0 +1,332 @@
+//------------------------------------------------------------------------------
+//
+// File        : topology.cpp
+// Description : A description of a network of transputers: its nodes, and the
+//               wiring of their links, read from a topology file.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <sstream>
+using namespace std;
+
+#include "topology.h"
+#include "log.h"
+
+namespace {
+	bool parseNumber(const std::string &word, int &number) {
+		char *end;
+		const long value = strtol(word.c_str(), &end, 10);
+		if (word.empty() || *end != '\0' || value < 0) {
+			return false;
+		}
+		number = (int) value;
+		return true;
+	}
+
+	bool parseNodeLink(const std::string &word, int &node, int &link) {
+		const size_t colon = word.find(':');
+		return colon != std::string::npos && parseNumber(word.substr(0, colon), node) &&
+			parseNumber(word.substr(colon + 1), link) && link <= 3;
+	}
+}
+
+Topology::Topology() = default;
+
+bool Topology::load(const std::string &fileName) {
+	std::ifstream in(fileName);
+	if (!in) {
+		logFatalF("Could not open topology file %s", fileName.c_str());
+		return false;
+	}
+	return parse(in, fileName);
+}
+
+bool Topology::parse(std::istream &in, const std::string &name) {
+	int nodeCount = 0;
+	int defaultMegs = 0;
+	std::vector<std::pair<int, int>> nodeMegs;
+	std::vector<std::pair<int, std::string>> nodeSymbols;
+	std::vector<std::pair<int, std::string>> nodeBootFiles;
+	std::string generator;
+	int width = 0, height = 0;
+	int lineNo = 0;
+	for (std::string line; std::getline(in, line); ) {
+		lineNo++;
+		const size_t hash = line.find('#');
+		if (hash != std::string::npos) {
+			line.erase(hash);
+		}
+		std::istringstream words(line);
+		std::vector<std::string> args;
+		for (std::string word; words >> word; ) {
+			args.push_back(word);
+		}
+		if (args.empty()) {
+			continue;
+		}
+		const std::string &keyword = args[0];
+		const size_t count = args.size();
+		int node, link, megs, crossbar, port, other;
+		bool ok = false;
+		if (keyword == "nodes" && count == 2) {
+			ok = parseNumber(args[1], nodeCount) && nodeCount >= 1;
+		} else if (keyword == "memory" && count == 2) {
+			ok = parseNumber(args[1], defaultMegs) && defaultMegs >= 1;
+		} else if (keyword == "memory" && count == 3) {
+			ok = parseNumber(args[1], node) && parseNumber(args[2], megs) && megs >= 1;
+			nodeMegs.emplace_back(node, megs);
+		} else if (keyword == "symbols" && count == 3) {
+			ok = parseNumber(args[1], node);
+			nodeSymbols.emplace_back(node, args[2]);
+		} else if (keyword == "boot" && count == 2) {
+			bootFile = args[1];
+			ok = true;
+		} else if (keyword == "boot" && count == 3) {
+			ok = parseNumber(args[1], node);
+			if (ok && node == 0) {
+				bootFile = args[2];
+			} else {
+				nodeBootFiles.emplace_back(node, args[2]);
+			}
+		} else if (keyword == "connect" && count == 3) {
+			Connection connection {};
+			ok = parseNodeLink(args[1], connection.nodeA, connection.linkA) &&
+				parseNodeLink(args[2], connection.nodeB, connection.linkB);
+			connections.push_back(connection);
+		} else if ((keyword == "pipeline" || keyword == "ring") && count == 1) {
+			ok = generator.empty();
+			generator = keyword;
+		} else if ((keyword == "mesh" || keyword == "torus") && count == 3) {
+			ok = generator.empty() && parseNumber(args[1], width) && parseNumber(args[2], height) &&
+				width >= 1 && height >= 1;
+			generator = keyword;
+		} else if (keyword == "hypercube" && count == 2) {
+			// Each dimension takes a link.
+			ok = generator.empty() && parseNumber(args[1], width) && width <= 4;
+			generator = keyword;
+		} else if (keyword == "tree" && count == 2) {
+			// One link to the parent leaves three for children.
+			ok = generator.empty() && parseNumber(args[1], width) && width >= 1 && width <= 3;
+			generator = keyword;
+		} else if (keyword == "crossbar" && count == 1) {
+			crossbars.push_back({ -1, -1, {}, {} });
+			ok = true;
+		} else if (keyword == "attach" && count == 4) {
+			ok = parseNumber(args[1], crossbar) && crossbar < (int) crossbars.size() &&
+				parseNumber(args[2], port) && port < 32 && parseNodeLink(args[3], node, link);
+			if (ok) {
+				crossbars[crossbar].attachments.push_back({ port, node, link });
+			}
+		} else if (keyword == "control" && count == 3) {
+			ok = parseNumber(args[1], crossbar) && crossbar < (int) crossbars.size() &&
+				crossbars[crossbar].controlNode == -1 && parseNodeLink(args[2], node, link);
+			if (ok) {
+				crossbars[crossbar].controlNode = node;
+				crossbars[crossbar].controlLink = link;
+			}
+		} else if (keyword == "route" && count == 4) {
+			ok = parseNumber(args[1], crossbar) && crossbar < (int) crossbars.size() &&
+				parseNumber(args[2], port) && port < 32 && parseNumber(args[3], other) && other < 32;
+			if (ok) {
+				crossbars[crossbar].routes.emplace_back(port, other);
+			}
+		}
+		if (!ok) {
+			logFatalF("%s:%d: cannot understand '%s'", name.c_str(), lineNo, line.c_str());
+			return false;
+		}
+	}
+
+	// The generators imply the number of nodes, or are given it.
+	int impliedCount = nodeCount;
+	if (generator == "mesh" || generator == "torus") {
+		impliedCount = width * height;
+	} else if (generator == "hypercube") {
+		impliedCount = 1 << width;
+	}
+	if (impliedCount == 0) {
+		logFatalF("%s: the number of nodes must be given", name.c_str());
+		return false;
+	}
+	if (nodeCount != 0 && nodeCount != impliedCount) {
+		logFatalF("%s: a %s has %d nodes, not %d", name.c_str(), generator.c_str(), impliedCount, nodeCount);
+		return false;
+	}
+	nodeCount = impliedCount;
+
+	nodes.assign(nodeCount, { defaultMegs * 1024L * 1024L, "", "" });
+	for (auto &memory: nodeMegs) {
+		if (memory.first >= nodeCount) {
+			logFatalF("%s: cannot give memory to node %d; nodes are numbered 0 to %d", name.c_str(), memory.first, nodeCount - 1);
+			return false;
+		}
+		nodes[memory.first].ramSize = memory.second * 1024L * 1024L;
+	}
+	for (auto &symbols: nodeSymbols) {
+		if (symbols.first >= nodeCount) {
+			logFatalF("%s: cannot give symbols to node %d; nodes are numbered 0 to %d", name.c_str(), symbols.first, nodeCount - 1);
+			return false;
+		}
+		nodes[symbols.first].symbolFile = symbols.second;
+	}
+	for (auto &boot: nodeBootFiles) {
+		if (boot.first >= nodeCount) {
+			logFatalF("%s: cannot boot node %d; nodes are numbered 0 to %d", name.c_str(), boot.first, nodeCount - 1);
+			return false;
+		}
+		nodes[boot.first].bootFile = boot.second;
+	}
+
+	// Mark the links used by explicit wiring, so the generator avoids them.
+	myUsedLinks.assign(nodeCount, std::vector<bool>(4, false));
+	myUsedLinks[0][0] = true; // the host's
+	bool ok = true;
+	for (const Connection &connection: connections) {
+		ok = ok && useLink(connection.nodeA, connection.linkA) && useLink(connection.nodeB, connection.linkB);
+	}
+	for (const Crossbar &crossbar: crossbars) {
+		for (const Attachment &attachment: crossbar.attachments) {
+			ok = ok && useLink(attachment.node, attachment.link);
+		}
+		if (crossbar.controlNode != -1) {
+			ok = ok && useLink(crossbar.controlNode, crossbar.controlLink);
+		}
+	}
+	if (!ok) {
+		return false;
+	}
+	return generator.empty() || generate(generator, width, height);
+}
+
+bool Topology::useLink(const int node, const int link) {
+	if (node >= (int) nodes.size()) {
+		logFatalF("Cannot wire node %d; nodes are numbered 0 to %d", node, (int) nodes.size() - 1);
+		return false;
+	}
+	if (myUsedLinks[node][link]) {
+		logFatalF("Link %d of node %d is wired more than once", link, node);
+		return false;
+	}
+	myUsedLinks[node][link] = true;
+	return true;
+}
+
+int Topology::freeLink(const int node) const {
+	for (int link = 1; link < 4; link++) {
+		if (!myUsedLinks[node][link]) {
+			return link;
+		}
+	}
+	return -1;
+}
+
+bool Topology::generate(const std::string &generator, const int width, const int height) {
+	const int nodeCount = (int) nodes.size();
+	std::vector<std::pair<int, int>> edges;
+	if (generator == "pipeline" || generator == "ring") {
+		for (int i = 0; i + 1 < nodeCount; i++) {
+			edges.emplace_back(i, i + 1);
+		}
+		if (generator == "ring" && nodeCount > 2) {
+			edges.emplace_back(nodeCount - 1, 0);
+		}
+	} else if (generator == "mesh" || generator == "torus") {
+		const bool wrap = (generator == "torus");
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				const int node = y * width + x;
+				if (x + 1 < width) {
+					edges.emplace_back(node, node + 1);
+				} else if (wrap && width > 2) {
+					edges.emplace_back(node, y * width);
+				}
+				if (y + 1 < height) {
+					edges.emplace_back(node, node + width);
+				} else if (wrap && height > 2) {
+					edges.emplace_back(node, x);
+				}
+			}
+		}
+	} else if (generator == "hypercube") {
+		for (int dimension = 0; dimension < width; dimension++) {
+			for (int node = 0; node < nodeCount; node++) {
+				if ((node & (1 << dimension)) == 0) {
+					edges.emplace_back(node, node | (1 << dimension));
+				}
+			}
+		}
+	} else if (generator == "tree") {
+		for (int node = 1; node < nodeCount; node++) {
+			edges.emplace_back((node - 1) / width, node);
+		}
+	}
+
+	// Each node's parent is its neighbour on a shortest path to the root.
+	std::vector<std::vector<int>> neighbours(nodeCount);
+	for (auto &edge: edges) {
+		neighbours[edge.first].push_back(edge.second);
+		neighbours[edge.second].push_back(edge.first);
+	}
+	// The root may not have a link for every neighbour, so those it can't reach directly boot through others.
+	int rootLinks = 0;
+	for (int link = 1; link < 4; link++) {
+		rootLinks += myUsedLinks[0][link] ? 0 : 1;
+	}
+	std::vector<int> parent(nodeCount, -1);
+	std::deque<int> frontier { 0 };
+	parent[0] = 0;
+	while (!frontier.empty()) {
+		const int node = frontier.front();
+		frontier.pop_front();
+		for (int neighbour: neighbours[node]) {
+			if (parent[neighbour] == -1 && (node != 0 || rootLinks-- > 0)) {
+				parent[neighbour] = node;
+				frontier.push_back(neighbour);
+			}
+		}
+	}
+
+	std::vector<bool> bootLinkWired(nodeCount, false);
+	for (auto &edge: edges) {
+		int a = edge.first, b = edge.second;
+		if (parent[a] == b && a != 0 && !bootLinkWired[a]) {
+			std::swap(a, b);
+		}
+		int linkA, linkB;
+		if (parent[b] == a && b != 0 && !bootLinkWired[b]) {
+			if (myUsedLinks[b][0]) {
+				logFatalF("The %s needs link 0 of node %d to boot it, but it is already wired", generator.c_str(), b);
+				return false;
+			}
+			bootLinkWired[b] = true;
+			linkB = 0;
+		} else {
+			linkB = freeLink(b);
+		}
+		linkA = freeLink(a);
+		if (linkA == -1 || linkB == -1) {
+			const int full = (linkA == -1) ? a : b;
+			if (full != 0) {
+				logFatalF("The %s needs more links than node %d has free", generator.c_str(), full);
+				return false;
+			}
+			logWarnF("The %s needs more links than the root has free; node %d is not wired to node %d",
+					 generator.c_str(), (full == a) ? b : a, full);
+			continue;
+		}
+		myUsedLinks[a][linkA] = myUsedLinks[b][linkB] = true;
+		connections.push_back({ a, linkA, b, linkB });
+	}
+	logDebugF("Generated a %s of %d nodes with %d connections", generator.c_str(), nodeCount, (int) connections.size());
+	return true;
+}
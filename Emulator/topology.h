@@ -0,0 +1,82 @@
+//------------------------------------------------------------------------------
+//
+// File        : topology.h
+// Description : A description of a network of transputers: its nodes, and the
+//               wiring of their links, read from a topology file.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#ifndef _TOPOLOGY_H
+#define _TOPOLOGY_H
+
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "types.h"
+
+// A topology file has one statement per line; # starts a comment. Nodes are numbered from 0, the root, whose link 0
+// goes to the host; every other node boots from its link 0.
+//   nodes <n>                    the number of nodes (or as implied by a generator)
+//   memory [<node>] <mb>         RAM of every node, or of one
+//   symbols <node> <file>        symbol file of one node
+//   boot [<node>] <file>         boot file, sent to the root, or by the host directly to another node
+//   connect <a>:<l> <b>:<m>      wire link l of node a to link m of node b
+//   pipeline | ring | mesh <w> <h> | torus <w> <h> | hypercube <d> | tree <k>
+//                                generate the wiring of all the nodes (see below)
+//   crossbar                     add a C004-style crossbar, numbered from 0
+//   attach <c> <port> <n>:<l>    wire link l of node n to port (0-31) of crossbar c
+//   control <c> <n>:<l>          wire link l of node n to crossbar c's configuration link
+//   route <c> <p> <q>            initially connect ports p and q of crossbar c, both ways
+// A generator wires each node's link 0 towards the root, along the shortest path, and allocates the other links
+// in turn, skipping any already used by connect, attach and control statements. The root has only three links for
+// its neighbours, so in a torus or 4-dimensional hypercube one of its wrap-around connections is left unwired.
+class Topology {
+	public:
+		struct Connection {
+			int nodeA;
+			int linkA;
+			int nodeB;
+			int linkB;
+		};
+		struct Node {
+			long ramSize; // 0 to use the network's default
+			std::string symbolFile; // empty for none
+			std::string bootFile; // empty unless booted directly by the host
+		};
+		struct Attachment {
+			int port;
+			int node;
+			int link;
+		};
+		struct Crossbar {
+			int controlNode; // -1 if it can't be reconfigured
+			int controlLink;
+			std::vector<Attachment> attachments;
+			std::vector<std::pair<int, int>> routes;
+		};
+		std::vector<Node> nodes;
+		std::vector<Connection> connections;
+		std::vector<Crossbar> crossbars;
+		std::string bootFile;
+
+		Topology();
+		// Return false, having logged why, if the description is invalid.
+		bool load(const std::string &fileName);
+		bool parse(std::istream &in, const std::string &name);
+
+	private:
+		bool generate(const std::string &generator, int width, int height);
+		bool useLink(int node, int link);
+		int freeLink(int node) const;
+		std::vector<std::vector<bool>> myUsedLinks;
+};
+
+#endif // _TOPOLOGY_H
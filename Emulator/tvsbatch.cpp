@@ -0,0 +1,306 @@
+//------------------------------------------------------------------------------
+//
+// File        : tvsbatch.cpp
+// Description : Runs a directory of Transputer Validation Suite programs,
+//               one emulator per host core, checking their outputs.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "filesystem.h"
+#include "version.h"
+
+static char *progName;
+static std::string emulator;
+static std::string tvsDirectory;
+static std::string outputDirectory;
+static std::string programExtension = ".bin";
+static std::string inputExtension = ".in";
+static std::string expectedExtension = ".expected";
+static int jobs = 0;
+static int timeoutSeconds = 60;
+
+// Each program <name><programExtension> in the directory is run with the input <name><inputExtension>, if there
+// is one; its output is compared with <name><expectedExtension>.
+struct TVSTest {
+	std::string name;
+	std::string program;
+	std::string input;
+	std::string output;
+	std::string expected;
+	std::string log;
+	std::chrono::steady_clock::time_point started;
+	bool timedOut;
+	int status;
+};
+
+void usage() {
+	logInfoF("Parachute v%s TVS Batch " __DATE__, projectVersion);
+	logInfo(" (C) 2005-2026 Matt J. Gumbley");
+	logInfo("  http://devzendo.github.io/parachute");
+	logInfo("Usage:");
+	logInfoF("%s: [options] tvs-directory", progName);
+	logInfo("Runs each program in the directory in its own emulator (temulate -tvs), as many at");
+	logInfo("once as there are host cores, and compares each one's output with the expected output.");
+	logInfo("Options:");
+	logInfo("  -e<F> The emulator to run. Default is the temulate alongside this program");
+	logInfo("  -j<N> Run N emulators at once. Default is the number of host cores");
+	logInfo("  -o<D> Write outputs (<name>.out) and emulator logs (<name>.log) to directory D.");
+	logInfo("        Default is the TVS directory");
+	logInfo("  -t<S> Fail any program still running after S seconds. Default is 60");
+	logInfo("  -p<X> Programs are the files with extension X. Default is .bin");
+	logInfo("  -i<X> Inputs have extension X. Default is .in");
+	logInfo("  -x<X> Expected outputs have extension X. Default is .expected");
+	logInfo("  -h    Displays this usage summary");
+	logInfo("  -l<X> Sets log level. X is one of [diwef] for DEBUG, INFO");
+	logInfo("        WARN, ERROR or FATAL. Default is INFO");
+}
+
+bool processCommandLine(int argc, char *argv[]) {
+	for (int i = 1; i < argc; i++) {
+		if (strlen(argv[i]) > 1 && argv[i][0] == '-') {
+			switch (argv[i][1]) {
+				case 'e':
+					emulator = std::string(argv[i] + 2);
+					break;
+				case 'j':
+					if (sscanf(&argv[i][2], "%d", &jobs) != 1 || jobs < 1) {
+						logFatal("-j must be directly followed by the number of emulators to run at once");
+						return false;
+					}
+					break;
+				case 'o':
+					outputDirectory = std::string(argv[i] + 2);
+					break;
+				case 't':
+					if (sscanf(&argv[i][2], "%d", &timeoutSeconds) != 1 || timeoutSeconds < 1) {
+						logFatal("-t must be directly followed by a timeout in seconds");
+						return false;
+					}
+					break;
+				case 'p':
+					programExtension = std::string(argv[i] + 2);
+					break;
+				case 'i':
+					inputExtension = std::string(argv[i] + 2);
+					break;
+				case 'x':
+					expectedExtension = std::string(argv[i] + 2);
+					break;
+				case 'h':
+				case '?':
+					usage();
+					return false;
+				case 'l':
+					if (strlen(argv[i]) == 3) {
+						switch (argv[i][2]) {
+							case 'd': setLogLevel(LOGLEVEL_DEBUG); break;
+							case 'i': setLogLevel(LOGLEVEL_INFO); break;
+							case 'w': setLogLevel(LOGLEVEL_WARN); break;
+							case 'e': setLogLevel(LOGLEVEL_ERROR); break;
+							case 'f': setLogLevel(LOGLEVEL_FATAL); break;
+							default:
+								logFatal("Incorrect level given to -l<loglevel> to set logging level");
+								return false;
+						}
+					} else {
+						logFatal("Incorrect level given to -l<loglevel> to set logging level");
+						return false;
+					}
+					break;
+				default:
+					logFatalF("Unknown option '%s'", argv[i]);
+					return false;
+			}
+		} else {
+			tvsDirectory = std::string(argv[i]);
+		}
+	}
+	if (tvsDirectory.empty()) {
+		usage();
+		return false;
+	}
+	if (emulator.empty()) {
+		const std::string self(progName);
+		const size_t slash = self.rfind('/');
+		emulator = (slash == std::string::npos) ? "temulate" : self.substr(0, slash + 1) + "temulate";
+	}
+	if (outputDirectory.empty()) {
+		outputDirectory = tvsDirectory;
+	}
+	if (jobs == 0) {
+		jobs = std::max(1, (int) std::thread::hardware_concurrency());
+	}
+	return true;
+}
+
+static bool endsWith(const std::string &s, const std::string &suffix) {
+	return s.size() > suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool findTests(std::vector<TVSTest> &tests) {
+	DIR *dir = opendir(tvsDirectory.c_str());
+	if (dir == nullptr) {
+		logFatalF("Could not read TVS directory %s: %s", tvsDirectory.c_str(), strerror(errno));
+		return false;
+	}
+	while (struct dirent *entry = readdir(dir)) {
+		const std::string fileName(entry->d_name);
+		if (!endsWith(fileName, programExtension)) {
+			continue;
+		}
+		TVSTest test;
+		test.name = fileName.substr(0, fileName.size() - programExtension.size());
+		test.program = pathJoin(tvsDirectory, fileName);
+		test.input = pathJoin(tvsDirectory, test.name + inputExtension);
+		if (access(test.input.c_str(), R_OK) != 0) {
+			test.input = "";
+		}
+		test.expected = pathJoin(tvsDirectory, test.name + expectedExtension);
+		test.output = pathJoin(outputDirectory, test.name + ".out");
+		test.log = pathJoin(outputDirectory, test.name + ".log");
+		test.timedOut = false;
+		test.status = 0;
+		tests.push_back(test);
+	}
+	closedir(dir);
+	std::sort(tests.begin(), tests.end(), [](const TVSTest &a, const TVSTest &b) { return a.name < b.name; });
+	return true;
+}
+
+pid_t startTest(TVSTest &test) {
+	const pid_t pid = fork();
+	if (pid == 0) {
+		// In the child: the emulator's own logging goes to the test's log.
+		const int fd = open(test.log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd != -1) {
+			dup2(fd, 1);
+			dup2(fd, 2);
+			close(fd);
+		}
+		execl(emulator.c_str(), emulator.c_str(), "-tvs", test.program.c_str(), test.input.c_str(),
+			  test.output.c_str(), (char *) nullptr);
+		fprintf(stderr, "Could not run %s: %s\n", emulator.c_str(), strerror(errno));
+		_exit(127);
+	}
+	if (pid == -1) {
+		logErrorF("Could not start %s: %s", test.name.c_str(), strerror(errno));
+	}
+	test.started = std::chrono::steady_clock::now();
+	return pid;
+}
+
+static bool readFile(const std::string &fileName, std::string &contents) {
+	std::ifstream in(fileName, std::ifstream::in | std::ifstream::binary);
+	if (!in) {
+		return false;
+	}
+	contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	return true;
+}
+
+// Empty if the test passed, otherwise why it failed.
+std::string checkTest(const TVSTest &test) {
+	if (test.timedOut) {
+		return "timed out";
+	}
+	if (!WIFEXITED(test.status) || WEXITSTATUS(test.status) != 0) {
+		return "emulator failed; see " + test.log;
+	}
+	std::string expected, output;
+	if (!readFile(test.expected, expected)) {
+		return "no expected output";
+	}
+	if (!readFile(test.output, output) || output != expected) {
+		return "output differs";
+	}
+	return "";
+}
+
+int main(int argc, char *argv[]) {
+	progName = argv[0];
+	setLogLevel(LOGLEVEL_INFO);
+	if (!processCommandLine(argc, argv)) {
+		exit(1);
+	}
+	std::vector<TVSTest> tests;
+	if (!findTests(tests)) {
+		exit(1);
+	}
+	logInfoF("Running %d TVS programs from %s with %s, %d at a time", (int) tests.size(), tvsDirectory.c_str(),
+			 emulator.c_str(), jobs);
+
+	std::map<pid_t, size_t> running;
+	size_t next = 0;
+	while (next < tests.size() || !running.empty()) {
+		while (next < tests.size() && (int) running.size() < jobs) {
+			const pid_t pid = startTest(tests[next]);
+			if (pid == -1) {
+				tests[next].status = -1;
+			} else {
+				running[pid] = next;
+			}
+			next++;
+		}
+		int status;
+		const pid_t pid = waitpid(-1, &status, WNOHANG);
+		if (pid > 0) {
+			tests[running[pid]].status = status;
+			running.erase(pid);
+			continue;
+		}
+		const auto now = std::chrono::steady_clock::now();
+		for (auto &child: running) {
+			TVSTest &test = tests[child.second];
+			if (!test.timedOut && now - test.started > std::chrono::seconds(timeoutSeconds)) {
+				test.timedOut = true;
+				kill(child.first, SIGKILL);
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	size_t width = 0;
+	for (const TVSTest &test: tests) {
+		width = std::max(width, test.name.size());
+	}
+	int failures = 0;
+	for (const TVSTest &test: tests) {
+		const std::string failure = checkTest(test);
+		if (failure.empty()) {
+			printf("%*s PASS\n", (int) width, test.name.c_str());
+		} else {
+			printf("%*s FAIL (%s)\n", (int) width, test.name.c_str(), failure.c_str());
+			failures++;
+		}
+	}
+	printf("tests: %d, ok: %d, fail: %d\n", (int) tests.size(), (int) tests.size() - failures, failures);
+	fflush(stdout);
+	exit(failures == 0 ? 0 : 1);
+}
@@ -175,6 +175,107 @@ char getConsoleChar(void) {
 	return ch;
 }
 
+// Waits up to timeoutMillis for a key to be typed, returning 1 and the key in *ch if one was, or 0 if not. Unlike
+// polling with isConsoleGetAvailable, the server does the waiting, so an idle client doesn't busy the host.
+BYTE getConsoleCharTimeout(WORD32 timeoutMillis, char *ch) {
+	BYTE request[8];
+	BYTE response[8];
+	WORD16 responseSize = 0;
+	request[0] = 6; // frame size, lsb
+	request[1] = 0; // frame size, msb
+	request[2] = REQ_GETKEYTIMEOUT;
+	request[3] = (BYTE) (timeoutMillis & 0xff);
+	request[4] = (BYTE) ((timeoutMillis >> 8) & 0xff);
+	request[5] = (BYTE) ((timeoutMillis >> 16) & 0xff);
+	request[6] = (BYTE) ((timeoutMillis >> 24) & 0xff);
+	request[7] = 0; // pad
+	asm __volatile
+	("out"
+	: /* no outputs */
+	: "cP" (request),
+	  "bP" (Link0Output),
+	  "aP" (8)
+	: "Areg", "Breg", "Creg", "FAreg", "FBreg", "FCreg", "Wreg[0]");
+	asm __volatile
+	("in"
+	: /* no outputs */
+	: "cP" (&responseSize),
+	  "bP" (Link0Input),
+	  "aP" (2)
+	: "FAreg", "FBreg", "FCreg", "memory");
+	if (responseSize > sizeof(response)) {
+		return 0; // not a response to this request
+	}
+	asm __volatile
+	("in"
+	: /* no outputs */
+	: "cP" (response),
+	  "bP" (Link0Input),
+	  "aP" (responseSize)
+	: "FAreg", "FBreg", "FCreg", "memory");
+	if (responseSize < 2 || response[0] != RES_SUCCESS) {
+		return 0;
+	}
+	*ch = (char) response[1];
+	return 1;
+}
+
+static void putRequestWord(BYTE *request, WORD32 w) {
+	request[0] = (BYTE) (w & 0xff);
+	request[1] = (BYTE) ((w >> 8) & 0xff);
+	request[2] = (BYTE) ((w >> 16) & 0xff);
+	request[3] = (BYTE) ((w >> 24) & 0xff);
+}
+
+static WORD32 transferDirect(BYTE tag, WORD32 streamId, BYTE *buffer, WORD32 length) {
+	BYTE request[16];
+	BYTE response[8];
+	WORD16 responseSize = 0;
+	request[0] = 14; // frame size, lsb
+	request[1] = 0; // frame size, msb
+	request[2] = tag;
+	putRequestWord(request + 3, streamId);
+	putRequestWord(request + 7, (WORD32) buffer);
+	putRequestWord(request + 11, length);
+	request[15] = 0; // pad
+	asm __volatile
+	("out"
+	: /* no outputs */
+	: "cP" (request),
+	  "bP" (Link0Output),
+	  "aP" (16)
+	: "Areg", "Breg", "Creg", "FAreg", "FBreg", "FCreg", "Wreg[0]");
+	asm __volatile
+	("in"
+	: /* no outputs */
+	: "cP" (&responseSize),
+	  "bP" (Link0Input),
+	  "aP" (2)
+	: "FAreg", "FBreg", "FCreg", "memory");
+	if (responseSize > sizeof(response)) {
+		return 0; // not a response to this request
+	}
+	asm __volatile
+	("in"
+	: /* no outputs */
+	: "cP" (response),
+	  "bP" (Link0Input),
+	  "aP" (responseSize)
+	: "FAreg", "FBreg", "FCreg", "memory");
+	if (responseSize < 5 || response[0] != RES_SUCCESS) {
+		return 0;
+	}
+	return response[1] | (response[2] << 8) | (response[3] << 16) | ((WORD32) response[4] << 24);
+}
+
+WORD32 writeStreamDirect(WORD32 streamId, BYTE *buffer, WORD32 length) {
+	return transferDirect(REQ_WRITEDIRECT, streamId, buffer, length);
+}
+
+WORD32 readStreamDirect(WORD32 streamId, BYTE *buffer, WORD32 length) {
+	return transferDirect(REQ_READDIRECT, streamId, buffer, length);
+}
+
 WORD32 getTimeMillis(void) {
 	WORD32 t=0;
 	asm __volatile
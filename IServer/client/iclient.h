@@ -29,6 +29,10 @@ extern void putConsoleCString(char *data);
 extern BYTE isConsolePutAvailable(void);
 extern BYTE isConsoleGetAvailable(void);
 extern char getConsoleChar(void);
+extern BYTE getConsoleCharTimeout(WORD32 timeoutMillis, char *ch);
+// Only served by emuserver, which transfers the buffer directly. Return the number of bytes transferred, 0 on error.
+extern WORD32 writeStreamDirect(WORD32 streamId, BYTE *buffer, WORD32 length);
+extern WORD32 readStreamDirect(WORD32 streamId, BYTE *buffer, WORD32 length);
 //
 struct timeGetUTC {
 	WORD32 dayInMonth;
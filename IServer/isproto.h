@@ -62,10 +62,11 @@
 // direction), maximum 512. Packet size must always be an even number of bytes.
 // (TDS 2nd ed, p356, sec 16.5.1.)
 // Inmos iServer has max packet size of 1040 ? Is that from T9000?
+// A client may negotiate a larger maximum with REQ_FRAMESIZE, below.
 
 // STRING encoding in a frame is:
 // +-----------------+
-// | WORD16 length   | Number of bytes that follow in the String [0 .. StringBufferSize] (StringBufferSize=508)
+// | WORD16 length   | Number of bytes that follow in the String [0 .. StringBufferSize] (StringBufferSize=508, or 4 less than a negotiated frame size)
 // | BYTE8 .. chars  | <length> bytes of String character data
 // +-----------------+
 
@@ -127,6 +128,10 @@ const BYTE8 REQ_COMMANDARG = 83;
 
 // DevZendo.org Extended IServer requests not present in the INMOS IServer
 const BYTE8 REQ_PUTCHAR = 90;
+const BYTE8 REQ_FRAMESIZE = 91;
+const BYTE8 REQ_GETKEYTIMEOUT = 92;
+const BYTE8 REQ_WRITEDIRECT = 93;
+const BYTE8 REQ_READDIRECT = 94;
 
 // Result codes
 const BYTE8 RES_SUCCESS = 0;
@@ -241,6 +246,82 @@ const BYTE8 REQ_OPEN_MODE_APPEND_UPDATE = 6;
 // +----------------------+
 
 
+// REQ_FLUSH
+// Flushes the output buffered for stream 'streamId' to the host file. Afterwards, the stream may be read, even if it
+// was last written.
+//
+// Request:
+// +----------------------+
+// | BYTE8 REQ_FLUSH      |
+// +----------------------+
+// | WORD32 streamid      | A stream identifier for this open file
+// +----------------------+
+//
+// Response data for REQ_FLUSH:
+// +----------------------+
+// | BYTE8 result         | RES_SUCCESS on success; RES_BADID if stream not open, or out of range; RES_ERROR if the
+// |                      | flush failed.
+// +----------------------+
+
+// REQ_SEEK
+// Sets the position of stream 'streamId' to 'offset' bytes from 'origin'. Afterwards, the stream may be read or
+// written, whichever it was last, and its end of file indicator is cleared.
+//
+// Request:
+// +----------------------+
+// | BYTE8 REQ_SEEK       |
+// +----------------------+
+// | WORD32 streamid      | A stream identifier for this open file
+// | WORD32 offset        | Signed offset from the origin
+// | WORD32 origin        | One of REQ_SEEK_ below
+// +----------------------+
+//
+// Response data for REQ_SEEK:
+// +----------------------+
+// | BYTE8 result         | RES_SUCCESS on success; RES_BADID if stream not open, or out of range; RES_ERROR if the
+// |                      | stream can't be positioned there.
+// +----------------------+
+const WORD32 REQ_SEEK_SET = 1;
+const WORD32 REQ_SEEK_CUR = 2;
+const WORD32 REQ_SEEK_END = 3;
+
+// REQ_TELL
+// Request:
+// +----------------------+
+// | BYTE8 REQ_TELL       |
+// +----------------------+
+// | WORD32 streamid      | A stream identifier for this open file
+// +----------------------+
+//
+// Response data for REQ_TELL:
+// +----------------------+
+// | BYTE8 result         | RES_SUCCESS on success; RES_BADID if stream not open, or out of range; RES_ERROR if the
+// |                      | stream has no position (e.g. the console).
+// +----------------------+
+// | WORD32 position      | Offset of the stream's position from its start
+// +----------------------+
+
+// REQ_EOF
+// Tests the end of file indicator of stream 'streamId', which is set when a read reaches the end of the stream, and
+// cleared by REQ_SEEK.
+//
+// Request:
+// +----------------------+
+// | BYTE8 REQ_EOF        |
+// +----------------------+
+// | WORD32 streamid      | A stream identifier for this open file
+// +----------------------+
+//
+// Response data for REQ_EOF:
+// +----------------------+
+// | BYTE8 result         | RES_SUCCESS if the indicator is set; RES_ERROR if it isn't; RES_BADID if stream not open,
+// |                      | or out of range.
+// +----------------------+
+
+// REQ_GETBLOCK, REQ_PUTBLOCK
+// Laid out, and handled, as REQ_READ and REQ_WRITE. A read of more than fits in a response frame (507 bytes) returns
+// only that many.
+
 
 // REQ_EXIT
 // Request:
@@ -319,5 +400,70 @@ const WORD32 RES_EXIT_FAILURE = -999999999;
 // | BYTE8 result         | RES_SUCCESS on success; RES_BADID if stream not open, or out of range.
 // +----------------------+
 
+// REQ_FRAMESIZE
+// Negotiates the maximum frame length (including the two length bytes) for all subsequent requests and responses,
+// so that REQ_READ/REQ_GETBLOCK and REQ_WRITE/REQ_PUTBLOCK can transfer more than 507 bytes at a time. Until this is
+// sent the maximum is the standard 512, so clients that don't know of it are unaffected. The server grants the
+// requested length, clamped to [512 .. 65534] and rounded down to an even number; the client must use no more than
+// the granted length. It may be sent again, e.g. with 512 to return to the standard maximum.
+//
+// Request:
+// +----------------------+
+// | BYTE8 REQ_FRAMESIZE  |
+// +----------------------+
+// | WORD32 length        | The maximum frame length the client would like to use.
+// +----------------------+
+//
+// Response data for REQ_FRAMESIZE (sent within the standard 512 byte maximum):
+// +----------------------+
+// | BYTE8 result         | RES_SUCCESS
+// +----------------------+
+// | WORD32 length        | The maximum frame length granted.
+// +----------------------+
+
+// REQ_GETKEYTIMEOUT
+// Reads a single character from the keyboard without echo, waiting up to the given timeout for one to be typed. Use
+// this rather than REQ_POLLKEY in a loop: the server waits without consuming host CPU, and the guest gets its key as
+// soon as it is typed.
+//
+// Request:
+// +-------------------------+
+// | BYTE8 REQ_GETKEYTIMEOUT |
+// +-------------------------+
+// | WORD32 timeout          | The longest time to wait for a key, in milliseconds. 0 is the same as REQ_POLLKEY.
+// +-------------------------+
+//
+// Response data for REQ_GETKEYTIMEOUT:
+// +----------------------+
+// | BYTE8 result         | RES_SUCCESS if a key was typed; RES_ERROR if not, within the timeout.
+// +----------------------+
+// | BYTE8 key            | The key typed, if result is RES_SUCCESS.
+// +----------------------+
+
+// REQ_WRITEDIRECT, REQ_READDIRECT
+// Only for a transputer emulated in the same process as the server, e.g. by emuserver: rather than the data being sent
+// in the frame, the request names a buffer in the transputer's memory, which the server writes to the stream from, or
+// reads from the stream into, directly. The transfer may be of any length, and the data is copied only once. Other
+// servers respond RES_UNIMPLEMENTED, so clients can fall back to REQ_WRITE/REQ_READ. The buffer must not be used
+// until the response has been received.
+//
+// Request:
+// +-------------------------+
+// | BYTE8 REQ_WRITEDIRECT   | or REQ_READDIRECT
+// +-------------------------+
+// | WORD32 streamid         |
+// | WORD32 address          | The address of the buffer in the transputer's memory.
+// | WORD32 length           | The number of bytes to write from, or read into, the buffer.
+// +-------------------------+
+//
+// Response data for REQ_WRITEDIRECT, REQ_READDIRECT:
+// +----------------------+
+// | BYTE8 result         | RES_SUCCESS on success; RES_BADID if stream not open, or out of range; RES_ERROR if the
+// |                      | buffer isn't all memory (or, for REQ_READDIRECT, RAM), or while the monitor has
+// |                      | watchpoints set; RES_UNIMPLEMENTED if the server can't access the transputer's memory.
+// +----------------------+
+// | WORD32 length        | The number of bytes written or read; fewer than requested at the end of the file.
+// +----------------------+
+
 #endif // _ISPROTO_H
 
@@ -0,0 +1,171 @@
+//------------------------------------------------------------------------------
+//
+// File        : filecache.cpp
+// Description : Holds the contents of files opened read-only, so that a file
+//               opened repeatedly is read from the host once.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "platformdetection.h"
+#include "filecache.h"
+#include "log.h"
+
+FileCache::FileCache(const size_t capacityBytes): myCapacity(capacityBytes), myCachedBytes(0),
+    myHits(0L), myMisses(0L), myEvictions(0L) {
+}
+
+bool FileCache::versionOf(const std::string &path, Version &version) {
+#if defined(PLATFORM_WINDOWS)
+    struct _stat64 statBuffer{};
+    if (_stat64(path.c_str(), &statBuffer) != 0) {
+        return false;
+    }
+    version.modified = (long long) statBuffer.st_mtime * 1000000000LL;
+    version.regular = (statBuffer.st_mode & _S_IFMT) == _S_IFREG;
+#endif
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+    struct stat statBuffer{};
+    if (stat(path.c_str(), &statBuffer) != 0) {
+        return false;
+    }
+#if defined(PLATFORM_OSX)
+    version.modified = (long long) statBuffer.st_mtimespec.tv_sec * 1000000000LL + statBuffer.st_mtimespec.tv_nsec;
+#else
+    version.modified = (long long) statBuffer.st_mtim.tv_sec * 1000000000LL + statBuffer.st_mtim.tv_nsec;
+#endif
+    version.regular = S_ISREG(statBuffer.st_mode);
+#endif
+    version.size = (long long) statBuffer.st_size;
+    return true;
+}
+
+std::shared_ptr<const std::vector<BYTE8>> FileCache::contents(const std::string &path) {
+    Version version {};
+    if (!versionOf(path, version)) {
+        return nullptr; // opening it as usual will report why
+    }
+    // Nothing is read from anything that isn't a plain file (a FIFO or device might never end), or that couldn't be
+    // held.
+    if (!version.regular || version.size > (long long) myCapacity) {
+        logDebugF("Not caching %s: %s", path.c_str(), version.regular ? "larger than the cache" : "not a regular file");
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        auto found = myIndex.find(path);
+        if (found != myIndex.end()) {
+            if (found->second->version == version) {
+                myHits++;
+                myEntries.splice(myEntries.begin(), myEntries, found->second);
+                logDebugF("File cache hit for %s", path.c_str());
+                return found->second->contents;
+            }
+            logDebugF("File cache entry for %s has changed on the host", path.c_str());
+            remove(found->second);
+        }
+        myMisses++;
+    }
+
+    // Read outside the lock, so that other files can be served meanwhile. Should the file change while it's being
+    // read, the contents will be newer than the version they're cached with, so will just be read again next time;
+    // should it grow beyond the capacity, it's given up on.
+    std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+    if (!file) {
+        return nullptr;
+    }
+    std::vector<BYTE8> bytes;
+    bytes.reserve((size_t) version.size);
+    char chunk[65536];
+    while (file.read(chunk, sizeof(chunk)) || file.gcount() > 0) {
+        bytes.insert(bytes.end(), chunk, chunk + file.gcount());
+        if (bytes.size() > myCapacity) {
+            logDebugF("Not caching %s: it has grown larger than the cache", path.c_str());
+            return nullptr;
+        }
+    }
+    if (file.bad()) {
+        return nullptr;
+    }
+    std::shared_ptr<const std::vector<BYTE8>> contents = std::make_shared<const std::vector<BYTE8>>(std::move(bytes));
+    logDebugF("File cache miss for %s: read %zu bytes", path.c_str(), contents->size());
+
+    std::lock_guard<std::mutex> lock(myMutex);
+    // Another thread may have read the file too.
+    auto found = myIndex.find(path);
+    if (found != myIndex.end()) {
+        remove(found->second);
+    }
+    myEntries.push_front(Entry { path, version, contents });
+    myIndex[path] = myEntries.begin();
+    myCachedBytes += contents->size();
+    evict();
+    return contents;
+}
+
+void FileCache::invalidate(const std::string &path) {
+    std::lock_guard<std::mutex> lock(myMutex);
+    auto found = myIndex.find(path);
+    if (found != myIndex.end()) {
+        logDebugF("Invalidating file cache entry for %s", path.c_str());
+        remove(found->second);
+    }
+}
+
+void FileCache::remove(const Entries::iterator entry) {
+    myCachedBytes -= entry->contents->size();
+    myIndex.erase(entry->path);
+    myEntries.erase(entry);
+}
+
+void FileCache::evict() {
+    while (myCachedBytes > myCapacity) {
+        logDebugF("Evicting %s from the file cache", myEntries.back().path.c_str());
+        remove(std::prev(myEntries.end()));
+        myEvictions++;
+    }
+}
+
+size_t FileCache::capacity() const {
+    return myCapacity;
+}
+
+WORD64 FileCache::hits() const {
+    std::lock_guard<std::mutex> lock(myMutex);
+    return myHits;
+}
+
+WORD64 FileCache::misses() const {
+    std::lock_guard<std::mutex> lock(myMutex);
+    return myMisses;
+}
+
+WORD64 FileCache::evictions() const {
+    std::lock_guard<std::mutex> lock(myMutex);
+    return myEvictions;
+}
+
+size_t FileCache::cachedFiles() const {
+    std::lock_guard<std::mutex> lock(myMutex);
+    return myEntries.size();
+}
+
+size_t FileCache::cachedBytes() const {
+    std::lock_guard<std::mutex> lock(myMutex);
+    return myCachedBytes;
+}
+
+void FileCache::logStatistics() const {
+    std::lock_guard<std::mutex> lock(myMutex);
+    logInfoF("File cache: %llu hit(s), %llu miss(es), %llu eviction(s); holding %zu file(s), %zu of %zu bytes",
+             (unsigned long long) myHits, (unsigned long long) myMisses, (unsigned long long) myEvictions,
+             myEntries.size(), myCachedBytes, myCapacity);
+}
@@ -0,0 +1,78 @@
+//------------------------------------------------------------------------------
+//
+// File        : filecache.h
+// Description : Holds the contents of files opened read-only, so that a file
+//               opened repeatedly is read from the host once.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#ifndef _FILECACHE_H
+#define _FILECACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "types.h"
+
+// Files are keyed by path, and an entry is only used while the file's modification time and size are those it had
+// when it was read. Files written through the server are invalidated explicitly, since a write may not change either
+// within the modification time's resolution. The least recently used files are evicted to keep the total size of the
+// cached contents within the capacity; contents evicted while a stream is still reading them live on until it's
+// closed. May be used from several threads, e.g. the host I/O pool, and shared by several platforms.
+class FileCache {
+public:
+    explicit FileCache(size_t capacityBytes);
+    FileCache(const FileCache &) = delete;
+    FileCache & operator=(const FileCache &) = delete;
+
+    // The whole contents of the file, from the cache or read in and cached. Null, without reading anything, if the
+    // file isn't a regular file or is larger than the capacity, and null if it can't be read: the caller should then
+    // open it as usual.
+    std::shared_ptr<const std::vector<BYTE8>> contents(const std::string &path);
+    // Called when the file is opened for writing, and again when it's closed.
+    void invalidate(const std::string &path);
+
+    size_t capacity() const;
+    WORD64 hits() const;
+    WORD64 misses() const;
+    WORD64 evictions() const;
+    size_t cachedFiles() const;
+    size_t cachedBytes() const;
+    void logStatistics() const;
+
+private:
+    struct Version {
+        long long modified; // in nanoseconds, where the host records them
+        long long size;
+        bool regular;
+        bool operator==(const Version &other) const { return modified == other.modified && size == other.size; }
+    };
+    struct Entry {
+        std::string path;
+        Version version;
+        std::shared_ptr<const std::vector<BYTE8>> contents;
+    };
+    typedef std::list<Entry> Entries; // most recently used first
+    static bool versionOf(const std::string &path, Version &version);
+    void remove(Entries::iterator entry); // call with myMutex held
+    void evict(); // call with myMutex held
+    const size_t myCapacity;
+    mutable std::mutex myMutex;
+    Entries myEntries;
+    std::unordered_map<std::string, Entries::iterator> myIndex;
+    size_t myCachedBytes;
+    WORD64 myHits;
+    WORD64 myMisses;
+    WORD64 myEvictions;
+};
+
+#endif // _FILECACHE_H
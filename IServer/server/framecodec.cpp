@@ -16,9 +16,9 @@
 #include "framecodec.h"
 #include "log.h"
 
-FrameCodec::FrameCodec(): myReadFrameSize(0), myReadFrameIndex(0), myWriteFrameIndex(0) {
-    std::memset(myTransactionBuffer, 0, sizeof(myTransactionBuffer));
-    std::memset(myStringBuffer, 0, sizeof(myStringBuffer));
+FrameCodec::FrameCodec(): myReadFrameIndex(0), myWriteFrameIndex(0), myBuffer(TransactionBufferSize, 0),
+        myReadFrameSize(0) {
+    myTransactionBuffer = myBuffer.data();
 }
 
 WORD16 FrameCodec::getReadFrameSize() {
@@ -30,7 +30,30 @@ void FrameCodec::setReadFrameSize(const WORD16 size) {
 }
 
 bool FrameCodec::readFrameSizeOutOfRange() {
-    return myReadFrameSize < 6 || myReadFrameSize > 510;
+    return myReadFrameSize < 6 || myReadFrameSize > getTransactionBufferSize() - 2;
+}
+
+int FrameCodec::getTransactionBufferSize() {
+    return (int) myBuffer.size();
+}
+
+// Frames up to the given size (including the two frame size bytes) may be read and written from now on. The contents
+// of the buffer are preserved, so a response being built when the size changes is unaffected.
+void FrameCodec::setTransactionBufferSize(const int size) noexcept(false) {
+    if (size < TransactionBufferSize || size > MaxTransactionBufferSize || (size & 0x01) == 0x01) {
+        logWarnF("Transaction buffer size %d is out of range", size);
+        throw std::range_error("Transaction buffer size out of range");
+    }
+    myBuffer.resize(size, 0);
+    myTransactionBuffer = myBuffer.data();
+}
+
+int FrameCodec::getStringBufferSize() {
+    return getTransactionBufferSize() - 2 - 2; // - frame size bytes - string length bytes
+}
+
+int FrameCodec::getBlockBufferSize() {
+    return getTransactionBufferSize() - 2 - 1 - 2; // - frame size bytes - result byte - count bytes
 }
 
 void FrameCodec::put(const BYTE8 byte8) {
@@ -77,18 +100,46 @@ WORD32 FrameCodec::get32() {
 // Size  |       String bytes, 4 in all, not null terminated
 // (6,0) String
 //       Size (4,0)
-// String max length is TransactionBufferSize - 2 - 2
+// String max length is the transaction buffer size - 2 - 2
 // (- frame size bytes - string size bytes)
 std::string FrameCodec::getString() noexcept(false) {
-    WORD16 stringLen = get16();
-    if (stringLen > StringBufferSize) {
-        logWarnF("String in frame is %d bytes - exceeding maximum of %d", stringLen, StringBufferSize);
+    WORD16 stringLen;
+    const char *cbuf = getStringView(stringLen);
+    return std::string(cbuf, (int)stringLen);
+}
+
+// As getString, but rather than being copied out, the string is returned as a pointer into the transaction buffer,
+// valid until the next frame is read, and its length. It is not null terminated.
+const char *FrameCodec::getStringView(WORD16 &length) noexcept(false) {
+    length = get16();
+    if (length > getStringBufferSize() || myReadFrameIndex + length > getTransactionBufferSize()) {
+        logWarnF("String in frame is %d bytes - exceeding maximum of %d", length, getStringBufferSize());
         throw std::range_error("String in frame exceeds maximum size");
     }
-    const auto *buf = const_cast<const BYTE8 *>(myTransactionBuffer + myReadFrameIndex);
-    const char *cbuf = (const char *)buf;
-    myReadFrameIndex += stringLen;
-    return std::string(cbuf, (int)stringLen);
+    const char *cbuf = (const char *) (myTransactionBuffer + myReadFrameIndex);
+    myReadFrameIndex += length;
+    return cbuf;
+}
+
+// A block is laid out as a string, but rather than being copied out, the block is returned as a pointer into the
+// transaction buffer, valid until the next frame is read, and its length.
+const BYTE8 *FrameCodec::getBlock(WORD16 &length) noexcept(false) {
+    length = get16();
+    if (myReadFrameIndex + length > getTransactionBufferSize()) {
+        logWarnF("Block in frame is %d bytes - exceeding the transaction buffer", length);
+        throw std::range_error("Block in frame exceeds transaction buffer");
+    }
+    const BYTE8 *block = myTransactionBuffer + myReadFrameIndex;
+    myReadFrameIndex += length;
+    return block;
+}
+
+// The block's length, then its contents, copied straight into the frame being written. The caller ensures it fits.
+void FrameCodec::putBlock(const BYTE8 *data, const WORD16 length) {
+    put(length);
+    logDebugF("put @ %04X block of %d bytes", myWriteFrameIndex, length);
+    memcpy(myTransactionBuffer + myWriteFrameIndex, data, length);
+    myWriteFrameIndex += length;
 }
 
 void FrameCodec::resetWriteFrame() {
@@ -115,7 +166,8 @@ WORD16 FrameCodec::fillInFrameSize() {
     WORD16 frameSize = (oldWriteFrameIndex - 2);
     put(frameSize);
     myWriteFrameIndex = oldWriteFrameIndex;
-    // TODO enforce minimum frame size of 6 (8 including the two frame size bytes) and maximum of 510 (512 incl size)
+    // TODO enforce minimum frame size of 6 (8 including the two frame size bytes) and maximum of the transaction
+    // buffer size - 2
     return frameSize;
 }
 
@@ -15,15 +15,22 @@
 #define _FRAMECODEC_H
 
 #include <string>
+#include <vector>
 #include "types.h"
 
 const int TransactionBufferSize = 512; // From TDS 2nd ed, p356, sec 16.5.1.
 const int StringBufferSize = TransactionBufferSize - 2 - 2; // - frame size bytes - string length bytes
+const int BlockBufferSize = TransactionBufferSize - 2 - 1 - 2; // - frame size bytes - result byte - count bytes
+// A client may negotiate a larger buffer with REQ_FRAMESIZE; this is the largest even size the WORD16 frame
+// indices can address.
+const int MaxTransactionBufferSize = 65534;
 
 
 class FrameCodec {
 public:
     FrameCodec();
+    FrameCodec(const FrameCodec &) = delete;
+    FrameCodec & operator=(const FrameCodec &) = delete;
 
     void put(BYTE8 byte8);
     void put(WORD16 word16);
@@ -32,22 +39,31 @@ public:
     WORD16 get16();
     WORD32 get32();
     std::string getString() noexcept(false);
+    // Views into the transaction buffer, valid until the next frame is read: nothing is copied.
+    const char *getStringView(WORD16 &length) noexcept(false);
+    const BYTE8 *getBlock(WORD16 &length) noexcept(false);
+    void putBlock(const BYTE8 *data, WORD16 length);
 
     WORD16 getReadFrameSize();
     void setReadFrameSize(WORD16 size);
     bool readFrameSizeOutOfRange();
 
+    int getTransactionBufferSize();
+    void setTransactionBufferSize(int size) noexcept(false);
+    int getStringBufferSize();
+    int getBlockBufferSize();
+
     void resetWriteFrame();
     void fillInReadFrameSize();
     WORD16 fillInFrameSize();
     BYTE8 *writeOffset(WORD16 offset);
     void advance(WORD16 amount);
 
-    BYTE8 myTransactionBuffer[TransactionBufferSize];
-    BYTE8 myStringBuffer[StringBufferSize]; // TODO keep this?
+    BYTE8 *myTransactionBuffer; // the start of myBuffer, which is resized when a larger buffer is negotiated
     WORD16 myReadFrameIndex;
     WORD16 myWriteFrameIndex;
 private:
+    std::vector<BYTE8> myBuffer;
     WORD16 myReadFrameSize; // set if readFrame returns true
 };
 
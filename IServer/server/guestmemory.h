@@ -0,0 +1,30 @@
+//------------------------------------------------------------------------------
+//
+// File        : guestmemory.h
+// Description : Direct access to the memory of a transputer emulated in the
+//               same process as the IServer.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#ifndef _GUESTMEMORY_H
+#define _GUESTMEMORY_H
+
+#include "types.h"
+
+// Lets the WriteDirect and ReadDirect requests name a buffer in the guest's memory, rather than carrying its
+// contents over the link. The guest is blocked on the link awaiting the response while its buffer is accessed.
+class GuestMemory {
+public:
+    virtual ~GuestMemory() = default;
+    // The host address of the length bytes of guest memory from address, or nullptr if they aren't all readable
+    // (or, if forWriting, writable). A range mapped for writing is taken to have been written.
+    virtual BYTE8 *map(WORD32 address, WORD32 length, bool forWriting) = 0;
+};
+
+#endif // _GUESTMEMORY_H
@@ -0,0 +1,68 @@
+//------------------------------------------------------------------------------
+//
+// File        : hostiopool.cpp
+// Description : A pool of threads that perform blocking host I/O on behalf of
+//               protocol handlers.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <exception>
+#include "hostiopool.h"
+#include "log.h"
+
+HostIOPool::HostIOPool(const int threads): myStopping(false) {
+    logDebugF("Starting host I/O pool of %d threads", threads);
+    for (int i = 0; i < threads; i++) {
+        myThreads.emplace_back(&HostIOPool::work, this);
+    }
+}
+
+HostIOPool::~HostIOPool() {
+    logDebug("Stopping host I/O pool");
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        myStopping = true;
+    }
+    myTaskAvailable.notify_all();
+    for (std::thread &thread: myThreads) {
+        thread.join();
+    }
+}
+
+void HostIOPool::submit(const std::function<void()> &task) {
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        myTasks.push_back(task);
+    }
+    myTaskAvailable.notify_one();
+}
+
+int HostIOPool::threads() const {
+    return (int) myThreads.size();
+}
+
+void HostIOPool::work() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(myMutex);
+            myTaskAvailable.wait(lock, [this] { return myStopping || !myTasks.empty(); });
+            if (myTasks.empty()) {
+                return; // stopping, and everything submitted has been run
+            }
+            task = myTasks.front();
+            myTasks.pop_front();
+        }
+        try {
+            task();
+        } catch (const std::exception &e) {
+            logErrorF("Host I/O task failed: %s", e.what());
+        }
+    }
+}
@@ -0,0 +1,47 @@
+//------------------------------------------------------------------------------
+//
+// File        : hostiopool.h
+// Description : A pool of threads that perform blocking host I/O on behalf of
+//               protocol handlers.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#ifndef _HOSTIOPOOL_H
+#define _HOSTIOPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tasks are run in the order submitted, but several may run at once, so a submitter that needs its tasks to run in
+// order must wait for each to finish before submitting the next, as ProtocolHandler does.
+class HostIOPool {
+public:
+    explicit HostIOPool(int threads);
+    // Waits for all submitted tasks to be run.
+    ~HostIOPool();
+    HostIOPool(const HostIOPool &) = delete;
+    HostIOPool & operator=(const HostIOPool &) = delete;
+
+    void submit(const std::function<void()> &task);
+    int threads() const;
+
+private:
+    void work();
+    std::mutex myMutex;
+    std::condition_variable myTaskAvailable;
+    std::deque<std::function<void()>> myTasks;
+    bool myStopping;
+    std::vector<std::thread> myThreads;
+};
+
+#endif // _HOSTIOPOOL_H
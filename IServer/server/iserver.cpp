@@ -61,6 +61,32 @@ bool processCommandLine(int argc, char *argv[]) {
 					}
 					programCommandLine += std::string(argv[i]);
 					break;
+				case '-': {
+					const char *value;
+					if (strcmp(argv[i], "--") == 0) {
+						// The rest are the program's, whatever they look like.
+						for (i++; i < argc; i++) {
+							if (!programCommandLine.empty()) {
+								programCommandLine += " ";
+							}
+							programCommandLine += std::string(argv[i]);
+						}
+					} else if ((value = longOptionValue(argv[i], "cache")) != nullptr) {
+						if (!createFileCache(std::string(value))) {
+							return false;
+						}
+					} else if ((value = longOptionValue(argv[i], "preload")) != nullptr) {
+						if (!addPreloadImage(std::string(value))) {
+							return false;
+						}
+					} else {
+						if (!programCommandLine.empty()) {
+							programCommandLine += " ";
+						}
+						programCommandLine += std::string(argv[i]);
+					}
+					}
+					break;
 
 				case 'M':
 					monitorLink = true;
@@ -155,6 +181,11 @@ void usage() {
 	logInfo("  -dl   Enables link communications (high level) debug");
 	logInfo("  -dL   Enables link communications (high & low level) debug");
 	logInfo("  -M    Monitors boot link instead of handling protocol");
+	logInfo("  --preload=<F>@<H> Load image file F into memory at hex address H, with block pokes,");
+	logInfo("        before sending the bootfile (can be repeated). The Emulator must be run with -k");
+	logInfo("  --cache[=<MB>] Serves files opened read-only from a cache of MB megabytes (default 64),");
+	logInfo("        so that files opened repeatedly are read from the host once");
+	logInfo("  --    Passes all the arguments after it to the transputer, even options the IServer uses itself");
 	logInfo("  -h    Displays this usage summary");
 	logInfo("  -l<X> Sets log level. X is one of [diwef] for DEBUG, INFO");
 	logInfo("        WARN, ERROR or FATAL. Default is INFO");
@@ -166,12 +197,18 @@ void usage() {
 	logInfo("  -T<N><TTY device file|COM number> (e.g. -T0/dev/tty.usbmodem2102 or -T013 for COM13:) for link N 0..3");
 	logInfo("        (Forces link N to type T)");
 	logInfo("Any options not understood by the IServer are stored to be made available to the transputer.");
+	logInfo("Options beginning -d -h -l -L -M -r -T, and the long options above, are the IServer's own: give them");
+	logInfo("after -- to pass them on.");
 }
 
 void cleanup() {
 	if (myPlatform != NULL) {
 		delete myPlatform;
 	}
+	if (fileCache != NULL) {
+		fileCache->logStatistics();
+		delete fileCache;
+	}
 	if (myLink != NULL) {
 		delete myLink;
 	}
@@ -212,6 +249,8 @@ int main(int argc, char *argv[]) {
 		cleanup();
 		exit(1);
 	}
+	myPlatform->setConsoleOutputPolicy(CONSOLE_COALESCE);
+	myPlatform->setFileCache(fileCache);
 
 	linkFactory = new LinkFactory(true, debugLinkRaw);
 	if (!linkFactory->processCommandLine(argc, argv)) {
@@ -240,7 +279,8 @@ int main(int argc, char *argv[]) {
 	}
 
 	// start iserver operations
-	if (!bootFile.empty()) {
+	preloadImagesOverLink();
+	if (!bootFile.empty() && !finished) {
 		sendFileOverLink(bootFile, "boot");
 		logDebug("End of boot file send");
 	}
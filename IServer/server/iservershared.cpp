@@ -12,10 +12,13 @@
 //------------------------------------------------------------------------------
 
 #include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <string>
 using namespace std;
 
 #include "iservershared.h"
+#include "constants.h"
 #include "log.h"
 #include "link.h"
 #include "linkfactory.h"
@@ -45,6 +48,7 @@ PlatformFactory *platformFactory;
 Link *myLink;
 LinkFactory *linkFactory;
 std::string bootFile;
+std::vector<std::pair<std::string, WORD32>> preloadImages;
 bool debugPlatform;
 bool debugProtocol;
 bool debugLink;
@@ -53,6 +57,7 @@ bool monitorLink;
 std::string fullCommandLine;
 std::string programCommandLine;
 bool finished;
+FileCache *fileCache = nullptr;
 
 extern void cleanup();
 
@@ -116,8 +121,13 @@ void interruptHandler(int sig) {
 // Send a file's contents over the link, typically a boot file.
 // A boot file must start with a byte indicating its length; if the code is longer than 255 bytes, the boot file
 // must contain a chain loader, first.
+// Any bytes before offset (e.g. already loaded directly into memory) aren't sent.
 // Precondition: sendFile != empty
-void sendFileOverLink(std::string sendFile, std::string fileDescription) {
+void sendFileOverLink(std::string sendFile, std::string fileDescription, long offset) {
+	sendFileOverLink(*myLink, sendFile, fileDescription, offset);
+}
+
+void sendFileOverLink(Link &link, std::string sendFile, std::string fileDescription, long offset) {
 	// Open file and set exceptions to be thrown on failure
 	ifstream fileStream;
 	fileStream.exceptions(std::ifstream::failbit | std::ifstream::badbit);
@@ -126,6 +136,7 @@ void sendFileOverLink(std::string sendFile, std::string fileDescription) {
 		BYTE8 buf[128];
 		streamsize nread = 0;
 		fileStream.open(sendFile, ifstream::in | ifstream::binary);
+		fileStream.seekg(offset, ios::beg);
 		do {
 			fileStream.exceptions(std::ifstream::goodbit);
 			fileStream.read(reinterpret_cast<char *>(buf), 128);
@@ -134,16 +145,13 @@ void sendFileOverLink(std::string sendFile, std::string fileDescription) {
 				if (debugLink) {
 					logDebugF("Read %d bytes of boot code; sending down link", nread);
 				}
-				for (int i = 0; i < nread; i++) {
-					try {
-						// TODO do this in blocks to improve performance
-						myLink->writeByte(buf[i]);
-					} catch (exception e) {
-						logFatalF("Could not write down link 0: %s", e.what());
-						fileStream.close();
-						finished = true;
-						return;
-					}
+				try {
+					link.writeBytes(buf, (int) nread);
+				} catch (exception e) {
+					logFatalF("Could not write down link %d: %s", link.getLinkNo(), e.what());
+					fileStream.close();
+					finished = true;
+					return;
 				}
 			}
 		} while (nread > 0);
@@ -153,6 +161,89 @@ void sendFileOverLink(std::string sendFile, std::string fileDescription) {
 	}
 }
 
+const char *longOptionValue(const char *arg, const char *name) {
+	const size_t nameLength = strlen(name);
+	if (strncmp(arg, "--", 2) != 0 || strncmp(arg + 2, name, nameLength) != 0) {
+		return nullptr;
+	}
+	const char *rest = arg + 2 + nameLength;
+	if (*rest == '\0') {
+		return rest;
+	}
+	return (*rest == '=') ? rest + 1 : nullptr;
+}
+
+bool addPreloadImage(const std::string &spec) {
+	const size_t at = spec.find('@');
+	WORD32 address = 0;
+	if (at == 0 || at == std::string::npos ||
+#if defined(PLATFORM_WINDOWS)
+		sscanf_s(spec.c_str() + at + 1, "%x", &address) != 1) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		sscanf(spec.c_str() + at + 1, "%x", &address) != 1) {
+#endif
+		logFatalF("An image to preload must be given as a file and hex address e.g. app.bin@80001000, not %s", spec.c_str());
+		return false;
+	}
+	preloadImages.emplace_back(spec.substr(0, at), address);
+	return true;
+}
+
+bool createFileCache(const std::string &megabytes) {
+	int capacity = DefaultFileCacheMegabytes;
+	if (!megabytes.empty() &&
+#if defined(PLATFORM_WINDOWS)
+		(sscanf_s(megabytes.c_str(), "%d", &capacity) != 1 || capacity < 1)) {
+#elif defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+		(sscanf(megabytes.c_str(), "%d", &capacity) != 1 || capacity < 1)) {
+#endif
+		logFatalF("The file cache's capacity must be a positive number of megabytes, not %s", megabytes.c_str());
+		return false;
+	}
+	delete fileCache;
+	fileCache = new FileCache((size_t) capacity * 1024 * 1024);
+	return true;
+}
+
+// Load the images into memory with block pokes, each a control byte, address and length words, then the data, so
+// that a bootstrap can start a large program without it being sent word by word. The emulator must have the
+// extended boot protocol enabled.
+void preloadImagesOverLink(void) {
+	// As the emulator copies it into memory.
+	const WORD32 blockSize = 65536;
+	std::vector<BYTE8> block(blockSize);
+	for (auto &image: preloadImages) {
+		std::ifstream in(image.first, std::ifstream::in | std::ifstream::binary);
+		if (!in) {
+			logFatalF("Could not open image file %s", image.first.c_str());
+			finished = true;
+			return;
+		}
+		WORD32 address = image.second;
+		WORD32 total = 0;
+		try {
+			for (;;) {
+				in.read(reinterpret_cast<char *>(block.data()), blockSize);
+				const WORD32 nread = (WORD32) in.gcount();
+				if (nread == 0) {
+					break;
+				}
+				myLink->writeByte(BOOT_BLOCK_POKE);
+				myLink->writeWord(address);
+				myLink->writeWord(nread);
+				myLink->writeBytes(block.data(), (int) nread);
+				address += nread;
+				total += nread;
+			}
+		} catch (exception &e) {
+			logFatalF("Could not write image %s down link 0: %s", image.first.c_str(), e.what());
+			finished = true;
+			return;
+		}
+		logInfoF("Preloaded %u bytes of %s at %08X", total, image.first.c_str(), image.second);
+	}
+}
+
 void monitorBootLink(void) {
 	for(;;) {
 		try {
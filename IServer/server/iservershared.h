@@ -14,11 +14,16 @@
 #ifndef ISERVERSHARED_H
 #define ISERVERSHARED_H
 
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "link.h"
 #include "linkfactory.h"
 #include "inmemorylink.h"
 #include "platform.h"
 #include "platformfactory.h"
+#include "filecache.h"
 
 extern void usage(); // different for the two programs.
 
@@ -29,6 +34,9 @@ extern PlatformFactory *platformFactory;
 extern Link *myLink;
 extern LinkFactory *linkFactory;
 extern std::string bootFile;
+// Images to be loaded into the emulator's memory with the extended boot protocol's block pokes, before the
+// bootfile is sent, and the addresses to load them at.
+extern std::vector<std::pair<std::string, WORD32>> preloadImages;
 extern bool debugPlatform;
 extern bool debugProtocol;
 extern bool debugLink;
@@ -37,6 +45,9 @@ extern bool monitorLink;
 extern std::string fullCommandLine;
 extern std::string programCommandLine;
 extern bool finished;
+// Serves files opened read-only from memory, when enabled with --cache.
+extern FileCache *fileCache;
+const int DefaultFileCacheMegabytes = 64;
 
 void setupCurrentPathAndRootDirectory();
 bool fileExists(const std::string &filename);
@@ -44,7 +55,16 @@ bool fileExists(const std::string &filename);
 void segViolHandler(int sig);
 void interruptHandler(int sig);
 #endif
-void sendFileOverLink(std::string sendFile, std::string fileDescription);
+void sendFileOverLink(std::string sendFile, std::string fileDescription, long offset = 0);
+void sendFileOverLink(Link &link, std::string sendFile, std::string fileDescription, long offset = 0);
+// If arg is the long option --name, or --name=<value>, returns its value (empty if not given); otherwise nullptr.
+const char *longOptionValue(const char *arg, const char *name);
+// Parse an image to preload, given as <file>@<hex address>. Returns false, having logged why, if it's invalid.
+bool addPreloadImage(const std::string &spec);
+void preloadImagesOverLink(void);
+// Create the file cache, given its capacity in megabytes, or the default if that's empty. Returns false, having logged
+// why, if it's invalid.
+bool createFileCache(const std::string &megabytes);
 void monitorBootLink(void);
 
 #endif // ISERVERSHARED_H
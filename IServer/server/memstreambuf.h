@@ -15,6 +15,8 @@
 #define _MEMSTREAMBUF_H
 
 #include <iostream>
+#include <mutex>
+#include <string>
 #include "log.h"
 
 class membuf : public std::basic_streambuf<char> {
@@ -76,6 +78,33 @@ public:
     }
 };
 
+// Records what is written to it, and how many writes were made; can be examined while another thread writes to it.
+class recordingstreambuf : public std::basic_streambuf<char> {
+public:
+    std::string written() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return contents;
+    }
+
+    int writes() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+protected:
+    std::streamsize xsputn(const char* __s, std::streamsize __n) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        contents.append(__s, __n);
+        count++;
+        return __n;
+    }
+
+private:
+    std::mutex mutex;
+    std::string contents;
+    int count = 0;
+};
+
 class memistream : public std::istream {
 public:
     memistream(const uint8_t *p, size_t l) :
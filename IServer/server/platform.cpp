@@ -11,6 +11,8 @@
 //
 //------------------------------------------------------------------------------
 
+#include <chrono>
+#include <cstring>
 #include <exception>
 #include <memory>
 #include <vector>
@@ -20,6 +22,7 @@
 
 #include "types.h"
 #include "platform.h"
+#include "filecache.h"
 #include "log.h"
 
 
@@ -37,15 +40,18 @@ public:
     WORD16 read(WORD16 size, BYTE8 *buffer);
 
     int streamId;
+    std::string filePath; // empty for the console
     bool isReadable = false;
     bool isWritable = false;
     bool isBinary = false;
+    bool isAtEOF = false; // set by a short read, cleared by a seek
     InputOutputOperation lastIOOperation = IO_NONE;
 };
 
 class FileStream: public Stream {
 public:
     explicit FileStream(int streamId, const std::string & filePath, const std::ios_base::openmode mode): Stream(streamId) {
+        this->filePath = filePath;
         // From https://stackoverflow.com/questions/17337602/how-to-get-error-message-when-ifstream-open-fails
         // Thanks to ɲeuroburɳ for their answer on error handling.
         fstream.open(filePath, mode);
@@ -95,6 +101,81 @@ private:
     std::fstream fstream;
 };
 
+// Reads a file's contents held by the FileCache, which it shares with the cache and any other streams reading the
+// same file. Positioned like a file, so seeks, tells and end of file behave as they do on a FileStream.
+class CachedFileBuf: public std::streambuf {
+public:
+    explicit CachedFileBuf(std::shared_ptr<const std::vector<BYTE8>> contents): myContents(std::move(contents)) {
+        char *begin = reinterpret_cast<char *>(const_cast<BYTE8 *>(myContents->data()));
+        setg(begin, begin, begin + myContents->size());
+    }
+
+protected:
+    pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override {
+        if ((which & std::ios_base::in) == 0) {
+            return pos_type(off_type(-1));
+        }
+        const off_type size = egptr() - eback();
+        off_type origin = 0;
+        switch (direction) {
+            case std::ios_base::cur: origin = gptr() - eback(); break;
+            case std::ios_base::end: origin = size; break;
+            default: break;
+        }
+        const off_type position = origin + offset;
+        if (position < 0 || position > size) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), eback() + position, egptr());
+        return pos_type(position);
+    }
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode which) override {
+        return seekoff(off_type(position), std::ios_base::beg, which);
+    }
+
+private:
+    std::shared_ptr<const std::vector<BYTE8>> myContents;
+};
+
+class CachedFileStream: public Stream {
+public:
+    explicit CachedFileStream(int streamId, const std::string & filePath, const std::ios_base::openmode mode,
+                              std::shared_ptr<const std::vector<BYTE8>> contents):
+            Stream(streamId), buf(std::move(contents)), iostream(&buf), open(true) {
+        this->filePath = filePath;
+        isReadable = true;
+        isBinary = ((mode & std::ios_base::binary) != 0);
+        logInfoF("Opened file %s with mode %d from the file cache", filePath.c_str(), mode);
+    }
+
+    ~CachedFileStream() override {
+        logDebugF("Destroying cached file stream #%d", streamId);
+    }
+
+    bool is_console() override {
+        return false;
+    }
+
+    bool is_open() override {
+        return open;
+    };
+
+    void close() override {
+        logDebugF("Closing cached file stream #%d", streamId);
+        open = false;
+    };
+
+    std::iostream & getIOStream() override {
+        return iostream;
+    }
+
+private:
+    CachedFileBuf buf;
+    std::iostream iostream;
+    bool open;
+};
+
 class ConsoleStream: public Stream {
 public:
     explicit ConsoleStream(int streamId, std::streambuf *buf) : Stream(streamId), iostream(buf) {
@@ -121,11 +202,35 @@ public:
         return iostream;
     }
 
+    // Hold output back until a line is complete or the buffer fills, rather than making a system call for every
+    // write. The whole write is reported as written: a failure to write it is only known when it's drained.
+    WORD16 coalesce(WORD16 size, BYTE8 *buffer) {
+        if (pending.size() + size > ConsoleOutputBufferSize) {
+            drain();
+        }
+        if (size >= ConsoleOutputBufferSize) {
+            return write(size, buffer);
+        }
+        pending.insert(pending.end(), buffer, buffer + size);
+        if (memchr(buffer, '\n', size) != nullptr || pending.size() == ConsoleOutputBufferSize) {
+            drain();
+        }
+        return size;
+    }
+
+    void drain() {
+        if (!pending.empty()) {
+            write((WORD16) pending.size(), pending.data());
+            pending.clear();
+        }
+    }
+
     // For use by tests...
     void _setStreamBuf(std::streambuf *buffer);
 
 private:
     std::iostream iostream;
+    std::vector<BYTE8> pending;
 };
 
 namespace {
@@ -225,6 +330,7 @@ WORD16 Stream::read(WORD16 size, BYTE8 *buffer) {
     if (read != size) {
         logWarnF("Failed to read %d bytes from stream #%d, read %d bytes instead", size, streamId, read);
         stream.setstate(std::ios::badbit);
+        isAtEOF = true;
     }
     return read;
 }
@@ -241,6 +347,9 @@ void FileStream::_setFileBuf(std::filebuf &buffer) {
 
 Platform::Platform() {
     bDebug = false;
+    myConsoleOutputPolicy = CONSOLE_FLUSH_EACH_WRITE;
+    myConsoleFlushIntervalMillis = ConsoleFlushIntervalMillis;
+    myConsoleFlusherStopping = false;
 
     logDebug("Constructing platform");
     // Initialise standard in, out and error
@@ -256,6 +365,7 @@ Platform::Platform() {
     }
 
     myNextAvailableFile = FILE_STDERR + 1;
+    myFileCache = nullptr;
 }
 
 void Platform::setCommandLines(std::string fullCommandLine, std::string programCommandLine) {
@@ -266,6 +376,9 @@ void Platform::setCommandLines(std::string fullCommandLine, std::string programC
 Platform::~Platform() {
     logDebug("Destroying platform");
 
+    stopConsoleFlusher();
+    flushConsoleOutput();
+
     // Close all open streams
     for (int i=0; i < MAX_FILES; i++) {
         if (myFiles[i] != nullptr) {
@@ -282,17 +395,24 @@ void Platform::setDebug(bool newDebug) {
     bDebug = newDebug;
 }
 
+bool Platform::waitForConsoleChar(const WORD32 timeoutMillis) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+    while (!isConsoleCharAvailable()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
 
-std::vector<BYTE8> Platform::getCommandLineAll() {
-	std::vector<BYTE8> v;
-	std::copy(myFullCommandLine.begin(), myFullCommandLine.end(), std::back_inserter(v));
-	return v;
+
+const std::string & Platform::getCommandLineAll() {
+	return myFullCommandLine;
 }
 
-std::vector<BYTE8> Platform::getCommandLineForProgram() {
-	std::vector<BYTE8> v;
-	std::copy(myProgramCommandLine.begin(), myProgramCommandLine.end(), std::back_inserter(v));
-	return v;
+const std::string & Platform::getCommandLineForProgram() {
+	return myProgramCommandLine;
 }
 
 
@@ -317,7 +437,16 @@ WORD16 Platform::writeStream(int streamId, WORD16 size, BYTE8 *buffer) noexcept(
     }
     logDebugF("Writing %d bytes to stream #%d", size, streamId);
     // Needs to be validated at the platform level first, then adapted to the protocol handler.
-    WORD16 written = pStream->write(size, buffer);
+    WORD16 written;
+    if (pStream->is_console() && myConsoleOutputPolicy == CONSOLE_COALESCE) {
+        std::lock_guard<std::mutex> lock(myConsoleOutputMutex);
+        // Whatever the other console stream holds was written first, so must appear first, e.g. a prompt on stdout
+        // before an error on stderr. So at most one of them holds anything.
+        drainConsoleStream(streamId == FILE_STDOUT ? FILE_STDERR : FILE_STDOUT);
+        written = dynamic_cast<ConsoleStream *>(pStream.get())->coalesce(size, buffer);
+    } else {
+        written = pStream->write(size, buffer);
+    }
     pStream->lastIOOperation = IO_WRITE;
     logDebugF("Wrote %d bytes to stream #%d", written, streamId);
     return written;
@@ -341,6 +470,10 @@ WORD16 Platform::readStream(int streamId, WORD16 size, BYTE8 *buffer) noexcept(f
         logWarnF("Attempt to read from previously written stream #%d", streamId);
         throw std::domain_error("Previously written stream not readable");
     }
+    if (pStream->is_console()) {
+        // Whatever prompted the read must be seen before it blocks.
+        flushConsoleOutput();
+    }
     logDebugF("Reading %d bytes from stream #%d", size, streamId);
     WORD16 read = pStream->read(size, buffer);
     pStream->lastIOOperation = IO_READ;
@@ -348,11 +481,70 @@ WORD16 Platform::readStream(int streamId, WORD16 size, BYTE8 *buffer) noexcept(f
     return read;
 }
 
-void Platform::flushStream(int streamId) noexcept(false) {
-    // precondition: all the validity/writability checks have been done in the write call that called this..
-    std::unique_ptr<Stream> &pStream = myFiles[streamId];
-    pStream->getIOStream().flush();
-    // Not implementing the last IO operation check at the moment - this is currently just used to flush after putchar
+Stream & Platform::validStream(const int streamId, const char *operation) noexcept(false) {
+    if (streamId < 0 || streamId >= MAX_FILES) {
+        logWarnF("Attempt to %s out-of-range stream id #%d", operation, streamId);
+        throw std::range_error("Stream id out of range");
+    }
+    std::unique_ptr<Stream> & pStream = myFiles[streamId];
+    if (pStream == nullptr) {
+        logWarnF("Attempt to %s unopen stream #%d", operation, streamId);
+        throw std::invalid_argument("Stream id not open");
+    }
+    return *pStream;
+}
+
+bool Platform::flushStream(int streamId) noexcept(false) {
+    Stream & stream = validStream(streamId, "flush");
+    logDebugF("Flushing stream #%d", streamId);
+    if (stream.is_console()) {
+        std::lock_guard<std::mutex> lock(myConsoleOutputMutex);
+        drainConsoleStream(streamId);
+    }
+    std::iostream & iostream = stream.getIOStream();
+    if (iostream.rdbuf()->pubsync() == -1) {
+        logWarnF("Failed to flush stream #%d", streamId);
+        return false;
+    }
+    stream.lastIOOperation = IO_NONE;
+    return true;
+}
+
+bool Platform::seekStream(const int streamId, const SWORD32 offset, const int origin) noexcept(false) {
+    Stream & stream = validStream(streamId, "seek");
+    std::ios_base::seekdir direction;
+    switch (origin) {
+        case 1: direction = std::ios_base::beg; break;
+        case 2: direction = std::ios_base::cur; break;
+        case 3: direction = std::ios_base::end; break;
+        default:
+            logWarnF("Attempt to seek stream #%d from unknown origin %d", streamId, origin);
+            return false;
+    }
+    logDebugF("Seeking stream #%d to %d from origin %d", streamId, offset, origin);
+    // As with read and write, go to the stream buffer: the stream's own seekg fails once a short read has set its
+    // badbit. A file has one position, for both reading and writing; a pending write is flushed first.
+    std::iostream & iostream = stream.getIOStream();
+    const std::streampos position = iostream.rdbuf()->pubseekoff(offset, direction, std::ios_base::in | std::ios_base::out);
+    if (position == std::streampos(-1)) {
+        logWarnF("Failed to seek stream #%d to %d from origin %d", streamId, offset, origin);
+        return false;
+    }
+    iostream.clear();
+    stream.isAtEOF = false;
+    stream.lastIOOperation = IO_NONE;
+    return true;
+}
+
+SWORD32 Platform::tellStream(const int streamId) noexcept(false) {
+    Stream & stream = validStream(streamId, "tell");
+    const std::streampos position = stream.getIOStream().rdbuf()->pubseekoff(0, std::ios_base::cur, std::ios_base::in | std::ios_base::out);
+    logDebugF("Stream #%d is at position %ld", streamId, (long) position);
+    return (SWORD32) position;
+}
+
+bool Platform::isEndOfStream(const int streamId) noexcept(false) {
+    return validStream(streamId, "test end of").isAtEOF;
 }
 
 bool Platform::isBinaryStream(int streamId) noexcept(false) {
@@ -372,11 +564,41 @@ WORD16 Platform::openFileStream(const std::string & filePath, const std::ios_bas
     if (streamId == MAX_FILES) {
         throw std::runtime_error(Formatter() << "No streams available to open " << filePath );
     }
-    std::unique_ptr<FileStream> pStream { std::make_unique<FileStream>(streamId, filePath, mode) };
+    std::unique_ptr<Stream> pStream;
+    std::shared_ptr<const std::vector<BYTE8>> contents;
+    if (myFileCache != nullptr && isCacheable(mode)) {
+        contents = myFileCache->contents(filePath);
+    }
+    if (contents != nullptr) {
+        pStream = std::make_unique<CachedFileStream>(streamId, filePath, mode, contents);
+    } else {
+        if (myFileCache != nullptr && (mode & std::ios_base::out) != 0) {
+            myFileCache->invalidate(filePath);
+        }
+        pStream = std::make_unique<FileStream>(streamId, filePath, mode);
+    }
+    std::lock_guard<std::mutex> lock(myConsoleOutputMutex);
     myFiles[streamId] = std::move(pStream);
     return streamId;
 }
 
+void Platform::setFileCache(FileCache *fileCache) {
+    myFileCache = fileCache;
+}
+
+// Only files opened for reading alone are cached. On Windows, text mode translates line endings, which the cache,
+// holding the file's bytes as they are, would not.
+bool Platform::isCacheable(const std::ios_base::openmode mode) {
+    if ((mode & (std::ios_base::out | std::ios_base::app | std::ios_base::trunc)) != 0) {
+        return false;
+    }
+#if defined(PLATFORM_WINDOWS)
+    return (mode & std::ios_base::binary) != 0;
+#else
+    return true;
+#endif
+}
+
 bool Platform::closeStream(const int streamId) {
     if (streamId < 0 || streamId >= MAX_FILES) {
         logWarnF("Attempt to close out-of-range stream id #%d", streamId);
@@ -388,14 +610,67 @@ bool Platform::closeStream(const int streamId) {
         throw std::invalid_argument("Stream id not open");
     }
     logDebugF("Closing stream #%d", streamId);
+    std::lock_guard<std::mutex> lock(myConsoleOutputMutex);
+    drainConsoleStream(streamId);
     pStream->close();
     std::iostream &iostream = pStream->getIOStream();
     bool closeOk = !iostream.fail();
     logDebugF("Stream #%d %s", streamId, (closeOk ? "closed" : "failed to close correctly"));
+    if (myFileCache != nullptr && pStream->isWritable && !pStream->filePath.empty()) {
+        myFileCache->invalidate(pStream->filePath);
+    }
     myFiles[streamId].reset();
     return closeOk;
 }
 
+void Platform::setConsoleOutputPolicy(const ConsoleOutputPolicy policy, const int flushIntervalMillis) {
+    logDebugF("Console output will be %s", policy == CONSOLE_COALESCE ? "coalesced" : "flushed on each write");
+    stopConsoleFlusher();
+    flushConsoleOutput();
+    myConsoleOutputPolicy = policy;
+    myConsoleFlushIntervalMillis = flushIntervalMillis;
+    if (policy == CONSOLE_COALESCE) {
+        myConsoleFlusherStopping = false;
+        myConsoleFlusher = std::thread(&Platform::flushConsoleOutputPeriodically, this);
+    }
+}
+
+void Platform::flushConsoleOutput() {
+    std::lock_guard<std::mutex> lock(myConsoleOutputMutex);
+    drainConsoleStream(FILE_STDOUT);
+    drainConsoleStream(FILE_STDERR);
+}
+
+void Platform::drainConsoleStream(const int streamId) {
+    std::unique_ptr<Stream> & pStream = myFiles[streamId];
+    if (pStream != nullptr && pStream->is_console()) {
+        dynamic_cast<ConsoleStream *>(pStream.get())->drain();
+    }
+}
+
+// Nothing is held for longer than the flush interval, so output that doesn't end a line (e.g. a prompt, or progress
+// dots) still appears while the guest gets on with something else.
+void Platform::flushConsoleOutputPeriodically() {
+    std::unique_lock<std::mutex> lock(myConsoleOutputMutex);
+    while (!myConsoleFlusherStopping) {
+        myConsoleFlusherWakeup.wait_for(lock, std::chrono::milliseconds(myConsoleFlushIntervalMillis));
+        drainConsoleStream(FILE_STDOUT);
+        drainConsoleStream(FILE_STDERR);
+    }
+}
+
+void Platform::stopConsoleFlusher() {
+    if (!myConsoleFlusher.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(myConsoleOutputMutex);
+        myConsoleFlusherStopping = true;
+    }
+    myConsoleFlusherWakeup.notify_all();
+    myConsoleFlusher.join();
+}
+
 // For use by tests...
 
 void Platform::_setStreamBuf(const int streamId, std::streambuf *buffer) {
@@ -407,6 +682,7 @@ void Platform::_setStreamBuf(const int streamId, std::streambuf *buffer) {
     }
     if (pStream->is_console()) {
         auto * pConsoleStream = dynamic_cast<ConsoleStream *>(pStream.get());
+        std::lock_guard<std::mutex> lock(myConsoleOutputMutex);
         pConsoleStream->_setStreamBuf(buffer);
     } else {
         logWarnF("Cannot set stream buffer for a FileStream stream #%d", streamId);
@@ -14,11 +14,14 @@
 #ifndef _PLATFORM_H
 #define _PLATFORM_H
 
+#include <condition_variable>
 #include <exception>
 #include <ios>
 #include <iostream>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include <log.h>
@@ -66,7 +69,14 @@ const int FILE_STDERR = 2;
 
 enum InputOutputOperation { IO_READ, IO_WRITE, IO_NONE };
 
+// By default, each write to stdout or stderr is flushed. When coalescing, console output is held until a line is
+// complete, ConsoleOutputBufferSize bytes are held, the console is read, or ConsoleFlushIntervalMillis has passed.
+enum ConsoleOutputPolicy { CONSOLE_FLUSH_EACH_WRITE, CONSOLE_COALESCE };
+const int ConsoleOutputBufferSize = 4096;
+const int ConsoleFlushIntervalMillis = 20;
+
 class Stream;
+class FileCache;
 
 class Platform {
 public:
@@ -77,23 +87,38 @@ public:
     void setDebug(bool newDebug);
 
     virtual bool isConsoleCharAvailable() = 0;
+    // Blocks until a console char is available (true) or the timeout expires (false). This implementation polls;
+    // platforms that can wait on the console should.
+    virtual bool waitForConsoleChar(WORD32 timeoutMillis);
     virtual BYTE8 getConsoleChar() = 0;
     virtual void putConsoleChar(BYTE8 ch) = 0;
 
     virtual WORD32 getTimeMillis() = 0;
     virtual UTCTime getUTCTime() = 0;
     
-    std::vector<BYTE8> getCommandLineAll();
-    std::vector<BYTE8> getCommandLineForProgram();
+    // Not copied: the REQ_COMMAND response is built from these directly.
+    const std::string & getCommandLineAll();
+    const std::string & getCommandLineForProgram();
 
     // The WORD16s used for size parameters come from the protocol definition of REQ_READ, REQ_WRITE.
     WORD16 writeStream(int streamId, WORD16 size, BYTE8* buffer) noexcept(false);
     WORD16 readStream(int streamId, WORD16 size, BYTE8* buffer) noexcept(false);
-    void flushStream(int streamId);
+    bool flushStream(int streamId) noexcept(false); // true => flush succeeded
     bool isBinaryStream(int streamId);
+    // The origins used by REQ_SEEK: 1 = start of stream, 2 = current position, 3 = end of stream. Seeking or flushing
+    // a stream allows it to be read after being written, or written after being read.
+    bool seekStream(int streamId, SWORD32 offset, int origin) noexcept(false); // true => seek succeeded
+    SWORD32 tellStream(int streamId) noexcept(false); // -1 if the stream has no position
+    bool isEndOfStream(int streamId) noexcept(false); // true once a read has reached the end
 
     WORD16 openFileStream(const std::string & filePath, std::ios_base::openmode mode);
     bool closeStream(int streamId); // true => close succeeded
+    // Files opened for reading alone are then served from the cache, which is not owned, so may be shared by several
+    // platforms. Files opened for writing are invalidated in it.
+    void setFileCache(FileCache *fileCache);
+
+    void setConsoleOutputPolicy(ConsoleOutputPolicy policy, int flushIntervalMillis = ConsoleFlushIntervalMillis);
+    void flushConsoleOutput(); // writes any console output being held
 
     // For use by tests...
     void _setStreamBuf(int streamId, std::streambuf *buffer);
@@ -101,11 +126,26 @@ public:
     void _setLastIOOperation(int streamId, InputOutputOperation op);
 
 protected:
+    Stream & validStream(int streamId, const char *operation) noexcept(false);
     bool bDebug;
     std::unique_ptr<Stream> myFiles[MAX_FILES];
     int myNextAvailableFile;
     std::string myFullCommandLine;
     std::string myProgramCommandLine;
+
+private:
+    static bool isCacheable(std::ios_base::openmode mode);
+    FileCache *myFileCache;
+    void drainConsoleStream(int streamId); // call with myConsoleOutputMutex held
+    void flushConsoleOutputPeriodically();
+    void stopConsoleFlusher();
+    ConsoleOutputPolicy myConsoleOutputPolicy;
+    int myConsoleFlushIntervalMillis;
+    // Guards the held console output, and the console entries of myFiles, against the flusher thread.
+    std::mutex myConsoleOutputMutex;
+    std::condition_variable myConsoleFlusherWakeup;
+    bool myConsoleFlusherStopping;
+    std::thread myConsoleFlusher;
 };
 
 #endif // _PLATFORM_H
@@ -70,17 +70,30 @@ POSIXPlatform::~POSIXPlatform() {
 }
 
 bool POSIXPlatform::isConsoleCharAvailable() {
+    struct timeval wait = timeout;
+    return waitForStdin(&wait);
+}
+
+bool POSIXPlatform::waitForConsoleChar(const WORD32 timeoutMillis) {
+    struct timeval wait{};
+    wait.tv_sec = timeoutMillis / 1000;
+    wait.tv_usec = (timeoutMillis % 1000) * 1000;
+    return waitForStdin(&wait);
+}
+
+// On Linux, select leaves what's left of the wait in *wait, so being interrupted doesn't restart the whole wait.
+bool POSIXPlatform::waitForStdin(struct timeval *wait) {
     BYTE8 ready = 0;
     fd_set stdinfdset;
     for (;;) {
         FD_ZERO(&stdinfdset);
         FD_SET(stdinfd, &stdinfdset);
-        int fds = select(stdinfd+1, &stdinfdset, nullptr, nullptr, &timeout);
+        int fds = select(stdinfd+1, &stdinfdset, nullptr, nullptr, wait);
         if (fds == -1) {
             if (errno == EINTR) {
                 continue; // try again
             }
-            logWarnF("isConsoleCharAvailable select failed: %s", strerror(errno));
+            logWarnF("Console select failed: %s", strerror(errno));
             break;
         }
         if (fds == 0) {
@@ -90,7 +103,7 @@ bool POSIXPlatform::isConsoleCharAvailable() {
             ready = 1;
             break;
         }
-        logWarnF("isConsoleCharAvailable select returned %d", fds);
+        logWarnF("Console select returned %d", fds);
         break;
     }
     return ready;
@@ -31,12 +31,14 @@ public:
     ~POSIXPlatform() override;
 
     bool isConsoleCharAvailable() override;
+    bool waitForConsoleChar(WORD32 timeoutMillis) override;
     BYTE8 getConsoleChar() override;
     void putConsoleChar(BYTE8 ch) override;
 
     WORD32 getTimeMillis() override;
     UTCTime getUTCTime() override;
 private:
+    bool waitForStdin(struct timeval *wait);
     // For console keyboard handling
     int stdinfd;
     struct timeval timeout{};
@@ -14,6 +14,7 @@
 //
 //------------------------------------------------------------------------------
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <filesystem.h>
@@ -66,6 +67,10 @@ namespace {
             case REQ_COMMANDARG: return "CommandArg";
 
             case REQ_PUTCHAR: return "PutChar";
+            case REQ_FRAMESIZE: return "FrameSize";
+            case REQ_GETKEYTIMEOUT: return "GetKeyTimeout";
+            case REQ_WRITEDIRECT: return "WriteDirect";
+            case REQ_READDIRECT: return "ReadDirect";
 
             case RES_SUCCESS: return "Success";
             case RES_UNIMPLEMENTED: return "Unimplement";
@@ -112,7 +117,11 @@ namespace {
     }
 }
 
-ProtocolHandler::~ProtocolHandler() = default;
+ProtocolHandler::~ProtocolHandler() {
+    // A frame being handled by the host I/O pool refers to this handler.
+    std::unique_lock<std::mutex> lock(myPollMutex);
+    myPollDone.wait(lock, [this] { return myPollState != POLL_HANDLING || myPollHandled; });
+}
 
 void ProtocolHandler::setDebug(bool newDebug) {
     bDebug = newDebug;
@@ -156,14 +165,7 @@ bool ProtocolHandler::readFrame() {
     if (bDebug) {
         logDebugF("Read frame size word is %04X (%d)", codec.getReadFrameSize(), codec.getReadFrameSize());
     }
-    if (codec.readFrameSizeOutOfRange()) {
-        logWarnF("Read frame size %04X out of range", codec.getReadFrameSize());
-        myBadFrameCount++;
-        return false;
-    }
-    if ((codec.getReadFrameSize() & 0x01) == 0x01) {
-        logWarnF("Read frame size %04X is odd", codec.getReadFrameSize());
-        myBadFrameCount++;
+    if (!frameSizeAcceptable()) {
         return false;
     }
     // Fail if frame size > max frame length.
@@ -184,6 +186,20 @@ bool ProtocolHandler::readFrame() {
     return true;
 }
 
+bool ProtocolHandler::frameSizeAcceptable() {
+    if (codec.readFrameSizeOutOfRange()) {
+        logWarnF("Read frame size %04X out of range", codec.getReadFrameSize());
+        myBadFrameCount++;
+        return false;
+    }
+    if ((codec.getReadFrameSize() & 0x01) == 0x01) {
+        logWarnF("Read frame size %04X is odd", codec.getReadFrameSize());
+        myBadFrameCount++;
+        return false;
+    }
+    return true;
+}
+
 bool ProtocolHandler::requestResponse() {
     BYTE8 tag = codec.myTransactionBuffer[2];
     logDebugF("Read frame tag %02X (%s)", tag, tagToName(tag));
@@ -198,11 +214,14 @@ bool ProtocolHandler::requestResponse() {
             reqClose();
             break;
         }
-        case REQ_READ: {
+        // The block transfers are laid out as, and behave as, reads and writes.
+        case REQ_READ:
+        case REQ_GETBLOCK: {
             reqRead();
             break;
         }
-        case REQ_WRITE: {
+        case REQ_WRITE:
+        case REQ_PUTBLOCK: {
             reqWrite();
             break;
         }
@@ -213,18 +232,22 @@ bool ProtocolHandler::requestResponse() {
             reqPuts();
             break;
         }
-//        case REQ_FLUSH: {
-//            break;
-//        }
-//        case REQ_SEEK: {
-//            break;
-//        }
-//        case REQ_TELL: {
-//            break;
-//        }
-//        case REQ_EOF: {
-//            break;
-//        }
+        case REQ_FLUSH: {
+            reqFlush();
+            break;
+        }
+        case REQ_SEEK: {
+            reqSeek();
+            break;
+        }
+        case REQ_TELL: {
+            reqTell();
+            break;
+        }
+        case REQ_EOF: {
+            reqEOF();
+            break;
+        }
 //        case REQ_FERROR: {
 //            break;
 //        }
@@ -234,12 +257,6 @@ bool ProtocolHandler::requestResponse() {
 //        case REQ_RENAME: {
 //            break;
 //        }
-//        case REQ_GETBLOCK: {
-//            break;
-//        }
-//        case REQ_PUTBLOCK: {
-//            break;
-//        }
 //        case REQ_ISATTY: {
 //            break;
 //        }
@@ -314,6 +331,19 @@ bool ProtocolHandler::requestResponse() {
             reqPutChar();
             break;
         }
+        case REQ_FRAMESIZE: {
+            reqFrameSize();
+            break;
+        }
+        case REQ_GETKEYTIMEOUT: {
+            reqGetKeyTimeout();
+            break;
+        }
+        case REQ_WRITEDIRECT:
+        case REQ_READDIRECT: {
+            reqDirect(tag);
+            break;
+        }
         default: {
             logWarnF("Frame tag %02X (%s) is unknown", tag, tagToName(tag));
             myUnimplementedFrameCount++;
@@ -325,6 +355,14 @@ bool ProtocolHandler::requestResponse() {
 }
 
 bool ProtocolHandler::writeFrame() {
+    if (!prepareWriteFrame()) {
+        return false;
+    }
+    myIOLink.writeBytes(codec.myTransactionBuffer, codec.myWriteFrameIndex);
+    return true;
+}
+
+bool ProtocolHandler::prepareWriteFrame() {
     if (codec.myWriteFrameIndex == 0) {
         logWarn("No write frame has been prepared");
         return false;
@@ -336,10 +374,146 @@ bool ProtocolHandler::writeFrame() {
                 frameSize, frameSize, tag, tagToName(tag));
         hexdump(codec.myTransactionBuffer, codec.myWriteFrameIndex);
     }
-    myIOLink.writeBytes(codec.myTransactionBuffer, codec.myWriteFrameIndex);
     return true;
 }
 
+// The requests that may block on the host's filesystem or console.
+bool ProtocolHandler::isHostIORequest(const BYTE8 tag) {
+    switch (tag) {
+        case REQ_OPEN:
+        case REQ_CLOSE:
+        case REQ_READ:
+        case REQ_WRITE:
+        case REQ_PUTS:
+        case REQ_FLUSH:
+        case REQ_SEEK:
+        case REQ_TELL:
+        case REQ_EOF:
+        case REQ_GETBLOCK:
+        case REQ_PUTBLOCK:
+        case REQ_GETKEY:
+        case REQ_GETKEYTIMEOUT:
+        case REQ_WRITEDIRECT:
+        case REQ_READDIRECT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Each call transfers whatever the link will allow without blocking, and hands any whole frame on to be handled.
+// There is only ever one frame in progress, and its response is written before the next is read, so responses
+// stay in request order however long the host takes. Links that can't be polled block, as for processFrame.
+bool ProtocolHandler::pollFrame() {
+    bool progressed = false;
+    for (;;) {
+        switch (myPollState) {
+            case POLL_READING: {
+                const int frameEnd = (myPollIndex < 2) ? 2 : codec.getReadFrameSize() + 2;
+                if (myPollIndex < frameEnd) {
+                    BYTE8 b;
+                    if (!myIOLink.tryReadByte(b)) {
+                        return progressed;
+                    }
+                    progressed = true;
+                    codec.myTransactionBuffer[myPollIndex++] = b;
+                    if (myPollIndex == 2) {
+                        codec.setReadFrameSize((WORD16) (codec.myTransactionBuffer[0] | (codec.myTransactionBuffer[1] << 8)));
+                        myFrameCount++;
+                        if (bDebug) {
+                            logDebugF("Read frame size word is %04X (%d)", codec.getReadFrameSize(), codec.getReadFrameSize());
+                        }
+                        if (!frameSizeAcceptable()) {
+                            myPollIndex = 0;
+                        }
+                    }
+                    break;
+                }
+                if (bDebug) {
+                    hexdump(codec.myTransactionBuffer, frameEnd);
+                }
+                myPollIndex = 0;
+                const BYTE8 tag = codec.myTransactionBuffer[2];
+                if (myHostIOPool != nullptr && isHostIORequest(tag)) {
+                    myPollState = POLL_HANDLING;
+                    myPollHandled = false;
+                    myHostIOPool->submit([this] {
+                        bool exitFrameReceived = false;
+                        try {
+                            exitFrameReceived = requestResponse();
+                        } catch (const std::exception &e) {
+                            logErrorF("Could not handle frame: %s", e.what());
+                            codec.resetWriteFrame();
+                            codec.put(RES_ERROR);
+                        }
+                        // Notified under the lock, so that the destructor can't return while the task is still here.
+                        std::lock_guard<std::mutex> lock(myPollMutex);
+                        if (myProgressCallback) {
+                            myProgressCallback();
+                        }
+                        myPollExitFrame = exitFrameReceived;
+                        myPollHandled = true;
+                        myPollDone.notify_all();
+                    });
+                    return true;
+                }
+                myPollExitFrame = requestResponse();
+                myPollState = prepareWriteFrame() ? POLL_WRITING : POLL_READING;
+                break;
+            }
+            case POLL_HANDLING: {
+                {
+                    std::lock_guard<std::mutex> lock(myPollMutex);
+                    if (!myPollHandled) {
+                        return progressed;
+                    }
+                }
+                progressed = true;
+                myPollState = prepareWriteFrame() ? POLL_WRITING : POLL_READING;
+                break;
+            }
+            case POLL_WRITING: {
+                if (myPollIndex < codec.myWriteFrameIndex) {
+                    if (!myIOLink.tryWriteByte(codec.myTransactionBuffer[myPollIndex])) {
+                        return progressed;
+                    }
+                    progressed = true;
+                    myPollIndex++;
+                    break;
+                }
+                myPollIndex = 0;
+                myPollState = POLL_READING;
+                if (myPollExitFrame) {
+                    myExitReceived = true;
+                }
+                // One frame at a time, so the caller can see whether it was an exit frame.
+                return true;
+            }
+        }
+    }
+}
+
+bool ProtocolHandler::exitReceived() const {
+    return myExitReceived;
+}
+
+bool ProtocolHandler::isHandlingFrame() const {
+    std::lock_guard<std::mutex> lock(myPollMutex);
+    return myPollState == POLL_HANDLING && !myPollHandled;
+}
+
+void ProtocolHandler::setHostIOPool(HostIOPool *pool) {
+    myHostIOPool = pool;
+}
+
+void ProtocolHandler::setGuestMemory(GuestMemory *guestMemory) {
+    myGuestMemory = guestMemory;
+}
+
+void ProtocolHandler::setProgressCallback(const std::function<void()> &callback) {
+    myProgressCallback = callback;
+}
+
 WORD64 ProtocolHandler::frameCount() const {
     return myFrameCount;
 }
@@ -455,7 +629,12 @@ void ProtocolHandler::reqClose() {
 
 void ProtocolHandler::reqRead() {
     const WORD32 streamId = codec.get32();
-    const WORD16 size = codec.get16();
+    WORD16 size = codec.get16();
+    if (size > codec.getBlockBufferSize()) {
+        // Only this much fits in the response frame; the client sees a short read.
+        logDebugF("Read of %d bytes limited to %d", size, codec.getBlockBufferSize());
+        size = codec.getBlockBufferSize();
+    }
     // TODO if length < 1 nothing happens....
     try {
         logDebugF("Reading %d bytes from stream #%d", size, streamId);
@@ -497,11 +676,12 @@ void ProtocolHandler::reqRead() {
 
 void ProtocolHandler::reqWrite() {
     const WORD32 streamId = codec.get32();
-    const std::string data = codec.getString(); // can be binary, this is fine.. Size limited to WORD16.
+    WORD16 size;
+    // Written straight from the transaction buffer. Can be binary, this is fine.
+    const BYTE8 *data = codec.getBlock(size);
     try {
-        WORD16 size = data.size();
         logDebugF("Writing %d bytes to stream #%d", size, streamId);
-        WORD16 wrote = (size > 0) ? myPlatform.writeStream(streamId, size, (BYTE8 *) data.data()) : 0;
+        WORD16 wrote = (size > 0) ? myPlatform.writeStream(streamId, size, const_cast<BYTE8 *>(data)) : 0;
         logDebugF("Wrote %d bytes to stream #%d", wrote, streamId);
         // TODO if streamId == 1 or 2, flush (test after open done, so we can correctly sense presence/absence of flush call on platform
         codec.put(RES_SUCCESS);
@@ -527,11 +707,11 @@ void ProtocolHandler::reqWrite() {
 
 void ProtocolHandler::reqPuts() {
     const WORD32 streamId = codec.get32();
-    const std::string data = codec.getString(); // can be binary, this is fine.. Size limited to WORD16.
+    WORD16 size;
+    const char *data = codec.getStringView(size); // can be binary, this is fine.. Size limited to WORD16.
     try {
-        WORD16 size = data.size();
         logDebugF("Writing %d bytes to stream #%d", size, streamId);
-        WORD16 wrote = (size > 0) ? myPlatform.writeStream(streamId, size, (BYTE8 *) data.data()) : 0;
+        WORD16 wrote = (size > 0) ? myPlatform.writeStream(streamId, size, (BYTE8 *) data) : 0;
         logDebugF("Wrote %d bytes from request to stream #%d", wrote, streamId);
         // If this is a TEXT stream (on Windows) we can just write \n and Windows will translate it to \r\n.
         // If this is a BINARY stream (on Windows), we'll have to write \r\n to get the right endings.
@@ -575,6 +755,64 @@ void ProtocolHandler::reqPuts() {
     }
 }
 
+void ProtocolHandler::reqFlush() {
+    const WORD32 streamId = codec.get32();
+    try {
+        codec.put(myPlatform.flushStream((int) streamId) ? RES_SUCCESS : RES_ERROR);
+    } catch (const std::range_error &e) {
+        logWarn(e.what());
+        codec.put(RES_BADID);
+    } catch (const std::invalid_argument &e) {
+        logWarn(e.what());
+        codec.put(RES_BADID);
+    }
+}
+
+void ProtocolHandler::reqSeek() {
+    const WORD32 streamId = codec.get32();
+    const SWORD32 offset = (SWORD32) codec.get32();
+    const WORD32 origin = codec.get32();
+    try {
+        codec.put(myPlatform.seekStream((int) streamId, offset, (int) origin) ? RES_SUCCESS : RES_ERROR);
+    } catch (const std::range_error &e) {
+        logWarn(e.what());
+        codec.put(RES_BADID);
+    } catch (const std::invalid_argument &e) {
+        logWarn(e.what());
+        codec.put(RES_BADID);
+    }
+}
+
+void ProtocolHandler::reqTell() {
+    const WORD32 streamId = codec.get32();
+    try {
+        const SWORD32 position = myPlatform.tellStream((int) streamId);
+        codec.put(position == -1 ? RES_ERROR : RES_SUCCESS);
+        codec.put((WORD32) position);
+    } catch (const std::range_error &e) {
+        logWarn(e.what());
+        codec.put(RES_BADID);
+        codec.put((WORD32) 0);
+    } catch (const std::invalid_argument &e) {
+        logWarn(e.what());
+        codec.put(RES_BADID);
+        codec.put((WORD32) 0);
+    }
+}
+
+void ProtocolHandler::reqEOF() {
+    const WORD32 streamId = codec.get32();
+    try {
+        codec.put(myPlatform.isEndOfStream((int) streamId) ? RES_SUCCESS : RES_ERROR);
+    } catch (const std::range_error &e) {
+        logWarn(e.what());
+        codec.put(RES_BADID);
+    } catch (const std::invalid_argument &e) {
+        logWarn(e.what());
+        codec.put(RES_BADID);
+    }
+}
+
 void ProtocolHandler::reqGetKey() {
     const WORD32 streamId = FILE_STDIN;
     const WORD16 size = 1;
@@ -610,6 +848,8 @@ void ProtocolHandler::reqPollKey() {
     const WORD16 size = 1;
     try {
         logDebug("Poll key from stream #1");
+        // A guest polling for a key is probably waiting for a response to something it's written.
+        myPlatform.flushConsoleOutput();
         // TDS 2nd edition says the response is "result key", and if a keystroke
         // is not available, the call returns immediately with a nonzero
         // result... suggests that it always returns two bytes.. but Inmos'
@@ -642,6 +882,7 @@ void ProtocolHandler::reqPollKey() {
 void ProtocolHandler::reqExit() {
     const WORD32 status = codec.get32();
     logDebugF("Exit status received as %08X", status);
+    myPlatform.flushConsoleOutput();
 
     switch (status) {
         case RES_EXIT_SUCCESS:
@@ -660,18 +901,14 @@ void ProtocolHandler::reqExit() {
 void ProtocolHandler::reqCommand() {
     const BYTE8 all = codec.get8();
     logDebugF("Command line 'all' flag is %d", all);
-    std::vector<BYTE8> commandLine;
-    if (all) {
-	    commandLine = myPlatform.getCommandLineAll();
-    } else {
-	    commandLine = myPlatform.getCommandLineForProgram();
+    const std::string &commandLine = all ? myPlatform.getCommandLineAll() : myPlatform.getCommandLineForProgram();
+    WORD16 length = (WORD16) std::min(commandLine.size(), (size_t) codec.getBlockBufferSize());
+    if (length < commandLine.size()) {
+        logWarnF("Command line of %d bytes truncated to %d", (int) commandLine.size(), length);
     }
 
     codec.put(RES_SUCCESS);
-    codec.put((WORD16) commandLine.size());
-    for (auto c: commandLine) {
-	    codec.put((BYTE8) c);
-    }
+    codec.putBlock((const BYTE8 *) commandLine.data(), length);
 }
 
 void ProtocolHandler::reqId() {
@@ -722,3 +959,90 @@ void ProtocolHandler::reqPutChar() {
         codec.put(RES_BADID);
     }
 }
+
+void ProtocolHandler::reqFrameSize() {
+    WORD32 size = codec.get32();
+    // Grant what was asked for, within what the codec can hold; a client that asks for less than the standard size
+    // gets the standard size back.
+    if (size < (WORD32) TransactionBufferSize) {
+        size = TransactionBufferSize;
+    } else if (size > (WORD32) MaxTransactionBufferSize) {
+        size = MaxTransactionBufferSize;
+    }
+    size &= ~(WORD32) 0x01;
+    logDebugF("Transaction buffer size of %d bytes granted", size);
+    // The response is built in the buffer being resized, but it's small enough that this doesn't affect it.
+    codec.setTransactionBufferSize((int) size);
+    codec.put(RES_SUCCESS);
+    codec.put(size);
+}
+
+void ProtocolHandler::reqGetKeyTimeout() {
+    const WORD32 timeoutMillis = codec.get32();
+    logDebugF("Get key with a timeout of %d ms", timeoutMillis);
+    myPlatform.flushConsoleOutput();
+    if (myPlatform.waitForConsoleChar(timeoutMillis)) {
+        codec.put(RES_SUCCESS);
+        unsigned char consoleChar = myPlatform.getConsoleChar();
+        logDebugF("Read console char 0x%x", consoleChar);
+        codec.put(consoleChar);
+    } else {
+        logDebug("No console char available within the timeout");
+        codec.put(RES_ERROR);
+    }
+}
+
+// The stream is read or written straight from the guest's buffer, in as many calls as the platform's WORD16 sizes need.
+void ProtocolHandler::reqDirect(const BYTE8 tag) {
+    const WORD32 streamId = codec.get32();
+    const WORD32 address = codec.get32();
+    const WORD32 length = codec.get32();
+    if (myGuestMemory == nullptr) {
+        logWarnF("Frame tag %02X (%s) needs direct access to the guest's memory", tag, tagToName(tag));
+        myUnimplementedFrameCount++;
+        codec.put(RES_UNIMPLEMENTED);
+        codec.put((WORD32) 0);
+        return;
+    }
+    const bool reading = tag == REQ_READDIRECT;
+    BYTE8 *buffer = myGuestMemory->map(address, length, reading);
+    if (buffer == nullptr) {
+        logWarnF("Guest buffer of %u bytes at #%08X is not %s memory", length, address, reading ? "writable" : "readable");
+        codec.put(RES_ERROR);
+        codec.put((WORD32) 0);
+        return;
+    }
+    WORD32 transferred = 0;
+    try {
+        logDebugF("%s %u bytes %s guest memory at #%08X %s stream #%d", reading ? "Reading" : "Writing", length,
+                  reading ? "into" : "from", address, reading ? "from" : "to", streamId);
+        while (transferred < length) {
+            const WORD16 size = (WORD16) std::min<WORD32>(length - transferred, 0xFFFF);
+            const WORD16 done = reading ? myPlatform.readStream(streamId, size, buffer + transferred)
+                                        : myPlatform.writeStream(streamId, size, buffer + transferred);
+            transferred += done;
+            if (done != size) {
+                break;
+            }
+        }
+        logDebugF("%s %u bytes", reading ? "Read" : "Wrote", transferred);
+        codec.put(RES_SUCCESS);
+        codec.put(transferred);
+    } catch (const std::range_error &e) {
+        logWarn(e.what());
+        codec.put(RES_BADID);
+        codec.put((WORD32) 0);
+    } catch (const std::runtime_error &e) { // File must be open for reading or writing
+        logWarn(e.what());
+        codec.put(RES_BADID);
+        codec.put((WORD32) 0);
+    } catch (const std::domain_error &e) { // Last op must be the same
+        logWarn(e.what());
+        codec.put(RES_NOPOSN);
+        codec.put((WORD32) 0);
+    } catch (const std::invalid_argument &e) {
+        logWarn(e.what());
+        codec.put(RES_BADID);
+        codec.put((WORD32) 0);
+    }
+}
@@ -17,18 +17,24 @@
 #ifndef _PROTOCOL_HANDLER_H
 #define _PROTOCOL_HANDLER_H
 
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <string>
 #include "types.h"
 #include "link.h"
 #include "platform.h"
 #include "framecodec.h"
+#include "hostiopool.h"
+#include "guestmemory.h"
 
 class ProtocolHandler {
 public:
     ProtocolHandler(Link & ioLink, Platform & platform, const std::string &rootDirectory):
         myIOLink(ioLink), myPlatform(platform), myRootDirectory(rootDirectory), bDebug(false),
         myFrameCount(0L), myBadFrameCount(0L), myUnimplementedFrameCount(0L),
-        myExitCode(0) {};
+        myExitCode(0), myHostIOPool(nullptr), myGuestMemory(nullptr), myPollState(POLL_READING), myPollIndex(0), myPollHandled(false),
+        myPollExitFrame(false), myExitReceived(false) {};
     ~ProtocolHandler();
     void setDebug(bool newDebug);
 
@@ -36,6 +42,17 @@ public:
     // Return true if the frame is an exit frame; false otherwise.
     bool processFrame();
 
+    // Polled operation, for a thread that serves several links, or that also runs the CPU: transfers what it can
+    // without blocking, returning true if it made any progress. With a host I/O pool, requests that may block on the
+    // host are handled on the pool, and the progress callback is called when one completes.
+    bool pollFrame();
+    bool exitReceived() const; // true once pollFrame has responded to an exit frame
+    bool isHandlingFrame() const; // true while a frame is being handled on the host I/O pool
+    void setHostIOPool(HostIOPool *pool);
+    void setProgressCallback(const std::function<void()> &callback);
+    // For a guest emulated in-process, which may then use the WriteDirect and ReadDirect requests.
+    void setGuestMemory(GuestMemory *guestMemory);
+
     WORD64 frameCount() const;
     WORD64 badFrameCount() const;
     WORD64 unimplementedFrameCount() const;
@@ -50,15 +67,37 @@ private:
     WORD64 myBadFrameCount;
     WORD64 myUnimplementedFrameCount;
     bool readFrame();
+    bool frameSizeAcceptable();
     bool requestResponse();
     bool writeFrame();
+    bool prepareWriteFrame();
+    static bool isHostIORequest(BYTE8 tag);
     int myExitCode;
+    // Polled operation
+    enum PollState { POLL_READING, POLL_HANDLING, POLL_WRITING };
+    HostIOPool *myHostIOPool;
+    GuestMemory *myGuestMemory;
+    std::function<void()> myProgressCallback;
+    PollState myPollState;
+    int myPollIndex; // bytes of the frame read or written so far
+    // Guard the result of a frame being handled by the pool, and signal it's there. The task holds the mutex while
+    // it calls the progress callback and publishes the result, so once the handler sees the result, the task no
+    // longer refers to it.
+    mutable std::mutex myPollMutex;
+    std::condition_variable myPollDone;
+    bool myPollHandled;
+    bool myPollExitFrame;
+    bool myExitReceived;
     // Frame handling routines
     void reqOpen();
     void reqClose();
     void reqRead();
     void reqWrite();
     void reqPuts();
+    void reqFlush();
+    void reqSeek();
+    void reqTell();
+    void reqEOF();
     void reqGetKey();
     void reqPollKey();
     void reqExit();
@@ -67,6 +106,9 @@ private:
 
     // Extended frame handling routines
     void reqPutChar();
+    void reqFrameSize();
+    void reqGetKeyTimeout();
+    void reqDirect(BYTE8 tag);
 };
 
 #endif // _PROTOCOL_HANDLER_H
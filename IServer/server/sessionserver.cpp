@@ -0,0 +1,152 @@
+//------------------------------------------------------------------------------
+//
+// File        : sessionserver.cpp
+// Description : Serves the IServer protocol over many links at once, each
+//               session having its own platform and root directory, from one
+//               event loop.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include "sessionserver.h"
+#include "log.h"
+
+const int SessionServer::PollIntervalMillis;
+
+SessionServer::SessionServer(const int hostIOThreads): bDebug(false), myWoken(false), myStopping(false),
+    myHostIOPool(hostIOThreads), myActiveSessions(0) {
+}
+
+SessionServer::~SessionServer() {
+    // In reverse, as each platform restores the console settings it found when it was initialised.
+    for (auto it = mySessions.rbegin(); it != mySessions.rend(); ++it) {
+        Session *session = *it;
+        session->link.setProgressCallback(nullptr);
+        const Platform *platform = session->platform;
+        delete session; // waits for any frame being handled on the pool
+        delete platform;
+    }
+}
+
+void SessionServer::setDebug(const bool newDebug) {
+    bDebug = newDebug;
+    for (Session *session: mySessions) {
+        session->handler.setDebug(newDebug);
+    }
+}
+
+int SessionServer::addSession(Link &link, Platform *platform, const std::string &rootDirectory,
+                              GuestMemory *guestMemory) {
+    if (!link.canPoll()) {
+        delete platform;
+        throw std::invalid_argument("A session's link must be able to poll");
+    }
+    auto *session = new Session(link, platform, rootDirectory);
+    session->handler.setDebug(bDebug);
+    session->handler.setHostIOPool(&myHostIOPool);
+    session->handler.setGuestMemory(guestMemory);
+    session->handler.setProgressCallback([this] { wake(); });
+    link.setProgressCallback([this] { wake(); });
+    mySessions.push_back(session);
+    myActiveSessions++;
+    logDebugF("Added session %d serving root directory '%s'", (int) mySessions.size() - 1, rootDirectory.c_str());
+    return (int) mySessions.size() - 1;
+}
+
+void SessionServer::setFinishedCallback(const std::function<void(int)> &callback) {
+    myFinishedCallback = callback;
+}
+
+void SessionServer::run() {
+    logInfoF("Serving %d session(s)", myActiveSessions);
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(myMutex);
+            if (myStopping || myActiveSessions == 0) {
+                break;
+            }
+            // Anything that happens from here on, while polling, will be seen by the wait below.
+            myWoken = false;
+        }
+        bool progressed = false;
+        for (int i = 0; i < (int) mySessions.size(); i++) {
+            if (!mySessions[i]->finished && pollSession(i)) {
+                progressed = true;
+            }
+        }
+        if (!progressed) {
+            std::unique_lock<std::mutex> lock(myMutex);
+            myWakeup.wait_for(lock, std::chrono::milliseconds(PollIntervalMillis),
+                              [this] { return myWoken || myStopping; });
+        }
+    }
+    logInfoF("Stopped serving, with %d session(s) still active", myActiveSessions);
+}
+
+void SessionServer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        myStopping = true;
+    }
+    myWakeup.notify_all();
+}
+
+// Returns true if the session made progress.
+bool SessionServer::pollSession(const int session) {
+    Session *s = mySessions[session];
+    try {
+        const bool progressed = s->handler.pollFrame();
+        if (s->handler.exitReceived()) {
+            logInfoF("Session %d exited with code %d after %llu frame(s)", session, s->handler.exitCode(),
+                     (unsigned long long) s->handler.frameCount());
+            finishSession(session, s->handler.exitCode());
+        }
+        return progressed;
+    } catch (const std::exception &e) {
+        logErrorF("Session %d failed: %s", session, e.what());
+        finishSession(session, 1);
+        return true;
+    }
+}
+
+void SessionServer::finishSession(const int session, const int exitCode) {
+    Session *s = mySessions[session];
+    s->exitCode = exitCode;
+    s->finished = true;
+    myActiveSessions--;
+    if (myFinishedCallback) {
+        myFinishedCallback(session);
+    }
+}
+
+void SessionServer::wake() {
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        myWoken = true;
+    }
+    myWakeup.notify_all();
+}
+
+int SessionServer::sessions() const {
+    return (int) mySessions.size();
+}
+
+bool SessionServer::sessionFinished(const int session) const {
+    return mySessions.at(session)->finished;
+}
+
+int SessionServer::exitCode(const int session) const {
+    return mySessions.at(session)->exitCode;
+}
+
+WORD64 SessionServer::frameCount(const int session) const {
+    return mySessions.at(session)->handler.frameCount();
+}
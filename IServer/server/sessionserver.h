@@ -0,0 +1,93 @@
+//------------------------------------------------------------------------------
+//
+// File        : sessionserver.h
+// Description : Serves the IServer protocol over many links at once, each
+//               session having its own platform and root directory, from one
+//               event loop.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#ifndef _SESSIONSERVER_H
+#define _SESSIONSERVER_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "link.h"
+#include "platform.h"
+#include "protocolhandler.h"
+#include "hostiopool.h"
+#include "guestmemory.h"
+
+// Each session is a link to one emulated board's root node, with its own platform (so its own file table) and root
+// directory. The sessions are polled in turn on the thread calling run(), which sleeps when none can progress until
+// one of their links, or the host I/O pool they share, has something for it.
+class SessionServer {
+public:
+    // How long the event loop sleeps, if nothing wakes it, before polling all the sessions again.
+    static const int PollIntervalMillis = 100;
+
+    explicit SessionServer(int hostIOThreads);
+    ~SessionServer();
+    SessionServer(const SessionServer &) = delete;
+    SessionServer & operator=(const SessionServer &) = delete;
+    void setDebug(bool newDebug);
+
+    // The link must be able to poll, and outlive the server. The server takes ownership of the platform, which must
+    // have been initialised. Any guest memory (of a board emulated in-process) must outlive the server too. Returns
+    // the session's number, counting from 0. Sessions must all be added before run().
+    int addSession(Link &link, Platform *platform, const std::string &rootDirectory,
+                   GuestMemory *guestMemory = nullptr);
+    // Called on the thread calling run(), with the session's number, as each session receives an exit frame or fails,
+    // e.g. to stop the board it was serving.
+    void setFinishedCallback(const std::function<void(int)> &callback);
+
+    // Serve all the sessions until each has received an exit frame, or failed, or stop() is called.
+    void run();
+    // May be called from any thread.
+    void stop();
+
+    int sessions() const;
+    bool sessionFinished(int session) const;
+    // The exit code the session's program gave, or 1 if its link failed.
+    int exitCode(int session) const;
+    WORD64 frameCount(int session) const;
+
+private:
+    struct Session {
+        Session(Link &link, Platform *platform, const std::string &rootDirectory):
+            link(link), platform(platform), rootDirectory(rootDirectory), handler(link, *platform, this->rootDirectory),
+            finished(false), exitCode(0) {};
+        Link &link;
+        Platform *platform;
+        const std::string rootDirectory; // the handler holds a reference to this
+        ProtocolHandler handler;
+        bool finished;
+        int exitCode;
+    };
+    bool pollSession(int session);
+    void finishSession(int session, int exitCode);
+    void wake();
+    bool bDebug;
+    // Declared before the pool, so that they outlive its threads, which wake() the server as they finish tasks.
+    std::mutex myMutex;
+    std::condition_variable myWakeup;
+    bool myWoken;
+    bool myStopping;
+    // Declared before the sessions, so that it outlives their handlers, which wait for its tasks to finish.
+    HostIOPool myHostIOPool;
+    std::vector<Session *> mySessions;
+    int myActiveSessions;
+    std::function<void(int)> myFinishedCallback;
+};
+
+#endif // _SESSIONSERVER_H
@@ -0,0 +1,144 @@
+//------------------------------------------------------------------------------
+//
+// File        : testfilecache.cpp
+// Description : Tests for the cache of read-only files' contents.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <string>
+
+#include "platformdetection.h"
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+#include <sys/stat.h>
+#endif
+
+#include "log.h"
+#include "filecache.h"
+
+#include "gtest/gtest.h"
+#include "tempfilesfixture.h"
+
+class TestFileCache : public TestTempFiles, public ::testing::Test {
+protected:
+    void SetUp() override {
+        setLogLevel(LOGLEVEL_DEBUG);
+    }
+
+    void TearDown() override {
+        removeTempFiles();
+    }
+
+    static std::string asString(const std::shared_ptr<const std::vector<BYTE8>> &contents) {
+        return std::string(contents->begin(), contents->end());
+    }
+};
+
+TEST_F(TestFileCache, FirstReadMissesThenHits)
+{
+    const std::string path = createRandomTempFile("contents");
+    FileCache cache(100);
+    EXPECT_EQ(asString(cache.contents(path)), "contents");
+    EXPECT_EQ(asString(cache.contents(path)), "contents");
+    EXPECT_EQ(cache.misses(), 1);
+    EXPECT_EQ(cache.hits(), 1);
+    EXPECT_EQ(cache.cachedFiles(), 1);
+    EXPECT_EQ(cache.cachedBytes(), 8);
+}
+
+TEST_F(TestFileCache, FileChangedOnTheHostIsReadAgain)
+{
+    const std::string path = createRandomTempFile("before");
+    FileCache cache(100);
+    EXPECT_EQ(asString(cache.contents(path)), "before");
+    createTempFile(path, "and after");
+    EXPECT_EQ(asString(cache.contents(path)), "and after");
+    EXPECT_EQ(cache.misses(), 2);
+    EXPECT_EQ(cache.hits(), 0);
+    EXPECT_EQ(cache.cachedBytes(), 9);
+}
+
+TEST_F(TestFileCache, InvalidatedFileIsReadAgain)
+{
+    const std::string path = createRandomTempFile("contents");
+    FileCache cache(100);
+    cache.contents(path);
+    cache.invalidate(path);
+    EXPECT_EQ(cache.cachedFiles(), 0);
+    EXPECT_EQ(cache.cachedBytes(), 0);
+    cache.contents(path);
+    EXPECT_EQ(cache.misses(), 2);
+}
+
+TEST_F(TestFileCache, LeastRecentlyUsedFileIsEvicted)
+{
+    const std::string first = createRandomTempFile("1111");
+    const std::string second = createRandomTempFile("2222");
+    const std::string third = createRandomTempFile("3333");
+    FileCache cache(8);
+    cache.contents(first);
+    cache.contents(second);
+    cache.contents(first); // so second is the least recently used
+    cache.contents(third);
+    EXPECT_EQ(cache.evictions(), 1);
+    EXPECT_EQ(cache.cachedFiles(), 2);
+    EXPECT_EQ(cache.cachedBytes(), 8);
+    cache.contents(first);
+    cache.contents(third);
+    EXPECT_EQ(cache.hits(), 3);
+    cache.contents(second);
+    EXPECT_EQ(cache.misses(), 4);
+}
+
+TEST_F(TestFileCache, EvictedContentsLiveOnWhileInUse)
+{
+    const std::string first = createRandomTempFile("1111");
+    const std::string second = createRandomTempFile("2222");
+    FileCache cache(4);
+    const std::shared_ptr<const std::vector<BYTE8>> contents = cache.contents(first);
+    cache.contents(second);
+    EXPECT_EQ(cache.evictions(), 1);
+    EXPECT_EQ(asString(contents), "1111");
+}
+
+TEST_F(TestFileCache, FileLargerThanTheCapacityIsNotRead)
+{
+    const std::string path = createRandomTempFile("too large");
+    FileCache cache(4);
+    EXPECT_EQ(cache.contents(path), nullptr);
+    EXPECT_EQ(cache.cachedFiles(), 0);
+    EXPECT_EQ(cache.misses(), 0);
+}
+
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+TEST_F(TestFileCache, FifoIsNotRead)
+{
+    // Reading a FIFO with no writer would block; it isn't even opened.
+    const std::string path = createRandomTempFilePath();
+    ASSERT_EQ(mkfifo(path.c_str(), 0600), 0);
+    FileCache cache(100);
+    EXPECT_EQ(cache.contents(path), nullptr);
+    EXPECT_EQ(cache.misses(), 0);
+}
+#endif
+
+TEST_F(TestFileCache, EmptyFileIsCached)
+{
+    const std::string path = createRandomTempFile("");
+    FileCache cache(4);
+    EXPECT_TRUE(cache.contents(path)->empty());
+    EXPECT_TRUE(cache.contents(path)->empty());
+    EXPECT_EQ(cache.hits(), 1);
+}
+
+TEST_F(TestFileCache, MissingFileIsNotCached)
+{
+    FileCache cache(100);
+    EXPECT_EQ(cache.contents(createRandomTempFilePath()), nullptr);
+    EXPECT_EQ(cache.misses(), 0);
+}
@@ -155,6 +155,7 @@ TEST_F(TestFrameCodec, GetMultipleStrings) {
 TEST_F(TestFrameCodec, FrameSizeInvariants) {
     EXPECT_EQ(512, TransactionBufferSize);
     EXPECT_EQ(508, StringBufferSize);
+    EXPECT_EQ(507, BlockBufferSize);
 }
 
 TEST_F(TestFrameCodec, GetMaxLengthString) {
@@ -181,6 +182,113 @@ TEST_F(TestFrameCodec, GetStringTooLong) {
     EXPECT_THROW(codec.getString(), std::range_error);
 }
 
+TEST_F(TestFrameCodec, GetStringViewIsAViewOfTheFrame) {
+    codec.put((WORD16) 6); // Frame Size
+    codec.put((WORD16) 3); // String Size
+    codec.put((BYTE8) 'A');
+    codec.put((BYTE8) 'B');
+    codec.put((BYTE8) 'C');
+    codec.put((BYTE8) 0); // pad
+    codec.setReadFrameSize(codec.get16());
+
+    WORD16 length = 0;
+    const char *str = codec.getStringView(length);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ((const BYTE8 *) str, codec.myTransactionBuffer + 4);
+    EXPECT_EQ(std::string(str, length), "ABC");
+    EXPECT_EQ(codec.myReadFrameIndex, 7);
+}
+
+TEST_F(TestFrameCodec, GetStringViewBeyondTransactionBuffer) {
+    codec.put((WORD16) 510); // Frame Size
+    codec.put((WORD16) 0); // pad, so the string starts further in
+    codec.put((WORD16) StringBufferSize); // String Size, within the maximum, but running off the end of the buffer
+    codec.get16();
+    codec.get16();
+
+    WORD16 length = 0;
+    EXPECT_THROW(codec.getStringView(length), std::range_error);
+}
+
+TEST_F(TestFrameCodec, GetBlockIsAViewOfTheFrame) {
+    codec.put((WORD16) 6); // Frame Size
+    codec.put((WORD16) 3); // Block Size
+    codec.put((BYTE8) 'A');
+    codec.put((BYTE8) 'B');
+    codec.put((BYTE8) 'C');
+    codec.put((BYTE8) 0); // pad
+    codec.setReadFrameSize(codec.get16());
+
+    WORD16 length = 0;
+    const BYTE8 *block = codec.getBlock(length);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(block, codec.myTransactionBuffer + 4);
+    EXPECT_EQ(block[0], 'A');
+    EXPECT_EQ(block[2], 'C');
+    EXPECT_EQ(codec.myReadFrameIndex, 7);
+}
+
+TEST_F(TestFrameCodec, GetBlockBeyondTransactionBuffer) {
+    codec.put((WORD16) 510); // Frame Size
+    codec.put((WORD16) (TransactionBufferSize - 3)); // Block Size, one more than the rest of the buffer
+    codec.setReadFrameSize(codec.get16());
+
+    WORD16 length = 0;
+    EXPECT_THROW(codec.getBlock(length), std::range_error);
+}
+
+TEST_F(TestFrameCodec, StandardTransactionBufferSizeByDefault) {
+    EXPECT_EQ(codec.getTransactionBufferSize(), TransactionBufferSize);
+    EXPECT_EQ(codec.getStringBufferSize(), StringBufferSize);
+    EXPECT_EQ(codec.getBlockBufferSize(), BlockBufferSize);
+}
+
+TEST_F(TestFrameCodec, LargerTransactionBufferSize) {
+    codec.setTransactionBufferSize(4096);
+    EXPECT_EQ(codec.getTransactionBufferSize(), 4096);
+    EXPECT_EQ(codec.getStringBufferSize(), 4092);
+    EXPECT_EQ(codec.getBlockBufferSize(), 4091);
+
+    codec.put((WORD16) 4094); // Frame Size
+    codec.put((WORD16) 4092); // Max String Size
+    for (int i = 0; i < 4092; i++) {
+        codec.put((BYTE8) 'A');
+    }
+    codec.setReadFrameSize(codec.get16());
+    EXPECT_EQ(codec.getString().size(), 4092);
+}
+
+TEST_F(TestFrameCodec, ResizingPreservesTheBuffer) {
+    codec.put((WORD32) 0xAB03C9AF);
+    codec.setTransactionBufferSize(MaxTransactionBufferSize);
+    EXPECT_EQ(codec.get32(), 0xAB03C9AF);
+    codec.setTransactionBufferSize(TransactionBufferSize);
+    EXPECT_EQ(codec.myTransactionBuffer[0], (BYTE8)0xAF);
+}
+
+TEST_F(TestFrameCodec, TransactionBufferSizeOutOfRange) {
+    EXPECT_THROW(codec.setTransactionBufferSize(TransactionBufferSize - 2), std::range_error);
+    EXPECT_THROW(codec.setTransactionBufferSize(MaxTransactionBufferSize + 2), std::range_error);
+    EXPECT_THROW(codec.setTransactionBufferSize(1025), std::range_error);
+    EXPECT_EQ(codec.getTransactionBufferSize(), TransactionBufferSize);
+}
+
+TEST_F(TestFrameCodec, ReadFrameSizeOutOfRangeHonoursTransactionBufferSize) {
+    codec.setReadFrameSize(4);
+    EXPECT_TRUE(codec.readFrameSizeOutOfRange());
+    codec.setReadFrameSize(510);
+    EXPECT_FALSE(codec.readFrameSizeOutOfRange());
+    codec.setReadFrameSize(512);
+    EXPECT_TRUE(codec.readFrameSizeOutOfRange());
+
+    codec.setTransactionBufferSize(1024);
+    EXPECT_FALSE(codec.readFrameSizeOutOfRange());
+    codec.setReadFrameSize(1022);
+    EXPECT_FALSE(codec.readFrameSizeOutOfRange());
+    codec.setReadFrameSize(1024);
+    EXPECT_TRUE(codec.readFrameSizeOutOfRange());
+}
+
 // FRAME HANDLING
 
 TEST_F(TestFrameCodec, ResetWriteFrame) {
@@ -210,6 +318,17 @@ TEST_F(TestFrameCodec, Advance) {
     EXPECT_EQ(codec.myTransactionBuffer[9], (BYTE8)0x99);
 }
 
+TEST_F(TestFrameCodec, PutBlock) {
+    codec.resetWriteFrame();
+    const BYTE8 block[] = {'A', 'B', 'C'};
+    codec.putBlock(block, 3);
+    EXPECT_EQ(codec.myWriteFrameIndex, 7);
+    EXPECT_EQ(codec.myTransactionBuffer[2], (BYTE8)0x03);
+    EXPECT_EQ(codec.myTransactionBuffer[3], (BYTE8)0x00);
+    EXPECT_EQ(codec.myTransactionBuffer[4], 'A');
+    EXPECT_EQ(codec.myTransactionBuffer[6], 'C');
+}
+
 TEST_F(TestFrameCodec, FillInFrameSize) {
     // Initial size
     EXPECT_EQ(codec.myTransactionBuffer[0], (BYTE8)0x00);
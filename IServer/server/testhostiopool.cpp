@@ -0,0 +1,62 @@
+//------------------------------------------------------------------------------
+//
+// File        : testhostiopool.cpp
+// Description : Tests for the host I/O thread pool.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+
+#include "log.h"
+#include "hostiopool.h"
+#include "gtest/gtest.h"
+
+class TestHostIOPool : public ::testing::Test {
+protected:
+    void SetUp() override {
+        setLogLevel(LOGLEVEL_DEBUG);
+    }
+};
+
+TEST_F(TestHostIOPool, RunsEverythingSubmittedBeforeStopping)
+{
+    std::atomic<int> run(0);
+    {
+        HostIOPool pool(2);
+        EXPECT_EQ(pool.threads(), 2);
+        for (int i = 0; i < 100; i++) {
+            pool.submit([&run] { run++; });
+        }
+    }
+    EXPECT_EQ(run, 100);
+}
+
+TEST_F(TestHostIOPool, SlowTaskDoesNotHoldUpOthers)
+{
+    HostIOPool pool(2);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> quick;
+    pool.submit([released] { released.wait(); });
+    pool.submit([&quick] { quick.set_value(); });
+    EXPECT_EQ(quick.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    release.set_value();
+}
+
+TEST_F(TestHostIOPool, FailingTaskDoesNotStopThePool)
+{
+    HostIOPool pool(1);
+    std::promise<void> after;
+    pool.submit([] { throw std::runtime_error("failed"); });
+    pool.submit([&after] { after.set_value(); });
+    EXPECT_EQ(after.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+}
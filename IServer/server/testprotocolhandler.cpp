@@ -11,7 +11,10 @@
 //
 //------------------------------------------------------------------------------
 
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <thread>
 
 #include <hexdump.h>
 #include "log.h"
@@ -45,8 +48,8 @@ public:
     UTCTime getUTCTime() override;
     void setUTCTime(UTCTime utcTime); // for tests
 
-    std::vector<BYTE8> getCommandLineAll();
-    std::vector<BYTE8> getCommandLineForProgram();
+    const std::string & getCommandLineAll();
+    const std::string & getCommandLineForProgram();
     void setCommandLine(std::string text); // for tests
 private:
     std::vector<BYTE8> myKeyboardChars;
@@ -91,6 +94,21 @@ void StubPlatform::setUTCTime(const UTCTime utcTime) {
     myUTCTime = utcTime;
 }
 
+// Guest memory of a given size at a given address.
+class StubGuestMemory final : public GuestMemory {
+public:
+    StubGuestMemory(const WORD32 base, const WORD32 size): myBase(base), myBytes(size) {}
+    BYTE8 *map(const WORD32 address, const WORD32 length, bool forWriting) override {
+        if (address < myBase || address - myBase + (WORD64) length > myBytes.size()) {
+            return nullptr;
+        }
+        return myBytes.data() + (address - myBase);
+    }
+    std::vector<BYTE8> &bytes() { return myBytes; } // for tests
+private:
+    WORD32 myBase;
+    std::vector<BYTE8> myBytes;
+};
 
 class TestProtocolHandler : public TestTempFiles, public ::testing::Test {
 protected:
@@ -223,7 +241,7 @@ protected:
               (frame[offset+1] << 8);
     }
 
-    WORD16 get32(const std::vector<BYTE8> & frame, const int offset) {
+    WORD32 get32(const std::vector<BYTE8> & frame, const int offset) {
         // Always output as a little-endian word, LSB first MSB last
         return frame[offset] +
               (frame[offset+1] << 8) +
@@ -240,6 +258,80 @@ protected:
         return streamId;
     }
 
+    // Open a binary file in the root directory, returning its stream Id
+    WORD32 openBinaryFile(const std::string &testFileName, const BYTE8 openMode) {
+        std::vector<BYTE8> openFrame = {REQ_OPEN};
+        appendString(openFrame, testFileName);
+        append8(openFrame, REQ_OPEN_TYPE_BINARY);
+        append8(openFrame, openMode);
+        padAndSendFrame(openFrame);
+        return getStreamId();
+    }
+
+    // Send a frame of a tag and stream id, returning the response's tag
+    BYTE8 sendStreamFrame(const BYTE8 tag, const WORD32 streamId) {
+        std::vector<BYTE8> frame = {tag};
+        append32(frame, streamId);
+        padAndSendFrame(frame);
+        return get8(readResponseFrame(), 2);
+    }
+
+    BYTE8 seek(const WORD32 streamId, const SWORD32 offset, const WORD32 origin) {
+        std::vector<BYTE8> seekFrame = {REQ_SEEK};
+        append32(seekFrame, streamId);
+        append32(seekFrame, (WORD32) offset);
+        append32(seekFrame, origin);
+        padAndSendFrame(seekFrame);
+        std::vector<BYTE8> seekResponse = readResponseFrame();
+        checkResponseFrameSize(seekResponse, 2); // result + 0-pad
+        return get8(seekResponse, 2);
+    }
+
+    WORD32 tell(const WORD32 streamId) {
+        std::vector<BYTE8> tellFrame = {REQ_TELL};
+        append32(tellFrame, streamId);
+        padAndSendFrame(tellFrame);
+        std::vector<BYTE8> tellResponse = readResponseFrame();
+        checkResponseFrameTag(tellResponse, RES_SUCCESS);
+        checkResponseFrameSize(tellResponse, 6); // RES_SUCCESS + position + 0-pad
+        return get32(tellResponse, 3);
+    }
+
+    std::string read(const BYTE8 tag, const WORD32 streamId, const WORD16 size) {
+        std::vector<BYTE8> readFrame = {tag};
+        append32(readFrame, streamId);
+        append16(readFrame, size);
+        padAndSendFrame(readFrame);
+        std::vector<BYTE8> readResponse = readResponseFrame();
+        checkResponseFrameTag(readResponse, RES_SUCCESS);
+        const WORD16 count = get16(readResponse, 3);
+        return std::string(readResponse.begin() + 5, readResponse.begin() + 5 + count);
+    }
+
+    // Poll the handler until it has written a response, returning it
+    std::vector<BYTE8> pollForResponseFrame() {
+        for (int i = 0; i < 5000; i++) {
+            handler->pollFrame();
+            std::vector<BYTE8> response = readResponseFrame();
+            if (!response.empty()) {
+                return response;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return std::vector<BYTE8>();
+    }
+
+    // Negotiate the maximum frame length, returning the length granted
+    WORD32 negotiateFrameSize(const WORD32 size) {
+        std::vector<BYTE8> frameSizeFrame = {REQ_FRAMESIZE};
+        append32(frameSizeFrame, size);
+        padAndSendFrame(frameSizeFrame);
+        std::vector<BYTE8> frameSizeResponse = readResponseFrame();
+        checkResponseFrameTag(frameSizeResponse, RES_SUCCESS);
+        checkResponseFrameSize(frameSizeResponse, 6); // RES_SUCCESS + length + 0-pad
+        return get32(frameSizeResponse, 3);
+    }
+
     // Common test code for testing \n translation in 'open text for output' tests
     std::string openTextOutputTranslation(const std::string& writtenString, const unsigned short expectedWrittenBytes) {
         std::string testFileName = createRandomTempFileName();
@@ -1418,14 +1510,136 @@ TEST_F(TestProtocolHandler, PutsZero)
 }
 
 // REQ_FLUSH
+TEST_F(TestProtocolHandler, FlushUnopenFileIsUnsuccessful)
+{
+    EXPECT_EQ(sendStreamFrame(REQ_FLUSH, 5), RES_BADID);
+}
+
+TEST_F(TestProtocolHandler, FlushWritesToRealFile)
+{
+    const std::pair<std::string, std::string> &testFilePathAndName = createRandomTempFilePathContaining();
+    const WORD32 streamId = openBinaryFile(testFilePathAndName.second, REQ_OPEN_MODE_OUTPUT);
+
+    std::vector<BYTE8> writeFrame = {REQ_WRITE};
+    append32(writeFrame, streamId);
+    appendString(writeFrame, "ABCD");
+    padAndSendFrame(writeFrame);
+    checkResponseFrameTag(readResponseFrame(), RES_SUCCESS);
+
+    EXPECT_EQ(sendStreamFrame(REQ_FLUSH, streamId), RES_SUCCESS);
+    // Still open.
+    EXPECT_EQ(readFileContents(testFilePathAndName.first), "ABCD");
+}
+
 // REQ_SEEK
 // REQ_TELL
+TEST_F(TestProtocolHandler, SeekAndTellInRealFile)
+{
+    const std::pair<std::string, std::string> &testFilePathAndName = createRandomTempFilePathContaining("ABCDEF");
+    const WORD32 streamId = openBinaryFile(testFilePathAndName.second, REQ_OPEN_MODE_INPUT);
+
+    EXPECT_EQ(tell(streamId), 0);
+    EXPECT_EQ(seek(streamId, 2, REQ_SEEK_SET), RES_SUCCESS);
+    EXPECT_EQ(tell(streamId), 2);
+    EXPECT_EQ(read(REQ_READ, streamId, 2), "CD");
+    EXPECT_EQ(tell(streamId), 4);
+    EXPECT_EQ(seek(streamId, -3, REQ_SEEK_CUR), RES_SUCCESS);
+    EXPECT_EQ(read(REQ_READ, streamId, 1), "B");
+    EXPECT_EQ(seek(streamId, -1, REQ_SEEK_END), RES_SUCCESS);
+    EXPECT_EQ(read(REQ_READ, streamId, 1), "F");
+}
+
+TEST_F(TestProtocolHandler, SeekAllowsReadAfterWrite)
+{
+    const std::pair<std::string, std::string> &testFilePathAndName = createRandomTempFilePathContaining();
+    const WORD32 streamId = openBinaryFile(testFilePathAndName.second, REQ_OPEN_MODE_NEW_UPDATE);
+
+    std::vector<BYTE8> writeFrame = {REQ_PUTBLOCK};
+    append32(writeFrame, streamId);
+    appendString(writeFrame, "ZZXX");
+    padAndSendFrame(writeFrame);
+    checkResponseFrameTag(readResponseFrame(), RES_SUCCESS);
+
+    EXPECT_EQ(seek(streamId, 1, REQ_SEEK_SET), RES_SUCCESS);
+    EXPECT_EQ(read(REQ_GETBLOCK, streamId, 3), "ZXX");
+}
+
+TEST_F(TestProtocolHandler, SeekFromUnknownOriginFails)
+{
+    const std::pair<std::string, std::string> &testFilePathAndName = createRandomTempFilePathContaining("ABCDEF");
+    const WORD32 streamId = openBinaryFile(testFilePathAndName.second, REQ_OPEN_MODE_INPUT);
+
+    EXPECT_EQ(seek(streamId, 0, 4), RES_ERROR);
+}
+
+TEST_F(TestProtocolHandler, SeekAndTellUnopenFileAreUnsuccessful)
+{
+    EXPECT_EQ(seek(5, 0, REQ_SEEK_SET), RES_BADID);
+    EXPECT_EQ(sendStreamFrame(REQ_TELL, 5), RES_BADID);
+}
+
 // REQ_EOF
+TEST_F(TestProtocolHandler, EOFOnceReadHasReachedTheEnd)
+{
+    const std::pair<std::string, std::string> &testFilePathAndName = createRandomTempFilePathContaining("AB");
+    const WORD32 streamId = openBinaryFile(testFilePathAndName.second, REQ_OPEN_MODE_INPUT);
+
+    EXPECT_EQ(sendStreamFrame(REQ_EOF, streamId), RES_ERROR);
+    EXPECT_EQ(read(REQ_READ, streamId, 4), "AB");
+    EXPECT_EQ(sendStreamFrame(REQ_EOF, streamId), RES_SUCCESS);
+    // Seeking clears it.
+    EXPECT_EQ(seek(streamId, 0, REQ_SEEK_SET), RES_SUCCESS);
+    EXPECT_EQ(sendStreamFrame(REQ_EOF, streamId), RES_ERROR);
+    EXPECT_EQ(read(REQ_READ, streamId, 2), "AB");
+}
+
+TEST_F(TestProtocolHandler, EOFOfUnopenFileIsUnsuccessful)
+{
+    EXPECT_EQ(sendStreamFrame(REQ_EOF, 5), RES_BADID);
+}
+
 // REQ_FERROR
 // REQ_REMOVE
 // REQ_RENAME
 // REQ_GETBLOCK
+TEST_F(TestProtocolHandler, GetBlockIsLimitedToTheResponseFrame)
+{
+    const std::string contents(600, 'A');
+    const std::pair<std::string, std::string> &testFilePathAndName = createRandomTempFilePathContaining(contents);
+    const WORD32 streamId = openBinaryFile(testFilePathAndName.second, REQ_OPEN_MODE_INPUT);
+
+    std::vector<BYTE8> readFrame = {REQ_GETBLOCK};
+    append32(readFrame, streamId);
+    append16(readFrame, 1000);
+    padAndSendFrame(readFrame);
+
+    std::vector<BYTE8> response = readResponseFrame();
+    checkResponseFrameTag(response, RES_SUCCESS);
+    checkResponseFrameSize(response, 510); // RES_SUCCESS + 507 + 0-pad: the largest frame
+    EXPECT_EQ(get16(response, 3), BlockBufferSize);
+    EXPECT_EQ(read(REQ_GETBLOCK, streamId, 200), contents.substr(0, 600 - BlockBufferSize));
+}
+
 // REQ_PUTBLOCK
+TEST_F(TestProtocolHandler, PutBlockToRealFile)
+{
+    const std::pair<std::string, std::string> &testFilePathAndName = createRandomTempFilePathContaining();
+    const WORD32 streamId = openBinaryFile(testFilePathAndName.second, REQ_OPEN_MODE_OUTPUT);
+
+    std::vector<BYTE8> writeFrame = {REQ_PUTBLOCK};
+    append32(writeFrame, streamId);
+    appendString(writeFrame, "ABCDE");
+    padAndSendFrame(writeFrame);
+
+    std::vector<BYTE8> writeResponse = readResponseFrame();
+    checkResponseFrameTag(writeResponse, RES_SUCCESS);
+    checkResponseFrameSize(writeResponse, 4); // RES_SUCCESS + 5 + 0 + 0-pad
+    EXPECT_EQ(get16(writeResponse, 3), 5);
+
+    EXPECT_EQ(sendStreamFrame(REQ_CLOSE, streamId), RES_SUCCESS);
+    EXPECT_EQ(readFileContents(testFilePathAndName.first), "ABCDE");
+}
+
 // REQ_ISATTY
 // REQ_OPENREC
 // REQ_GETREC
@@ -1586,6 +1800,20 @@ TEST_F(TestProtocolHandler, CommandFrameForProgram)
     EXPECT_EQ((int)response[9], 'c');
 }
 
+TEST_F(TestProtocolHandler, CommandFrameTooLongForTheFrameIsTruncated)
+{
+    stubPlatform.setCommandLines(std::string(1000, 'x'), "");
+    std::vector<BYTE8> cmdFrame = {REQ_COMMAND};
+    append8(cmdFrame, 1);
+    std::vector<BYTE8> padded = padFrame(cmdFrame);
+    EXPECT_EQ(checkGoodFrame(padded), false);
+    std::vector<BYTE8> response = readResponseFrame();
+    checkResponseFrameSize(response, 1 + 2 + BlockBufferSize); // the largest frame
+    checkResponseFrameTag(response, RES_SUCCESS);
+    EXPECT_EQ(response[3] | (response[4] << 8), BlockBufferSize);
+    EXPECT_EQ(response[5 + BlockBufferSize - 1], 'x');
+}
+
 
 // REQ_CORE
 // REQ_ID
@@ -1663,3 +1891,271 @@ TEST_F(TestProtocolHandler, PutCharOk)
     EXPECT_EQ(stringstream.str(), "0");
 }
 
+// REQ_FRAMESIZE
+TEST_F(TestProtocolHandler, LongFrame1024IsBadWithoutNegotiation)
+{
+    std::vector<BYTE8> longFrame;
+    padTo(1024, longFrame);
+
+    checkBadFrame(longFrame);
+}
+
+TEST_F(TestProtocolHandler, FrameSizeIsGrantedWithinLimits)
+{
+    EXPECT_EQ(negotiateFrameSize(4096), 4096);
+    EXPECT_EQ(negotiateFrameSize(1025), 1024);
+    EXPECT_EQ(negotiateFrameSize(100), TransactionBufferSize);
+    EXPECT_EQ(negotiateFrameSize(100000), MaxTransactionBufferSize);
+}
+
+TEST_F(TestProtocolHandler, NegotiatedFrameSizeAllowsLongFrames)
+{
+    EXPECT_EQ(negotiateFrameSize(2048), 2048);
+
+    std::vector<BYTE8> maxFrame;
+    padTo(2046, maxFrame);
+    sendFrame(maxFrame);
+    checkResponseFrameTag(readResponseFrame(), RES_UNIMPLEMENTED);
+
+    // A bad frame's data isn't consumed, so nothing more can be sent after it.
+    std::vector<BYTE8> longFrame;
+    padTo(2048, longFrame);
+    sendFrame(longFrame);
+    EXPECT_EQ(handler->badFrameCount(), 1L);
+}
+
+TEST_F(TestProtocolHandler, FrameSizeCanBeNegotiatedBackToStandard)
+{
+    EXPECT_EQ(negotiateFrameSize(2048), 2048);
+    EXPECT_EQ(negotiateFrameSize(TransactionBufferSize), TransactionBufferSize);
+
+    std::vector<BYTE8> longFrame;
+    padTo(512, longFrame);
+    sendFrame(longFrame);
+    EXPECT_EQ(handler->badFrameCount(), 1L);
+}
+
+TEST_F(TestProtocolHandler, NegotiatedFrameSizeAllowsLongPutBlockAndGetBlock)
+{
+    EXPECT_EQ(negotiateFrameSize(8192), 8192);
+    std::string contents;
+    for (int i = 0; i < 5000; i++) {
+        contents += (char) ('A' + (i % 26));
+    }
+
+    const std::pair<std::string, std::string> &testFilePathAndName = createRandomTempFilePathContaining();
+    const WORD32 outputStreamId = openBinaryFile(testFilePathAndName.second, REQ_OPEN_MODE_OUTPUT);
+    std::vector<BYTE8> writeFrame = {REQ_PUTBLOCK};
+    append32(writeFrame, outputStreamId);
+    appendString(writeFrame, contents);
+    padAndSendFrame(writeFrame);
+    std::vector<BYTE8> writeResponse = readResponseFrame();
+    checkResponseFrameTag(writeResponse, RES_SUCCESS);
+    EXPECT_EQ(get16(writeResponse, 3), 5000);
+    EXPECT_EQ(sendStreamFrame(REQ_CLOSE, outputStreamId), RES_SUCCESS);
+    EXPECT_EQ(readFileContents(testFilePathAndName.first), contents);
+
+    const WORD32 inputStreamId = openBinaryFile(testFilePathAndName.second, REQ_OPEN_MODE_INPUT);
+    EXPECT_EQ(read(REQ_GETBLOCK, inputStreamId, 10000), contents);
+}
+
+// REQ_GETKEYTIMEOUT
+TEST_F(TestProtocolHandler, GetKeyTimeoutSomethingAvailable)
+{
+    stubPlatform.putKeyboardChar('A');
+
+    std::vector<BYTE8> getKeyFrame = {REQ_GETKEYTIMEOUT};
+    append32(getKeyFrame, 1000);
+    EXPECT_FALSE(checkGoodFrame(padFrame(getKeyFrame)));
+    EXPECT_EQ(handler->unimplementedFrameCount(), 0L); // it is an implemented tag
+
+    std::vector<BYTE8> response = readResponseFrame();
+    checkResponseFrameTag(response, RES_SUCCESS);
+    checkResponseFrameSize(response, 2); // RES_SUCCESS + A (no padding)
+    EXPECT_EQ((int)response[3], 0x41);
+}
+
+TEST_F(TestProtocolHandler, GetKeyTimeoutWaitsThenTimesOut)
+{
+    // Do not 'press any keys'
+    std::vector<BYTE8> getKeyFrame = {REQ_GETKEYTIMEOUT};
+    append32(getKeyFrame, 50);
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(checkGoodFrame(padFrame(getKeyFrame)));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+
+    std::vector<BYTE8> response = readResponseFrame();
+    checkResponseFrameTag(response, RES_ERROR);
+    checkResponseFrameSize(response, 2); // RES_ERROR + padding
+}
+
+// REQ_WRITEDIRECT, REQ_READDIRECT
+TEST_F(TestProtocolHandler, DirectTransfersNeedGuestMemory)
+{
+    std::vector<BYTE8> writeFrame = {REQ_WRITEDIRECT};
+    append32(writeFrame, 1);
+    append32(writeFrame, 0x80000070);
+    append32(writeFrame, 4);
+    EXPECT_FALSE(sendFrame(padFrame(writeFrame)));
+    EXPECT_EQ(handler->unimplementedFrameCount(), 1L);
+
+    std::vector<BYTE8> response = readResponseFrame();
+    checkResponseFrameTag(response, RES_UNIMPLEMENTED);
+    checkResponseFrameSize(response, 6); // RES_UNIMPLEMENTED + length + 0-pad
+}
+
+TEST_F(TestProtocolHandler, WriteDirectWritesFromGuestMemory)
+{
+    // More than a platform write, or a frame, can carry.
+    StubGuestMemory guestMemory(0x80000070, 100000);
+    for (size_t i = 0; i < guestMemory.bytes().size(); i++) {
+        guestMemory.bytes()[i] = 'A' + (i % 26);
+    }
+    handler->setGuestMemory(&guestMemory);
+    const std::pair<std::string, std::string> &testFilePathAndName = createRandomTempFilePathContaining();
+    const WORD32 streamId = openBinaryFile(testFilePathAndName.second, REQ_OPEN_MODE_OUTPUT);
+
+    std::vector<BYTE8> writeFrame = {REQ_WRITEDIRECT};
+    append32(writeFrame, streamId);
+    append32(writeFrame, 0x80000070);
+    append32(writeFrame, 100000);
+    padAndSendFrame(writeFrame);
+    std::vector<BYTE8> writeResponse = readResponseFrame();
+    checkResponseFrameTag(writeResponse, RES_SUCCESS);
+    checkResponseFrameSize(writeResponse, 6); // RES_SUCCESS + length + 0-pad
+    EXPECT_EQ(get32(writeResponse, 3), 100000UL);
+
+    EXPECT_EQ(sendStreamFrame(REQ_CLOSE, streamId), RES_SUCCESS);
+    EXPECT_EQ(readFileContents(testFilePathAndName.first),
+              std::string(guestMemory.bytes().begin(), guestMemory.bytes().end()));
+}
+
+TEST_F(TestProtocolHandler, ReadDirectReadsIntoGuestMemoryUntilTheEnd)
+{
+    StubGuestMemory guestMemory(0x80000070, 256);
+    handler->setGuestMemory(&guestMemory);
+    const std::pair<std::string, std::string> &testFilePathAndName = createRandomTempFilePathContaining("ABCDEFGHIJ");
+    const WORD32 streamId = openBinaryFile(testFilePathAndName.second, REQ_OPEN_MODE_INPUT);
+
+    std::vector<BYTE8> readFrame = {REQ_READDIRECT};
+    append32(readFrame, streamId);
+    append32(readFrame, 0x80000074);
+    append32(readFrame, 100);
+    padAndSendFrame(readFrame);
+    std::vector<BYTE8> readResponse = readResponseFrame();
+    checkResponseFrameTag(readResponse, RES_SUCCESS);
+    EXPECT_EQ(get32(readResponse, 3), 10UL);
+    EXPECT_EQ(std::string(guestMemory.bytes().begin() + 4, guestMemory.bytes().begin() + 14), "ABCDEFGHIJ");
+    EXPECT_EQ(guestMemory.bytes()[3], 0);
+    EXPECT_EQ(guestMemory.bytes()[14], 0);
+}
+
+TEST_F(TestProtocolHandler, DirectTransferOutsideGuestMemoryIsAnError)
+{
+    StubGuestMemory guestMemory(0x80000070, 256);
+    handler->setGuestMemory(&guestMemory);
+
+    std::vector<BYTE8> writeFrame = {REQ_WRITEDIRECT};
+    append32(writeFrame, 1);
+    append32(writeFrame, 0x80000100);
+    append32(writeFrame, 256);
+    padAndSendFrame(writeFrame);
+    std::vector<BYTE8> writeResponse = readResponseFrame();
+    checkResponseFrameTag(writeResponse, RES_ERROR);
+    EXPECT_EQ(get32(writeResponse, 3), 0UL);
+    EXPECT_TRUE(stubPlatform.getScreenChars().empty());
+}
+
+TEST_F(TestProtocolHandler, DirectTransferToUnopenStreamIsBadId)
+{
+    StubGuestMemory guestMemory(0x80000070, 256);
+    handler->setGuestMemory(&guestMemory);
+
+    std::vector<BYTE8> readFrame = {REQ_READDIRECT};
+    append32(readFrame, 7);
+    append32(readFrame, 0x80000070);
+    append32(readFrame, 16);
+    padAndSendFrame(readFrame);
+    std::vector<BYTE8> readResponse = readResponseFrame();
+    checkResponseFrameTag(readResponse, RES_BADID);
+    EXPECT_EQ(get32(readResponse, 3), 0UL);
+}
+
+// POLLED OPERATION
+TEST_F(TestProtocolHandler, PollFrameWithNothingToReadMakesNoProgress)
+{
+    EXPECT_FALSE(handler->pollFrame());
+    EXPECT_EQ(handler->frameCount(), 0L);
+}
+
+TEST_F(TestProtocolHandler, PollFrameHandlesAFrameReadInParts)
+{
+    stubLink.setReadableBytes({6, 0, REQ_ID});
+    EXPECT_TRUE(handler->pollFrame());
+    EXPECT_TRUE(readResponseFrame().empty());
+
+    stubLink.setReadableBytes({0, 0, 0, 0, 0});
+    EXPECT_TRUE(handler->pollFrame());
+    std::vector<BYTE8> response = readResponseFrame();
+    checkResponseFrameTag(response, RES_SUCCESS);
+    checkResponseFrameSize(response, 6);
+    EXPECT_EQ(handler->frameCount(), 1L);
+    EXPECT_FALSE(handler->exitReceived());
+    EXPECT_FALSE(handler->pollFrame());
+}
+
+TEST_F(TestProtocolHandler, PollFrameSkipsABadFrameSize)
+{
+    stubLink.setReadableBytes({3, 0});
+    std::vector<BYTE8> idFrame = {REQ_ID};
+    setReadableIserverMessage(padFrame(idFrame));
+    handler->pollFrame();
+    EXPECT_EQ(handler->badFrameCount(), 1L);
+    checkResponseFrameTag(readResponseFrame(), RES_SUCCESS);
+}
+
+TEST_F(TestProtocolHandler, PollFrameSensesExit)
+{
+    std::vector<BYTE8> exitFrame = {REQ_EXIT};
+    append32(exitFrame, RES_EXIT_SUCCESS);
+    setReadableIserverMessage(padFrame(exitFrame));
+    EXPECT_TRUE(handler->pollFrame());
+    EXPECT_TRUE(handler->exitReceived());
+    EXPECT_EQ(handler->exitCode(), 0);
+}
+
+TEST_F(TestProtocolHandler, PollFrameHandsHostIOToThePool)
+{
+    HostIOPool pool(1);
+    std::atomic<int> completions(0);
+    handler->setHostIOPool(&pool);
+    handler->setProgressCallback([&completions] { completions++; });
+    const std::pair<std::string, std::string> &testFilePathAndName = createRandomTempFilePathContaining("ABC");
+
+    std::vector<BYTE8> openFrame = {REQ_OPEN};
+    appendString(openFrame, testFilePathAndName.second);
+    append8(openFrame, REQ_OPEN_TYPE_BINARY);
+    append8(openFrame, REQ_OPEN_MODE_INPUT);
+    setReadableIserverMessage(padFrame(openFrame));
+    std::vector<BYTE8> openResponse = pollForResponseFrame();
+    checkResponseFrameTag(openResponse, RES_SUCCESS);
+    const WORD32 streamId = get32(openResponse, 3);
+    EXPECT_EQ(completions, 1);
+
+    // The next request is only read once the last has been responded to.
+    std::vector<BYTE8> readFrame = {REQ_READ};
+    append32(readFrame, streamId);
+    append16(readFrame, 3);
+    setReadableIserverMessage(padFrame(readFrame));
+    std::vector<BYTE8> readResponse = pollForResponseFrame();
+    checkResponseFrameTag(readResponse, RES_SUCCESS);
+    EXPECT_EQ(std::string(readResponse.begin() + 5, readResponse.begin() + 8), "ABC");
+    EXPECT_EQ(completions, 2);
+
+    // Frames that don't touch the host are handled straight away.
+    std::vector<BYTE8> idFrame = {REQ_ID};
+    setReadableIserverMessage(padFrame(idFrame));
+    EXPECT_TRUE(handler->pollFrame());
+    checkResponseFrameTag(readResponseFrame(), RES_SUCCESS);
+    EXPECT_EQ(completions, 2);
+}
@@ -0,0 +1,201 @@
+//------------------------------------------------------------------------------
+//
+// File        : testsessionserver.cpp
+// Description : Tests for the multi-session IServer.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "log.h"
+#include "filesystem.h"
+#include "inmemorylink.h"
+#include "platform.h"
+#include "sessionserver.h"
+#include "stublink.h"
+#include "../isproto.h"
+
+#include "gtest/gtest.h"
+#include "tempfilesfixture.h"
+
+class QuietPlatform final : public Platform {
+public:
+    void initialise() noexcept(false) override {}
+    bool isConsoleCharAvailable() override { return false; }
+    BYTE8 getConsoleChar() override { return 0; }
+    void putConsoleChar(BYTE8 ch) override {}
+    WORD32 getTimeMillis() override { return 0; }
+    UTCTime getUTCTime() override { return UTCTime(); }
+};
+
+// The board's end of a session: sends requests and reads responses over its end of an InMemoryLink.
+class Board {
+public:
+    Board(): myLinks(0, 0) {}
+    Link &serverLink() { return *myLinks.linkA(); }
+    Link &boardLink() { return *myLinks.linkB(); }
+
+    std::vector<BYTE8> request(std::vector<BYTE8> frame) {
+        while (frame.size() < 6 || (frame.size() & 0x01) == 0x01) {
+            frame.push_back(0x00);
+        }
+        boardLink().writeByte(frame.size() & 0xff);
+        boardLink().writeByte(frame.size() >> 8);
+        boardLink().writeBytes(frame.data(), (int) frame.size());
+        const WORD16 size = boardLink().readByte() | (boardLink().readByte() << 8);
+        std::vector<BYTE8> response(size);
+        boardLink().readBytes(response.data(), size);
+        return response;
+    }
+
+    BYTE8 exit(const WORD32 status) {
+        std::vector<BYTE8> exitFrame = {REQ_EXIT};
+        append32(exitFrame, status);
+        return request(exitFrame)[0];
+    }
+
+    static void append32(std::vector<BYTE8> &frame, const WORD32 w) {
+        frame.push_back(w & 0x000000ff);
+        frame.push_back((w & 0x0000ff00) >> 8);
+        frame.push_back((w & 0x00ff0000) >> 16);
+        frame.push_back((w & 0xff000000) >> 24);
+    }
+
+private:
+    InMemoryLinkFactory myLinks;
+};
+
+class TestSessionServer : public TestTempFiles, public ::testing::Test {
+protected:
+    void SetUp() override {
+        setLogLevel(LOGLEVEL_DEBUG);
+    }
+
+    void TearDown() override {
+        removeTempFiles();
+    }
+};
+
+TEST_F(TestSessionServer, SessionsHaveTheirOwnRootDirectoriesFileTablesAndExitCodes)
+{
+    const std::pair<std::string, std::string> pathAndName = createRandomTempFilePathContaining("board 0's file");
+    Board board0, board1;
+    {
+        SessionServer server(2);
+        EXPECT_EQ(server.addSession(board0.serverLink(), new QuietPlatform(), tempdir()), 0);
+        EXPECT_EQ(server.addSession(board1.serverLink(), new QuietPlatform(),
+                                    pathJoin(tempdir(), pathAndName.second + ".missing")), 1);
+        std::thread boards([&] {
+            std::vector<BYTE8> openFrame = {REQ_OPEN, (BYTE8) pathAndName.second.length(), 0};
+            openFrame.insert(openFrame.end(), pathAndName.second.begin(), pathAndName.second.end());
+            openFrame.push_back(REQ_OPEN_TYPE_BINARY);
+            openFrame.push_back(REQ_OPEN_MODE_INPUT);
+            std::vector<BYTE8> openResponse = board0.request(openFrame);
+            EXPECT_EQ(openResponse[0], RES_SUCCESS);
+            // Board 1 can't see the file, in its own root directory, nor use board 0's stream.
+            EXPECT_EQ(board1.request(openFrame)[0], RES_ERROR);
+            std::vector<BYTE8> readFrame = {REQ_READ, openResponse[1], openResponse[2], openResponse[3], openResponse[4], 4, 0};
+            EXPECT_EQ(board1.request(readFrame)[0], RES_BADID);
+            std::vector<BYTE8> readResponse = board0.request(readFrame);
+            EXPECT_EQ(readResponse[0], RES_SUCCESS);
+            EXPECT_EQ(std::string(readResponse.begin() + 3, readResponse.begin() + 7), "boar");
+            EXPECT_EQ(board0.exit(3), RES_SUCCESS);
+            EXPECT_EQ(board1.exit(4), RES_SUCCESS);
+        });
+        server.run();
+        boards.join();
+        EXPECT_TRUE(server.sessionFinished(0));
+        EXPECT_TRUE(server.sessionFinished(1));
+        EXPECT_EQ(server.exitCode(0), 3);
+        EXPECT_EQ(server.exitCode(1), 4);
+        EXPECT_EQ(server.frameCount(0), 3);
+        EXPECT_EQ(server.frameCount(1), 3);
+    }
+}
+
+TEST_F(TestSessionServer, ManySessionsAreServedTogether)
+{
+    const int boardCount = 50;
+    std::vector<Board> boards(boardCount);
+    SessionServer server(4);
+    for (int i = 0; i < boardCount; i++) {
+        server.addSession(boards[i].serverLink(), new QuietPlatform(), tempdir());
+    }
+    EXPECT_EQ(server.sessions(), boardCount);
+    // Each board runs on its own thread, as an emulated board would.
+    std::vector<std::thread> threads;
+    for (int i = 0; i < boardCount; i++) {
+        threads.emplace_back([&boards, i] {
+            std::vector<BYTE8> idFrame = {REQ_ID};
+            EXPECT_EQ(boards[i].request(idFrame)[0], RES_SUCCESS);
+            EXPECT_EQ(boards[i].exit((WORD32) i + 10), RES_SUCCESS);
+        });
+    }
+    server.run();
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+    for (int i = 0; i < boardCount; i++) {
+        EXPECT_TRUE(server.sessionFinished(i));
+        EXPECT_EQ(server.exitCode(i), i + 10);
+    }
+}
+
+TEST_F(TestSessionServer, FailedLinkEndsOnlyItsSession)
+{
+    Board board0, board1;
+    SessionServer server(1);
+    server.addSession(board0.serverLink(), new QuietPlatform(), tempdir());
+    server.addSession(board1.serverLink(), new QuietPlatform(), tempdir());
+    std::vector<int> finished;
+    server.setFinishedCallback([&finished] (const int session) { finished.push_back(session); });
+    std::thread boards([&] {
+        board1.boardLink().resetLink();
+        EXPECT_EQ(board0.exit(0), RES_SUCCESS);
+    });
+    server.run();
+    boards.join();
+    EXPECT_TRUE(server.sessionFinished(0));
+    EXPECT_EQ(server.exitCode(0), 0);
+    EXPECT_TRUE(server.sessionFinished(1));
+    EXPECT_EQ(server.exitCode(1), 1);
+    ASSERT_EQ(finished.size(), 2);
+    EXPECT_NE(finished[0], finished[1]);
+}
+
+TEST_F(TestSessionServer, StopEndsTheEventLoop)
+{
+    Board board;
+    SessionServer server(1);
+    server.addSession(board.serverLink(), new QuietPlatform(), tempdir());
+    std::thread stopper([&server] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        server.stop();
+    });
+    server.run();
+    stopper.join();
+    EXPECT_FALSE(server.sessionFinished(0));
+}
+
+TEST_F(TestSessionServer, LinksThatCannotPollAreRejected)
+{
+    // A Link that only blocks.
+    class BlockingLink : public StubLink {
+    public:
+        BlockingLink(): StubLink(0, true) {}
+        bool canPoll() override { return false; }
+    };
+    BlockingLink link;
+    SessionServer server(1);
+    EXPECT_THROW(server.addSession(link, new QuietPlatform(), tempdir()), std::invalid_argument);
+    EXPECT_EQ(server.sessions(), 0);
+}
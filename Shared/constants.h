@@ -37,6 +37,14 @@ const int BitsPerWord=32;                       // For use in instruction timing
 const int ByteSelectMask=0x03;                    // Mask to check word alignment
 const WORD32 WordMask=0xFFFFFFFC;             // ~ByteSelectMask to get word part
 
+// Control bytes of the boot-from-link protocol; others are the length of a bootstrap to follow.
+const BYTE8 BOOT_POKE = 0;                         // address word, data word
+const BYTE8 BOOT_PEEK = 1;                 // address word; replies with data word
+// Extended control bytes, only understood by emulators started with the extended boot protocol enabled; otherwise
+// they're the lengths of (very short) bootstraps.
+const BYTE8 BOOT_BLOCK_POKE = 2;      // address word, length word, length bytes
+const BYTE8 BOOT_BLOCK_PEEK = 3;  // address word, length word; replies with data
+
 const WORD32 NotProcess_p=0x80000000;  // Minimum integer; lowest memory location
 
 // Values that the ALT state of an alternative, held in WPtr - 3 can have
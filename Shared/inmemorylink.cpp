@@ -13,6 +13,9 @@
 //------------------------------------------------------------------------------
 
 #include <cctype>
+#include <condition_variable>
+#include <functional>
+#include <stdexcept>
 #include <thread>
 
 #include "inmemorylink.h"
@@ -23,39 +26,91 @@
 
 class ByteRegister {
 public:
-    ByteRegister() : m_register(0), m_storing(false) {
+    ByteRegister() : m_register(0), m_time(0), m_storing(false), m_reset(false) {
     }
 
     // Precondition: m_storing == false
     void store(BYTE8 buf) {
-        MUTEX
-        m_register = buf;
-        m_storing = true;
+        {
+            MUTEX
+            m_register = buf;
+            m_storing = true;
+        }
+        changed();
     }
 
     // Precondition: m_storing == true
     BYTE8 read() {
-        MUTEX
-        m_storing = false;
-        return m_register;
+        BYTE8 buf;
+        {
+            MUTEX
+            m_storing = false;
+            buf = m_register;
+        }
+        changed();
+        return buf;
     }
 
-    void read_maybe(BYTE8 *buf, bool *done) {
-        MUTEX
-        if (m_storing) {
-            *done = true;
-            *buf = m_register;
-            m_storing = false;
+    // If a byte was taken, anyone waiting to write another is told.
+    void read_maybe(BYTE8 *buf, WORD32 *time, bool *done) {
+        std::function<void()> taken;
+        {
+            MUTEX
+            if (m_storing) {
+                *done = true;
+                *buf = m_register;
+                *time = m_time;
+                m_storing = false;
+                taken = m_takenCallback;
+            }
+        }
+        if (*done) {
+            changed();
+        }
+        if (taken) {
+            taken();
         }
     }
 
-    void write_maybe(const BYTE8 *buf, bool *done) {
-        MUTEX
-        if (!m_storing) {
-            *done = true;
-            m_register = *buf;
-            m_storing = true;
+    // If a byte was stored, anyone waiting to read it is told.
+    void write_maybe(const BYTE8 *buf, WORD32 time, bool *done) {
+        std::function<void()> stored;
+        {
+            MUTEX
+            if (!m_storing) {
+                *done = true;
+                m_register = *buf;
+                m_time = time;
+                m_storing = true;
+                stored = m_storedCallback;
+            }
+        }
+        if (*done) {
+            changed();
         }
+        if (stored) {
+            stored();
+        }
+    }
+
+    // Block a reader until there's a byte to take, or a writer until the byte it stored has been taken, or until the
+    // register is reset, rather than spinning.
+    void wait_stored() {
+#ifdef DESKTOP
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait(lock, [this] { return m_storing || m_reset; });
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    void wait_taken() {
+#ifdef DESKTOP
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait(lock, [this] { return !m_storing || m_reset; });
+#else
+        std::this_thread::yield();
+#endif
     }
 
     bool storing() {
@@ -63,20 +118,66 @@ public:
         return m_storing;
     }
 
+    // Once reset, any transfer waiting on this register, or subsequently started, fails.
+    void reset(bool newReset) {
+        std::function<void()> stored, taken;
+        {
+            MUTEX
+            m_reset = newReset;
+            stored = m_storedCallback;
+            taken = m_takenCallback;
+        }
+        changed();
+        if (newReset) {
+            if (stored) {
+                stored();
+            }
+            if (taken) {
+                taken();
+            }
+        }
+    }
+
+    void setStoredCallback(const std::function<void()> &callback) {
+        MUTEX
+        m_storedCallback = callback;
+    }
+
+    void setTakenCallback(const std::function<void()> &callback) {
+        MUTEX
+        m_takenCallback = callback;
+    }
+
+    bool isReset() {
+        MUTEX
+        return m_reset;
+    }
+
+    void changed() {
+#ifdef DESKTOP
+        m_changed.notify_all();
+#endif
+    }
+
 #ifdef DESKTOP
     std::mutex m_mutex;
+    std::condition_variable m_changed; // notified whenever a byte is stored or taken, or on reset
 #endif
 #ifdef PICO
     CriticalSection m_criticalsection;
 #endif
     BYTE8 m_register;
+    WORD32 m_time; // when m_register reaches the reader, on a timed link
     bool m_storing;
+    bool m_reset;
+    std::function<void()> m_storedCallback; // the reader's
+    std::function<void()> m_takenCallback; // the writer's
 };
 
 //------------------------------------------------------------------------------
 
 InMemoryLink::InMemoryLink(int linkNo, void *readState, void *writeState) : Link(linkNo, false),
-    myWriteSequence(0), myReadSequence(0) {
+    myWriteSequence(0), myReadSequence(0), myLatency(0), myWriteTime(0), myReadTime(0) {
     // Although these links are used in the EmuServer between IServer and Emulator, we
     // don't need to distinguish between 'server' and 'client', as the ends are given
     // by the state pairs.
@@ -87,6 +188,8 @@ InMemoryLink::InMemoryLink(int linkNo, void *readState, void *writeState) : Link
 
 void InMemoryLink::initialise() {
     myWriteSequence = myReadSequence = 0;
+    static_cast<ByteRegister *>(m_read_state)->reset(false);
+    static_cast<ByteRegister *>(m_write_state)->reset(false);
 }
 
 InMemoryLink::~InMemoryLink() {
@@ -94,40 +197,76 @@ InMemoryLink::~InMemoryLink() {
 }
 
 BYTE8 InMemoryLink::readByte() {
-	BYTE8 buf;
+    BYTE8 buf;
+    while (!tryReadByte(buf)) {
+        static_cast<ByteRegister *>(m_read_state)->wait_stored();
+    }
+    return buf;
+}
+
+void InMemoryLink::writeByte(BYTE8 buf) {
+    while (!tryWriteByte(buf)) {
+        static_cast<ByteRegister *>(m_write_state)->wait_taken();
+    }
+}
+
+bool InMemoryLink::tryReadByte(BYTE8 &buf) {
     bool done = false;
-    for (;;) {
-        ByteRegister *read_reg = static_cast<ByteRegister *>(m_read_state);
-        read_reg->read_maybe(&buf, &done);
-        if (done) {
-            break;
-        }
-        std::this_thread::yield();
+    ByteRegister *read_reg = static_cast<ByteRegister *>(m_read_state);
+    if (read_reg->isReset()) {
+        throw std::runtime_error("Link reset");
     }
-    if (bDebug) {
+    read_reg->read_maybe(&buf, &myReadTime, &done);
+    if (done && bDebug) {
         logDebugF("Link %d R #%08X %02X (%c)", myLinkNo, myReadSequence++, buf, isprint(buf) ? buf : '.');
     }
-    return buf;
+    return done;
 }
 
-void InMemoryLink::writeByte(BYTE8 buf) {
-    BYTE8 bufstore = buf;
+bool InMemoryLink::tryWriteByte(BYTE8 buf) {
     bool done = false;
-    for (;;) {
-        ByteRegister *write_reg = static_cast<ByteRegister *>(m_write_state);
-        write_reg->write_maybe(&bufstore, &done);
-        if (done) {
-            break;
-        }
-        std::this_thread::yield();
+    ByteRegister *write_reg = static_cast<ByteRegister *>(m_write_state);
+    if (write_reg->isReset()) {
+        throw std::runtime_error("Link reset");
     }
-    if (bDebug) {
+    write_reg->write_maybe(&buf, myWriteTime, &done);
+    if (done && bDebug) {
         logDebugF("Link %d W #%08X %02X (%c)", myLinkNo, myWriteSequence++, buf, isprint(buf) ? buf : '.');
     }
+    return done;
+}
+
+void InMemoryLink::setProgressCallback(const std::function<void()> &callback) {
+    // We can progress when the other end stores a byte for us to read, or takes the one we wrote.
+    static_cast<ByteRegister *>(m_read_state)->setStoredCallback(callback);
+    static_cast<ByteRegister *>(m_write_state)->setTakenCallback(callback);
+}
+
+bool InMemoryLink::canPoll() {
+    return true;
+}
+
+WORD32 InMemoryLink::getLatency() {
+    return myLatency;
+}
+
+void InMemoryLink::setWriteTime(WORD32 time) {
+    myWriteTime = time;
+}
+
+WORD32 InMemoryLink::getReadTime() {
+    return myReadTime;
+}
+
+void InMemoryLink::setLatency(WORD32 latency) {
+    myLatency = latency;
 }
 
 void InMemoryLink::resetLink() {
-    // TODO
+    // Both directions are shared with the other end, so this fails transfers waiting at either end.
+    logDebugF("Resetting InMemory link %d", myLinkNo);
+    static_cast<ByteRegister *>(m_read_state)->reset(true);
+    static_cast<ByteRegister *>(m_write_state)->reset(true);
 }
 
 int InMemoryLink::getLinkType() {
@@ -155,6 +294,11 @@ InMemoryLinkFactory::InMemoryLinkFactory(int linkANo, int linkBNo) {
     m_linkB = new InMemoryLink(linkBNo, m_state_a, m_state_b);
 }
 
+InMemoryLinkFactory::~InMemoryLinkFactory() {
+    delete static_cast<ByteRegister *>(m_state_a);
+    delete static_cast<ByteRegister *>(m_state_b);
+}
+
 Link *InMemoryLinkFactory::linkA() const {
     return reinterpret_cast<Link *>(m_linkA);
 };
@@ -162,3 +306,8 @@ Link *InMemoryLinkFactory::linkA() const {
 Link *InMemoryLinkFactory::linkB() const {
     return reinterpret_cast<Link *>(m_linkB);
 };
+
+void InMemoryLinkFactory::setLatency(WORD32 latency) {
+    m_linkA->setLatency(latency);
+    m_linkB->setLatency(latency);
+}
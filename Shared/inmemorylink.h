@@ -24,6 +24,14 @@ public:
     void initialise(void);
     BYTE8 readByte(void);
     void writeByte(BYTE8 b);
+    bool tryReadByte(BYTE8 &b);
+    bool tryWriteByte(BYTE8 b);
+    void setProgressCallback(const std::function<void()> &callback);
+    bool canPoll(void);
+    WORD32 getLatency(void);
+    void setWriteTime(WORD32 time);
+    WORD32 getReadTime(void);
+    void setLatency(WORD32 latency);
     void resetLink(void);
     int getLinkType(void);
     ~InMemoryLink(void);
@@ -32,6 +40,7 @@ public:
     bool _writeAvailable() const;
 private:
     WORD32 myWriteSequence{}, myReadSequence{};
+    WORD32 myLatency, myWriteTime, myReadTime;
     void *m_write_state; // an internal object
     void *m_read_state; // an internal object
 };
@@ -43,7 +52,10 @@ public:
     InMemoryLinkFactory(int linkANo, int linkBNo);
     Link *linkA() const;
     Link *linkB() const;
-    ~InMemoryLinkFactory() = default;
+    // Make both links timed, each byte taking latency cycles to cross.
+    void setLatency(WORD32 latency);
+    // Frees the state the links share, so delete the links first; they're not deleted here, as their owners do that.
+    ~InMemoryLinkFactory();
 private:
     void *m_state_a; // an internal object
     void *m_state_b; // an internal object
@@ -75,6 +75,38 @@ void Link::writeWord(WORD32 w) {
 	writeByte((w & 0xff000000) >> 24);
 }
 
+bool Link::rebindForClone(const std::string &input, const std::string &output) {
+	return false;
+}
+
+bool Link::tryReadByte(BYTE8 &b) {
+	b = readByte();
+	return true;
+}
+
+bool Link::tryWriteByte(BYTE8 b) {
+	writeByte(b);
+	return true;
+}
+
+void Link::setProgressCallback(const std::function<void()> &callback) {
+}
+
+bool Link::canPoll(void) {
+	return false;
+}
+
+WORD32 Link::getLatency(void) {
+	return 0;
+}
+
+void Link::setWriteTime(WORD32 time) {
+}
+
+WORD32 Link::getReadTime(void) {
+	return 0;
+}
+
 int Link::getLinkNo(void) {
 	return myLinkNo;
 }
@@ -14,6 +14,9 @@
 #ifndef _LINK_H
 #define _LINK_H
 
+#include <functional>
+#include <string>
+
 #include "platformdetection.h"
 #include "types.h"
 
@@ -33,6 +36,7 @@ const int LinkType_Async = 7;
 const int LinkType_USBCDC = 8;
 const int LinkType_TTY = 9;
 const int LinkType_InMemory = 10;
+const int LinkType_Recording = 11;
 
 class Link {
 public:
@@ -58,6 +62,23 @@ public:
 	int getLinkNo(void);
 	void setDebug(bool newDebug);
 	virtual int getLinkType(void) = 0;
+	// Called in a child emulator that has been forked from a running one, to give the child its own input and
+	// output streams. Returns false if this type of link can't do that.
+	virtual bool rebindForClone(const std::string &input, const std::string &output);
+	// Non-blocking transfers, for emulators that share a host thread: these return false if the byte can't be
+	// transferred yet, in which case the progress callback is called when it might be. Links that can't tell
+	// just block, as readByte and writeByte do, and never call the callback.
+	virtual bool tryReadByte(BYTE8 &b);
+	virtual bool tryWriteByte(BYTE8 b);
+	virtual void setProgressCallback(const std::function<void()> &callback);
+	// Whether the non-blocking transfers can return false, so that a link can be polled alongside others.
+	virtual bool canPoll(void);
+	// Emulated time, for networks simulated in PDES mode: a timed link stamps each byte written with the time
+	// (in processor cycles) at which it reaches the other end, and the reader's clock advances to that. Links
+	// are untimed, with no latency, unless the network gives them one.
+	virtual WORD32 getLatency(void);
+	virtual void setWriteTime(WORD32 time);
+	virtual WORD32 getReadTime(void);
 
 protected:
 	int myLinkNo;
@@ -67,6 +67,9 @@ static void linkConfigError(char *arg, const char *reason) {
 
 bool LinkFactory::processCommandLine(int argc, char *argv[]) {
 	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--") == 0) {
+			break; // the rest are the program's
+		}
 		if (argv[i][0] == '-' && argv[i][1] == 'L') {
 			if (strlen(argv[i]) != 4) {
 				linkConfigError(argv[i], "not four characters long");
@@ -0,0 +1,80 @@
+//------------------------------------------------------------------------------
+//
+// File        : recordinglink.cpp
+// Description : A Link that records everything written through it to a file,
+//               for replaying a host's input to an emulated network.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <stdexcept>
+
+#include "recordinglink.h"
+#include "log.h"
+
+RecordingLink::RecordingLink(Link *link, const std::string &fileName) :
+    Link(link->getLinkNo(), true), myLink(link), myFileName(fileName) {
+    logDebugF("Constructing Recording link %d to %s", myLinkNo, fileName.c_str());
+}
+
+void RecordingLink::initialise(void) {
+    myLink->initialise();
+    myRecording.open(myFileName, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (!myRecording) {
+        throw std::runtime_error("Could not create recording " + myFileName);
+    }
+    myRecording.write(RecordingMagic, RecordingMagicLength);
+}
+
+RecordingLink::~RecordingLink() {
+    logDebugF("Destroying Recording link %d", myLinkNo);
+    myRecording.close();
+    delete myLink;
+}
+
+// Reading means the host has finished sending, for now, so this is a good time to flush the recording, in case the
+// host then crashes.
+BYTE8 RecordingLink::readByte() {
+    myRecording.flush();
+    return myLink->readByte();
+}
+
+void RecordingLink::writeByte(BYTE8 b) {
+    myLink->writeByte(b);
+    myRecording.put(static_cast<char>(b));
+}
+
+bool RecordingLink::tryReadByte(BYTE8 &b) {
+    myRecording.flush();
+    return myLink->tryReadByte(b);
+}
+
+bool RecordingLink::tryWriteByte(BYTE8 b) {
+    if (!myLink->tryWriteByte(b)) {
+        return false;
+    }
+    myRecording.put(static_cast<char>(b));
+    return true;
+}
+
+void RecordingLink::setProgressCallback(const std::function<void()> &callback) {
+    myLink->setProgressCallback(callback);
+}
+
+bool RecordingLink::canPoll(void) {
+    return myLink->canPoll();
+}
+
+void RecordingLink::resetLink(void) {
+    myRecording.flush();
+    myLink->resetLink();
+}
+
+int RecordingLink::getLinkType() {
+    return LinkType_Recording;
+}
@@ -0,0 +1,50 @@
+//------------------------------------------------------------------------------
+//
+// File        : recordinglink.h
+// Description : A Link that records everything written through it to a file,
+//               for replaying a host's input to an emulated network.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#ifndef _RECORDINGLINK_H
+#define _RECORDINGLINK_H
+
+#include <fstream>
+#include <string>
+
+#include "types.h"
+#include "link.h"
+
+// A recording is the magic, then every byte written, in order. The bytes read aren't recorded: given the same
+// input, an emulated network sends the same output again.
+const char RecordingMagic[] = "PARAREC1";
+const int RecordingMagicLength = 8;
+
+class RecordingLink : public Link {
+public:
+    // Takes ownership of the link, through which all transfers are made.
+    RecordingLink(Link *link, const std::string &fileName);
+    // Throws a runtime_error if the recording can't be created.
+    void initialise(void);
+    ~RecordingLink(void);
+    BYTE8 readByte(void);
+    void writeByte(BYTE8 b);
+    bool tryReadByte(BYTE8 &b);
+    bool tryWriteByte(BYTE8 b);
+    void setProgressCallback(const std::function<void()> &callback);
+    bool canPoll(void);
+    void resetLink(void);
+    int getLinkType(void);
+private:
+    Link *myLink;
+    std::string myFileName;
+    std::ofstream myRecording;
+};
+
+#endif // _RECORDINGLINK_H
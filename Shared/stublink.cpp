@@ -54,6 +54,18 @@ void StubLink::writeByte(BYTE8 buf) {
     wrq->push(buf);
 }
 
+bool StubLink::tryReadByte(BYTE8 &b) {
+    if (rdq->empty()) {
+        return false;
+    }
+    b = readByte();
+    return true;
+}
+
+bool StubLink::canPoll() {
+    return true;
+}
+
 void StubLink::resetLink() {
     // TODO
 }
@@ -27,6 +27,8 @@ public:
     ~StubLink() override;
     BYTE8 readByte() override;
     void writeByte(BYTE8 b) override;
+    bool tryReadByte(BYTE8 &b) override; // false when there's nothing left to read
+    bool canPoll() override;
     void resetLink() override;
     // Used by tests to sense what has been written (by SUT calling writeByte) and
     // to inject data to be read (by SUT calling readbyte).
@@ -14,11 +14,13 @@
 #include <vector>
 #include <chrono>
 #include <thread>
+#include <ctime>
 
 #include "gtest/gtest.h"
 #include "link.h"
 #include "inmemorylink.h"
 #include "constants.h"
+#include "platformdetection.h"
 #include "log.h"
 
 class InMemoryLinkTest : public ::testing::Test {
@@ -159,3 +161,65 @@ TEST_F(InMemoryLinkTest, WriteByteAndReadThreadedTortureTest) {
     delete b_thread;
     logDebug("WriteByteAndReadThreadedTortureTest end");
 }
+
+TEST_F(InMemoryLinkTest, ResetFailsBlockedRead) {
+    std::thread *b_thread = new std::thread([this] {
+        EXPECT_THROW(m_linkB->readByte(), std::runtime_error);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    m_linkA->resetLink();
+    b_thread->join();
+    delete b_thread;
+    EXPECT_THROW(m_linkA->writeByte(0x42), std::runtime_error);
+}
+
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+TEST_F(InMemoryLinkTest, BlockedReadWaitsWithoutSpinning) {
+    double readerCpuMillis = 0;
+    std::thread b_thread([this, &readerCpuMillis] {
+        EXPECT_EQ(m_linkB->readByte(), 0x42);
+        struct timespec cpu {};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+        readerCpuMillis = cpu.tv_sec * 1000.0 + cpu.tv_nsec / 1000000.0;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    m_linkA->writeByte(0x42);
+    b_thread.join();
+    // Spinning, the reader would have used most of the 300ms.
+    EXPECT_LT(readerCpuMillis, 100.0);
+}
+
+TEST_F(InMemoryLinkTest, BlockedWriteWaitsForTheByteToBeTaken) {
+    m_linkA->writeByte(0x01);
+    std::thread a_thread([this] {
+        m_linkA->writeByte(0x02); // waits until the first is read
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(m_linkB->readByte(), 0x01);
+    EXPECT_EQ(m_linkB->readByte(), 0x02);
+    a_thread.join();
+}
+#endif
+
+TEST_F(InMemoryLinkTest, InitialiseClearsReset) {
+    m_linkA->resetLink();
+    m_linkA->initialise();
+    m_linkA->writeByte(0x42);
+    EXPECT_EQ(m_linkB->readByte(), 0x42);
+}
+
+TEST_F(InMemoryLinkTest, UntimedByDefault) {
+    EXPECT_EQ(m_linkA->getLatency(), 0U);
+    EXPECT_EQ(m_linkB->getLatency(), 0U);
+}
+
+TEST_F(InMemoryLinkTest, TimedLinkCarriesWriteTime) {
+    m_linkFactory->setLatency(22);
+    EXPECT_EQ(m_linkA->getLatency(), 22U);
+    EXPECT_EQ(m_linkB->getLatency(), 22U);
+    m_linkA->setWriteTime(1000);
+    m_linkA->writeByte(0x42);
+    m_linkA->setWriteTime(1022);
+    EXPECT_EQ(m_linkB->readByte(), 0x42);
+    EXPECT_EQ(m_linkB->getReadTime(), 1000U);
+}
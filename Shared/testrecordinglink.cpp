@@ -0,0 +1,78 @@
+//------------------------------------------------------------------------------
+//
+// File        : testrecordinglink.cpp
+// Description : Tests for the RecordingLink.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <stdexcept>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "link.h"
+#include "inmemorylink.h"
+#include "recordinglink.h"
+#include "tempfilesfixture.h"
+#include "log.h"
+
+class RecordingLinkTest : public TestTempFiles, public ::testing::Test {
+protected:
+    void SetUp() override {
+        setLogLevel(LOGLEVEL_INFO);
+        m_linkFactory = new InMemoryLinkFactory(0, 0);
+        m_recordingPath = createRandomTempFile();
+        // The recording link owns link A.
+        m_recordingLink = new RecordingLink(m_linkFactory->linkA(), m_recordingPath);
+        m_recordingLink->initialise();
+        m_linkB = m_linkFactory->linkB();
+        m_linkB->initialise();
+    }
+
+    void TearDown() override {
+        delete m_recordingLink;
+        delete m_linkB;
+        delete m_linkFactory;
+        removeTempFiles();
+    }
+
+    InMemoryLinkFactory *m_linkFactory = nullptr;
+    RecordingLink *m_recordingLink = nullptr;
+    Link *m_linkB = nullptr;
+    std::string m_recordingPath;
+};
+
+TEST_F(RecordingLinkTest, RecordsOnlyWhatIsWritten) {
+    m_recordingLink->writeByte('h');
+    EXPECT_EQ(m_linkB->readByte(), 'h');
+    m_linkB->writeByte('x');
+    EXPECT_EQ(m_recordingLink->readByte(), 'x');
+    m_recordingLink->writeByte('i');
+    EXPECT_EQ(m_linkB->readByte(), 'i');
+    // Closing the recording.
+    delete m_recordingLink;
+    m_recordingLink = nullptr;
+
+    EXPECT_EQ(readFileContents(m_recordingPath), std::string(RecordingMagic) + "hi");
+}
+
+TEST_F(RecordingLinkTest, ReadingFlushesRecording) {
+    m_recordingLink->writeByte('h');
+    EXPECT_EQ(m_linkB->readByte(), 'h');
+    m_linkB->writeByte('x');
+    EXPECT_EQ(m_recordingLink->readByte(), 'x');
+
+    EXPECT_EQ(readFileContents(m_recordingPath), std::string(RecordingMagic) + "h");
+}
+
+TEST_F(RecordingLinkTest, UncreatableRecordingThrows) {
+    InMemoryLinkFactory linkFactory(0, 0);
+    RecordingLink recordingLink(linkFactory.linkA(), "/nonexistent/directory/recording");
+    EXPECT_THROW(recordingLink.initialise(), std::runtime_error);
+    delete linkFactory.linkB();
+}
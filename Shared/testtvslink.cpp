@@ -0,0 +1,112 @@
+//------------------------------------------------------------------------------
+//
+// File        : testtvslink.cpp
+// Description : Tests for the TVSLink.
+// License     : Apache License v2.0 - see LICENSE.txt for more details
+// Created     : 18/10/2026
+//
+// (C) 2005-2026 Matt J. Gumbley
+// matt.gumbley@devzendo.org
+// http://devzendo.github.io/parachute
+//
+//------------------------------------------------------------------------------
+
+#include <stdexcept>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "tvslink.h"
+#include "tempfilesfixture.h"
+#include "log.h"
+
+class TVSLinkTest : public TestTempFiles, public ::testing::Test {
+protected:
+    void SetUp() override {
+        setLogLevel(LOGLEVEL_INFO);
+        m_programPath = createRandomTempFile("pro");
+        m_inputPath = createRandomTempFile("in");
+        m_outputPath = createRandomTempFile();
+    }
+
+    void TearDown() override {
+        delete m_link;
+        removeTempFiles();
+    }
+
+    std::string readAll(int count) {
+        std::string read;
+        for (int i = 0; i < count; i++) {
+            read += (char) m_link->readByte();
+        }
+        return read;
+    }
+
+    TVSLink *m_link = nullptr;
+    std::string m_programPath;
+    std::string m_inputPath;
+    std::string m_outputPath;
+};
+
+TEST_F(TVSLinkTest, ServesProgramThenInputThenEnds) {
+    m_link = new TVSLink(0, m_programPath, m_inputPath, m_outputPath);
+    m_link->initialise();
+    EXPECT_EQ(readAll(5), "proin");
+    EXPECT_THROW(m_link->readByte(), std::runtime_error);
+}
+
+TEST_F(TVSLinkTest, EndsAfterProgramWithoutInput) {
+    m_link = new TVSLink(0, m_programPath, "", m_outputPath);
+    m_link->initialise();
+    EXPECT_EQ(readAll(3), "pro");
+    EXPECT_THROW(m_link->readByte(), std::runtime_error);
+}
+
+TEST_F(TVSLinkTest, EmptyInputIsServed) {
+    const std::string emptyInput = createRandomTempFile();
+    m_link = new TVSLink(0, m_programPath, emptyInput, m_outputPath);
+    m_link->initialise();
+    EXPECT_EQ(readAll(3), "pro");
+    EXPECT_THROW(m_link->readByte(), std::runtime_error);
+}
+
+TEST_F(TVSLinkTest, MissingProgramCannotBeInitialised) {
+    m_link = new TVSLink(0, m_programPath + ".missing", "", m_outputPath);
+    EXPECT_THROW(m_link->initialise(), std::runtime_error);
+}
+
+TEST_F(TVSLinkTest, OutputIsBufferedUntilTheEnd) {
+    m_link = new TVSLink(0, m_programPath, "", m_outputPath);
+    m_link->initialise();
+    m_link->writeByte('o');
+    m_link->writeByte('k');
+    EXPECT_EQ(readFileContents(m_outputPath), "");
+    EXPECT_EQ(readAll(3), "pro");
+    EXPECT_THROW(m_link->readByte(), std::runtime_error);
+    EXPECT_EQ(readFileContents(m_outputPath), "ok");
+}
+
+TEST_F(TVSLinkTest, OutputIsWrittenWhenDestroyed) {
+    m_link = new TVSLink(0, m_programPath, "", m_outputPath);
+    m_link->initialise();
+    m_link->writeByte('o');
+    m_link->writeByte('k');
+    delete m_link;
+    m_link = nullptr;
+    EXPECT_EQ(readFileContents(m_outputPath), "ok");
+}
+
+TEST_F(TVSLinkTest, CloneCarriesOnWithItsOwnInputAndOutput) {
+    m_link = new TVSLink(0, m_programPath, m_inputPath, m_outputPath);
+    m_link->initialise();
+    EXPECT_EQ(readAll(2), "pr");
+    m_link->writeByte('p');
+    const std::string cloneInput = createRandomTempFile("ci");
+    const std::string cloneOutput = createRandomTempFile();
+    ASSERT_TRUE(m_link->rebindForClone(cloneInput, cloneOutput));
+    EXPECT_EQ(readAll(3), "oci");
+    m_link->writeByte('c');
+    delete m_link;
+    m_link = nullptr;
+    // The parent's output was buffered by the parent, not the clone.
+    EXPECT_EQ(readFileContents(cloneOutput), "c");
+}
@@ -15,8 +15,19 @@
 
 #include <exception>
 #include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
 #include <utility>
 
+#include "platformdetection.h"
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "tvslink.h"
 #include "log.h"
 
@@ -25,6 +36,8 @@ TVSLink::TVSLink(int linkNo, std::string tvsProgram, std::string tvsInput, std::
     myTVSProgram = std::move(tvsProgram);
     myTVSInput = std::move(tvsInput);
     myTVSOutput = std::move(tvsOutput);
+    myProgram = { nullptr, 0, nullptr, {} };
+    myInput = { nullptr, 0, nullptr, {} };
     myProgramSent = myInputSent = 0;
     logDebugF("Constructing TVS link %d for cpu client", myLinkNo);
 }
@@ -32,18 +45,14 @@ TVSLink::TVSLink(int linkNo, std::string tvsProgram, std::string tvsInput, std::
 void TVSLink::initialise() {
     logDebugF("Initialising TVS link %d for cpu client", myLinkNo);
     myWriteSequence = myReadSequence = 0;
-    try {
-        myTVSProgramStream.open(myTVSProgram, std::ifstream::in | std::ifstream::binary);
-    } catch (std::system_error& e) {
-        snprintf(myMsgbuf, TVS_MSGBUF_SIZE, "Could not open program file %s: %s", myTVSProgram.c_str(), e.code().message().c_str());
+    if (!mapFile(myTVSProgram, myProgram)) {
+        snprintf(myMsgbuf, TVS_MSGBUF_SIZE, "Could not open program file %s: %s", myTVSProgram.c_str(), strerror(errno));
         logFatalF("%s", myMsgbuf);
         throw std::runtime_error(myMsgbuf);
     }
     if (!myTVSInput.empty()) {
-        try {
-            myTVSInputStream.open(myTVSInput, std::ifstream::in | std::ifstream::binary);
-        } catch (std::system_error& e) {
-            snprintf(myMsgbuf, TVS_MSGBUF_SIZE, "Could not open input file %s: %s", myTVSInput.c_str(), e.code().message().c_str());
+        if (!mapFile(myTVSInput, myInput)) {
+            snprintf(myMsgbuf, TVS_MSGBUF_SIZE, "Could not open input file %s: %s", myTVSInput.c_str(), strerror(errno));
             logFatalF("%s", myMsgbuf);
             throw std::runtime_error(myMsgbuf);
         }
@@ -57,68 +66,143 @@ void TVSLink::initialise() {
         logFatalF("%s", myMsgbuf);
         throw std::runtime_error(myMsgbuf);
     }
+    myOutputBuffer.reserve(OutputBufferSize);
 }
 
 TVSLink::~TVSLink() {
     logDebugF("Destroying TVS link %d", myLinkNo);
-    myTVSProgramStream.close();
-    if (!myTVSInput.empty()) {
-        myTVSInputStream.close();
-    }
+    flushOutput();
+    unmapFile(myProgram);
+    unmapFile(myInput);
     myTVSOutputStream.close();
 }
 
+bool TVSLink::mapFile(const std::string &fileName, MappedFile &file) {
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+    const int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+    file.length = (size_t) st.st_size;
+    file.mapping = nullptr;
+    file.data = nullptr;
+    // An empty file can't be mapped, but there's nothing to serve from it anyway.
+    if (file.length != 0) {
+        void *mapping = mmap(nullptr, file.length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            const int error = errno;
+            close(fd);
+            errno = error;
+            return false;
+        }
+        file.mapping = mapping;
+        file.data = static_cast<const BYTE8 *>(mapping);
+    }
+    // The mapping holds its own reference to the file.
+    close(fd);
+    return true;
+#else
+    std::ifstream in(fileName, std::ifstream::in | std::ifstream::binary);
+    if (!in) {
+        return false;
+    }
+    file.copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    file.mapping = nullptr;
+    file.data = file.copy.data();
+    file.length = file.copy.size();
+    return true;
+#endif
+}
+
+void TVSLink::unmapFile(MappedFile &file) {
+#if defined(PLATFORM_OSX) || defined(PLATFORM_LINUX)
+    if (file.mapping != nullptr) {
+        munmap(file.mapping, file.length);
+    }
+#endif
+    file.copy.clear();
+    file = { nullptr, 0, nullptr, {} };
+}
+
+void TVSLink::flushOutput() {
+    if (myOutputBuffer.empty()) {
+        return;
+    }
+    myTVSOutputStream.write(reinterpret_cast<const char *>(myOutputBuffer.data()), (std::streamsize) myOutputBuffer.size());
+    myTVSOutputStream.flush();
+    myOutputBuffer.clear();
+}
+
 BYTE8 TVSLink::readByte() {
-    BYTE8 buf[1];
-    bool finished = false;
-    myTVSProgramStream.read(reinterpret_cast<char *>(buf), 1);
-    if (myTVSProgramStream.gcount() == 0) {
-        myTVSProgramStream.close();
+    BYTE8 b;
+    if (myProgramSent < myProgram.length) {
+        b = myProgram.data[myProgramSent++];
+        if (bDebug) {
+            logDebugF("Read program byte %08x...", myProgramSent);
+        }
+    } else if (myInputSent < myInput.length) {
+        b = myInput.data[myInputSent++];
+        if (bDebug) {
+            logDebugF("Read input byte %08x...", myInputSent);
+        }
+    } else {
         if (myTVSInput.empty()) {
             logInfo("Program is at EOF; there is no input");
-            finished = true;
         } else {
-            myTVSInputStream.read(reinterpret_cast<char *>(buf), 1);
-
-            if (myTVSInputStream.gcount() == 0) {
-                myTVSInputStream.close();
-                logInfo("Program and input files are both at EOF");
-                finished = true;
-            } else {
-                myInputSent++;
-                if (bDebug) {
-                    logDebugF("Read input byte %08x...", myInputSent);
-                }
-            }
+            logInfo("Program and input files are both at EOF");
         }
-    } else {
-        myProgramSent++;
-        if (bDebug) {
-            logDebugF("Read program byte %08x...", myProgramSent);
-        }
-    }
-    if (finished) {
         logInfo("Finished; terminating emulator");
+        flushOutput();
         throw std::runtime_error("TVS signalled end of emulation");
     }
 
     if (bDebug) {
-        logDebugF("Link %d R #%08X %02X (%c)", myLinkNo, myReadSequence++, buf[0], isprint(buf[0]) ? buf[0] : '.');
+        logDebugF("Link %d R #%08X %02X (%c)", myLinkNo, myReadSequence++, b, isprint(b) ? b : '.');
     }
-    return buf[0];
+    return b;
 }
 
 void TVSLink::writeByte(BYTE8 buf) {
     if (bDebug) {
         logDebugF("Link %d W #%08X %02X (%c)", myLinkNo, myWriteSequence++, buf, isprint(buf) ? buf : '.');
     }
-    const BYTE8 outBuf = buf;
-    myTVSOutputStream.write(reinterpret_cast<const char *>(&outBuf), 1);
-    myTVSOutputStream.flush();
+    myOutputBuffer.push_back(buf);
+    if (myOutputBuffer.size() >= OutputBufferSize) {
+        flushOutput();
+    }
 }
 
 void TVSLink::resetLink() {
-    // TODO
+    flushOutput();
+}
+
+// The child inherits its parent's mapping of the program, and carries on serving it from where the parent had
+// reached; then the child's own input is served from its start, and output goes to the child's own output file.
+// Output the parent had buffered is the parent's, not the child's.
+bool TVSLink::rebindForClone(const std::string &input, const std::string &output) {
+    unmapFile(myInput);
+    myTVSInput = input;
+    myInputSent = 0;
+    if (!myTVSInput.empty() && !mapFile(myTVSInput, myInput)) {
+        logErrorF("Could not open input file %s", myTVSInput.c_str());
+        return false;
+    }
+    myOutputBuffer.clear();
+    myTVSOutputStream.close();
+    myTVSOutput = output;
+    myTVSOutputStream.open(myTVSOutput, std::ofstream::out | std::ofstream::binary);
+    if (!myTVSOutputStream.good()) {
+        logErrorF("Could not open output file %s", myTVSOutput.c_str());
+        return false;
+    }
+    return true;
 }
 
 int TVSLink::getLinkType() {
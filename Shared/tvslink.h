@@ -19,10 +19,13 @@
 #include <string>
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 #include "types.h"
 #include "link.h"
 
+// The program and input files are mapped into memory (or, where that isn't possible, read in whole), and served
+// from there; output is buffered, and written when the buffer fills, and when the emulation ends.
 class TVSLink : public Link {
 public:
     TVSLink(int linkNo, std::string tvsProgram, std::string tvsInput, std::string tvsOutput);
@@ -32,14 +35,26 @@ public:
     void writeByte(BYTE8 b);
     void resetLink(void);
     int getLinkType(void);
+    bool rebindForClone(const std::string &input, const std::string &output);
 private:
     static constexpr int TVS_MSGBUF_SIZE = 128;
+    static constexpr size_t OutputBufferSize = 65536;
+    struct MappedFile {
+        const BYTE8 *data;
+        size_t length;
+        void *mapping; // or nullptr if the file has been read into copy
+        std::vector<BYTE8> copy;
+    };
+    bool mapFile(const std::string &fileName, MappedFile &file);
+    void unmapFile(MappedFile &file);
+    void flushOutput(void);
     std::string myTVSProgram;
-    std::ifstream myTVSProgramStream;
+    MappedFile myProgram;
     std::string myTVSInput;
-    std::ifstream myTVSInputStream;
+    MappedFile myInput;
     std::string myTVSOutput;
     std::ofstream myTVSOutputStream;
+    std::vector<BYTE8> myOutputBuffer;
     WORD32 myProgramSent, myInputSent;
     WORD32 myWriteSequence{}, myReadSequence{};
 	char myMsgbuf[TVS_MSGBUF_SIZE]{};